@@ -1,5 +1,9 @@
 #include "anim.h"
 
+#if defined(ANIM_SSE)
+#include <immintrin.h>
+#endif
+
 void Serialize_AnimSkeleton(Serializer *serializer, AnimSkeleton *value)
 {
 	SV_ADD(SV_INITIAL, AssetId, id);
@@ -25,15 +29,45 @@ void Serialize_AnimTrack(Serializer *serializer, AnimTrack *value)
 	SV_ADD(SV_INITIAL, FloatList, scales);
 }
 
+void Serialize_AnimClip(Serializer *serializer, AnimClip *value)
+{
+	SV_ADD(SV_ANIM_CLIP, uint32_t, frames_length);
+	SV_ADD(SV_ANIM_CLIP, uint32_t, key_stride);
+	SV_ADD(SV_ANIM_CLIP, uint32_t, keys_length);
+	SV_ADD(SV_ANIM_CLIP, uint32_t, key_size);
+	SV_ADD(SV_ANIM_CLIP, uint32_t, tracks_length);
+	if (serializer->is_reading) {
+		value->tracks = calloc(value->tracks_length, sizeof(struct AnimClipTrack));
+		value->keys = calloc(value->keys_length * value->key_size, sizeof(uint16_t));
+	}
+	if (serializer->version>=SV_ANIM_CLIP) {
+		SerializeBytes(serializer, value->tracks, value->tracks_length * sizeof(struct AnimClipTrack));
+		SerializeBytes(serializer, value->keys, value->keys_length * value->key_size * sizeof(uint16_t));
+	}
+}
+
 void Serialize_Animation(Serializer *serializer, Animation *value)
 {
 	SV_ADD(SV_INITIAL, AssetId, id);
 	SV_ADD(SV_INITIAL, AssetId, skeleton_id);
 	SV_ADD(SV_INITIAL, AnimTrack, root_motion_track);
 	SV_ADD(SV_INITIAL, uint32_t, tracks_length);
-	for (uint32_t i = 0; i < value->tracks_length; ++i) {
-		SV_ADD(SV_INITIAL, AnimTrack, tracks[i]);
+	if (serializer->version < SV_ANIM_CLIP) {
+		// raw tracks from an old cook, compress them without key reduction
+		ASSERT(serializer->is_reading);
+		struct AnimTrack *tracks = calloc(value->tracks_length, sizeof(struct AnimTrack));
+		for (uint32_t i = 0; i < value->tracks_length; ++i) {
+			Serialize_AnimTrack(serializer, tracks + i);
+		}
+		value->clip = anim_clip_compress(tracks, value->tracks_length, 1);
+		for (uint32_t i = 0; i < value->tracks_length; ++i) {
+			free(tracks[i].translations.data);
+			free(tracks[i].rotations.data);
+			free(tracks[i].scales.data);
+		}
+		free(tracks);
 	}
+	SV_ADD(SV_ANIM_CLIP, AnimClip, clip);
 	for (uint32_t i = 0; i < value->tracks_length; ++i) {
 		SV_ADD(SV_INITIAL, uint32_t, tracks_identifier[i]);
 	}
@@ -73,27 +107,342 @@ void Serialize_SkeletalMeshAsset(Serializer *serializer, SkeletalMeshAsset *valu
 	}
 }
 
+// -- Compressed clips
+
+#define ANIM_CLIP_QUAT_RANGE 0.707106781f // all components but the largest are in [-1/sqrt(2), 1/sqrt(2)]
+#define ANIM_CLIP_CONSTANT_EPSILON 1e-6f
+
+static uint16_t _anim_clip_quantize(float value, float min, float extent, float quantized_max)
+{
+	float normalized = extent > 0.0f ? (value - min) / extent : 0.0f;
+	normalized = normalized < 0.0f ? 0.0f : (normalized > 1.0f ? 1.0f : normalized);
+	return (uint16_t)(normalized * quantized_max + 0.5f);
+}
+
+static float _anim_clip_dequantize(uint16_t value, float min, float extent)
+{
+	return min + (float)value * (1.0f / 65535.0f) * extent;
+}
+
+static void _anim_clip_encode_quat(Quat q, uint16_t *out)
+{
+	uint32_t ilargest = 0;
+	for (uint32_t i = 1; i < 4; ++i) {
+		if (fabsf(q.values[i]) > fabsf(q.values[ilargest])) {
+			ilargest = i;
+		}
+	}
+	// q and -q are the same rotation, flip it so that the dropped component is positive
+	float sign = q.values[ilargest] < 0.0f ? -1.0f : 1.0f;
+	uint32_t ivalue = 0;
+	for (uint32_t i = 0; i < 4; ++i) {
+		if (i != ilargest) {
+			out[ivalue++] = _anim_clip_quantize(sign * q.values[i], -ANIM_CLIP_QUAT_RANGE, 2.0f * ANIM_CLIP_QUAT_RANGE, 32767.0f);
+		}
+	}
+	out[0] |= (uint16_t)((ilargest & 1) << 15);
+	out[1] |= (uint16_t)((ilargest >> 1) << 15);
+}
+
+static Quat _anim_clip_decode_quat(uint16_t const *in)
+{
+	uint32_t ilargest = (uint32_t)(in[0] >> 15) | ((uint32_t)(in[1] >> 15) << 1);
+	float values[3];
+	float sum = 0.0f;
+	for (uint32_t i = 0; i < 3; ++i) {
+		values[i] = (float)(in[i] & 0x7FFF) * (2.0f * ANIM_CLIP_QUAT_RANGE / 32767.0f) - ANIM_CLIP_QUAT_RANGE;
+		sum += values[i] * values[i];
+	}
+	Quat q;
+	uint32_t ivalue = 0;
+	for (uint32_t i = 0; i < 4; ++i) {
+		q.values[i] = i == ilargest ? sqrtf(sum < 1.0f ? 1.0f - sum : 0.0f) : values[ivalue++];
+	}
+	return q;
+}
+
+static void _anim_clip_decode(struct AnimClipTrack const *track, uint16_t const *key, Float3 *translation, Quat *rotation, float *scale)
+{
+	if (track->translation_offset == ANIM_CLIP_CONSTANT) {
+		*translation = track->translation_min;
+	} else {
+		uint16_t const *t = key + track->translation_offset;
+		translation->x = _anim_clip_dequantize(t[0], track->translation_min.x, track->translation_extent.x);
+		translation->y = _anim_clip_dequantize(t[1], track->translation_min.y, track->translation_extent.y);
+		translation->z = _anim_clip_dequantize(t[2], track->translation_min.z, track->translation_extent.z);
+	}
+	if (track->rotation_offset == ANIM_CLIP_CONSTANT) {
+		*rotation = track->rotation;
+	} else {
+		*rotation = _anim_clip_decode_quat(key + track->rotation_offset);
+	}
+	if (track->scale_offset == ANIM_CLIP_CONSTANT) {
+		*scale = track->scale_min;
+	} else {
+		*scale = _anim_clip_dequantize(key[track->scale_offset], track->scale_min, track->scale_extent);
+	}
+}
+
+struct AnimClip anim_clip_compress(struct AnimTrack const *tracks, uint32_t tracks_length, uint32_t key_stride)
+{
+	ASSERT(tracks_length > 0);
+	ASSERT(0 < key_stride && key_stride <= ANIM_CLIP_MAX_KEY_STRIDE);
+	struct AnimClip clip = {0};
+	clip.frames_length = tracks[0].translations.length;
+	ASSERT(clip.frames_length > 0);
+	clip.key_stride = key_stride;
+	clip.keys_length = (clip.frames_length - 1 + key_stride - 1) / key_stride + 1;
+	clip.tracks_length = tracks_length;
+	clip.tracks = calloc(tracks_length, sizeof(struct AnimClipTrack));
+
+	// Find the constant channels and the range of the animated ones
+	for (uint32_t itrack = 0; itrack < tracks_length; ++itrack) {
+		struct AnimTrack const *track = tracks + itrack;
+		ASSERT(track->translations.length == clip.frames_length);
+		ASSERT(track->rotations.length == clip.frames_length);
+		ASSERT(track->scales.length == clip.frames_length);
+
+		Float3 translation_min = track->translations.data[0];
+		Float3 translation_max = track->translations.data[0];
+		Quat first_rotation = track->rotations.data[0];
+		bool is_rotation_constant = true;
+		float scale_min = track->scales.data[0];
+		float scale_max = track->scales.data[0];
+		for (uint32_t iframe = 1; iframe < clip.frames_length; ++iframe) {
+			Float3 translation = track->translations.data[iframe];
+			for (uint32_t i = 0; i < 3; ++i) {
+				translation_min.values[i] = fminf(translation_min.values[i], translation.values[i]);
+				translation_max.values[i] = fmaxf(translation_max.values[i], translation.values[i]);
+			}
+			Quat rotation = track->rotations.data[iframe];
+			float dot = rotation.x * first_rotation.x + rotation.y * first_rotation.y + rotation.z * first_rotation.z + rotation.w * first_rotation.w;
+			is_rotation_constant &= fabsf(dot) >= 1.0f - ANIM_CLIP_CONSTANT_EPSILON;
+			scale_min = fminf(scale_min, track->scales.data[iframe]);
+			scale_max = fmaxf(scale_max, track->scales.data[iframe]);
+		}
+
+		struct AnimClipTrack *out_track = clip.tracks + itrack;
+		Float3 translation_extent = float3_sub(translation_max, translation_min);
+		bool is_translation_constant = translation_extent.x <= ANIM_CLIP_CONSTANT_EPSILON
+			&& translation_extent.y <= ANIM_CLIP_CONSTANT_EPSILON
+			&& translation_extent.z <= ANIM_CLIP_CONSTANT_EPSILON;
+		if (is_translation_constant) {
+			out_track->translation_min = track->translations.data[0];
+			out_track->translation_offset = ANIM_CLIP_CONSTANT;
+		} else {
+			out_track->translation_min = translation_min;
+			out_track->translation_extent = translation_extent;
+			out_track->translation_offset = (uint16_t)clip.key_size;
+			clip.key_size += 3;
+		}
+		if (is_rotation_constant) {
+			out_track->rotation = first_rotation;
+			out_track->rotation_offset = ANIM_CLIP_CONSTANT;
+		} else {
+			out_track->rotation_offset = (uint16_t)clip.key_size;
+			clip.key_size += 3;
+		}
+		if (scale_max - scale_min <= ANIM_CLIP_CONSTANT_EPSILON) {
+			out_track->scale_min = track->scales.data[0];
+			out_track->scale_offset = ANIM_CLIP_CONSTANT;
+		} else {
+			out_track->scale_min = scale_min;
+			out_track->scale_extent = scale_max - scale_min;
+			out_track->scale_offset = (uint16_t)clip.key_size;
+			clip.key_size += 1;
+		}
+		ASSERT(clip.key_size < ANIM_CLIP_CONSTANT);
+	}
+
+	// Quantize the animated channels
+	clip.keys = calloc(clip.keys_length * clip.key_size, sizeof(uint16_t));
+	for (uint32_t ikey = 0; ikey < clip.keys_length; ++ikey) {
+		uint32_t frame = ikey * key_stride < clip.frames_length ? ikey * key_stride : clip.frames_length - 1;
+		uint16_t *key = clip.keys + ikey * clip.key_size;
+		for (uint32_t itrack = 0; itrack < tracks_length; ++itrack) {
+			struct AnimTrack const *track = tracks + itrack;
+			struct AnimClipTrack const *clip_track = clip.tracks + itrack;
+			if (clip_track->translation_offset != ANIM_CLIP_CONSTANT) {
+				Float3 translation = track->translations.data[frame];
+				for (uint32_t i = 0; i < 3; ++i) {
+					key[clip_track->translation_offset + i] = _anim_clip_quantize(translation.values[i], clip_track->translation_min.values[i], clip_track->translation_extent.values[i], 65535.0f);
+				}
+			}
+			if (clip_track->rotation_offset != ANIM_CLIP_CONSTANT) {
+				_anim_clip_encode_quat(track->rotations.data[frame], key + clip_track->rotation_offset);
+			}
+			if (clip_track->scale_offset != ANIM_CLIP_CONSTANT) {
+				key[clip_track->scale_offset] = _anim_clip_quantize(track->scales.data[frame], clip_track->scale_min, clip_track->scale_extent, 65535.0f);
+			}
+		}
+	}
+
+	return clip;
+}
+
+void anim_clip_term(struct AnimClip *clip)
+{
+	free(clip->tracks);
+	free(clip->keys);
+	*clip = (struct AnimClip){0};
+}
+
+static void _anim_transforms_set(struct AnimTransformsSoA *transforms, uint32_t i, Float3 translation, Quat rotation, float scale)
+{
+	transforms->translation_x[i] = translation.x;
+	transforms->translation_y[i] = translation.y;
+	transforms->translation_z[i] = translation.z;
+	transforms->rotation_x[i] = rotation.x;
+	transforms->rotation_y[i] = rotation.y;
+	transforms->rotation_z[i] = rotation.z;
+	transforms->rotation_w[i] = rotation.w;
+	transforms->scale[i] = scale;
+}
+
+void anim_clip_sample(struct AnimClip const *clip, uint32_t frame, struct AnimTransformsSoA *out_transforms)
+{
+	ASSERT(frame < clip->frames_length);
+	uint32_t ikey = frame / clip->key_stride;
+	uint32_t key_frame = ikey * clip->key_stride;
+	uint16_t const *key = clip->keys + ikey * clip->key_size;
+
+	if (key_frame == frame) {
+		for (uint32_t itrack = 0; itrack < clip->tracks_length; ++itrack) {
+			Float3 translation;
+			Quat rotation;
+			float scale;
+			_anim_clip_decode(clip->tracks + itrack, key, &translation, &rotation, &scale);
+			_anim_transforms_set(out_transforms, itrack, translation, rotation, scale);
+		}
+		return;
+	}
+
+	// Key reduction, interpolate between the two surrounding keys
+	uint32_t next_key_frame = key_frame + clip->key_stride < clip->frames_length ? key_frame + clip->key_stride : clip->frames_length - 1;
+	float coef = (float)(frame - key_frame) / (float)(next_key_frame - key_frame);
+	uint16_t const *next_key = key + clip->key_size;
+	for (uint32_t itrack = 0; itrack < clip->tracks_length; ++itrack) {
+		Float3 translation, next_translation;
+		Quat rotation, next_rotation;
+		float scale, next_scale;
+		_anim_clip_decode(clip->tracks + itrack, key, &translation, &rotation, &scale);
+		_anim_clip_decode(clip->tracks + itrack, next_key, &next_translation, &next_rotation, &next_scale);
+
+		float dot = rotation.x * next_rotation.x + rotation.y * next_rotation.y + rotation.z * next_rotation.z + rotation.w * next_rotation.w;
+		float next_coef = dot < 0.0f ? -coef : coef;
+		for (uint32_t i = 0; i < 4; ++i) {
+			rotation.values[i] = rotation.values[i] * (1.0f - coef) + next_rotation.values[i] * next_coef;
+		}
+		translation = float3_lerp(translation, next_translation, coef);
+		scale = float_lerp(scale, next_scale, coef);
+		_anim_transforms_set(out_transforms, itrack, translation, quat_normalize(rotation), scale);
+	}
+}
+
+void anim_transforms_to_matrices_scalar(struct AnimTransformsSoA const *transforms, uint32_t count, Float3x4 *out_matrices)
+{
+	for (uint32_t i = 0; i < count; ++i) {
+		Float3 translation = {transforms->translation_x[i], transforms->translation_y[i], transforms->translation_z[i]};
+		Quat rotation = {transforms->rotation_x[i], transforms->rotation_y[i], transforms->rotation_z[i], transforms->rotation_w[i]};
+		out_matrices[i] = float3x4_from_transform(translation, rotation, float3_from_float(transforms->scale[i]));
+	}
+}
+
+#if defined(ANIM_SSE)
+// Same operations in the same order as float3x4_from_transform, on 4 bones
+static void _anim_transforms_to_matrices_sse(struct AnimTransformsSoA const *transforms, uint32_t count, Float3x4 *out_matrices)
+{
+	__m128 sign = _mm_set1_ps(-0.0f);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 half = _mm_set1_ps(0.5f);
+	for (uint32_t i = 0; i < count; i += ANIM_SIMD_WIDTH) {
+		__m128 qx = _mm_loadu_ps(transforms->rotation_x + i);
+		__m128 qy = _mm_loadu_ps(transforms->rotation_y + i);
+		__m128 qz = _mm_loadu_ps(transforms->rotation_z + i);
+		__m128 qw = _mm_loadu_ps(transforms->rotation_w + i);
+		__m128 s = _mm_mul_ps(two, _mm_loadu_ps(transforms->scale + i));
+		__m128 xx = _mm_mul_ps(qx, qx), xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), xw = _mm_mul_ps(qx, qw);
+		__m128 yy = _mm_mul_ps(qy, qy), yz = _mm_mul_ps(qy, qz), yw = _mm_mul_ps(qy, qw);
+		__m128 zz = _mm_mul_ps(qz, qz), zw = _mm_mul_ps(qz, qw);
+
+		// m[k] is the k-th value of the 4 matrices
+		__m128 m[12];
+		m[0] = _mm_mul_ps(s, _mm_add_ps(_mm_sub_ps(_mm_xor_ps(yy, sign), zz), half));
+		m[1] = _mm_mul_ps(s, _mm_add_ps(xy, zw));
+		m[2] = _mm_mul_ps(s, _mm_add_ps(_mm_xor_ps(yw, sign), xz));
+		m[3] = _mm_mul_ps(s, _mm_add_ps(_mm_xor_ps(zw, sign), xy));
+		m[4] = _mm_mul_ps(s, _mm_add_ps(_mm_sub_ps(_mm_xor_ps(xx, sign), zz), half));
+		m[5] = _mm_mul_ps(s, _mm_add_ps(xw, yz));
+		m[6] = _mm_mul_ps(s, _mm_add_ps(xz, yw));
+		m[7] = _mm_mul_ps(s, _mm_add_ps(_mm_xor_ps(xw, sign), yz));
+		m[8] = _mm_mul_ps(s, _mm_add_ps(_mm_sub_ps(_mm_xor_ps(xx, sign), yy), half));
+		m[9] = _mm_loadu_ps(transforms->translation_x + i);
+		m[10] = _mm_loadu_ps(transforms->translation_y + i);
+		m[11] = _mm_loadu_ps(transforms->translation_z + i);
+
+		// transpose to one matrix per lane
+		_MM_TRANSPOSE4_PS(m[0], m[1], m[2], m[3]);
+		_MM_TRANSPOSE4_PS(m[4], m[5], m[6], m[7]);
+		_MM_TRANSPOSE4_PS(m[8], m[9], m[10], m[11]);
+		uint32_t lanes = count - i < ANIM_SIMD_WIDTH ? count - i : ANIM_SIMD_WIDTH;
+		for (uint32_t lane = 0; lane < lanes; ++lane) {
+			float *out = out_matrices[i + lane].values;
+			_mm_storeu_ps(out + 0, m[lane]);
+			_mm_storeu_ps(out + 4, m[4 + lane]);
+			_mm_storeu_ps(out + 8, m[8 + lane]);
+		}
+	}
+}
+
+// Same operations in the same order as float3x4_mul, a column per register
+static void _anim_mul_sse(float const *a, float const *b, float *out)
+{
+	__m128 a0 = _mm_loadu_ps(a + 0);
+	__m128 a1 = _mm_loadu_ps(a + 3);
+	__m128 a2 = _mm_loadu_ps(a + 6);
+	__m128 a3 = _mm_loadu_ps(a + 8);
+	a3 = _mm_shuffle_ps(a3, a3, _MM_SHUFFLE(3, 3, 2, 1));
+
+	__m128 r[4];
+	for (uint32_t j = 0; j < 4; ++j) {
+		r[j] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[3*j+0])), _mm_mul_ps(a1, _mm_set1_ps(b[3*j+1]))), _mm_mul_ps(a2, _mm_set1_ps(b[3*j+2])));
+	}
+	r[3] = _mm_add_ps(r[3], a3);
+
+	// pack the 4 columns of 3 floats
+	__m128 t = _mm_shuffle_ps(r[0], r[1], _MM_SHUFFLE(0, 0, 2, 2));
+	_mm_storeu_ps(out + 0, _mm_shuffle_ps(r[0], t, _MM_SHUFFLE(2, 0, 1, 0)));
+	_mm_storeu_ps(out + 4, _mm_shuffle_ps(r[1], r[2], _MM_SHUFFLE(1, 0, 2, 1)));
+	t = _mm_shuffle_ps(r[2], r[3], _MM_SHUFFLE(0, 0, 2, 2));
+	_mm_storeu_ps(out + 8, _mm_shuffle_ps(t, r[3], _MM_SHUFFLE(2, 1, 2, 0)));
+}
+#endif
+
+void anim_transforms_to_matrices(struct AnimTransformsSoA const *transforms, uint32_t count, Float3x4 *out_matrices)
+{
+	ASSERT(count <= MAX_BONES_PER_MESH);
+#if defined(ANIM_SSE)
+	_anim_transforms_to_matrices_sse(transforms, count, out_matrices);
+#else
+	anim_transforms_to_matrices_scalar(transforms, count, out_matrices);
+#endif
+}
+
 bool anim_evaluate_animation(struct AnimSkeleton const *skeleton, Animation const* anim, struct AnimPose *out_pose, uint32_t frame)
 {
-	uint32_t count = anim->tracks[0].translations.length;
+	uint32_t count = anim->clip.frames_length;
 	bool has_ended = frame >= count;
 
 	if (frame >= count) {
 		frame = count - 1;
 	}
 	out_pose->bones_length = skeleton->bones_length;
+	ASSERT(anim->clip.tracks_length == anim->tracks_length);
 	for (uint32_t ibone = 0; ibone < anim->tracks_length; ++ibone) {
-		ASSERT(anim->tracks[ibone].translations.length == count);
-		ASSERT(anim->tracks[ibone].rotations.length == count);
-		ASSERT(anim->tracks[ibone].scales.length == count);
 		ASSERT(anim->tracks_identifier[ibone] == skeleton->bones_identifier[ibone]);
-
-		Float3 translation = anim->tracks[ibone].translations.data[frame];
-		Quat rotation = anim->tracks[ibone].rotations.data[frame];
-		float scale = anim->tracks[ibone].scales.data[frame];
-
-		out_pose->local_transforms[ibone] = float3x4_from_transform(translation, rotation, float3_from_float(scale));
 	}
+	anim_clip_sample(&anim->clip, frame, &out_pose->local_trs);
+	anim_transforms_to_matrices(&out_pose->local_trs, anim->clip.tracks_length, out_pose->local_transforms);
 
 	if (frame > 0) {
 		// apply the translation from previous frame to this frame
@@ -122,6 +471,21 @@ bool anim_evaluate_animation(struct AnimSkeleton const *skeleton, Animation cons
 }
 
 void anim_pose_compute_global_transforms(struct AnimSkeleton const *skeleton, struct AnimPose *pose)
+{
+#if defined(ANIM_SSE)
+	// The hierarchy is sequential, each multiply is vectorized over the rows of a column
+	_anim_mul_sse(skeleton->bones_global_transforms[0].values, pose->local_transforms[0].values, pose->global_transforms[0].values);
+	for (uint32_t i = 1; i < skeleton->bones_length; ++i) {
+		uint8_t iparent = skeleton->bones_parent[i];
+		ASSERT(iparent < i);
+		_anim_mul_sse(pose->global_transforms[iparent].values, pose->local_transforms[i].values, pose->global_transforms[i].values);
+	}
+#else
+	anim_pose_compute_global_transforms_scalar(skeleton, pose);
+#endif
+}
+
+void anim_pose_compute_global_transforms_scalar(struct AnimSkeleton const *skeleton, struct AnimPose *pose)
 {
 	pose->global_transforms[0] = float3x4_mul(skeleton->bones_global_transforms[0], pose->local_transforms[0]);
 	for (uint32_t i = 1; i < skeleton->bones_length; ++i) {
@@ -131,6 +495,26 @@ void anim_pose_compute_global_transforms(struct AnimSkeleton const *skeleton, st
 	}
 }
 
+uint32_t anim_skeleton_find_bone(struct AnimSkeleton const *skeleton, uint32_t bone_identifier)
+{
+	for (uint32_t ibone = 0; ibone < skeleton->bones_length; ++ibone) {
+		if (skeleton->bones_identifier[ibone] == bone_identifier) {
+			return ibone;
+		}
+	}
+	return MAX_BONES_PER_MESH;
+}
+
+void anim_pose_gather_bone_positions(struct AnimPose const *pose, Float3x4 world_transform, uint8_t const *bone_indices, uint32_t count, float *out_x, float *out_y, float *out_z)
+{
+	for (uint32_t i = 0; i < count; ++i) {
+		Float3 position = float3x4_transform_point(world_transform, pose->global_transforms[bone_indices[i]].cols[3]);
+		out_x[i] = position.x;
+		out_y[i] = position.y;
+		out_z[i] = position.z;
+	}
+}
+
 void skeletal_mesh_create_instance(struct SkeletalMeshAsset const *asset, struct SkeletalMeshInstance *instance, struct AnimSkeleton const *skeleton)
 {
 	instance->asset = asset;
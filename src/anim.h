@@ -4,7 +4,14 @@
 #define MAX_ANIMATIONS_PER_ASSET 64
 
 #define AssetId uint32_t
+
+// Pose kernels work on ANIM_SIMD_WIDTH bones at a time, with a scalar fallback
+#define ANIM_SIMD_WIDTH 4
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIM_SSE 1
+#endif
 typedef struct AnimTrack AnimTrack;
+typedef struct AnimClip AnimClip;
 typedef struct Animation Animation;
 typedef struct AnimSkeleton AnimSkeleton;
 
@@ -34,12 +41,49 @@ struct AnimTrack
 	struct FloatList scales;
 };
 
+/**
+Compressed bone tracks, produced by the cooker.
+
+Each track has 3 channels: translation, rotation and uniform scale. Constant channels are stored once at full
+precision in their AnimClipTrack, animated channels are quantized in keys of uint16_t:
+- translation and scale are range reduced: value = min + q / 65535 * extent
+- rotations use the smallest three: the 3 smallest components on 15 bits, the index of the dropped one
+  in the top bit of the first two values
+A key holds the animated channels of every track, so sampling a frame reads one contiguous block.
+With key reduction only one frame every key_stride is stored, frames in between are interpolated.
+ **/
+#define ANIM_CLIP_CONSTANT 0xFFFF // channel offset of a constant channel
+#define ANIM_CLIP_MAX_KEY_STRIDE 8
+
+struct AnimClipTrack
+{
+	Float3 translation_min; // constant value if translation_offset is ANIM_CLIP_CONSTANT
+	Float3 translation_extent;
+	Quat rotation; // constant value if rotation_offset is ANIM_CLIP_CONSTANT
+	float scale_min; // constant value if scale_offset is ANIM_CLIP_CONSTANT
+	float scale_extent;
+	uint16_t translation_offset; // in uint16_t from the start of a key
+	uint16_t rotation_offset;
+	uint16_t scale_offset;
+};
+
+struct AnimClip
+{
+	uint32_t frames_length; // frames of the source animation
+	uint32_t key_stride; // 1 without key reduction
+	uint32_t keys_length;
+	uint32_t key_size; // number of uint16_t per key
+	uint32_t tracks_length;
+	struct AnimClipTrack *tracks;
+	uint16_t *keys;
+};
+
 struct Animation
 {
 	AssetId id;
 	AssetId skeleton_id;
-	struct AnimTrack root_motion_track;
-	struct AnimTrack tracks[MAX_BONES_PER_MESH];
+	struct AnimTrack root_motion_track; // not compressed, it moves the character
+	struct AnimClip clip;
 	uint32_t tracks_identifier[MAX_BONES_PER_MESH]; // debug only
 	uint32_t tracks_length;
 };
@@ -53,11 +97,25 @@ enum AnimPoseState
 	ANIM_POSE_STATE_ADDITIVE,
 };
 
+// Bone space transforms stored SoA, ANIM_SIMD_WIDTH bones are converted to matrices at once
+struct AnimTransformsSoA
+{
+	float translation_x[MAX_BONES_PER_MESH];
+	float translation_y[MAX_BONES_PER_MESH];
+	float translation_z[MAX_BONES_PER_MESH];
+	float rotation_x[MAX_BONES_PER_MESH];
+	float rotation_y[MAX_BONES_PER_MESH];
+	float rotation_z[MAX_BONES_PER_MESH];
+	float rotation_w[MAX_BONES_PER_MESH];
+	float scale[MAX_BONES_PER_MESH];
+};
+
 struct AnimPose
 {
 	AnimSkeleton const* anim_skeleton;
 	uint32_t bones_length;
 	enum AnimPoseState state;
+	struct AnimTransformsSoA local_trs; // bone space, sampled from the animation
 	Float3x4 local_transforms[MAX_BONES_PER_MESH]; // bone space
 	Float3x4 global_transforms[MAX_BONES_PER_MESH]; // character space
 	Float3  root_motion_delta_translation;
@@ -93,12 +151,28 @@ struct SkeletalMeshInstance
 };
 
 void Serialize_AnimTrack(Serializer *serializer, AnimTrack *value);
+void Serialize_AnimClip(Serializer *serializer, AnimClip *value);
 void Serialize_Animation(Serializer *serializer, Animation *value);
 void Serialize_AnimSkeleton(Serializer *serializer, AnimSkeleton *value);
 void Serialize_SkeletalMeshAsset(Serializer *serializer, SkeletalMeshAsset *value);
 
+// Compress tracks that all have the same number of frames, only keeps one frame every key_stride
+struct AnimClip anim_clip_compress(struct AnimTrack const *tracks, uint32_t tracks_length, uint32_t key_stride);
+void anim_clip_term(struct AnimClip *clip);
+// Decompress the clip tracks at frame into local transforms
+void anim_clip_sample(struct AnimClip const *clip, uint32_t frame, struct AnimTransformsSoA *out_transforms);
+// TRS to matrices, the SIMD path gives the same bits as float3x4_from_transform
+void anim_transforms_to_matrices(struct AnimTransformsSoA const *transforms, uint32_t count, Float3x4 *out_matrices);
+void anim_transforms_to_matrices_scalar(struct AnimTransformsSoA const *transforms, uint32_t count, Float3x4 *out_matrices);
+
 bool anim_evaluate_animation(struct AnimSkeleton const *skeleton, Animation const* anim, struct AnimPose *out_pose, uint32_t frame);
+// Parent to child order, the SIMD path gives the same bits as float3x4_mul
 void anim_pose_compute_global_transforms(struct AnimSkeleton const *skeleton, struct AnimPose *pose);
+void anim_pose_compute_global_transforms_scalar(struct AnimSkeleton const *skeleton, struct AnimPose *pose);
+// Returns MAX_BONES_PER_MESH if the skeleton does not have this bone
+uint32_t anim_skeleton_find_bone(struct AnimSkeleton const *skeleton, uint32_t bone_identifier);
+// World positions of a list of bones: out_positions[i] = world_transform * global_transforms[bone_indices[i]]
+void anim_pose_gather_bone_positions(struct AnimPose const *pose, Float3x4 world_transform, uint8_t const *bone_indices, uint32_t count, float *out_x, float *out_y, float *out_z);
 
 void skeletal_mesh_create_instance(struct SkeletalMeshAsset const *asset, struct SkeletalMeshInstance *instance, struct AnimSkeleton const *skeleton);
 void skeletal_mesh_apply_pose(struct SkeletalMeshInstance *instance, struct AnimPose *pose);
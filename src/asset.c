@@ -1,6 +1,11 @@
 #include "asset.h"
 #include "anim.h"
 
+#if !defined(XXH_INLINE_ALL)
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+#endif
+
 void Serialize_MaterialAsset(Serializer *serializer, MaterialAsset *value)
 {
 	SV_ADD(SV_INITIAL, Blob, vertex_shader_bytecode);
@@ -25,118 +30,222 @@ void Serialize_SkeletalMeshWithAnimationsAsset(Serializer *serializer, SkeletalM
 	}
 }
 
-MaterialAsset const *asset_library_get_material(struct AssetLibrary *assets, AssetId id)
+// -- Asset table
+
+static uint32_t _asset_table_hash(AssetId id)
+{
+	uint32_t h = id * 0x9E3779B9u;
+	h ^= h >> 16;
+	return h;
+}
+
+static uint32_t _asset_table_index_of(struct AssetTable const *table, AssetId id)
 {
-	for (uint32_t i = 0; i < ASSET_MATERIAL_CAPACITY; ++i) {
-		if (assets->materials_id[i] == id) {
-			return assets->materials + i;
+	if (table->index_capacity == 0) {
+		return UINT32_MAX;
+	}
+	uint32_t mask = table->index_capacity - 1;
+	for (uint32_t islot = _asset_table_hash(id) & mask;; islot = (islot + 1) & mask) {
+		uint32_t ielement = table->index[islot];
+		if (ielement == 0) {
+			return UINT32_MAX;
+		}
+		if (table->ids[ielement - 1] == id) {
+			return ielement - 1;
 		}
 	}
-	ASSERT(false);
-	return NULL;
 }
 
-ComputeProgramAsset const *asset_library_get_compute_program(struct AssetLibrary *assets, AssetId id)
+static void _asset_table_index_insert(struct AssetTable *table, uint32_t ielement)
 {
-	for (uint32_t i = 0; i < ASSET_COMPUTE_PROGRAM_CAPACITY; ++i) {
-		if (assets->compute_programs_id[i] == id) {
-			return assets->compute_programs + i;
-		}
+	uint32_t mask = table->index_capacity - 1;
+	uint32_t islot = _asset_table_hash(table->ids[ielement]) & mask;
+	while (table->index[islot] != 0) {
+		islot = (islot + 1) & mask;
 	}
-	ASSERT(false);
-	return NULL;
+	table->index[islot] = ielement + 1;
 }
 
-SkeletalMeshAsset const *asset_library_get_skeletal_mesh(struct AssetLibrary *assets, AssetId id)
+static void _asset_table_grow_index(struct AssetTable *table)
 {
-	for (uint32_t i = 0; i < ASSET_SKELETAL_MESH_CAPACITY; ++i) {
-		if (assets->skeletal_meshes_id[i] == id) {
-			return assets->skeletal_meshes + i;
-		}
+	uint32_t capacity = table->index_capacity ? 2 * table->index_capacity : 64;
+	free(table->index);
+	table->index = calloc(capacity, sizeof(uint32_t));
+	table->index_capacity = capacity;
+	for (uint32_t ielement = 0; ielement < table->length; ++ielement) {
+		_asset_table_index_insert(table, ielement);
 	}
-	ASSERT(false);
-	return NULL;
 }
 
-AnimSkeleton const *asset_library_get_anim_skeleton(struct AssetLibrary *assets, AssetId id)
+static void _asset_table_grow_storage(struct AssetTable *table, uint32_t element_size)
 {
-	for (uint32_t i = 0; i < ASSET_ANIM_SKELETON_CAPACITY; ++i) {
-		if (assets->anim_skeletons_id[i] == id) {
-			return assets->anim_skeletons + i;
-		}
+	table->pages = realloc(table->pages, (table->pages_length + 1) * sizeof(void*));
+	table->pages[table->pages_length] = calloc(ASSET_TABLE_PAGE_SIZE, element_size);
+	table->pages_length += 1;
+	table->capacity += ASSET_TABLE_PAGE_SIZE;
+	table->ids = realloc(table->ids, table->capacity * sizeof(AssetId));
+	table->generations = realloc(table->generations, table->capacity * sizeof(uint16_t));
+}
+
+AssetHandle asset_table_find(struct AssetTable const *table, AssetId id)
+{
+	uint32_t ielement = _asset_table_index_of(table, id);
+	if (ielement == UINT32_MAX) {
+		return ASSET_HANDLE_INVALID;
 	}
-	ASSERT(false);
-	return NULL;
+	return ((uint32_t)table->generations[ielement] << 16) | ielement;
 }
 
-Animation const *asset_library_get_animation(struct AssetLibrary *assets, AssetId id)
+void *asset_table_at(struct AssetTable const *table, uint32_t index, uint32_t element_size)
 {
-	for (uint32_t i = 0; i < ASSET_ANIMATIONS_CAPACITY; ++i) {
-		if (assets->animations_id[i] == id) {
-			return assets->animations + i;
-		}
+	ASSERT(index < table->length);
+	uint8_t *page = table->pages[index / ASSET_TABLE_PAGE_SIZE];
+	return page + (index % ASSET_TABLE_PAGE_SIZE) * element_size;
+}
+
+void *asset_table_get(struct AssetTable const *table, AssetHandle handle, uint32_t element_size)
+{
+	uint32_t ielement = handle & 0xFFFF;
+	uint16_t generation = (uint16_t)(handle >> 16);
+	if (handle == ASSET_HANDLE_INVALID || ielement >= table->length || table->generations[ielement] != generation) {
+		ASSERT(false); // stale handle
+		return NULL;
 	}
-	ASSERT(false);
-	return NULL;
+	return asset_table_at(table, ielement, element_size);
 }
 
-AssetId asset_library_add_material(struct AssetLibrary *assets, struct MaterialAsset material)
+AssetHandle asset_table_add(struct AssetTable *table, AssetId id, void const *element, uint32_t element_size)
 {
-	// support hot reload
-	for (uint32_t i = 0;  i  < ASSET_MATERIAL_CAPACITY; ++i) {
-		if (assets->materials_id[i] == material.id) {
-			assets->materials[i] = material;
-			return material.id;
-		}
+	// support hot reload, the asset is replaced in place and keeps its handle
+	uint32_t ielement = _asset_table_index_of(table, id);
+	if (ielement != UINT32_MAX) {
+		memcpy(asset_table_at(table, ielement, element_size), element, element_size);
+		return asset_table_find(table, id);
 	}
 
-	uint32_t i = assets->material_generation++;
-	ASSERT(i < ASSET_MATERIAL_CAPACITY);
-	assets->materials[i] = material;
-	assets->materials_id[i] = material.id;
-	return material.id;
+	ielement = table->length;
+	ASSERT(ielement < 0xFFFF);
+	if (ielement == table->capacity) {
+		_asset_table_grow_storage(table, element_size);
+	}
+	table->ids[ielement] = id;
+	table->length += 1;
+	// keep the load factor under 1/2, growing rebuilds the index with the new element
+	if (2 * table->length > table->index_capacity) {
+		_asset_table_grow_index(table);
+	} else {
+		_asset_table_index_insert(table, ielement);
+	}
+
+	// generation 0 is reserved so that a valid handle is never 0
+	table->generation += 1;
+	if (table->generation == 0) {
+		table->generation = 1;
+	}
+	table->generations[ielement] = table->generation;
+	memcpy(asset_table_at(table, ielement, element_size), element, element_size);
+	return asset_table_find(table, id);
 }
 
-AssetId asset_library_add_compute_program(struct AssetLibrary *assets, struct ComputeProgramAsset program)
+void asset_table_term(struct AssetTable *table)
 {
-	// support hot reload
-	for (uint32_t i = 0;  i  < ASSET_COMPUTE_PROGRAM_CAPACITY; ++i) {
-		if (assets->compute_programs_id[i] == program.id) {
-			assets->compute_programs[i] = program;
-			return program.id;
-		}
+	for (uint32_t ipage = 0; ipage < table->pages_length; ++ipage) {
+		free(table->pages[ipage]);
 	}
+	free(table->pages);
+	free(table->ids);
+	free(table->generations);
+	free(table->index);
+	memset(table, 0, sizeof(struct AssetTable));
+}
+
+// -- Asset library
+
+void asset_library_add_content_hash(struct AssetLibrary *assets, struct Blob content)
+{
+	assets->content_hash = XXH3_64bits_withSeed(content.data, content.size, assets->content_hash);
+}
+
+void asset_library_term(struct AssetLibrary *assets)
+{
+	asset_table_term(&assets->materials);
+	asset_table_term(&assets->compute_programs);
+	asset_table_term(&assets->skeletal_meshes);
+	asset_table_term(&assets->anim_skeletons);
+	asset_table_term(&assets->animations);
+}
 
-	uint32_t i = assets->compute_program_generation++;
-	ASSERT(i < ASSET_COMPUTE_PROGRAM_CAPACITY);
-	assets->compute_programs[i] = program;
-	assets->compute_programs_id[i] = program.id;
+MaterialAsset const *asset_library_get_material(struct AssetLibrary *assets, AssetId id)
+{
+	return asset_table_get(&assets->materials, asset_table_find(&assets->materials, id), sizeof(MaterialAsset));
+}
+
+ComputeProgramAsset const *asset_library_get_compute_program(struct AssetLibrary *assets, AssetId id)
+{
+	return asset_table_get(&assets->compute_programs, asset_table_find(&assets->compute_programs, id), sizeof(ComputeProgramAsset));
+}
+
+SkeletalMeshAsset const *asset_library_get_skeletal_mesh(struct AssetLibrary *assets, AssetId id)
+{
+	return asset_table_get(&assets->skeletal_meshes, asset_table_find(&assets->skeletal_meshes, id), sizeof(SkeletalMeshAsset));
+}
+
+AnimSkeleton const *asset_library_get_anim_skeleton(struct AssetLibrary *assets, AssetId id)
+{
+	return asset_table_get(&assets->anim_skeletons, asset_table_find(&assets->anim_skeletons, id), sizeof(AnimSkeleton));
+}
+
+Animation const *asset_library_get_animation(struct AssetLibrary *assets, AssetId id)
+{
+	return asset_table_get(&assets->animations, asset_table_find(&assets->animations, id), sizeof(Animation));
+}
+
+AssetHandle asset_library_find_anim_skeleton(struct AssetLibrary *assets, AssetId id)
+{
+	return asset_table_find(&assets->anim_skeletons, id);
+}
+
+AssetHandle asset_library_find_animation(struct AssetLibrary *assets, AssetId id)
+{
+	return asset_table_find(&assets->animations, id);
+}
+
+AnimSkeleton const *asset_library_anim_skeleton_from_handle(struct AssetLibrary *assets, AssetHandle handle)
+{
+	return asset_table_get(&assets->anim_skeletons, handle, sizeof(AnimSkeleton));
+}
+
+Animation const *asset_library_animation_from_handle(struct AssetLibrary *assets, AssetHandle handle)
+{
+	return asset_table_get(&assets->animations, handle, sizeof(Animation));
+}
+
+AssetId asset_library_add_material(struct AssetLibrary *assets, struct MaterialAsset material)
+{
+	asset_table_add(&assets->materials, material.id, &material, sizeof(MaterialAsset));
+	return material.id;
+}
+
+AssetId asset_library_add_compute_program(struct AssetLibrary *assets, struct ComputeProgramAsset program)
+{
+	asset_table_add(&assets->compute_programs, program.id, &program, sizeof(ComputeProgramAsset));
 	return program.id;
 }
 
 AssetId asset_library_add_skeletal_mesh(struct AssetLibrary *assets, struct SkeletalMeshAsset skeletal_mesh)
 {
-	uint32_t i = assets->skeletal_mesh_generation++;
-	ASSERT(i < ASSET_SKELETAL_MESH_CAPACITY);
-	assets->skeletal_meshes[i] = skeletal_mesh;
-	assets->skeletal_meshes_id[i] = skeletal_mesh.id;
+	asset_table_add(&assets->skeletal_meshes, skeletal_mesh.id, &skeletal_mesh, sizeof(SkeletalMeshAsset));
 	return skeletal_mesh.id;
 }
 
 AssetId asset_library_add_anim_skeleton(struct AssetLibrary *assets, struct AnimSkeleton anim_skeleton)
 {
-	uint32_t i = assets->anim_skeleton_generation++;
-	ASSERT(i < ASSET_ANIM_SKELETON_CAPACITY);
-	assets->anim_skeletons[i] = anim_skeleton;
-	assets->anim_skeletons_id[i] = anim_skeleton.id;
+	asset_table_add(&assets->anim_skeletons, anim_skeleton.id, &anim_skeleton, sizeof(AnimSkeleton));
 	return anim_skeleton.id;
 }
 
 AssetId asset_library_add_animation(struct AssetLibrary *assets, struct Animation animation)
 {
-	uint32_t i = assets->animation_generation++;
-	ASSERT(i < ASSET_ANIMATIONS_CAPACITY);
-	assets->animations[i] = animation;
-	assets->animations_id[i] = animation.id;
+	asset_table_add(&assets->animations, animation.id, &animation, sizeof(Animation));
 	return animation.id;
 }
@@ -35,37 +35,53 @@ struct SkeletalMeshWithAnimationsAsset
 };
 void Serialize_SkeletalMeshWithAnimationsAsset(Serializer *serializer, SkeletalMeshWithAnimationsAsset *value);
 
-#define ASSET_MATERIAL_CAPACITY 8
-#define ASSET_COMPUTE_PROGRAM_CAPACITY 8
-#define ASSET_SKELETAL_MESH_CAPACITY 4
-#define ASSET_ANIM_SKELETON_CAPACITY 4
-#define ASSET_ANIMATIONS_CAPACITY 128
+// Generational handle: (generation << 16) | index in the asset table, 0 is invalid
+typedef uint32_t AssetHandle;
+#define ASSET_HANDLE_INVALID 0
+#define ASSET_TABLE_PAGE_SIZE 64 // elements per page, pages never move so asset pointers stay valid
 
-struct AssetLibrary
+// Growable asset storage with an open addressing id -> index hash
+struct AssetTable
 {
-	MaterialAsset materials[ASSET_MATERIAL_CAPACITY];
-	AssetId materials_id[ASSET_MATERIAL_CAPACITY];
-	ComputeProgramAsset compute_programs[ASSET_COMPUTE_PROGRAM_CAPACITY];
-	AssetId compute_programs_id[ASSET_COMPUTE_PROGRAM_CAPACITY];
-	SkeletalMeshAsset skeletal_meshes[ASSET_SKELETAL_MESH_CAPACITY];
-	AssetId skeletal_meshes_id[ASSET_SKELETAL_MESH_CAPACITY];
-	AnimSkeleton anim_skeletons[ASSET_ANIM_SKELETON_CAPACITY];
-	AssetId anim_skeletons_id[ASSET_ANIM_SKELETON_CAPACITY];
-	Animation animations[ASSET_ANIMATIONS_CAPACITY];
-	AssetId animations_id[ASSET_ANIMATIONS_CAPACITY];
+	void **pages;
+	uint32_t pages_length;
+	AssetId *ids;
+	uint16_t *generations;
+	uint32_t length;
+	uint32_t capacity;
+	uint32_t *index; // element index + 1, 0 is empty
+	uint32_t index_capacity; // power of 2
+	uint16_t generation;
+};
+
+AssetHandle asset_table_find(struct AssetTable const *table, AssetId id);
+void *asset_table_get(struct AssetTable const *table, AssetHandle handle, uint32_t element_size);
+void *asset_table_at(struct AssetTable const *table, uint32_t index, uint32_t element_size);
+AssetHandle asset_table_add(struct AssetTable *table, AssetId id, void const *element, uint32_t element_size);
+void asset_table_term(struct AssetTable *table);
 
-	AssetId material_generation;
-	AssetId compute_program_generation;
-	AssetId skeletal_mesh_generation;
-	AssetId anim_skeleton_generation;
-	AssetId animation_generation;
+struct AssetLibrary
+{
+	struct AssetTable materials;
+	struct AssetTable compute_programs;
+	struct AssetTable skeletal_meshes;
+	struct AssetTable anim_skeletons;
+	struct AssetTable animations;
+	uint64_t content_hash; // of the cooked files loaded in the library, identifies the assets of a replay
 };
 
+void asset_library_term(struct AssetLibrary *assets);
+void asset_library_add_content_hash(struct AssetLibrary *assets, struct Blob content);
 MaterialAsset const *asset_library_get_material(struct AssetLibrary *assets, AssetId id);
 ComputeProgramAsset const *asset_library_get_compute_program(struct AssetLibrary *assets, AssetId id);
 SkeletalMeshAsset const *asset_library_get_skeletal_mesh(struct AssetLibrary *assets, AssetId id);
 AnimSkeleton const *asset_library_get_anim_skeleton(struct AssetLibrary *assets, AssetId id);
 Animation const *asset_library_get_animation(struct AssetLibrary *assets, AssetId id);
+// Handles are resolved once at load, getting an asset from its handle is a direct index
+AssetHandle asset_library_find_anim_skeleton(struct AssetLibrary *assets, AssetId id);
+AssetHandle asset_library_find_animation(struct AssetLibrary *assets, AssetId id);
+AnimSkeleton const *asset_library_anim_skeleton_from_handle(struct AssetLibrary *assets, AssetHandle handle);
+Animation const *asset_library_animation_from_handle(struct AssetLibrary *assets, AssetHandle handle);
 AssetId asset_library_add_material(struct AssetLibrary *assets, struct MaterialAsset material);
 AssetId asset_library_add_compute_program(struct AssetLibrary *assets, struct ComputeProgramAsset program);
 AssetId asset_library_add_skeletal_mesh(struct AssetLibrary *assets, struct SkeletalMeshAsset skeletal_mesh);
@@ -0,0 +1,1152 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#define MODE_PRODUCTION
+#include <adjust.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+/**
+Headless benchmarks: no window, no GPU, no ImGui.
+
+usage: bench.exe battle [frames] [inputs_file]
+  battle: load the character and the cooked skeletal mesh and run battle_simulate_frame
+          with scripted inputs, or with the raw BattleInputs array in inputs_file.
+          Reports ns/frame, p50/p99 and a per-phase breakdown.
+usage: bench.exe collision [iterations]
+  collision: run the cylinder overlap kernel on random and boundary cases, check that every compiled
+             SIMD path returns the same hit masks as the scalar path, and report ns/test per path.
+             Returns 1 on mismatch. Build with /arch:AVX2 (-mavx2) to include the AVX path.
+usage: bench.exe pose [iterations]
+  pose: sample every frame of the cooked animations, then compare the scalar and SIMD paths of the
+        TRS to matrix conversion and of the global transforms. Reports ns/pose per stage and path,
+        and the max difference between paths. Returns 1 if it is above POSE_MAX_ERROR.
+usage: bench.exe predict [latency_frames] [inputs_file]
+  predict: replay the scripted inputs, or the raw BattleInputs array in inputs_file, through a
+           rollback with a constant remote latency, and compare the repeat last input prediction
+           with the BattleInputPredictor. Reports the misprediction rate and the rollback frames
+           for each, for latency_frames or for a few usual latencies.
+usage: bench.exe replay [inputs_file]
+  replay: record a one hour replay of the scripted inputs, or of the raw BattleInputs array in inputs_file
+          played in a loop, with its keyframes. Reports the worst case seek latency with and without the
+          keyframes and the latency of random seeks. Returns 1 if a seek does not match the simulation
+          from the start.
+usage: bench.exe verify replay_file [trace_file] [write]
+  verify: play a replay file from the game headlessly and hash the BattleState after every frame.
+          Without trace_file, the states are checked against the keyframes embedded in the replay by the
+          build that recorded it, the desync_<frame>.tekreplay files of network battles end with the state
+          of the frame that desynced. With write, the hashes are saved to trace_file as the golden trace,
+          otherwise they are compared to it. Reports the first diverging frame and a field by field diff
+          of the state after it, against the previous golden state of the trace resimulated up to that
+          frame. Returns 1 on divergence.
+          Build bench.exe with other compilers or optimization levels to check them against a trace.
+
+Phases are measured by redefining the Tracy zone macros used by the simulation.
+ **/
+
+// -- Timing
+
+static uint64_t bench_now_ns(void)
+{
+#if defined(_WIN32)
+	static LARGE_INTEGER frequency = {0};
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (uint64_t)((double)counter.QuadPart * (1e9 / (double)frequency.QuadPart));
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+#define BENCH_MAX_ZONES 32
+
+struct BenchZoneStats
+{
+	const char *name;
+	uint64_t total_ns;
+	uint64_t count;
+};
+
+struct BenchZone
+{
+	const char *name;
+	uint64_t begin;
+};
+
+struct BenchZoneStats bench_zones[BENCH_MAX_ZONES];
+uint32_t bench_zones_length;
+
+static struct BenchZone bench_zone_begin(const char *name)
+{
+	return (struct BenchZone){name, bench_now_ns()};
+}
+
+static void bench_zone_end(struct BenchZone zone)
+{
+	uint64_t elapsed = bench_now_ns() - zone.begin;
+	uint32_t i = 0;
+	for (; i < bench_zones_length; ++i) {
+		if (bench_zones[i].name == zone.name || strcmp(bench_zones[i].name, zone.name) == 0) {
+			break;
+		}
+	}
+	if (i == bench_zones_length) {
+		if (bench_zones_length >= BENCH_MAX_ZONES) {
+			return;
+		}
+		bench_zones[i].name = zone.name;
+		bench_zones_length += 1;
+	}
+	bench_zones[i].total_ns += elapsed;
+	bench_zones[i].count += 1;
+}
+
+static void bench_zones_reset(void)
+{
+	memset(bench_zones, 0, sizeof(bench_zones));
+	bench_zones_length = 0;
+}
+
+#define TracyCZoneN(ctx, name, active) struct BenchZone ctx = bench_zone_begin(name)
+#define TracyCZoneEnd(ctx) bench_zone_end(ctx)
+
+#include "core.h"
+#include "asset.h"
+#include "renderer.h" // Camera
+#include "tek.h"
+#include "game_battle.h"
+#include "game_replay.h"
+#include "collision.h"
+#include "file.h"
+
+// -- Assets
+
+static void bench_load_assets(struct AssetLibrary *assets)
+{
+	Serializer s = serialize_begin_read_file("cooking/3227071964");
+	asset_library_add_content_hash(assets, s.buffer);
+	SkeletalMeshWithAnimationsAsset *skeletal_mesh_with_animations = calloc(1, sizeof(SkeletalMeshWithAnimationsAsset));
+	Serialize_SkeletalMeshWithAnimationsAsset(&s, skeletal_mesh_with_animations);
+	serialize_end_read_file(&s);
+
+	asset_library_add_anim_skeleton(assets, skeletal_mesh_with_animations->anim_skeleton);
+	asset_library_add_skeletal_mesh(assets, skeletal_mesh_with_animations->skeletal_mesh);
+	for (uint32_t ianim = 0; ianim < skeletal_mesh_with_animations->animations_length; ++ianim) {
+		asset_library_add_animation(assets, skeletal_mesh_with_animations->animations[ianim]);
+	}
+	free(skeletal_mesh_with_animations);
+
+	tek_read_character_json(assets);
+}
+
+// -- Inputs
+
+// Deterministic input script: each player holds a random direction + buttons for a few frames.
+struct BenchInputScript
+{
+	uint64_t rng;
+	uint8_t raw[2];
+	uint32_t remaining[2];
+};
+
+static uint32_t bench_rand(uint64_t *state)
+{
+	// xorshift64*
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return (uint32_t)((x * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static struct BattleInputs bench_scripted_input(struct BenchInputScript *script)
+{
+	for (uint32_t iplayer = 0; iplayer < 2; ++iplayer) {
+		if (script->remaining[iplayer] == 0) {
+			uint32_t r = bench_rand(&script->rng);
+			uint8_t raw = 0;
+			// directions, mostly neutral or forward
+			switch (r % 8) {
+			case 0: raw |= BATTLE_INPUT_FORWARD; break;
+			case 1: raw |= BATTLE_INPUT_BACK; break;
+			case 2: raw |= BATTLE_INPUT_DOWN; break;
+			case 3: raw |= BATTLE_INPUT_DOWN | BATTLE_INPUT_BACK; break;
+			case 4: raw |= BATTLE_INPUT_DOWN | BATTLE_INPUT_FORWARD; break;
+			default: break;
+			}
+			// buttons, pressed half of the time
+			if ((r >> 8) & 1) {
+				raw |= (uint8_t)(BATTLE_INPUT_LPUNCH << ((r >> 9) % 4));
+			}
+			script->raw[iplayer] = raw;
+			script->remaining[iplayer] = 1 + ((r >> 16) % 12);
+		}
+		script->remaining[iplayer] -= 1;
+	}
+
+	struct BattleInputs inputs = {0};
+	inputs.player1 = battle_input_from_raw(script->raw[0]);
+	inputs.player2 = battle_input_from_raw(script->raw[1]);
+	return inputs;
+}
+
+// -- Battle benchmark
+
+static int bench_compare_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static int bench_battle(int argc, char *argv[])
+{
+	uint32_t frames_count = 1000000;
+	const char *inputs_path = NULL;
+	if (argc > 2) {
+		frames_count = (uint32_t)strtoul(argv[2], NULL, 10);
+	}
+	if (argc > 3) {
+		inputs_path = argv[3];
+	}
+	if (frames_count == 0) {
+		printf("invalid frames count\n");
+		return 1;
+	}
+
+	// Recorded inputs are a raw array of BattleInputs, played in a loop
+	struct BattleInputs *recorded_inputs = NULL;
+	uint32_t recorded_inputs_length = 0;
+	if (inputs_path) {
+		struct Blob file = file_read_entire_file(inputs_path);
+		recorded_inputs = file.data;
+		recorded_inputs_length = file.size / sizeof(struct BattleInputs);
+		if (recorded_inputs_length == 0) {
+			printf("no inputs in %s\n", inputs_path);
+			return 1;
+		}
+	}
+
+	struct AssetLibrary *assets = calloc(1, sizeof(struct AssetLibrary));
+	bench_load_assets(assets);
+
+	struct BattleContext *ctx = calloc(1, sizeof(struct BattleContext));
+	struct BattleContext *initial_ctx = calloc(1, sizeof(struct BattleContext));
+	ctx->assets = assets; // no presentation hooks
+	ctx->battle_non_state.rounds_first_to = 3;
+	battle_state_init(ctx);
+	memcpy(initial_ctx, ctx, sizeof(struct BattleContext));
+
+	struct BenchInputScript script = {0};
+	script.rng = 0x7e6b3a1d5f2c9e41ull;
+
+	uint64_t *frames_ns = calloc(frames_count, sizeof(uint64_t));
+	uint32_t const warmup_frames = 1000;
+	uint32_t matches = 0;
+
+	for (uint32_t iframe = 0; iframe < warmup_frames + frames_count; ++iframe) {
+		if (iframe == warmup_frames) {
+			bench_zones_reset();
+		}
+
+		struct BattleInputs inputs = {0};
+		if (recorded_inputs) {
+			inputs = recorded_inputs[iframe % recorded_inputs_length];
+		} else {
+			inputs = bench_scripted_input(&script);
+		}
+
+		uint64_t begin = bench_now_ns();
+		enum BattleFrameResult result = battle_simulate_frame(ctx, inputs);
+		uint64_t end = bench_now_ns();
+
+		if (iframe >= warmup_frames) {
+			frames_ns[iframe - warmup_frames] = end - begin;
+		}
+		if (result == BATTLE_FRAME_RESULT_END) {
+			memcpy(ctx, initial_ctx, sizeof(struct BattleContext));
+			matches += 1;
+		}
+	}
+
+	uint64_t total_ns = 0;
+	for (uint32_t i = 0; i < frames_count; ++i) {
+		total_ns += frames_ns[i];
+	}
+	qsort(frames_ns, frames_count, sizeof(uint64_t), bench_compare_u64);
+	uint64_t p50 = frames_ns[(frames_count - 1) * 50 / 100];
+	uint64_t p99 = frames_ns[(frames_count - 1) * 99 / 100];
+	uint64_t max = frames_ns[frames_count - 1];
+
+	printf("battle: %u frames (%s inputs), %u matches\n", frames_count, recorded_inputs ? "recorded" : "scripted", matches);
+	printf("  mean %8.1f ns/frame\n", (double)total_ns / (double)frames_count);
+	printf("  p50  %8llu ns\n", (unsigned long long)p50);
+	printf("  p99  %8llu ns\n", (unsigned long long)p99);
+	printf("  max  %8llu ns\n", (unsigned long long)max);
+	printf("  phases (ns/frame):\n");
+	for (uint32_t i = 0; i < bench_zones_length; ++i) {
+		printf("    %-28s %8.1f\n", bench_zones[i].name, (double)bench_zones[i].total_ns / (double)frames_count);
+	}
+
+	free(frames_ns);
+	free(initial_ctx);
+	free(ctx);
+	asset_library_term(assets);
+	free(assets);
+	free(recorded_inputs);
+	return 0;
+}
+
+// -- Input prediction evaluation
+
+struct BenchPredictResult
+{
+	uint32_t predicted;
+	uint32_t mispredicted;
+	uint32_t rollbacks;
+	uint32_t rollback_frames;
+};
+
+static bool bench_input_equal(struct BattleInput a, struct BattleInput b)
+{
+	return a.motion == b.motion && a.actions == b.actions;
+}
+
+// Replays the inputs of one player like the remote inputs of a session: the input of frame t - latency
+// is confirmed at frame t, the frames after it are predicted, and a wrong prediction rolls back to it.
+static struct BenchPredictResult bench_predict_player(struct BattleInputs const *inputs, uint32_t inputs_length, uint32_t iplayer, uint32_t latency, struct BattleInputPredictor *predictor)
+{
+	struct BenchPredictResult result = {0};
+	struct BattleInput *predictions = calloc(inputs_length, sizeof(struct BattleInput));
+	struct BattleInput confirmed = {0};
+
+	for (uint32_t frame = 0; frame < inputs_length; ++frame) {
+		if (frame >= latency) {
+			uint32_t confirmed_frame = frame - latency;
+			confirmed = iplayer == 0 ? inputs[confirmed_frame].player1 : inputs[confirmed_frame].player2;
+			if (predictor) {
+				battle_input_predictor_observe(predictor, iplayer, confirmed);
+			}
+
+			if (confirmed_frame > 0 && latency > 0) {
+				result.predicted += 1;
+				if (!bench_input_equal(predictions[confirmed_frame], confirmed)) {
+					result.mispredicted += 1;
+					result.rollbacks += 1;
+					result.rollback_frames += latency;
+					// the resimulation predicts the frames after the confirmed one again
+					for (uint32_t f = confirmed_frame + 1; f < frame; ++f) {
+						predictions[f] = predictor ? battle_input_predict(predictor, iplayer, confirmed, f - confirmed_frame) : confirmed;
+					}
+				}
+			}
+		}
+
+		if (latency > 0) {
+			uint32_t frames_ahead = frame >= latency ? latency : frame + 1;
+			predictions[frame] = predictor ? battle_input_predict(predictor, iplayer, confirmed, frames_ahead) : confirmed;
+		}
+	}
+
+	free(predictions);
+	return result;
+}
+
+static int bench_predict(int argc, char *argv[])
+{
+	uint32_t latencies[] = {1, 2, 4, 8};
+	uint32_t latencies_length = ARRAY_LENGTH(latencies);
+	const char *inputs_path = NULL;
+	if (argc > 2) {
+		latencies[0] = (uint32_t)strtoul(argv[2], NULL, 10);
+		latencies_length = 1;
+	}
+	if (argc > 3) {
+		inputs_path = argv[3];
+	}
+
+	struct BattleInputs *inputs = NULL;
+	uint32_t inputs_length = 0;
+	if (inputs_path) {
+		struct Blob file = file_read_entire_file(inputs_path);
+		inputs = file.data;
+		inputs_length = file.size / sizeof(struct BattleInputs);
+		if (inputs_length == 0) {
+			printf("no inputs in %s\n", inputs_path);
+			return 1;
+		}
+	} else {
+		struct BenchInputScript script = {0};
+		script.rng = 0x7e6b3a1d5f2c9e41ull;
+		inputs_length = 100000;
+		inputs = calloc(inputs_length, sizeof(struct BattleInputs));
+		for (uint32_t i = 0; i < inputs_length; ++i) {
+			inputs[i] = bench_scripted_input(&script);
+		}
+	}
+
+	printf("predict: %u frames (%s inputs)\n", inputs_length, inputs_path ? "recorded" : "scripted");
+	printf("  latency  strategy     mispredicted  rollbacks  rollback frames\n");
+	struct BattleInputPredictor *predictor = calloc(1, sizeof(struct BattleInputPredictor));
+	for (uint32_t ilatency = 0; ilatency < latencies_length; ++ilatency) {
+		uint32_t latency = latencies[ilatency];
+		struct BenchPredictResult results[2] = {0};
+		memset(predictor, 0, sizeof(struct BattleInputPredictor));
+		for (uint32_t iplayer = 0; iplayer < 2; ++iplayer) {
+			for (uint32_t istrategy = 0; istrategy < 2; ++istrategy) {
+				struct BenchPredictResult player = bench_predict_player(inputs, inputs_length, iplayer, latency, istrategy == 0 ? NULL : predictor);
+				results[istrategy].predicted += player.predicted;
+				results[istrategy].mispredicted += player.mispredicted;
+				results[istrategy].rollbacks += player.rollbacks;
+				results[istrategy].rollback_frames += player.rollback_frames;
+			}
+		}
+
+		static const char *strategy_names[] = {"repeat last", "predictor"};
+		for (uint32_t istrategy = 0; istrategy < 2; ++istrategy) {
+			struct BenchPredictResult const *result = &results[istrategy];
+			double rate = result->predicted ? 100.0 * (double)result->mispredicted / (double)result->predicted : 0.0;
+			printf("  %7u  %-11s  %11.2f%%  %9u  %15u\n", latency, strategy_names[istrategy], rate, result->rollbacks, result->rollback_frames);
+		}
+		uint32_t baseline_frames = results[0].rollback_frames;
+		double saved = baseline_frames ? 100.0 * ((double)baseline_frames - (double)results[1].rollback_frames) / (double)baseline_frames : 0.0;
+		printf("  %7u  rollback frames saved: %.2f%%\n", latency, saved);
+	}
+
+	free(predictor);
+	free(inputs);
+	return 0;
+}
+
+// -- Replay seeking benchmark
+
+#define BENCH_REPLAY_FRAMES (60*60*60) // 1 hour
+#define BENCH_REPLAY_SEEKS 200
+
+static int bench_replay(int argc, char *argv[])
+{
+	const char *inputs_path = NULL;
+	if (argc > 2) {
+		inputs_path = argv[2];
+	}
+
+	// one hour of inputs, recorded inputs are played in a loop
+	uint32_t const frames_count = BENCH_REPLAY_FRAMES;
+	struct BattleInputs *inputs = calloc(frames_count, sizeof(struct BattleInputs));
+	if (inputs_path) {
+		struct Blob file = file_read_entire_file(inputs_path);
+		struct BattleInputs *recorded_inputs = file.data;
+		uint32_t recorded_inputs_length = file.size / sizeof(struct BattleInputs);
+		if (recorded_inputs_length == 0) {
+			printf("no inputs in %s\n", inputs_path);
+			return 1;
+		}
+		for (uint32_t i = 0; i < frames_count; ++i) {
+			inputs[i] = recorded_inputs[i % recorded_inputs_length];
+		}
+		free(recorded_inputs);
+	} else {
+		struct BenchInputScript script = {0};
+		script.rng = 0x7e6b3a1d5f2c9e41ull;
+		for (uint32_t i = 0; i < frames_count; ++i) {
+			inputs[i] = bench_scripted_input(&script);
+		}
+	}
+
+	struct AssetLibrary *assets = calloc(1, sizeof(struct AssetLibrary));
+	bench_load_assets(assets);
+
+	struct BattleContext *ctx = calloc(1, sizeof(struct BattleContext));
+	struct BattleContext *initial_ctx = calloc(1, sizeof(struct BattleContext));
+	struct BattleContext *expected_ctx = calloc(1, sizeof(struct BattleContext));
+	ctx->assets = assets; // no presentation hooks
+	ctx->battle_non_state.rounds_first_to = 3;
+	battle_state_init(ctx);
+	memcpy(initial_ctx, ctx, sizeof(struct BattleContext));
+	struct BattleReplayKeyframe initial;
+	battle_replay_keyframe_save(ctx, &initial);
+
+	// recording, the replay keeps going after the end of the matches
+	struct BattleReplayKeyframes *keyframes = calloc(1, sizeof(struct BattleReplayKeyframes));
+	struct BattleReplayKeyframes *no_keyframes = calloc(1, sizeof(struct BattleReplayKeyframes));
+	battle_replay_keyframes_reset(keyframes, frames_count);
+	battle_replay_keyframes_reset(no_keyframes, frames_count);
+	uint64_t record_begin = bench_now_ns();
+	uint32_t current_frame = frames_count - 1;
+	battle_replay_seek(keyframes, ctx, &initial, inputs, 0, current_frame);
+	uint64_t record_ns = bench_now_ns() - record_begin;
+
+	printf("replay: %u frames (%s inputs)\n", frames_count, inputs_path ? "recorded" : "scripted");
+	printf("  keyframes: every %u frames, %u keyframes, %.1f MiB\n", keyframes->interval, keyframes->length,
+	       (double)keyframes->length * sizeof(struct BattleReplayKeyframe) / (1024.0 * 1024.0));
+	printf("  recording: %.1f ms\n", (double)record_ns / 1e6);
+
+	// worst case: one frame back from the end, right before a keyframe
+	uint32_t worst_frame = (frames_count - 2) / keyframes->interval * keyframes->interval + keyframes->interval - 1;
+	if (worst_frame >= current_frame) {
+		worst_frame -= keyframes->interval;
+	}
+	uint32_t mismatches = 0;
+	memcpy(expected_ctx, initial_ctx, sizeof(struct BattleContext));
+	uint64_t begin = bench_now_ns();
+	uint32_t full_frames = battle_replay_seek(no_keyframes, expected_ctx, &initial, inputs, 0, worst_frame);
+	uint64_t full_ns = bench_now_ns() - begin;
+	begin = bench_now_ns();
+	uint32_t keyframe_frames = battle_replay_seek(keyframes, ctx, &initial, inputs, current_frame, worst_frame);
+	uint64_t keyframe_ns = bench_now_ns() - begin;
+	current_frame = worst_frame;
+	mismatches += memcmp(&ctx->battle_state, &expected_ctx->battle_state, sizeof(struct BattleState)) != 0;
+	printf("  worst case seek to %u:\n", worst_frame);
+	printf("    from the start   %8u frames  %10.3f ms\n", full_frames, (double)full_ns / 1e6);
+	printf("    from a keyframe  %8u frames  %10.3f ms\n", keyframe_frames, (double)keyframe_ns / 1e6);
+
+	// random seeks in both directions, checked against a simulation from the start for a few of them
+	uint64_t *seeks_ns = calloc(BENCH_REPLAY_SEEKS, sizeof(uint64_t));
+	uint64_t rng = 0x2b992ddfa23249d6ull;
+	for (uint32_t iseek = 0; iseek < BENCH_REPLAY_SEEKS; ++iseek) {
+		uint32_t frame = bench_rand(&rng) % frames_count;
+		begin = bench_now_ns();
+		battle_replay_seek(keyframes, ctx, &initial, inputs, current_frame, frame);
+		seeks_ns[iseek] = bench_now_ns() - begin;
+		current_frame = frame;
+		if (iseek % 50 == 0) {
+			memcpy(expected_ctx, initial_ctx, sizeof(struct BattleContext));
+			battle_replay_seek(no_keyframes, expected_ctx, &initial, inputs, 0, frame);
+			mismatches += memcmp(&ctx->battle_state, &expected_ctx->battle_state, sizeof(struct BattleState)) != 0;
+		}
+	}
+	qsort(seeks_ns, BENCH_REPLAY_SEEKS, sizeof(uint64_t), bench_compare_u64);
+	printf("  %u random seeks: p50 %.3f ms, p99 %.3f ms, max %.3f ms\n", BENCH_REPLAY_SEEKS,
+	       (double)seeks_ns[(BENCH_REPLAY_SEEKS - 1) * 50 / 100] / 1e6,
+	       (double)seeks_ns[(BENCH_REPLAY_SEEKS - 1) * 99 / 100] / 1e6,
+	       (double)seeks_ns[BENCH_REPLAY_SEEKS - 1] / 1e6);
+	printf("  %u mismatches with the simulation from the start\n", mismatches);
+
+	free(seeks_ns);
+	free(no_keyframes);
+	free(keyframes);
+	free(expected_ctx);
+	free(initial_ctx);
+	free(ctx);
+	asset_library_term(assets);
+	free(assets);
+	free(inputs);
+	return mismatches == 0 ? 0 : 1;
+}
+
+// -- Determinism verifier
+
+#define BENCH_TRACE_MAGIC 0x54524b54 // "TKRT"
+#define BENCH_TRACE_VERSION 1
+#define BENCH_TRACE_STATE_INTERVAL 60 // frames between the full states of a trace, for the diffs
+
+// File: header, a hash per frame, then the state after every BENCH_TRACE_STATE_INTERVAL frames from frame 0
+struct BenchTraceHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t frames_length;
+	uint32_t state_interval;
+};
+
+// Bytes of BattleState outside of battle_state_fields: the padding, or fields missing from the table
+static uint32_t bench_state_unchecked_bytes(void)
+{
+	uint8_t covered[sizeof(struct BattleState)] = {0};
+	for (uint32_t ifield = 0; ifield < battle_state_fields_length; ++ifield) {
+		memset(covered + battle_state_fields[ifield].offset, 1, battle_state_fields[ifield].size);
+	}
+	uint32_t unchecked = 0;
+	for (uint32_t i = 0; i < sizeof(struct BattleState); ++i) {
+		unchecked += covered[i] == 0;
+	}
+	return unchecked;
+}
+
+static void bench_print_field_value(enum BattleStateFieldType type, uint8_t const *value)
+{
+	switch (type) {
+	case BATTLE_STATE_FIELD_U8: printf("%u", *value); break;
+	case BATTLE_STATE_FIELD_U16: { uint16_t v; memcpy(&v, value, sizeof(v)); printf("%u", v); break; }
+	case BATTLE_STATE_FIELD_U32: { uint32_t v; memcpy(&v, value, sizeof(v)); printf("%u", v); break; }
+	case BATTLE_STATE_FIELD_I32: { int32_t v; memcpy(&v, value, sizeof(v)); printf("%d", v); break; }
+	case BATTLE_STATE_FIELD_U64: { uint64_t v; memcpy(&v, value, sizeof(v)); printf("%llu", (unsigned long long)v); break; }
+	case BATTLE_STATE_FIELD_F32: {
+		float v; uint32_t bits;
+		memcpy(&v, value, sizeof(v));
+		memcpy(&bits, value, sizeof(bits));
+		printf("%.9g (0x%08x)", (double)v, bits);
+		break;
+	}
+	}
+}
+
+// Prints the fields that differ, returns their count
+static uint32_t bench_state_diff(struct BattleState const *expected, struct BattleState const *actual)
+{
+	uint32_t differences = 0;
+	for (uint32_t ifield = 0; ifield < battle_state_fields_length; ++ifield) {
+		struct BattleStateField const *field = &battle_state_fields[ifield];
+		uint8_t const *a = (uint8_t const*)expected + field->offset;
+		uint8_t const *b = (uint8_t const*)actual + field->offset;
+		uint32_t element_size = battle_state_field_type_sizes[field->type];
+		uint32_t elements_length = field->size / element_size;
+		uint32_t first = UINT32_MAX;
+		uint32_t differing = 0;
+		for (uint32_t i = 0; i < elements_length; ++i) {
+			if (memcmp(a + i * element_size, b + i * element_size, element_size) != 0) {
+				first = first == UINT32_MAX ? i : first;
+				differing += 1;
+			}
+		}
+		if (differing == 0) {
+			continue;
+		}
+		differences += 1;
+		if (elements_length > 1) {
+			printf("    %s[%u]: expected ", field->name, first);
+		} else {
+			printf("    %s: expected ", field->name);
+		}
+		bench_print_field_value(field->type, a + first * element_size);
+		printf(", actual ");
+		bench_print_field_value(field->type, b + first * element_size);
+		if (elements_length > 1) {
+			printf(" (%u of %u elements differ)", differing, elements_length);
+		}
+		printf("\n");
+	}
+	return differences;
+}
+
+// Everything bench_verify allocates, freed on every path by bench_verify_term
+struct BenchVerify
+{
+	struct AssetLibrary *assets;
+	struct BattleContext *ctx;
+	struct BattleContext *checkpoint_ctx; // the simulation after the last golden state that matched
+	struct ReplayReader *reader;
+	struct BattleInputs *inputs;
+	struct BattleReplayKeyframe *keyframes;
+	uint32_t *keyframes_frame;
+	uint64_t *hashes;
+	struct BattleState *states;
+	struct Blob golden_file;
+};
+
+static void bench_verify_term(struct BenchVerify *v)
+{
+	if (v->reader) {
+		replay_reader_close(v->reader);
+	}
+	free(v->golden_file.data);
+	free(v->states);
+	free(v->hashes);
+	free(v->keyframes_frame);
+	free(v->keyframes);
+	free(v->inputs);
+	free(v->reader);
+	free(v->checkpoint_ctx);
+	free(v->ctx);
+	if (v->assets) {
+		asset_library_term(v->assets);
+		free(v->assets);
+	}
+}
+
+// Diffs the state after diverging_frame with the golden trace. Without a golden state for that frame, the previous
+// one is resimulated up to it: if it reaches the golden hash, it is the exact state of the recording build.
+static void bench_verify_diff_golden(struct BenchVerify *v, struct BattleState const *golden_states, uint64_t const *golden_hashes, uint32_t diverging_frame)
+{
+	uint32_t golden_frame = diverging_frame - diverging_frame % BENCH_TRACE_STATE_INTERVAL;
+	struct BattleContext *expected_ctx = calloc(1, sizeof(struct BattleContext));
+	memcpy(expected_ctx, v->checkpoint_ctx, sizeof(struct BattleContext));
+	expected_ctx->battle_state = golden_states[golden_frame / BENCH_TRACE_STATE_INTERVAL];
+	for (uint32_t frame = golden_frame + 1; frame <= diverging_frame; ++frame) {
+		(void)battle_simulate_frame(expected_ctx, v->inputs[frame]);
+	}
+
+	bool is_exact = battle_state_hash(&expected_ctx->battle_state) == golden_hashes[diverging_frame];
+	if (golden_frame == diverging_frame) {
+		printf("  first diverging frame: %u, against its golden state:\n", diverging_frame);
+	} else if (is_exact) {
+		printf("  first diverging frame: %u, against the golden state of frame %u resimulated to it:\n", diverging_frame, golden_frame);
+	} else {
+		// the golden state resimulated by this build misses the golden hash
+		printf("  first diverging frame: %u, this build simulates frames %u to %u differently from the recording build\n",
+		       diverging_frame, golden_frame + 1, diverging_frame);
+	}
+	uint32_t differences = bench_state_diff(&expected_ctx->battle_state, &v->ctx->battle_state);
+	if (differences != 0) {
+		printf("  %u fields differ\n", differences);
+	} else if (is_exact) {
+		printf("    none, the simulation before frame %u differs outside of the replicated fields\n", golden_frame + 1);
+	}
+	free(expected_ctx);
+}
+
+static int bench_verify_run(struct BenchVerify *v, int argc, char *argv[])
+{
+	if (argc < 3) {
+		printf("usage: bench.exe verify replay_file [trace_file] [write]\n");
+		return 1;
+	}
+	const char *replay_path = argv[2];
+	const char *trace_path = argc > 3 ? argv[3] : NULL;
+	bool write_trace = argc > 4 && strcmp(argv[4], "write") == 0;
+
+	v->assets = calloc(1, sizeof(struct AssetLibrary));
+	bench_load_assets(v->assets);
+	struct BattleContext *ctx = calloc(1, sizeof(struct BattleContext));
+	v->ctx = ctx;
+	ctx->assets = v->assets; // no presentation hooks
+	battle_state_init(ctx);
+
+	// the whole replay, with the embedded keyframes
+	v->reader = calloc(1, sizeof(struct ReplayReader));
+	if (!replay_reader_open(v->reader, replay_path)) {
+		return 1;
+	}
+	if (!replay_file_header_matches(&v->reader->header, ctx)) {
+		printf("verify: %s was recorded with other characters or assets\n", replay_path);
+	}
+	ctx->battle_non_state.rounds_first_to = (int)v->reader->header.rounds_first_to;
+	battle_replay_keyframe_restore(ctx, &v->reader->header.initial);
+
+	uint32_t inputs_capacity = REPLAY_CHUNK_FRAMES;
+	uint32_t inputs_length = 0;
+	v->inputs = malloc(inputs_capacity * sizeof(struct BattleInputs));
+	uint32_t keyframes_capacity = 16;
+	uint32_t keyframes_length = 0;
+	v->keyframes = malloc(keyframes_capacity * sizeof(struct BattleReplayKeyframe));
+	v->keyframes_frame = malloc(keyframes_capacity * sizeof(uint32_t));
+	enum ReplayReadResult result;
+	struct BattleInputs frame_inputs;
+	struct BattleReplayKeyframe keyframe;
+	while ((result = replay_reader_next(v->reader, &frame_inputs, &keyframe)) != REPLAY_READ_END) {
+		if (result == REPLAY_READ_ERROR) {
+			printf("verify: %s is corrupted after frame %u\n", replay_path, inputs_length);
+			return 1;
+		}
+		if (result == REPLAY_READ_KEYFRAME) {
+			if (keyframes_length == keyframes_capacity) {
+				keyframes_capacity *= 2;
+				v->keyframes = realloc(v->keyframes, keyframes_capacity * sizeof(struct BattleReplayKeyframe));
+				v->keyframes_frame = realloc(v->keyframes_frame, keyframes_capacity * sizeof(uint32_t));
+			}
+			v->keyframes[keyframes_length] = keyframe;
+			v->keyframes_frame[keyframes_length] = inputs_length;
+			keyframes_length += 1;
+			continue;
+		}
+		if (inputs_length == inputs_capacity) {
+			inputs_capacity *= 2;
+			v->inputs = realloc(v->inputs, inputs_capacity * sizeof(struct BattleInputs));
+		}
+		v->inputs[inputs_length++] = frame_inputs;
+	}
+	replay_reader_close(v->reader);
+	if (inputs_length == 0) {
+		printf("verify: no frames in %s\n", replay_path);
+		return 1;
+	}
+
+	// golden trace
+	uint32_t const states_length = (inputs_length + BENCH_TRACE_STATE_INTERVAL - 1) / BENCH_TRACE_STATE_INTERVAL;
+	v->hashes = calloc(inputs_length, sizeof(uint64_t));
+	v->states = calloc(states_length, sizeof(struct BattleState));
+	uint64_t *golden_hashes = NULL;
+	struct BattleState *golden_states = NULL;
+	if (trace_path && !write_trace) {
+		v->golden_file = file_read_entire_file(trace_path);
+		struct Blob file = v->golden_file;
+		struct BenchTraceHeader header = {0};
+		if (file.size >= sizeof(header)) {
+			memcpy(&header, file.data, sizeof(header));
+		}
+		uint32_t golden_states_length = header.state_interval ? (header.frames_length + header.state_interval - 1) / header.state_interval : 0;
+		uint64_t expected_size = sizeof(header) + (uint64_t)header.frames_length * sizeof(uint64_t) + (uint64_t)golden_states_length * sizeof(struct BattleState);
+		if (header.magic != BENCH_TRACE_MAGIC || header.version != BENCH_TRACE_VERSION || header.state_interval != BENCH_TRACE_STATE_INTERVAL
+		    || header.frames_length != inputs_length || file.size != expected_size) {
+			printf("verify: %s is not a trace of this replay\n", trace_path);
+			return 1;
+		}
+		golden_hashes = (uint64_t*)((uint8_t*)file.data + sizeof(header));
+		golden_states = (struct BattleState*)(golden_hashes + header.frames_length);
+		v->checkpoint_ctx = calloc(1, sizeof(struct BattleContext));
+	}
+
+	printf("verify: %u frames, %u keyframes in %s, %u bytes of BattleState not checked (padding)\n",
+	       inputs_length, keyframes_length, replay_path, bench_state_unchecked_bytes());
+
+	uint32_t ikeyframe = 0;
+	uint32_t keyframes_checked = 0;
+	uint32_t diverging_frame = UINT32_MAX;
+	uint32_t diverging_keyframe = UINT32_MAX;
+	uint64_t begin = bench_now_ns();
+	// frame inputs_length only checks the keyframes after the last inputs, like the state of a desync file
+	for (uint32_t frame = 0; frame <= inputs_length; ++frame) {
+		// a keyframe is the state before its frame
+		for (; ikeyframe < keyframes_length && v->keyframes_frame[ikeyframe] <= frame; ++ikeyframe) {
+			if (v->keyframes_frame[ikeyframe] != frame || diverging_keyframe != UINT32_MAX) {
+				continue;
+			}
+			keyframes_checked += 1;
+			if (battle_state_hash(&v->keyframes[ikeyframe].battle_state) != battle_state_hash(&ctx->battle_state)) {
+				diverging_keyframe = ikeyframe;
+				printf("  keyframe of frame %u differs from the recording build:\n", frame);
+				bench_state_diff(&v->keyframes[ikeyframe].battle_state, &ctx->battle_state);
+			}
+		}
+		if (frame == inputs_length) {
+			break;
+		}
+
+		(void)battle_simulate_frame(ctx, v->inputs[frame]);
+		v->hashes[frame] = battle_state_hash(&ctx->battle_state);
+		if (frame % BENCH_TRACE_STATE_INTERVAL == 0) {
+			v->states[frame / BENCH_TRACE_STATE_INTERVAL] = ctx->battle_state;
+		}
+
+		if (golden_hashes && v->hashes[frame] != golden_hashes[frame]) {
+			diverging_frame = frame;
+			bench_verify_diff_golden(v, golden_states, golden_hashes, diverging_frame);
+			break;
+		}
+		// the frames up to the divergence are resimulated from here
+		if (golden_hashes && frame % BENCH_TRACE_STATE_INTERVAL == 0) {
+			memcpy(v->checkpoint_ctx, ctx, sizeof(struct BattleContext));
+		}
+	}
+	uint64_t elapsed_ns = bench_now_ns() - begin;
+
+	if (write_trace) {
+		struct BenchTraceHeader header = {BENCH_TRACE_MAGIC, BENCH_TRACE_VERSION, inputs_length, BENCH_TRACE_STATE_INTERVAL};
+		FILE *f = fopen(trace_path, "wb");
+		if (f == NULL) {
+			perror("Error");
+			return 1;
+		}
+		fwrite(&header, sizeof(header), 1, f);
+		fwrite(v->hashes, sizeof(uint64_t), inputs_length, f);
+		fwrite(v->states, sizeof(struct BattleState), states_length, f);
+		fclose(f);
+		printf("  wrote the golden trace %s\n", trace_path);
+	}
+
+	bool is_valid = diverging_frame == UINT32_MAX && diverging_keyframe == UINT32_MAX;
+	printf("  %u keyframes checked, %s%s, %.1f ns/frame\n", keyframes_checked,
+	       golden_hashes ? "golden trace " : "", is_valid ? "deterministic" : "DIVERGED",
+	       (double)elapsed_ns / (double)inputs_length);
+	return is_valid ? 0 : 1;
+}
+
+static int bench_verify(int argc, char *argv[])
+{
+	struct BenchVerify v = {0};
+	int result = bench_verify_run(&v, argc, argv);
+	bench_verify_term(&v);
+	return result;
+}
+
+// -- Collision benchmark
+
+typedef uint32_t (*BenchCylindersOverlapFn)(struct Cylinder cylinder, struct Cylinders cylinders, uint8_t *out_mask);
+
+struct BenchCollisionPath
+{
+	const char *name;
+	BenchCylindersOverlapFn overlap;
+};
+
+#define BENCH_COLLISION_CASES 256
+
+struct BenchCollisionCase
+{
+	struct Cylinder cylinder;
+	uint32_t offset; // first cylinder in the SoA arrays
+	uint32_t length;
+};
+
+static float bench_rand_float(uint64_t *state, float min, float max)
+{
+	return min + (max - min) * ((float)(bench_rand(state) >> 8) / (float)(1 << 24));
+}
+
+static int bench_collision(int argc, char *argv[])
+{
+	uint32_t iterations = 2000;
+	if (argc > 2) {
+		iterations = (uint32_t)strtoul(argv[2], NULL, 10);
+	}
+	if (iterations == 0) {
+		printf("invalid iterations count\n");
+		return 1;
+	}
+
+	struct BenchCollisionPath paths[] = {
+		{"scalar", cylinders_overlap_scalar},
+#if defined(COLLISION_SSE)
+		{"sse", cylinders_overlap_sse},
+#endif
+#if defined(COLLISION_AVX)
+		{"avx", cylinders_overlap_avx},
+#endif
+#if defined(COLLISION_NEON)
+		{"neon", cylinders_overlap_neon},
+#endif
+	};
+
+	// Every case gets its own padded range in the SoA arrays, lengths cover 0 to MAX_BONES_PER_MESH
+	uint32_t capacity = BENCH_COLLISION_CASES * (MAX_BONES_PER_MESH + CYLINDERS_SIMD_WIDTH);
+	float *x = calloc(capacity, sizeof(float));
+	float *y = calloc(capacity, sizeof(float));
+	float *z = calloc(capacity, sizeof(float));
+	float *radius = calloc(capacity, sizeof(float));
+	float *half_height = calloc(capacity, sizeof(float));
+	struct BenchCollisionCase *cases = calloc(BENCH_COLLISION_CASES, sizeof(struct BenchCollisionCase));
+
+	uint64_t rng = 0x3c6ef372fe94f82bull;
+	uint32_t offset = 0;
+	uint32_t tests_count = 0;
+	for (uint32_t icase = 0; icase < BENCH_COLLISION_CASES; ++icase) {
+		struct BenchCollisionCase *c = cases + icase;
+		c->cylinder.center.x = bench_rand_float(&rng, -1.0f, 1.0f);
+		c->cylinder.center.y = bench_rand_float(&rng, -1.0f, 1.0f);
+		c->cylinder.center.z = bench_rand_float(&rng, 0.0f, 2.0f);
+		c->cylinder.radius = bench_rand_float(&rng, 0.05f, 0.3f);
+		c->cylinder.half_height = bench_rand_float(&rng, 0.05f, 0.3f);
+		c->offset = offset;
+		c->length = icase == 0 ? 0 : bench_rand(&rng) % (MAX_BONES_PER_MESH + 1);
+
+		for (uint32_t i = 0; i < c->length; ++i) {
+			uint32_t j = offset + i;
+			uint32_t kind = bench_rand(&rng) % 8;
+			radius[j] = bench_rand_float(&rng, 0.02f, 0.2f);
+			half_height[j] = bench_rand_float(&rng, 0.02f, 0.2f);
+			if (kind == 0) {
+				// disabled box
+				radius[j] = 0.0f;
+			}
+			if (kind == 1) {
+				// exactly touching horizontally, along an axis
+				x[j] = c->cylinder.center.x + (c->cylinder.radius + radius[j]);
+				y[j] = c->cylinder.center.y;
+				z[j] = c->cylinder.center.z;
+			} else if (kind == 2) {
+				// exactly touching vertically
+				x[j] = c->cylinder.center.x;
+				y[j] = c->cylinder.center.y;
+				z[j] = c->cylinder.center.z - (c->cylinder.half_height + half_height[j]);
+			} else if (kind == 3) {
+				// same center
+				x[j] = c->cylinder.center.x;
+				y[j] = c->cylinder.center.y;
+				z[j] = c->cylinder.center.z;
+			} else {
+				x[j] = c->cylinder.center.x + bench_rand_float(&rng, -0.6f, 0.6f);
+				y[j] = c->cylinder.center.y + bench_rand_float(&rng, -0.6f, 0.6f);
+				z[j] = c->cylinder.center.z + bench_rand_float(&rng, -0.6f, 0.6f);
+			}
+		}
+		// padding lanes keep a zero radius
+		offset += (c->length + CYLINDERS_SIMD_WIDTH - 1) & ~(uint32_t)(CYLINDERS_SIMD_WIDTH - 1);
+		tests_count += c->length;
+	}
+
+	// Determinism: all paths must return the same masks as the scalar path
+	uint32_t mismatches = 0;
+	uint32_t hits = 0;
+	for (uint32_t icase = 0; icase < BENCH_COLLISION_CASES; ++icase) {
+		struct BenchCollisionCase *c = cases + icase;
+		struct Cylinders cylinders = {x + c->offset, y + c->offset, z + c->offset, radius + c->offset, half_height + c->offset, c->length};
+		uint8_t expected[MAX_BONES_PER_MESH / 8] = {0};
+		uint32_t expected_count = paths[0].overlap(c->cylinder, cylinders, expected);
+		hits += expected_count;
+		for (uint32_t ipath = 1; ipath < ARRAY_LENGTH(paths); ++ipath) {
+			uint8_t mask[MAX_BONES_PER_MESH / 8] = {0};
+			uint32_t count = paths[ipath].overlap(c->cylinder, cylinders, mask);
+			uint32_t mask_bytes = (c->length + 7) / 8;
+			if (count != expected_count || memcmp(mask, expected, mask_bytes) != 0) {
+				printf("mismatch: case %u (%u cylinders), %s\n", icase, c->length, paths[ipath].name);
+				mismatches += 1;
+			}
+		}
+	}
+
+	printf("collision: %u cases, %u cylinders, %u overlaps, %u paths\n", BENCH_COLLISION_CASES, tests_count, hits, (uint32_t)ARRAY_LENGTH(paths));
+	for (uint32_t ipath = 0; ipath < ARRAY_LENGTH(paths); ++ipath) {
+		uint32_t checksum = 0;
+		uint64_t begin = bench_now_ns();
+		for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+			for (uint32_t icase = 0; icase < BENCH_COLLISION_CASES; ++icase) {
+				struct BenchCollisionCase *c = cases + icase;
+				struct Cylinders cylinders = {x + c->offset, y + c->offset, z + c->offset, radius + c->offset, half_height + c->offset, c->length};
+				uint8_t mask[MAX_BONES_PER_MESH / 8];
+				checksum += paths[ipath].overlap(c->cylinder, cylinders, mask);
+			}
+		}
+		uint64_t end = bench_now_ns();
+		double tests = (double)tests_count * (double)iterations;
+		printf("  %-8s %6.2f ns/test (checksum %u)\n", paths[ipath].name, (double)(end - begin) / tests, checksum);
+	}
+	printf("  %u mismatches\n", mismatches);
+
+	free(cases);
+	free(half_height);
+	free(radius);
+	free(z);
+	free(y);
+	free(x);
+	return mismatches == 0 ? 0 : 1;
+}
+
+// -- Pose benchmark
+
+#define POSE_MAX_ERROR 1e-5f
+
+static float bench_matrices_max_error(Float3x4 const *a, Float3x4 const *b, uint32_t count, uint32_t *inexact_count)
+{
+	float max_error = 0.0f;
+	for (uint32_t i = 0; i < count; ++i) {
+		if (memcmp(a + i, b + i, sizeof(Float3x4)) != 0) {
+			*inexact_count += 1;
+		}
+		for (uint32_t j = 0; j < 12; ++j) {
+			max_error = fmaxf(max_error, fabsf(a[i].values[j] - b[i].values[j]));
+		}
+	}
+	return max_error;
+}
+
+static int bench_pose(int argc, char *argv[])
+{
+	uint32_t iterations = 200;
+	if (argc > 2) {
+		iterations = (uint32_t)strtoul(argv[2], NULL, 10);
+	}
+	if (iterations == 0) {
+		printf("invalid iterations count\n");
+		return 1;
+	}
+
+	struct AssetLibrary *assets = calloc(1, sizeof(struct AssetLibrary));
+	bench_load_assets(assets);
+	struct AnimPose *scalar_pose = calloc(1, sizeof(struct AnimPose));
+	struct AnimPose *simd_pose = calloc(1, sizeof(struct AnimPose));
+
+	// Compare the paths on every frame
+	uint32_t poses_count = 0;
+	uint32_t bones_count = 0;
+	uint32_t local_inexact = 0;
+	uint32_t global_inexact = 0;
+	float local_error = 0.0f;
+	float global_error = 0.0f;
+	for (uint32_t ianim = 0; ianim < assets->animations.length; ++ianim) {
+		Animation const *animation = asset_table_at(&assets->animations, ianim, sizeof(Animation));
+		AnimSkeleton const *skeleton = asset_library_get_anim_skeleton(assets, animation->skeleton_id);
+		for (uint32_t iframe = 0; iframe < animation->clip.frames_length; ++iframe) {
+			anim_clip_sample(&animation->clip, iframe, &scalar_pose->local_trs);
+			anim_transforms_to_matrices_scalar(&scalar_pose->local_trs, animation->clip.tracks_length, scalar_pose->local_transforms);
+			anim_transforms_to_matrices(&scalar_pose->local_trs, animation->clip.tracks_length, simd_pose->local_transforms);
+			local_error = fmaxf(local_error, bench_matrices_max_error(scalar_pose->local_transforms, simd_pose->local_transforms, animation->clip.tracks_length, &local_inexact));
+
+			anim_pose_compute_global_transforms_scalar(skeleton, scalar_pose);
+			anim_pose_compute_global_transforms(skeleton, simd_pose);
+			global_error = fmaxf(global_error, bench_matrices_max_error(scalar_pose->global_transforms, simd_pose->global_transforms, skeleton->bones_length, &global_inexact));
+			poses_count += 1;
+			bones_count += skeleton->bones_length;
+		}
+	}
+
+	printf("pose: %u animations, %u poses, %.1f bones/pose\n", assets->animations.length, poses_count, poses_count ? (double)bones_count / (double)poses_count : 0.0);
+	const char *stages[] = {"sample", "local scalar", "local simd", "global scalar", "global simd"};
+	for (uint32_t istage = 0; istage < ARRAY_LENGTH(stages); ++istage) {
+		uint64_t begin = bench_now_ns();
+		for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+			for (uint32_t ianim = 0; ianim < assets->animations.length; ++ianim) {
+				Animation const *animation = asset_table_at(&assets->animations, ianim, sizeof(Animation));
+				AnimSkeleton const *skeleton = asset_library_get_anim_skeleton(assets, animation->skeleton_id);
+				uint32_t tracks_length = animation->clip.tracks_length;
+				for (uint32_t iframe = 0; iframe < animation->clip.frames_length; ++iframe) {
+					switch (istage) {
+					case 0: anim_clip_sample(&animation->clip, iframe, &simd_pose->local_trs); break;
+					case 1: anim_transforms_to_matrices_scalar(&simd_pose->local_trs, tracks_length, simd_pose->local_transforms); break;
+					case 2: anim_transforms_to_matrices(&simd_pose->local_trs, tracks_length, simd_pose->local_transforms); break;
+					case 3: anim_pose_compute_global_transforms_scalar(skeleton, simd_pose); break;
+					case 4: anim_pose_compute_global_transforms(skeleton, simd_pose); break;
+					}
+				}
+			}
+		}
+		uint64_t end = bench_now_ns();
+		double poses = (double)poses_count * (double)iterations;
+		printf("  %-14s %8.1f ns/pose\n", stages[istage], poses > 0.0 ? (double)(end - begin) / poses : 0.0);
+	}
+	printf("  local:  %u inexact matrices, max error %g\n", local_inexact, local_error);
+	printf("  global: %u inexact matrices, max error %g\n", global_inexact, global_error);
+
+	free(simd_pose);
+	free(scalar_pose);
+	asset_library_term(assets);
+	free(assets);
+	bool is_valid = local_error <= POSE_MAX_ERROR && global_error <= POSE_MAX_ERROR;
+	return is_valid ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		printf("usage: bench.exe battle [frames] [inputs_file]\n");
+		printf("       bench.exe collision [iterations]\n");
+		printf("       bench.exe pose [iterations]\n");
+		printf("       bench.exe predict [latency_frames] [inputs_file]\n");
+		printf("       bench.exe replay [inputs_file]\n");
+		printf("       bench.exe verify replay_file [trace_file] [write]\n");
+		return 1;
+	}
+
+	if (strcmp(argv[1], "battle") == 0) {
+		return bench_battle(argc, argv);
+	}
+	if (strcmp(argv[1], "collision") == 0) {
+		return bench_collision(argc, argv);
+	}
+	if (strcmp(argv[1], "pose") == 0) {
+		return bench_pose(argc, argv);
+	}
+	if (strcmp(argv[1], "predict") == 0) {
+		return bench_predict(argc, argv);
+	}
+	if (strcmp(argv[1], "replay") == 0) {
+		return bench_replay(argc, argv);
+	}
+	if (strcmp(argv[1], "verify") == 0) {
+		return bench_verify(argc, argv);
+	}
+
+	printf("unknown benchmark %s\n", argv[1]);
+	return 1;
+}
+
+#include "asset.c"
+#include "anim.c"
+#include "game_components.c"
+#include "tek.c"
+#include "collision.c"
+#include "game_battle.c"
+#include "game_replay.c"
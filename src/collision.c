@@ -0,0 +1,160 @@
+#include "collision.h"
+
+#if defined(COLLISION_SSE) || defined(COLLISION_AVX)
+#include <immintrin.h>
+#endif
+#if defined(COLLISION_NEON)
+#include <arm_neon.h>
+#endif
+
+static uint32_t _cylinders_padded_length(struct Cylinders cylinders)
+{
+	return (cylinders.length + CYLINDERS_SIMD_WIDTH - 1) & ~(uint32_t)(CYLINDERS_SIMD_WIDTH - 1);
+}
+
+static uint32_t _mask_count(uint8_t bits)
+{
+	uint32_t count = 0;
+	for (; bits != 0; bits &= (uint8_t)(bits - 1)) {
+		count += 1;
+	}
+	return count;
+}
+
+uint32_t cylinders_overlap_scalar(struct Cylinder c, struct Cylinders cylinders, uint8_t *out_mask)
+{
+	uint32_t padded_length = _cylinders_padded_length(cylinders);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < padded_length; i += CYLINDERS_SIMD_WIDTH) {
+		uint8_t bits = 0;
+		for (uint32_t lane = 0; lane < CYLINDERS_SIMD_WIDTH; ++lane) {
+			uint32_t j = i + lane;
+			float dx = c.center.x - cylinders.x[j];
+			float dy = c.center.y - cylinders.y[j];
+			float dist2 = dx * dx + dy * dy;
+			float r = c.radius + cylinders.radius[j];
+			float dz = fabsf(c.center.z - cylinders.z[j]);
+			float h = c.half_height + cylinders.half_height[j];
+			bool inside = (cylinders.radius[j] > 0.0f) & (dist2 <= r * r) & (dz <= h);
+			bits |= (uint8_t)((uint32_t)inside << lane);
+		}
+		out_mask[i / CYLINDERS_SIMD_WIDTH] = bits;
+		count += _mask_count(bits);
+	}
+	return count;
+}
+
+#if defined(COLLISION_SSE)
+uint32_t cylinders_overlap_sse(struct Cylinder c, struct Cylinders cylinders, uint8_t *out_mask)
+{
+	__m128 cx = _mm_set1_ps(c.center.x);
+	__m128 cy = _mm_set1_ps(c.center.y);
+	__m128 cz = _mm_set1_ps(c.center.z);
+	__m128 cr = _mm_set1_ps(c.radius);
+	__m128 ch = _mm_set1_ps(c.half_height);
+	__m128 sign = _mm_set1_ps(-0.0f);
+	__m128 zero = _mm_setzero_ps();
+
+	uint32_t padded_length = _cylinders_padded_length(cylinders);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < padded_length; i += CYLINDERS_SIMD_WIDTH) {
+		uint32_t bits = 0;
+		for (uint32_t half = 0; half < 2; ++half) {
+			uint32_t j = i + 4 * half;
+			__m128 radius = _mm_loadu_ps(cylinders.radius + j);
+			__m128 dx = _mm_sub_ps(cx, _mm_loadu_ps(cylinders.x + j));
+			__m128 dy = _mm_sub_ps(cy, _mm_loadu_ps(cylinders.y + j));
+			__m128 dist2 = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+			__m128 r = _mm_add_ps(cr, radius);
+			__m128 dz = _mm_andnot_ps(sign, _mm_sub_ps(cz, _mm_loadu_ps(cylinders.z + j)));
+			__m128 h = _mm_add_ps(ch, _mm_loadu_ps(cylinders.half_height + j));
+			__m128 inside = _mm_and_ps(_mm_cmpgt_ps(radius, zero), _mm_cmple_ps(dist2, _mm_mul_ps(r, r)));
+			inside = _mm_and_ps(inside, _mm_cmple_ps(dz, h));
+			bits |= (uint32_t)_mm_movemask_ps(inside) << (4 * half);
+		}
+		out_mask[i / CYLINDERS_SIMD_WIDTH] = (uint8_t)bits;
+		count += _mask_count((uint8_t)bits);
+	}
+	return count;
+}
+#endif
+
+#if defined(COLLISION_AVX)
+uint32_t cylinders_overlap_avx(struct Cylinder c, struct Cylinders cylinders, uint8_t *out_mask)
+{
+	__m256 cx = _mm256_set1_ps(c.center.x);
+	__m256 cy = _mm256_set1_ps(c.center.y);
+	__m256 cz = _mm256_set1_ps(c.center.z);
+	__m256 cr = _mm256_set1_ps(c.radius);
+	__m256 ch = _mm256_set1_ps(c.half_height);
+	__m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 zero = _mm256_setzero_ps();
+
+	uint32_t padded_length = _cylinders_padded_length(cylinders);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < padded_length; i += CYLINDERS_SIMD_WIDTH) {
+		__m256 radius = _mm256_loadu_ps(cylinders.radius + i);
+		__m256 dx = _mm256_sub_ps(cx, _mm256_loadu_ps(cylinders.x + i));
+		__m256 dy = _mm256_sub_ps(cy, _mm256_loadu_ps(cylinders.y + i));
+		__m256 dist2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		__m256 r = _mm256_add_ps(cr, radius);
+		__m256 dz = _mm256_andnot_ps(sign, _mm256_sub_ps(cz, _mm256_loadu_ps(cylinders.z + i)));
+		__m256 h = _mm256_add_ps(ch, _mm256_loadu_ps(cylinders.half_height + i));
+		__m256 inside = _mm256_and_ps(_mm256_cmp_ps(radius, zero, _CMP_GT_OQ), _mm256_cmp_ps(dist2, _mm256_mul_ps(r, r), _CMP_LE_OQ));
+		inside = _mm256_and_ps(inside, _mm256_cmp_ps(dz, h, _CMP_LE_OQ));
+		uint8_t bits = (uint8_t)_mm256_movemask_ps(inside);
+		out_mask[i / CYLINDERS_SIMD_WIDTH] = bits;
+		count += _mask_count(bits);
+	}
+	return count;
+}
+#endif
+
+#if defined(COLLISION_NEON)
+uint32_t cylinders_overlap_neon(struct Cylinder c, struct Cylinders cylinders, uint8_t *out_mask)
+{
+	static const uint32_t lane_bits[4] = {1, 2, 4, 8};
+	uint32x4_t bit_weights = vld1q_u32(lane_bits);
+	float32x4_t cx = vdupq_n_f32(c.center.x);
+	float32x4_t cy = vdupq_n_f32(c.center.y);
+	float32x4_t cz = vdupq_n_f32(c.center.z);
+	float32x4_t cr = vdupq_n_f32(c.radius);
+	float32x4_t ch = vdupq_n_f32(c.half_height);
+	float32x4_t zero = vdupq_n_f32(0.0f);
+
+	uint32_t padded_length = _cylinders_padded_length(cylinders);
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < padded_length; i += CYLINDERS_SIMD_WIDTH) {
+		uint32_t bits = 0;
+		for (uint32_t half = 0; half < 2; ++half) {
+			uint32_t j = i + 4 * half;
+			float32x4_t radius = vld1q_f32(cylinders.radius + j);
+			float32x4_t dx = vsubq_f32(cx, vld1q_f32(cylinders.x + j));
+			float32x4_t dy = vsubq_f32(cy, vld1q_f32(cylinders.y + j));
+			float32x4_t dist2 = vaddq_f32(vmulq_f32(dx, dx), vmulq_f32(dy, dy));
+			float32x4_t r = vaddq_f32(cr, radius);
+			float32x4_t dz = vabsq_f32(vsubq_f32(cz, vld1q_f32(cylinders.z + j)));
+			float32x4_t h = vaddq_f32(ch, vld1q_f32(cylinders.half_height + j));
+			uint32x4_t inside = vandq_u32(vcgtq_f32(radius, zero), vcleq_f32(dist2, vmulq_f32(r, r)));
+			inside = vandq_u32(inside, vcleq_f32(dz, h));
+			bits |= vaddvq_u32(vandq_u32(inside, bit_weights)) << (4 * half);
+		}
+		out_mask[i / CYLINDERS_SIMD_WIDTH] = (uint8_t)bits;
+		count += _mask_count((uint8_t)bits);
+	}
+	return count;
+}
+#endif
+
+uint32_t cylinders_overlap(struct Cylinder cylinder, struct Cylinders cylinders, uint8_t *out_mask)
+{
+#if defined(COLLISION_AVX)
+	return cylinders_overlap_avx(cylinder, cylinders, out_mask);
+#elif defined(COLLISION_SSE)
+	return cylinders_overlap_sse(cylinder, cylinders, out_mask);
+#elif defined(COLLISION_NEON)
+	return cylinders_overlap_neon(cylinder, cylinders, out_mask);
+#else
+	return cylinders_overlap_scalar(cylinder, cylinders, out_mask);
+#endif
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+/**
+Batched overlap tests between one vertical cylinder and a list of vertical cylinders.
+
+The list is stored SoA and padded to CYLINDERS_SIMD_WIDTH, padding lanes have a zero radius and never overlap.
+Every path computes the same operations in the same order (squared distances, no sqrt), so the results are
+identical. The scalar path must not be contracted to fma: this is the MSVC default (/fp:precise), use
+-ffp-contract=off with gcc/clang.
+ **/
+
+#define CYLINDERS_SIMD_WIDTH 8
+
+#if defined(__AVX__)
+#define COLLISION_AVX 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLLISION_SSE 1
+#endif
+#if (defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64)
+#define COLLISION_NEON 1
+#endif
+
+struct Cylinder
+{
+	Float3 center;
+	float radius;
+	float half_height;
+};
+
+struct Cylinders
+{
+	float const *x;
+	float const *y;
+	float const *z;
+	float const *radius; // 0 = disabled
+	float const *half_height;
+	uint32_t length; // arrays hold at least length rounded up to CYLINDERS_SIMD_WIDTH
+};
+
+// Bit (i % 8) of out_mask[i / 8] is set if the cylinder i overlaps, returns the number of overlaps
+uint32_t cylinders_overlap(struct Cylinder cylinder, struct Cylinders cylinders, uint8_t *out_mask);
+
+// Every compiled path, the bench checks that they agree
+uint32_t cylinders_overlap_scalar(struct Cylinder cylinder, struct Cylinders cylinders, uint8_t *out_mask);
+#if defined(COLLISION_SSE)
+uint32_t cylinders_overlap_sse(struct Cylinder cylinder, struct Cylinders cylinders, uint8_t *out_mask);
+#endif
+#if defined(COLLISION_AVX)
+uint32_t cylinders_overlap_avx(struct Cylinder cylinder, struct Cylinders cylinders, uint8_t *out_mask);
+#endif
+#if defined(COLLISION_NEON)
+uint32_t cylinders_overlap_neon(struct Cylinder cylinder, struct Cylinders cylinders, uint8_t *out_mask);
+#endif
@@ -135,6 +135,7 @@ struct SkeletalMeshJson
 	uint32_t source_file_length;
 	uint32_t anim_skeleton_length;
 	uint32_t mesh_length;
+	float anim_max_error; // in meters, enables animation key reduction when > 0
 };
 
 struct SkeletalMeshJson parse_skeletal_mesh_json(const char* source_path)
@@ -164,6 +165,11 @@ struct SkeletalMeshJson parse_skeletal_mesh_json(const char* source_path)
 			skeletal_mesh.mesh = value->string;
 			skeletal_mesh.mesh_length = (uint32_t)value->string_size;
 		}
+		if (strcmp(it->name->string, "anim_max_error") == 0) {
+			struct json_number_s *value = json_value_as_number(it->value);
+			ASSERT(value != NULL);
+			skeletal_mesh.anim_max_error = strtof(value->number, NULL);
+		}
 	}
 
 	return skeletal_mesh;
@@ -301,6 +307,99 @@ int cook_compute_program()
 	return 0;
 }
 
+struct AnimClipError
+{
+	float max_error; // in meters, character space
+	uint32_t max_error_bone;
+	uint32_t max_error_frame;
+};
+
+// Compare the compressed clip with the raw tracks on the bones and on virtual points around them, the
+// virtual points catch the rotation error of the leaf bones
+#define ANIM_ERROR_VIRTUAL_POINT_DISTANCE 0.1f
+struct AnimClipError measure_anim_clip_error(struct AnimSkeleton const *skeleton, struct AnimTrack const *tracks, uint32_t tracks_length, struct AnimClip const *clip)
+{
+	struct AnimClipError error = {0};
+	struct AnimPose *raw_pose = calloc(1, sizeof(struct AnimPose));
+	struct AnimPose *clip_pose = calloc(1, sizeof(struct AnimPose));
+	Float3 points[] = {
+		{0.0f, 0.0f, 0.0f},
+		{ANIM_ERROR_VIRTUAL_POINT_DISTANCE, 0.0f, 0.0f},
+		{0.0f, ANIM_ERROR_VIRTUAL_POINT_DISTANCE, 0.0f},
+	};
+	for (uint32_t iframe = 0; iframe < clip->frames_length; ++iframe) {
+		for (uint32_t itrack = 0; itrack < tracks_length; ++itrack) {
+			Float3 translation = tracks[itrack].translations.data[iframe];
+			Quat rotation = tracks[itrack].rotations.data[iframe];
+			float scale = tracks[itrack].scales.data[iframe];
+			raw_pose->local_transforms[itrack] = float3x4_from_transform(translation, rotation, float3_from_float(scale));
+		}
+		anim_clip_sample(clip, iframe, &clip_pose->local_trs);
+		anim_transforms_to_matrices(&clip_pose->local_trs, clip->tracks_length, clip_pose->local_transforms);
+		anim_pose_compute_global_transforms(skeleton, raw_pose);
+		anim_pose_compute_global_transforms(skeleton, clip_pose);
+
+		for (uint32_t ibone = 0; ibone < skeleton->bones_length; ++ibone) {
+			for (uint32_t ipoint = 0; ipoint < ARRAY_LENGTH(points); ++ipoint) {
+				Float3 raw_point = float3x4_transform_point(raw_pose->global_transforms[ibone], points[ipoint]);
+				Float3 clip_point = float3x4_transform_point(clip_pose->global_transforms[ibone], points[ipoint]);
+				Float3 delta = float3_sub(raw_point, clip_point);
+				float distance = sqrtf(delta.x * delta.x + delta.y * delta.y + delta.z * delta.z);
+				if (distance > error.max_error) {
+					error.max_error = distance;
+					error.max_error_bone = ibone;
+					error.max_error_frame = iframe;
+				}
+			}
+		}
+	}
+	free(clip_pose);
+	free(raw_pose);
+	return error;
+}
+
+struct AnimClip compress_animation(struct AnimSkeleton const *skeleton, struct Animation const *animation, struct AnimTrack const *tracks, float max_error)
+{
+	struct AnimClip clip = anim_clip_compress(tracks, animation->tracks_length, 1);
+	struct AnimClipError error = measure_anim_clip_error(skeleton, tracks, animation->tracks_length, &clip);
+	// Keep the largest key stride that stays under the error budget
+	if (max_error > 0.0f) {
+		for (uint32_t key_stride = 2; key_stride <= ANIM_CLIP_MAX_KEY_STRIDE; ++key_stride) {
+			struct AnimClip reduced_clip = anim_clip_compress(tracks, animation->tracks_length, key_stride);
+			struct AnimClipError reduced_error = measure_anim_clip_error(skeleton, tracks, animation->tracks_length, &reduced_clip);
+			if (reduced_error.max_error <= max_error) {
+				anim_clip_term(&clip);
+				clip = reduced_clip;
+				error = reduced_error;
+			} else {
+				anim_clip_term(&reduced_clip);
+			}
+		}
+	}
+
+	uint32_t constant_channels = 0;
+	for (uint32_t itrack = 0; itrack < clip.tracks_length; ++itrack) {
+		constant_channels += clip.tracks[itrack].translation_offset == ANIM_CLIP_CONSTANT;
+		constant_channels += clip.tracks[itrack].rotation_offset == ANIM_CLIP_CONSTANT;
+		constant_channels += clip.tracks[itrack].scale_offset == ANIM_CLIP_CONSTANT;
+	}
+	uint32_t raw_size = clip.tracks_length * clip.frames_length * (uint32_t)(sizeof(Float3) + sizeof(Quat) + sizeof(float));
+	uint32_t clip_size = clip.tracks_length * (uint32_t)sizeof(struct AnimClipTrack) + clip.keys_length * clip.key_size * (uint32_t)sizeof(uint16_t);
+	fprintf(stderr, "Compressed anim %u: %u frames, key stride %u, %u/%u constant channels, %u -> %u bytes (%.1f%%), max error %.4f mm (bone %u, frame %u)\n",
+		animation->id,
+		clip.frames_length,
+		clip.key_stride,
+		constant_channels,
+		clip.tracks_length * 3,
+		raw_size,
+		clip_size,
+		raw_size > 0 ? 100.0f * (float)clip_size / (float)raw_size : 0.0f,
+		error.max_error * 1000.0f,
+		error.max_error_bone,
+		error.max_error_frame);
+	return clip;
+}
+
 int cook_fbx()
 {
 	char source_path[512];
@@ -392,6 +491,8 @@ int cook_fbx()
 	}
 	// Import animations
 	struct Animation *animations = calloc(MAX_ANIMATIONS_PER_ASSET, sizeof(struct Animation));
+	// raw bone tracks, compressed once the skeleton is imported
+	struct AnimTrack *animations_tracks = calloc(MAX_ANIMATIONS_PER_ASSET * MAX_BONES_PER_MESH, sizeof(struct AnimTrack));
 	ASSERT(scene->anim_stacks.count < MAX_ANIMATIONS_PER_ASSET);
 	for (size_t istack = 0; istack < scene->anim_stacks.count; istack++) {
 		ufbx_anim_stack *stack = scene->anim_stacks.data[istack];
@@ -402,6 +503,7 @@ int cook_fbx()
 		ASSERT(bake);
 		animations[istack].id = ufbx_string_to_id(stack->name);
 		animations[istack].skeleton_id = skeleton_id;
+		struct AnimTrack *tracks = animations_tracks + istack * MAX_BONES_PER_MESH;
 		fprintf(stderr, "Importing anim %u: %s (%zu frames)\n", animations[istack].id, stack->name.data, bake->nodes.count);
 		for (size_t inode = 0; inode < bake->nodes.count; inode++) {
 			ufbx_baked_node *baked_node = &bake->nodes.data[inode];
@@ -422,13 +524,13 @@ int cook_fbx()
 			animations[istack].tracks_identifier[ibone] = ufbx_string_to_id(node->name);
 
 			// extract the root motion track into a separate track
-			struct AnimTrack *out_track = &animations[istack].tracks[ibone];
+			struct AnimTrack *out_track = &tracks[ibone];
 			if (node == root_bone) {
 				ASSERT(ibone == 0);
 				out_track = &animations[istack].root_motion_track;
 
 				// set the regular track to identity
-				struct AnimTrack *out_regular_track = &animations[istack].tracks[ibone];
+				struct AnimTrack *out_regular_track = &tracks[ibone];
 				out_regular_track->translations.length = (uint32_t)baked_node->translation_keys.count;
 				out_regular_track->translations.data = calloc(baked_node->translation_keys.count, sizeof(Float3));
 				out_regular_track->rotations.length = (uint32_t)baked_node->rotation_keys.count;
@@ -605,6 +707,18 @@ int cook_fbx()
 		skeletal_mesh_with_animations.anim_skeleton.bones_parent[ibone] = bones_parent[ibone];
 		skeletal_mesh_with_animations.anim_skeleton.bones_identifier[ibone] = ufbx_string_to_id(bones[ibone]->name);
 	}
+	for (uint32_t ianim = 0; ianim < skeletal_mesh_with_animations.animations_length; ++ianim) {
+		struct Animation *animation = &skeletal_mesh_with_animations.animations[ianim];
+		struct AnimTrack const *tracks = animations_tracks + ianim * MAX_BONES_PER_MESH;
+		animation->clip = compress_animation(&skeletal_mesh_with_animations.anim_skeleton, animation, tracks, json.anim_max_error);
+	}
+	// the clips own their keys, the raw tracks are not serialized
+	for (uint32_t itrack = 0; itrack < MAX_ANIMATIONS_PER_ASSET * MAX_BONES_PER_MESH; ++itrack) {
+		free(animations_tracks[itrack].translations.data);
+		free(animations_tracks[itrack].rotations.data);
+		free(animations_tracks[itrack].scales.data);
+	}
+	free(animations_tracks);
 	skeletal_mesh_with_animations.skeletal_mesh.id = skeletal_mesh_id;
 	skeletal_mesh_with_animations.skeletal_mesh.indices = indices;
 	skeletal_mesh_with_animations.skeletal_mesh.indices_length = mesh_indices_length;
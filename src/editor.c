@@ -14,7 +14,7 @@ void _display_skeleton_component(struct SkeletonComponent *skeleton)
 void _display_animation_component(struct AnimationComponent *animation)
 {
 	ImGui_InputScalar("frame", ImGuiDataType_U32, &animation->frame);
-	ImGui_InputScalar("animation_id", ImGuiDataType_U32, &animation->animation_id);
+	ImGui_Text("animation_id: %u", animation->animation_id); // driven by the current move
 }
 void _display_skeletal_mesh_component(struct SkeletalMeshComponent *mesh)
 {
@@ -24,16 +24,8 @@ void _display_tek_component(struct TekPlayerComponent *player)
 {
 	struct tek_Character *chara = tek_characters + player->character_id;
 
-	uint32_t i_current_move = chara->moves_length;
-	uint32_t i_requested_move = chara->moves_length;
-	for (uint32_t imove = 0; imove < chara->moves_length; ++imove) {
-		if (chara->moves[imove].id == player->current_move_id) {
-			i_current_move = imove;
-		}
-		if (chara->moves[imove].id == player->requested_move_id) {
-			i_requested_move = imove;
-		}
-	}
+	uint32_t i_current_move = player->current_move < chara->moves_length ? player->current_move : chara->moves_length;
+	uint32_t i_requested_move = player->requested_move < chara->moves_length ? player->requested_move : chara->moves_length;
 
 	ImGui_InputScalar("character", ImGuiDataType_U32, &player->character_id);
 	ImGui_Text("current move: %s", chara->move_names[i_current_move].string);
@@ -54,7 +46,7 @@ void _display_tek_component(struct TekPlayerComponent *player)
 
 		ImGui_SameLine();
 		if (ImGui_Button("Do")) {
-			player->requested_move_id = move->id;
+			player->requested_move = (tek_MoveIndex)imove;
 		}
 
 		ImGui_PopID();
@@ -83,11 +75,11 @@ void ed_display_player_entity(const char* id, struct PlayerEntity *player)
 	ImGui_End();
 }
 
-void ed_display_debug_menu(struct BattleNonState *nonstate)
+void ed_display_debug_menu(struct AssetLibrary *assets, struct BattleNonState *nonstate)
 {
 	if (ImGui_Begin("Debug", NULL, 0)) {
 		if (ImGui_Button("Reload characters")) {
-			tek_read_character_json();
+			tek_read_character_json(assets);
 		}
 		ImGui_DragFloat3Ex("camera position", &nonstate->camera.position.x, 0.1f, 0.0f, 0.0f, "%.3f", 0);
 		ImGui_DragFloat3Ex("camera lookat", &nonstate->camera.lookat.x, 0.1f, 0.0f, 0.0f, "%.3f", 0);
@@ -1,4 +1,4 @@
 #pragma once
 
 void ed_display_player_entity(const char* id, struct PlayerEntity *player);
-void ed_display_debug_menu(struct BattleNonState *nonstate);
+void ed_display_debug_menu(struct AssetLibrary *assets, struct BattleNonState *nonstate);
@@ -34,8 +34,8 @@ struct Game
 	// common state
 	struct Simulation
 	{
-		uint64_t accumulator;
-		uint64_t t;
+		uint64_t accumulator; // microseconds
+		uint64_t t; // microseconds
 		struct BattleContext battle_context;
 	} simulation;
 
@@ -53,6 +53,7 @@ struct GameUpdateContext
 	struct Inputs inputs;
 	uint64_t current_time;
 	uint64_t previous_frame_time;
+	uint64_t previous_frame_time_us; // sub millisecond precision, for the simulation
 	uint64_t f;
 };
 
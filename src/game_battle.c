@@ -1,61 +1,18 @@
 #include "game_battle.h"
-#include "inputs.h"
-#include "debugdraw.h"
-#include "renderer.h"
-#include "editor.h"
-
-struct CancelContext
-{
-	uint32_t current_frame;
-	uint32_t animation_frame; // current frame of the animation
-	uint32_t animation_length; // number of frames in the animation
-};
+#include <stddef.h> // offsetof
+#if !defined(XXH_INLINE_ALL)
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+#endif
 
+// Print every cancel taken by the players, define it to 1 to debug the move lists
+#if !defined(BATTLE_DEBUG_PRINT_CANCELS)
+#define BATTLE_DEBUG_PRINT_CANCELS 0
+#endif
 
 // -- Battle Inputs
-static const char* _get_motion_label(struct BattleInput input)
-{
-	const char *MOTIONS_LABELS[] = {
-		" ",
-		"db",
-		"d",
-		"df",
-		"b",
-		"n",
-		"f",
-		"ub",
-		"u",
-		"uf",
-	};
-	ASSERT(input.motion < ARRAY_LENGTH(MOTIONS_LABELS));
-	return MOTIONS_LABELS[input.motion];
-}
 
-static const char* _get_action_label(struct BattleInput input)
-{
-	const char *ACTIONS_LABELS[] = {
-		" ",
-		"LP",
-		"RP",
-		"LP+RP",
-		"LK",
-		"LP+LK",
-		"RP+LK",
-		"LP+RP+LK",
-		"RK",
-		"LP+RK",
-		"RP+RK",
-		"LP+RP+RK",
-		"LK+RK",
-		"LP+LK+RK",
-		"RP+LK+RK",
-		"LP+RP+LK+RK",
-	};
-	ASSERT(input.actions < ARRAY_LENGTH(ACTIONS_LABELS));
-	return ACTIONS_LABELS[input.actions];
-}
-
-static struct BattleInput _battle_input_from_raw(uint8_t raw_input)
+struct BattleInput battle_input_from_raw(uint8_t raw_input)
 {
 	struct BattleInput result = {0};
 	// Motion
@@ -100,89 +57,81 @@ static struct BattleInput _battle_input_from_raw(uint8_t raw_input)
 	return result;
 }
 
-struct BattleInputs battle_read_input(struct Inputs const *inputs)
+// -- Input prediction
+
+void battle_input_predictor_observe(struct BattleInputPredictor *predictor, uint32_t iplayer, struct BattleInput input)
 {
-	uint8_t p1_raw = 0;
-	if (inputs->buttons_is_down[InputButtons_W]) {
-		p1_raw |= BATTLE_INPUT_UP;
-	}
-	if (inputs->buttons_is_down[InputButtons_A]) {
-		p1_raw |= BATTLE_INPUT_BACK;
-	}
-	if (inputs->buttons_is_down[InputButtons_S]) {
-		p1_raw |= BATTLE_INPUT_DOWN;
-	}
-	if (inputs->buttons_is_down[InputButtons_D]) {
-		p1_raw |= BATTLE_INPUT_FORWARD;
-	}
-	if (inputs->buttons_is_down[InputButtons_U]) {
-		p1_raw |= BATTLE_INPUT_LPUNCH;
-	}
-	if (inputs->buttons_is_down[InputButtons_I]) {
-		p1_raw |= BATTLE_INPUT_RPUNCH;
-	}
-	if (inputs->buttons_is_down[InputButtons_J]) {
-		p1_raw |= BATTLE_INPUT_LKICK;
-	}
-	if (inputs->buttons_is_down[InputButtons_K]) {
-		p1_raw |= BATTLE_INPUT_RKICK;
-	}
+	ASSERT(iplayer < ARRAY_LENGTH(predictor->players));
+	struct BattleInputPredictorPlayer *player = &predictor->players[iplayer];
+	for (uint32_t iaction = 0; iaction < TEK_ACTION_INPUT_COUNT; ++iaction) {
+		if ((input.actions & (1 << iaction)) != 0) {
+			if (player->held_frames[iaction] < INPUT_RUN_MAX) {
+				player->held_frames[iaction] += 1;
+			}
+			continue;
+		}
+		if (player->held_frames[iaction] == 0) {
+			continue;
+		}
 
-	uint8_t p2_raw = 0;
-	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_DPAD_UP]) {
-		p2_raw |= BATTLE_INPUT_UP;
-	}
-	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_DPAD_RIGHT]) {
-		p2_raw |= BATTLE_INPUT_BACK;
-	}
-	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_DPAD_DOWN]) {
-		p2_raw |= BATTLE_INPUT_DOWN;
-	}
-	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_DPAD_LEFT]) {
-		p2_raw |= BATTLE_INPUT_FORWARD;
-	}
-	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_WEST]) {
-		p2_raw |= BATTLE_INPUT_LPUNCH;
-	}
-	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_NORTH]) {
-		p2_raw |= BATTLE_INPUT_RPUNCH;
-	}
-	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_SOUTH]) {
-		p2_raw |= BATTLE_INPUT_LKICK;
-	}
-	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_EAST]) {
-		p2_raw |= BATTLE_INPUT_RKICK;
+		// the press just ended
+		uint16_t *durations = player->press_durations[iaction];
+		uint32_t press = player->held_frames[iaction];
+		durations[press < BATTLE_PREDICTOR_MAX_PRESS ? press : BATTLE_PREDICTOR_MAX_PRESS] += 1;
+		player->held_frames[iaction] = 0;
+		player->presses_length[iaction] += 1;
+		tek_ActionInputSet released = (tek_ActionInputSet)(player->last_input.actions & ~(1 << iaction));
+		if (input.motion == player->last_input.motion && input.actions == released) {
+			player->clean_releases[iaction] += 1;
+		}
+		if (player->presses_length[iaction] >= BATTLE_PREDICTOR_MAX_PRESSES) {
+			player->presses_length[iaction] = 0;
+			for (uint32_t duration = 0; duration <= BATTLE_PREDICTOR_MAX_PRESS; ++duration) {
+				durations[duration] /= 2;
+				player->presses_length[iaction] += durations[duration];
+			}
+			player->clean_releases[iaction] /= 2;
+		}
 	}
+	player->last_input = input;
+}
 
-	// Add left stick directional input (works alongside D-pad)
-	float stick_deadzone = 0.1f;
-	if (inputs->gamepads[0]) {
-		float left_stick_x = SDL_GetGamepadAxis(inputs->gamepads[0], SDL_GAMEPAD_AXIS_LEFTX) / 32768.0f ;
-		float left_stick_y = SDL_GetGamepadAxis(inputs->gamepads[0], SDL_GAMEPAD_AXIS_LEFTY) / 32768.0f;
-
-		printf("[inputs] gamepad left stick %f x %f\n", left_stick_x, left_stick_y);
-
-		if (-stick_deadzone < left_stick_y && left_stick_y < stick_deadzone) {
-			// NONE
-		} else if (left_stick_y < 0.0f) {
-			p2_raw |= BATTLE_INPUT_UP;
-		} else if (left_stick_y > 0.0f) {
-			p2_raw |= BATTLE_INPUT_DOWN;
+struct BattleInput battle_input_predict(struct BattleInputPredictor const *predictor, uint32_t iplayer, struct BattleInput last, uint32_t frames_ahead)
+{
+	ASSERT(iplayer < ARRAY_LENGTH(predictor->players));
+	struct BattleInputPredictorPlayer const *player = &predictor->players[iplayer];
+	struct BattleInput result = last;
+	for (uint32_t iaction = 0; iaction < TEK_ACTION_INPUT_COUNT; ++iaction) {
+		uint32_t held = player->held_frames[iaction];
+		if ((last.actions & (1 << iaction)) == 0 || held >= BATTLE_PREDICTOR_MAX_PRESS) {
+			continue;
 		}
 
-		if (-stick_deadzone < left_stick_x && left_stick_x < stick_deadzone) {
-			// NONE
-		} else if (left_stick_x < 0.0f) {
-			p2_raw |= BATTLE_INPUT_FORWARD;
-		} else if (left_stick_x > 0.0f) {
-			p2_raw |= BATTLE_INPUT_BACK;
+		// The prediction of a frame only matters if the press lasted until the frame before, otherwise the rollback
+		// already predicted it again. Predict the release on the first frame where the press usually ends, and
+		// the frames after stay released.
+		uint16_t const *durations = player->press_durations[iaction];
+		uint32_t presses_as_long = 0;
+		for (uint32_t duration = held; duration <= BATTLE_PREDICTOR_MAX_PRESS; ++duration) {
+			presses_as_long += durations[duration];
+		}
+		uint32_t clean_releases = player->clean_releases[iaction];
+		uint32_t presses_length = player->presses_length[iaction];
+		for (uint32_t duration = held; duration < held + frames_ahead && duration < BATTLE_PREDICTOR_MAX_PRESS; ++duration) {
+			if (presses_as_long < BATTLE_PREDICTOR_MIN_PRESSES) {
+				break;
+			}
+			// presses that ended after this duration, weighted by the share of clean releases
+			uint32_t presses_ended = durations[duration];
+			uint32_t presses_lasting = presses_as_long - presses_ended;
+			if (presses_ended * clean_releases > presses_lasting * presses_length) {
+				result.actions &= (tek_ActionInputSet)~(1 << iaction);
+				break;
+			}
+			presses_as_long = presses_lasting;
 		}
 	}
-
-	struct BattleInputs input = {0};
-	input.player1 = _battle_input_from_raw(p1_raw);
-	input.player2 = _battle_input_from_raw(p2_raw);
-	return input;
+	return result;
 }
 
 // -- Battle main functions
@@ -205,31 +154,16 @@ enum BattleFrameResult battle_simulate_frame(struct BattleContext *ctx, struct B
 	return result;
 }
 
-void battle_state_init_player(struct BattleContext *ctx, struct PlayerEntity *p, struct PlayerNonEntity *pn)
-{
-	struct tek_Character *c = tek_characters + p->tek.character_id;
-	SkeletalMeshAsset const *skeletal_mesh = asset_library_get_skeletal_mesh(ctx->assets, c->skeletal_mesh_id);
-	AnimSkeleton const *anim_skeleton = asset_library_get_anim_skeleton(ctx->assets, c->anim_skeleton_id);
-
-	// create an instance to hold the render pose
-	skeletal_mesh_create_instance(skeletal_mesh, &pn->mesh_instance, anim_skeleton);
-	// create render instances
-	struct SkeletalMeshInstanceData render_instance_data = {0};
-	render_instance_data.mesh = skeletal_mesh;
-	render_instance_data.dynamic_data_mesh = &pn->mesh_instance;
-	render_instance_data.dynamic_data_spatial = &p->spatial;
-	render_instance_data.dynamic_data_tek = &p->tek;
-	renderer_register_skeletal_mesh_instance(ctx->renderer, render_instance_data);
-}
-
 void battle_state_init(struct BattleContext *ctx)
 {
 	battle_state_new_round(ctx);
 
 	struct BattleState *state = &ctx->battle_state;
 	struct BattleNonState *nonstate = &ctx->battle_non_state;
-	battle_state_init_player(ctx, &state->p1_entity, &nonstate->p1_nonentity);
-	battle_state_init_player(ctx, &state->p2_entity, &nonstate->p2_nonentity);
+	if (ctx->presentation.init_player) {
+		ctx->presentation.init_player(ctx, &state->p1_entity, &nonstate->p1_nonentity);
+		ctx->presentation.init_player(ctx, &state->p2_entity, &nonstate->p2_nonentity);
+	}
 }
 
 void battle_state_new_round(struct BattleContext *ctx)
@@ -254,18 +188,19 @@ void battle_state_new_round(struct BattleContext *ctx)
 	struct tek_Character *c1 = tek_characters + state->p1_entity.tek.character_id;
 	struct tek_Character *c2 = tek_characters + state->p2_entity.tek.character_id;
 	state->p1_entity.tek.hp = c1->max_health;
-	state->p1_entity.tek.current_move_id = c1->moves[0].id;
+	state->p1_entity.tek.current_move = 0;
+	state->p1_entity.tek.requested_move = TEK_INVALID_MOVE;
 	state->p2_entity.tek.hp = c2->max_health;
-	state->p2_entity.tek.current_move_id = c2->moves[0].id;
+	state->p2_entity.tek.current_move = 0;
+	state->p2_entity.tek.requested_move = TEK_INVALID_MOVE;
 
-	// Reset animation
-	int const idle_anim_id = 1775356884;
+	// Reset animation, the first move is idle
 	state->p1_entity.anim_skeleton.anim_skeleton_id = c1->anim_skeleton_id;
-	state->p1_entity.animation.animation_id = idle_anim_id; // idle
+	state->p1_entity.animation.animation_id = c1->moves[0].animation_id;
 	state->p1_entity.animation.frame = 0;
 
 	state->p2_entity.anim_skeleton.anim_skeleton_id = c2->anim_skeleton_id;
-	state->p2_entity.animation.animation_id = idle_anim_id; // idle
+	state->p2_entity.animation.animation_id = c2->moves[0].animation_id;
 	state->p2_entity.animation.frame = 0;
 
 	// Reset camera
@@ -278,60 +213,201 @@ void battle_state_new_round(struct BattleContext *ctx)
 
 void battle_state_term(struct BattleContext *ctx)
 {
-	renderer_clear_skeletal_mesh_instances(ctx->renderer);
+	if (ctx->presentation.term) {
+		ctx->presentation.term(ctx);
+	}
+}
+
+// -- State hash
+
+uint32_t const battle_state_field_type_sizes[] = {1, 2, 4, 4, 8, 4};
+
+#define BATTLE_STATE_FIELD(path, type) {#path, (uint32_t)offsetof(struct BattleState, path), (uint32_t)sizeof(((struct BattleState*)0)->path), type},
+#define BATTLE_STATE_PLAYER_FIELDS(p) \
+	BATTLE_STATE_FIELD(p.spatial.bounds, BATTLE_STATE_FIELD_F32) \
+	BATTLE_STATE_FIELD(p.spatial.world_transform, BATTLE_STATE_FIELD_F32) \
+	BATTLE_STATE_FIELD(p.anim_skeleton.anim_skeleton_id, BATTLE_STATE_FIELD_U32) \
+	BATTLE_STATE_FIELD(p.animation.frame, BATTLE_STATE_FIELD_U32) \
+	BATTLE_STATE_FIELD(p.animation.animation_id, BATTLE_STATE_FIELD_U32) \
+	BATTLE_STATE_FIELD(p.mesh.skeletal_mesh_id, BATTLE_STATE_FIELD_U32) \
+	BATTLE_STATE_FIELD(p.tek.character_id, BATTLE_STATE_FIELD_U32) \
+	BATTLE_STATE_FIELD(p.tek.status, BATTLE_STATE_FIELD_U8) \
+	BATTLE_STATE_FIELD(p.tek.status_remaining, BATTLE_STATE_FIELD_U8) \
+	BATTLE_STATE_FIELD(p.tek.requested_move, BATTLE_STATE_FIELD_U16) \
+	BATTLE_STATE_FIELD(p.tek.current_move, BATTLE_STATE_FIELD_U16) \
+	BATTLE_STATE_FIELD(p.tek.hp, BATTLE_STATE_FIELD_I32) \
+	BATTLE_STATE_FIELD(p.tek.pushback_remaining_frames, BATTLE_STATE_FIELD_I32) \
+	BATTLE_STATE_FIELD(p.tek.pushback_strength, BATTLE_STATE_FIELD_F32) \
+	BATTLE_STATE_FIELD(p.tek.tracking_target, BATTLE_STATE_FIELD_F32) \
+	BATTLE_STATE_FIELD(p.tek.input_buffer, BATTLE_STATE_FIELD_U8) \
+	BATTLE_STATE_FIELD(p.tek.input_buffer_head, BATTLE_STATE_FIELD_U64) \
+	BATTLE_STATE_FIELD(p.tek.motion_absent_frames, BATTLE_STATE_FIELD_U8) \
+	BATTLE_STATE_FIELD(p.tek.action_held_frames, BATTLE_STATE_FIELD_U8) \
+	BATTLE_STATE_FIELD(p.tek.action_released_frames, BATTLE_STATE_FIELD_U8)
+
+struct BattleStateField const battle_state_fields[] = {
+	BATTLE_STATE_FIELD(frame_number, BATTLE_STATE_FIELD_U32)
+	BATTLE_STATE_PLAYER_FIELDS(p1_entity)
+	BATTLE_STATE_PLAYER_FIELDS(p2_entity)
+};
+uint32_t const battle_state_fields_length = ARRAY_LENGTH(battle_state_fields);
+
+#undef BATTLE_STATE_PLAYER_FIELDS
+#undef BATTLE_STATE_FIELD
+
+uint64_t battle_state_hash(struct BattleState const *state)
+{
+	uint8_t canonical[sizeof(struct BattleState)];
+	uint32_t size = 0;
+	for (uint32_t ifield = 0; ifield < battle_state_fields_length; ++ifield) {
+		struct BattleStateField const *field = &battle_state_fields[ifield];
+		memcpy(canonical + size, (uint8_t const*)state + field->offset, field->size);
+		size += field->size;
+	}
+	return XXH3_64bits(canonical, size);
+}
+
+// -- Replay keyframes
+
+void battle_replay_keyframe_save(struct BattleContext const *ctx, struct BattleReplayKeyframe *keyframe)
+{
+	memcpy(&keyframe->battle_state, &ctx->battle_state, sizeof(struct BattleState));
+	keyframe->rounds_p1_won = ctx->battle_non_state.rounds_p1_won;
+	keyframe->rounds_p2_won = ctx->battle_non_state.rounds_p2_won;
+}
+
+void battle_replay_keyframe_restore(struct BattleContext *ctx, struct BattleReplayKeyframe const *keyframe)
+{
+	memcpy(&ctx->battle_state, &keyframe->battle_state, sizeof(struct BattleState));
+	ctx->battle_non_state.rounds_p1_won = keyframe->rounds_p1_won;
+	ctx->battle_non_state.rounds_p2_won = keyframe->rounds_p2_won;
 }
 
+void battle_replay_keyframes_reset(struct BattleReplayKeyframes *keyframes, uint32_t expected_frames)
+{
+	uint32_t const max_keyframes = (uint32_t)BATTLE_REPLAY_MAX_KEYFRAMES;
+	keyframes->interval = (expected_frames + max_keyframes - 1) / max_keyframes;
+	if (keyframes->interval == 0) {
+		keyframes->interval = 1;
+	}
+	keyframes->length = 0;
+}
 
-static bool match_cancel(struct TekPlayerComponent player, struct tek_Cancel cancel, struct CancelContext ctx)
+void battle_replay_keyframes_capture(struct BattleReplayKeyframes *keyframes, struct BattleContext const *ctx, uint32_t frame)
 {
-	if (cancel.to_move_id == 0) {
-		// end of list?
-		return false;
+	// keyframes are kept in order, a frame seen for the first time is always right after the last simulated one
+	if (frame != keyframes->length * keyframes->interval) {
+		return;
+	}
+	if (keyframes->length >= BATTLE_REPLAY_MAX_KEYFRAMES) {
+		// full, keep every other keyframe, frame is the first one of the doubled interval
+		for (uint32_t i = 0; i < BATTLE_REPLAY_MAX_KEYFRAMES / 2; ++i) {
+			keyframes->keyframes[i] = keyframes->keyframes[2 * i];
+		}
+		keyframes->length = BATTLE_REPLAY_MAX_KEYFRAMES / 2;
+		keyframes->interval *= 2;
 	}
+	battle_replay_keyframe_save(ctx, &keyframes->keyframes[keyframes->length]);
+	keyframes->length += 1;
+}
+
+uint32_t battle_replay_seek(struct BattleReplayKeyframes *keyframes, struct BattleContext *ctx, struct BattleReplayKeyframe const *initial, struct BattleInputs const *inputs, uint32_t current_frame, uint32_t frame)
+{
+	TracyCZoneN(f, "Replay seek", true);
 
-	/** Frame window checks:
-	    - if the cancel does not specify inputs:
-		- if cancel is EOA -> set starting frame to end
-	        - cancel if animation_frame > starting_frame
-	    - if the cancel specify inputs:
-	        - animation frame has to be in input window range
-		- no window -> input window range is [0, animation_length]
-	**/
-	uint32_t starting_frame = cancel.starting_frame;
-	if (cancel.condition == TEK_CANCEL_CONDITION_END_OF_ANIMATION) {
-		starting_frame = ctx.animation_length;
+	// restore the last keyframe before frame, unless simulating forward from the current frame is shorter
+	uint32_t ikeyframe = frame / keyframes->interval;
+	if (ikeyframe >= keyframes->length) {
+		ikeyframe = keyframes->length - 1;
+	}
+	uint32_t keyframe_frame = keyframes->length > 0 ? ikeyframe * keyframes->interval : 0;
+	if (frame < current_frame || keyframe_frame > current_frame) {
+		battle_replay_keyframe_restore(ctx, keyframes->length > 0 ? &keyframes->keyframes[ikeyframe] : initial);
+		current_frame = keyframe_frame;
 	}
-	bool is_in_frame = ctx.animation_frame >= starting_frame;
 
-	uint32_t input_window_start = cancel.input_window_start;
-	uint32_t input_window_end = cancel.input_window_end;
-	bool is_in_input_window = input_window_start <= ctx.animation_frame && ctx.animation_frame <= input_window_end;
-	if (cancel.input_window_start == 0 && cancel.input_window_end == 0) {
-		is_in_input_window = true;
+	for (uint32_t i = current_frame; i < frame; ++i) {
+		TracyCZoneN(replay_frame, "Replay Frame", true);
+		battle_replay_keyframes_capture(keyframes, ctx, i);
+		(void)battle_simulate_frame(ctx, inputs[i]);
+		TracyCZoneEnd(replay_frame);
 	}
 
-	/** Input checks: **/
+	TracyCZoneEnd(f);
+	return frame - current_frame;
+}
+
+
+static uint8_t _input_run_next(uint8_t run, bool matches)
+{
+	if (!matches) {
+		return 0;
+	}
+	return run < INPUT_RUN_MAX ? (uint8_t)(run + 1) : run;
+}
+
+static void _push_input(struct TekPlayerComponent *player, struct BattleInput input)
+{
+	uint32_t input_index = player->input_buffer_head % INPUT_BUFFER_SIZE;
+	player->input_buffer_head += 1;
+	player->input_buffer[input_index] = input;
+
+	for (uint32_t imotion = 0; imotion < TEK_MOTION_INPUT_COUNT; ++imotion) {
+		player->motion_absent_frames[imotion] = _input_run_next(player->motion_absent_frames[imotion], input.motion != imotion);
+	}
+	for (uint32_t iaction = 0; iaction < TEK_ACTION_INPUT_COUNT; ++iaction) {
+		bool held = (input.actions & (1u << iaction)) != 0;
+		player->action_held_frames[iaction] = _input_run_next(player->action_held_frames[iaction], held);
+		player->action_released_frames[iaction] = _input_run_next(player->action_released_frames[iaction], !held);
+	}
+}
+
+// Every direction of the set was held for the last n frames <=> every direction outside of the set was absent for n frames
+static bool _input_motion_held_for(struct TekPlayerComponent const *player, tek_MotionInputSet motions, uint32_t n)
+{
+	if (motions == TEK_MOTION_INPUT_ANY) {
+		return true;
+	}
+	// zeroed inputs (no peer input yet) have the motion 0 and count as a direction here
+	for (uint32_t imotion = 0; imotion < TEK_MOTION_INPUT_COUNT; ++imotion) {
+		if ((motions & (1u << imotion)) == 0 && player->motion_absent_frames[imotion] < n) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool _input_actions_held_for(struct TekPlayerComponent const *player, tek_ActionInputSet pressed, tek_ActionInputSet not_held, uint32_t n)
+{
+	for (uint32_t iaction = 0; iaction < TEK_ACTION_INPUT_COUNT; ++iaction) {
+		if ((pressed & (1u << iaction)) != 0 && player->action_held_frames[iaction] < n) {
+			return false;
+		}
+		if ((not_held & (1u << iaction)) != 0 && player->action_released_frames[iaction] < n) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// The frame conditions of compiled cancels are already checked by their segment, only the inputs are left
+static bool match_cancel(struct TekPlayerComponent const *player, struct tek_CompiledCancel const *cancel)
+{
+	/** Input checks: the command has to be held for hold_duration frames, answered by the input runs **/
 	bool match_dir = true;
 	bool match_action = true;
-	bool has_enough_inputs = player.input_buffer_head >= cancel.command.fields.hold_duration;
-	bool is_larger_than_buffer = cancel.command.fields.hold_duration > INPUT_BUFFER_SIZE;
+	uint32_t hold_duration = cancel->command.fields.hold_duration;
+	bool has_enough_inputs = player->input_buffer_head >= hold_duration;
+	bool is_larger_than_buffer = hold_duration > INPUT_BUFFER_SIZE;
 	if (!has_enough_inputs || is_larger_than_buffer) {
 		match_dir = false;
 		match_action = false;
 	} else {
-		for (uint32_t i = 0; i < cancel.command.fields.hold_duration; ++i) {
-			uint32_t input_index = (player.input_buffer_head-i-1) % INPUT_BUFFER_SIZE;
-			struct BattleInput current_input = player.input_buffer[input_index];
-
-			uint32_t needle = (1u << current_input.motion);
-			match_dir = match_dir && ((cancel.command.fields.motion == TEK_MOTION_INPUT_ANY) || ((needle & cancel.command.fields.motion) != 0));
-
-			match_action = match_action && ((current_input.actions & cancel.command.fields.action.not_held) == 0);
-			match_action = match_action && ((current_input.actions & cancel.command.fields.action.pressed) == cancel.command.fields.action.pressed);
-		}
+		match_dir = _input_motion_held_for(player, cancel->command.fields.motion, hold_duration);
+		match_action = _input_actions_held_for(player, cancel->command.fields.action.pressed, cancel->command.fields.action.not_held, hold_duration);
 	}
 
-	return match_dir & match_action & is_in_frame & is_in_input_window;
+	return match_dir & match_action;
 }
 
 static void player_translate_world(uint32_t iplayer, struct PlayerEntity **players, struct tek_Character **characters, uint32_t players_length, Float3 world_translate)
@@ -372,9 +448,10 @@ static void player_translate_world(uint32_t iplayer, struct PlayerEntity **playe
 
 static void _evaluate_hit_conditions(struct PlayerEntity *p1, struct PlayerEntity *p2, struct PlayerNonEntity *np1, struct PlayerNonEntity *np2, struct tek_Character *c1, struct tek_Character *c2)
 {
-	struct tek_Move *current_move = tek_character_find_move(c1, p1->tek.current_move_id);
+	ASSERT(p1->tek.current_move < c1->moves_length);
+	struct tek_Move *current_move = c1->moves + p1->tek.current_move;
 
-	if (current_move && current_move->hit_conditions_length > 0) {
+	if (current_move->hit_conditions_length > 0) {
 		uint32_t current = p1->animation.frame;
 		uint32_t first_active = current_move->first_active;
 		uint32_t last_active = current_move->last_active;
@@ -382,30 +459,32 @@ static void _evaluate_hit_conditions(struct PlayerEntity *p1, struct PlayerEntit
 		if (is_active) {
 			ASSERT(current_move->hitbox < c1->hitboxes_length);
 			uint32_t ihitbox = current_move->hitbox;
-			Float3 hit_center = np1->hitboxes_position[ihitbox];
-			float hit_radius = c1->hitboxes_radius[ihitbox];
-			float hit_height = c1->hitboxes_height[ihitbox];
+			struct Cylinder hitbox = {0};
+			hitbox.center.x = np1->hitboxes_x[ihitbox];
+			hitbox.center.y = np1->hitboxes_y[ihitbox];
+			hitbox.center.z = np1->hitboxes_z[ihitbox];
+			hitbox.radius = c1->hitboxes_radius[ihitbox];
+			hitbox.half_height = c1->hitboxes_half_height[ihitbox];
+
+			if (hitbox.radius > 0.0f) {
+				// hurtboxes past hurtboxes_length have a zero radius, they pad the arrays to the SIMD width
+				struct Cylinders hurtboxes = {0};
+				hurtboxes.x = np2->hurtboxes_x;
+				hurtboxes.y = np2->hurtboxes_y;
+				hurtboxes.z = np2->hurtboxes_z;
+				hurtboxes.radius = c2->hurtboxes_radius;
+				hurtboxes.half_height = c2->hurtboxes_half_height;
+				hurtboxes.length = c2->hurtboxes_length;
+				uint8_t hurtboxes_hit[MAX_BONES_PER_MESH / 8];
+				cylinders_overlap(hitbox, hurtboxes, hurtboxes_hit);
 
-			if (hit_radius > 0.0f) {
 				for (uint32_t ihurtbox = 0; ihurtbox < c2->hurtboxes_length; ++ihurtbox){
-					Float3 hurt_center = np2->hurtboxes_position[ihurtbox];
-					float hurt_radius = c2->hurtboxes_radius[ihurtbox];
-					float hurt_height = c2->hurtboxes_height[ihurtbox];
-
-					float x_dist = hit_center.x - hurt_center.x;
-					float y_dist = hit_center.y - hurt_center.y;
-					float hor_distance = sqrtf(x_dist*x_dist + y_dist*y_dist);
-					float vert_distance = (float)fabs(hit_center.z - hurt_center.z);
-
-					bool is_valid = hurt_radius > 0.0f;
-					bool inside_vert = vert_distance <= ((hit_height + hurt_height) / 2.0f);
-					bool inside_hor = hor_distance <= (hit_radius + hurt_radius);
-					bool inside = is_valid & inside_vert & inside_hor;
+					bool inside = (hurtboxes_hit[ihurtbox / 8] >> (ihurtbox % 8)) & 1;
 					if (inside) {
 						struct tek_HitCondition hit_condition = current_move->hit_conditions[0];
 						struct tek_HitReactions *hit_reaction = c1->hit_reactions + hit_condition.ireactions;
 
-						struct tek_Move *p2_current_move = tek_character_find_move(c2, p2->tek.current_move_id);
+						struct tek_Move *p2_current_move = c2->moves + p2->tek.current_move;
 						ASSERT(p2->tek.input_buffer_head > 0);
 						struct BattleInput p2_current_input = p2->tek.input_buffer[(p2->tek.input_buffer_head-1)%INPUT_BUFFER_SIZE];
 
@@ -433,10 +512,10 @@ static void _evaluate_hit_conditions(struct PlayerEntity *p1, struct PlayerEntit
 						} else if (is_blocking) {
 							uint32_t stun_duration = 0;
 							if (current_move->hit_level == TEK_HIT_LEVEL_LOW) {
-								p2->tek.requested_move_id = hit_reaction->crouch_block_move;
+								p2->tek.requested_move = hit_reaction->icrouch_block_move;
 								stun_duration = hit_reaction->crouch_block_stun;
 							} else {
-								p2->tek.requested_move_id = hit_reaction->standing_block_move;
+								p2->tek.requested_move = hit_reaction->istanding_block_move;
 								stun_duration = hit_reaction->standing_block_stun;
 							}
 
@@ -450,10 +529,10 @@ static void _evaluate_hit_conditions(struct PlayerEntity *p1, struct PlayerEntit
 
 							uint32_t stun_duration = 0;
 							if (current_move->hit_level == TEK_HIT_LEVEL_LOW) {
-								p2->tek.requested_move_id = hit_reaction->crouch_move;
+								p2->tek.requested_move = hit_reaction->icrouch_move;
 								stun_duration = hit_reaction->crouch_stun;
 							} else {
-								p2->tek.requested_move_id = hit_reaction->standing_move;
+								p2->tek.requested_move = hit_reaction->istanding_move;
 								stun_duration = hit_reaction->standing_stun;
 							}
 						p2->tek.status = CHARACTER_STATUS_HITSTUN;
@@ -461,7 +540,7 @@ static void _evaluate_hit_conditions(struct PlayerEntity *p1, struct PlayerEntit
 						}
 
 					if (p2->tek.hp <= 0) {
-						p2->tek.requested_move_id = (uint32_t)TEK_MOVE_DEATH_ID;
+						p2->tek.requested_move = c2->imove_death;
 					}
 					}
 					// Set attacker to recovery
@@ -493,10 +572,7 @@ enum BattleFrameResult battle_state_update(struct BattleContext *ctx, struct Bat
 
 	// register input in the input buffer
 	for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-		struct PlayerEntity *p = players[iplayer];
-		uint32_t input_index = p->tek.input_buffer_head % INPUT_BUFFER_SIZE;
-		p->tek.input_buffer_head += 1;
-		p->tek.input_buffer[input_index] = pinputs[iplayer];
+		_push_input(&players[iplayer]->tek, pinputs[iplayer]);
 	}
 
 	// -- gameplay update
@@ -526,175 +602,86 @@ enum BattleFrameResult battle_state_update(struct BattleContext *ctx, struct Bat
 
 	// apply requested move from previous simulation
 	for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-		uint32_t requested_move_id = players[iplayer]->tek.requested_move_id;
-		if (requested_move_id != 0) {
-			struct tek_Move *request_move = tek_character_find_move(characters[iplayer], requested_move_id);
-			struct Animation const *animation = asset_library_get_animation(ctx->assets, request_move->animation_id);
-			(void)animation;
-
+		tek_MoveIndex requested_move = players[iplayer]->tek.requested_move;
+		if (requested_move != TEK_INVALID_MOVE) {
+			ASSERT(requested_move < characters[iplayer]->moves_length);
+			struct tek_Move *request_move = characters[iplayer]->moves + requested_move;
 			players[iplayer]->animation.animation_id = request_move->animation_id;
 			players[iplayer]->animation.frame = 0;
-			players[iplayer]->tek.current_move_id = requested_move_id;
-			players[iplayer]->tek.requested_move_id = 0;
+			players[iplayer]->tek.current_move = requested_move;
+			players[iplayer]->tek.requested_move = TEK_INVALID_MOVE;
 		}
 	}
 
 	// move request
+	TracyCZoneN(cancels_zone, "Battle - cancel matching", true);
 	for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-		// find current move
-		struct tek_Move *current_move = tek_character_find_move(characters[iplayer], players[iplayer]->tek.current_move_id);
-		struct tek_Cancel *current_cancels = current_move->cancels;
+		struct tek_Move *current_move = characters[iplayer]->moves + players[iplayer]->tek.current_move;
+		uint32_t animation_frame = players[iplayer]->animation.frame;
+
+		// find the cancel segment of the current frame, it holds the cancels that can fire in priority order
+		struct tek_CancelSegment const *segments = characters[iplayer]->cancel_segments + current_move->cancel_segments_offset;
+		uint32_t isegment = 0;
+		while (isegment + 1 < current_move->cancel_segments_length && segments[isegment + 1].first_frame <= animation_frame) {
+			isegment += 1;
+		}
 
 		// find valid cancel
-		struct Animation const *animation = asset_library_get_animation(ctx->assets, current_move->animation_id);
-		struct CancelContext cancel_ctx = {0};
-		cancel_ctx.current_frame = state->frame_number;
-		cancel_ctx.animation_frame = players[iplayer]->animation.frame;
-		cancel_ctx.animation_length = animation->root_motion_track.translations.length;
-		uint32_t request_move_id = 0;
-
-		struct tek_Cancel *cancel = NULL;
-		for (uint32_t imovecancel = 0; imovecancel < current_move->cancels_length; ++imovecancel) {
-			bool is_group = current_cancels[imovecancel].type == TEK_CANCEL_TYPE_LIST;
-
-			if (!is_group) {
-				if (match_cancel(players[iplayer]->tek, current_cancels[imovecancel], cancel_ctx)) {
-					cancel = &current_cancels[imovecancel];
-				}
-			} else {
-
-				uint32_t starting_frame = current_cancels[imovecancel].starting_frame;
-				if (current_cancels[imovecancel].condition == TEK_CANCEL_CONDITION_END_OF_ANIMATION) {
-					starting_frame = cancel_ctx.animation_length;
-				}
-				bool is_in_frame = cancel_ctx.animation_frame >= starting_frame;
-
-				uint32_t input_window_start = current_cancels[imovecancel].input_window_start;
-				uint32_t input_window_end = current_cancels[imovecancel].input_window_end;
-				bool is_in_input_window = input_window_start <= cancel_ctx.animation_frame && cancel_ctx.animation_frame <= input_window_end;
-				if (current_cancels[imovecancel].input_window_start == 0 && current_cancels[imovecancel].input_window_end == 0) {
-					is_in_input_window = true;
-				}
-
-				struct tek_CancelGroup *group = NULL;
-				// find group
-				for (uint32_t imovecancelgroup = 0; imovecancelgroup < characters[iplayer]->cancel_groups_length; ++imovecancelgroup) {
-					if (characters[iplayer]->cancel_groups[imovecancelgroup].id == current_cancels[imovecancel].to_move_id) {
-						group = &characters[iplayer]->cancel_groups[imovecancelgroup];
-						break;
-					}
-				}
-				// if found, match list
-				if (group && is_in_frame) {
-					for (uint32_t igroupcancel = 0; igroupcancel < MAX_CANCELS_PER_GROUP; ++igroupcancel) {
-						struct tek_Cancel *groupcancel = &group->cancels[igroupcancel];
-						if (match_cancel(players[iplayer]->tek, *groupcancel, cancel_ctx)) {
-							cancel = groupcancel;
-							break;
-						}
-					}
-				}
-			}
-			if (cancel) {
-				struct tek_Move *request_move = tek_character_find_move(characters[iplayer], cancel->to_move_id);
-				if (current_move->id != cancel->to_move_id) {
-					printf("p%u cancel %s[%u] -> %s[%u] | frame: %u | anim frame: %u | anim len: %u\n",
-					       iplayer,
-					       characters[iplayer]->move_names[current_move-characters[iplayer]->moves].string,
-					       current_move->id,
-					       characters[iplayer]->move_names[request_move-characters[iplayer]->moves].string,
-					       cancel->to_move_id,
-					       state->frame_number,
-					       cancel_ctx.animation_frame,
-					       cancel_ctx.animation_length
-					       );
-				}
-				request_move_id = cancel->to_move_id;
-				break;
-			}
-		}
-		if (request_move_id != 0) {
-			// find request move
-			struct tek_Move *request_move = tek_character_find_move(characters[iplayer], request_move_id);
-			// if found, perform the cancel
-			if (request_move != NULL) {
-		struct Animation const *anim = asset_library_get_animation(ctx->assets, request_move->animation_id);
-		(void)anim;
-				players[iplayer]->animation.animation_id = request_move->animation_id;
-				if (cancel->type == TEK_CANCEL_TYPE_SINGLE_LOOP || cancel->type == TEK_CANCEL_TYPE_SINGLE_CONTINUE) {
-					players[iplayer]->animation.frame = players[iplayer]->animation.frame % cancel_ctx.animation_length;
-				} else {
-					players[iplayer]->animation.frame = 0;
+		struct tek_CompiledCancel const *cancel = NULL;
+		if (current_move->cancel_segments_length > 0) {
+			struct tek_CompiledCancel const *segment_cancels = characters[iplayer]->cancel_program + segments[isegment].cancels_offset;
+			for (uint32_t icancel = 0; icancel < segments[isegment].cancels_length; ++icancel) {
+				if (match_cancel(&players[iplayer]->tek, segment_cancels + icancel)) {
+					cancel = segment_cancels + icancel;
+					break;
 				}
-				players[iplayer]->tek.current_move_id = request_move->id;
 			}
 		}
-	}
-
-	// Camera follow
-	if (nonstate->camera_focus != 0)
-	{
-		struct SpatialComponent *p1_root = &state->p1_entity.spatial;
-		struct SpatialComponent *p2_root = &state->p2_entity.spatial;
-
-		Float3 target_pos = float3_add(p1_root->world_transform.cols[3], p2_root->world_transform.cols[3]);
-		target_pos.x *= 0.5f;
-		target_pos.y *= 0.5f;
-		target_pos.z *= 0.5f;
-		Float3 camera_pos = nonstate->camera.position;
-		(void)camera_pos;
-		float target_distance = float3_distance(target_pos, camera_pos);
-		(void)target_distance;
-
-		float ratio = 9.0f / 16.0f;
-		float fov_rad = nonstate->camera.vertical_fov * 2.0f * 3.14f / 360.0f;
-		float width_from_dist = ratio * 2.0f * tanf(fov_rad / 2.0f);
-
-		float const CAMERA_HACK_TWEAK = 0.35f;
-		float ideal_width = float3_distance(p1_root->world_transform.cols[3], p2_root->world_transform.cols[3]) * CAMERA_HACK_TWEAK;
-
-		float ideal_distance = ideal_width / width_from_dist;
-
-		Float3 camera_dir = p1_root->world_transform.cols[0];
-		if (nonstate->camera_focus == 2) {
-			camera_dir = p2_root->world_transform.cols[0];
+#if BATTLE_DEBUG_PRINT_CANCELS
+		if (cancel && players[iplayer]->tek.current_move != cancel->ito_move) {
+			printf("p%u cancel %s[%u] -> %s[%u] | frame: %u | anim frame: %u | anim len: %u\n",
+			       iplayer,
+			       characters[iplayer]->move_names[players[iplayer]->tek.current_move].string,
+			       current_move->id,
+			       characters[iplayer]->move_names[cancel->ito_move].string,
+			       characters[iplayer]->moves[cancel->ito_move].id,
+			       state->frame_number,
+			       animation_frame,
+			       current_move->animation_length
+			       );
 		}
-
-		float const MINIMUM_DISTANCE = 3.5f;
-		float const CAMERA_SMOOTHING = 0.1f;
-
-		float delta_dist = (ideal_distance - nonstate->camera_distance) * CAMERA_SMOOTHING;
-		nonstate->camera_distance += delta_dist;
-		if (nonstate->camera_distance < MINIMUM_DISTANCE) {
-			nonstate->camera_distance = MINIMUM_DISTANCE;
+#endif
+		// perform the cancel, the move index was resolved at load
+		if (cancel) {
+			struct tek_Move *request_move = characters[iplayer]->moves + cancel->ito_move;
+			players[iplayer]->animation.animation_id = request_move->animation_id;
+			if (cancel->type == TEK_CANCEL_TYPE_SINGLE_LOOP || cancel->type == TEK_CANCEL_TYPE_SINGLE_CONTINUE) {
+				players[iplayer]->animation.frame = players[iplayer]->animation.frame % current_move->animation_length;
+			} else {
+				players[iplayer]->animation.frame = 0;
+			}
+			players[iplayer]->tek.current_move = cancel->ito_move;
 		}
-
-		nonstate->camera.position = float3_add(target_pos, float3_mul_scalar(camera_dir, nonstate->camera_distance));
-		nonstate->camera.lookat = target_pos;
-
-		nonstate->camera.position.z += 1.0f;
-		nonstate->camera.lookat.z += 1.0f;
 	}
+	TracyCZoneEnd(cancels_zone);
 
 	// Evaluate anims
+	TracyCZoneN(anim_zone, "Battle - anim eval", true);
 	for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-		struct AnimSkeleton const *anim_skeleton = asset_library_get_anim_skeleton(ctx->assets, players[iplayer]->anim_skeleton.anim_skeleton_id);
-		struct Animation const *animation = asset_library_get_animation(ctx->assets, players[iplayer]->animation.animation_id);
+		// the animation component always plays the animation of the current move
+		struct tek_Move *current_move = characters[iplayer]->moves + players[iplayer]->tek.current_move;
+		struct AnimSkeleton const *anim_skeleton = asset_library_anim_skeleton_from_handle(ctx->assets, characters[iplayer]->anim_skeleton);
+		struct Animation const *animation = asset_library_animation_from_handle(ctx->assets, current_move->animation);
 		// Evaluate animation and apply root motion
 		if (animation != NULL) {
 			anim_evaluate_animation(anim_skeleton, animation, &nonplayers[iplayer]->pose, players[iplayer]->animation.frame);
-			// update render skeleton
 			anim_pose_compute_global_transforms(anim_skeleton, &nonplayers[iplayer]->pose);
-			skeletal_mesh_apply_pose(&nonplayers[iplayer]->mesh_instance, &nonplayers[iplayer]->pose);
+			if (ctx->presentation.apply_pose) {
+				ctx->presentation.apply_pose(ctx, players[iplayer], nonplayers[iplayer]);
+			}
 			// apply root motion
 			Float3 root_translation = float3x4_transform_direction(players[iplayer]->spatial.world_transform, nonplayers[iplayer]->pose.root_motion_delta_translation);
-
-		(void)animation;
-
-			struct tek_Move *current_move = tek_character_find_move(characters[iplayer], players[iplayer]->tek.current_move_id);
-			if (current_move) {
-				root_translation = float3_mul_scalar(root_translation, current_move->animation_root_motion_scale);
-			}
+			root_translation = float3_mul_scalar(root_translation, current_move->animation_root_motion_scale);
 
 			player_translate_world(iplayer, players, characters, ARRAY_LENGTH(players), root_translation);
 
@@ -703,15 +690,16 @@ enum BattleFrameResult battle_state_update(struct BattleContext *ctx, struct Bat
 		// Update animation component
 		players[iplayer]->animation.frame += 1;
 	}
+	TracyCZoneEnd(anim_zone);
 
 	// Make players track each other
 	for (uint32_t iplayer = 0; iplayer < 2; ++iplayer) {
 		uint32_t iother = 1 - iplayer;
 		uint8_t cur = (uint8_t)players[iplayer]->animation.frame;
-		struct tek_Move *current_move = tek_character_find_move(characters[iplayer], players[iplayer]->tek.current_move_id);
+		struct tek_Move *current_move = characters[iplayer]->moves + players[iplayer]->tek.current_move;
 
 		// If the current move can track
-		if (current_move) {
+		{
 			if (current_move->track_first <= cur && cur <= current_move->track_end) {
 
 				// Get positions
@@ -736,35 +724,20 @@ enum BattleFrameResult battle_state_update(struct BattleContext *ctx, struct Bat
 
 
 	// Once all transform calculations are done, we can update hitboxes and evaluate hits
+	TracyCZoneN(hitboxes_zone, "Battle - hitbox update", true);
 	for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-		struct AnimSkeleton const *anim_skeleton = asset_library_get_anim_skeleton(ctx->assets, players[iplayer]->anim_skeleton.anim_skeleton_id);
-		// update hurtboxes positions
-		for (uint32_t ihurtbox = 0; ihurtbox < characters[iplayer]->hurtboxes_length; ++ihurtbox) {
-			uint32_t hurtbox_bone_id = characters[iplayer]->hurtboxes_bone_id[ihurtbox];
-			for (uint32_t ibone = 0; ibone < anim_skeleton->bones_length; ++ibone){
-				if (anim_skeleton->bones_identifier[ibone] == hurtbox_bone_id) {
-					nonplayers[iplayer]->hurtboxes_position[ihurtbox] = float3x4_transform_point(
-														     players[iplayer]->spatial.world_transform,
-														     nonplayers[iplayer]->pose.global_transforms[ibone].cols[3]);
-					break;
-				}
-			}
-		}
-		// update hitboxes positions
-		for (uint32_t ihitbox = 0; ihitbox < characters[iplayer]->hitboxes_length; ++ihitbox) {
-			uint32_t hitbox_bone_id = characters[iplayer]->hitboxes_bone_id[ihitbox];
-			for (uint32_t ibone = 0; ibone < anim_skeleton->bones_length; ++ibone){
-				if (anim_skeleton->bones_identifier[ibone] == hitbox_bone_id) {
-					nonplayers[iplayer]->hitboxes_position[ihitbox] = float3x4_transform_point(
-														     players[iplayer]->spatial.world_transform,
-														     nonplayers[iplayer]->pose.global_transforms[ibone].cols[3]);
-					break;
-				}
-			}
-		}
-	}
+		// box bones are resolved when the character is loaded
+		struct tek_Character const *c = characters[iplayer];
+		Float3x4 world_transform = players[iplayer]->spatial.world_transform;
+		struct PlayerNonEntity *pn = nonplayers[iplayer];
+		anim_pose_gather_bone_positions(&pn->pose, world_transform, c->hurtboxes_bone_index, c->hurtboxes_length, pn->hurtboxes_x, pn->hurtboxes_y, pn->hurtboxes_z);
+		anim_pose_gather_bone_positions(&pn->pose, world_transform, c->hitboxes_bone_index, c->hitboxes_length, pn->hitboxes_x, pn->hitboxes_y, pn->hitboxes_z);
+	}
+	TracyCZoneEnd(hitboxes_zone);
+	TracyCZoneN(hits_zone, "Battle - hit evaluation", true);
 	_evaluate_hit_conditions(players[0], players[1], nonplayers[0], nonplayers[1], characters[0], characters[1]);
 	_evaluate_hit_conditions(players[1], players[0], nonplayers[1], nonplayers[0], characters[1], characters[0]);
+	TracyCZoneEnd(hits_zone);
 
 
 	// post update: determine future game state
@@ -797,144 +770,11 @@ enum BattleFrameResult battle_state_update(struct BattleContext *ctx, struct Bat
 	// next frame
 	state->frame_number += 1;
 
-	TracyCZoneEnd(f);
-
-	return frame_result;
-}
-
-// -- Render
-
-void battle_render(struct BattleContext *ctx)
-{
-	TracyCZoneN(f, "BattleRender", true);
-	struct BattleState *state = &ctx->battle_state;
-	struct BattleNonState *nonstate = &ctx->battle_non_state;
-	struct PlayerEntity *players[] = {&state->p1_entity, &state->p2_entity};
-	struct PlayerNonEntity *nonplayers[] = {
-		&nonstate->p1_nonentity,
-		&nonstate->p2_nonentity,
-	};
-	struct tek_Character *characters[] = {
-		tek_characters + players[0]->tek.character_id,
-		tek_characters + players[1]->tek.character_id,
-	};
-
-	ed_display_player_entity("Player 1", &state->p1_entity);
-	ed_display_player_entity("Player 2", &state->p2_entity);
-	ed_display_debug_menu(nonstate);
-
-	// -- debug draw
-	debug_draw_reset();
-
-	// Evaluate anims
-	if (nonstate->draw_bones) {
-		for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-			struct AnimSkeleton const *anim_skeleton = asset_library_get_anim_skeleton(ctx->assets, players[iplayer]->anim_skeleton.anim_skeleton_id);
-			struct Animation const *animation = asset_library_get_animation(ctx->assets, players[iplayer]->animation.animation_id);
-			(void)animation;
-			// Debug draw animated pose
-			for (uint32_t ibone = 0; ibone < anim_skeleton->bones_length; ibone++) {
-				Float3 p;
-				p.x = F34(nonplayers[iplayer]->pose.global_transforms[ibone], 0, 3);
-				p.y = F34(nonplayers[iplayer]->pose.global_transforms[ibone], 1, 3);
-				p.z = F34(nonplayers[iplayer]->pose.global_transforms[ibone], 2, 3);
-				p = float3x4_transform_point(players[iplayer]->spatial.world_transform, p);
-				debug_draw_point(p);
-			}
-		}
-	}
-
-	// debug draw hurtboxes cylinders
-	if (nonstate->draw_hurtboxes) {
-		for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-			for (uint32_t ihurtbox = 0; ihurtbox < characters[iplayer]->hurtboxes_length; ++ihurtbox) {
-				Float3 center = nonplayers[iplayer]->hurtboxes_position[ihurtbox];
-				float radius = characters[iplayer]->hurtboxes_radius[ihurtbox];
-				float height = characters[iplayer]->hurtboxes_height[ihurtbox];
-				debug_draw_cylinder(center, radius, height, DD_RED);
-			}
-		}
+	if (ctx->presentation.frame_simulated) {
+		ctx->presentation.frame_simulated(ctx);
 	}
 
-	// debug draw hitboxes cylinders
-	if (nonstate->draw_hitboxes) {
-		for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-			struct tek_Move *current_move = tek_character_find_move(characters[iplayer], players[iplayer]->tek.current_move_id);
-
-			uint32_t current = players[iplayer]->animation.frame;
-			uint32_t first_active = current_move->first_active;
-			uint32_t last_active = current_move->last_active;
-			bool is_active = first_active <= current && current <= last_active;
-			if (is_active) {
-				ASSERT(current_move->hitbox < characters[iplayer]->hitboxes_length);
-				uint32_t ihitbox = current_move->hitbox;
-				Float3 center = nonplayers[iplayer]->hitboxes_position[ihitbox];
-				float radius = characters[iplayer]->hitboxes_radius[ihitbox];
-				float height = characters[iplayer]->hitboxes_height[ihitbox];
-				debug_draw_cylinder(center, radius, height, DD_GREEN);
-			}
-		}
-	}
-
-	if (nonstate->draw_colisions) {
-		for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-			float radius = (float)characters[iplayer]->colision_radius;
-			Float3 center = players[iplayer]->spatial.world_transform.cols[3];
-			float height = 2.0;
-			center.z += height * 0.5f;
-			debug_draw_cylinder(center, radius, height, DD_GREEN);
-		}
-	}
-	// debug draw grid
-	if (nonstate->draw_grid) {
-		float width = 24.0f;
-		for (float i = 1.0f; i <= width; i += 1.0f) {
-			debug_draw_line((Float3){i, -width, 0.0f}, (Float3){i, width, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
-			debug_draw_line((Float3){-i, -width, 0.0f}, (Float3){-i, width, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
-			debug_draw_line((Float3){-width, i, 0.0f}, (Float3){width, i, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
-			debug_draw_line((Float3){-width, -i, 0.0f}, (Float3){width, -i, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
-		}
-		debug_draw_line((Float3){-width, 0.0f, 0.0f}, (Float3){0, 0.0f, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
-		debug_draw_line((Float3){0, 0.0f, 0.0f}, (Float3){width, 0.0f, 0.0f}, DD_RED);
-		debug_draw_line((Float3){0.0f, -width, 0.0f}, (Float3){0, 0.0f, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
-		debug_draw_line((Float3){0, 0.0f, 0.0f}, (Float3){0.0f, width, 0.0f}, DD_GREEN);
-		debug_draw_line((Float3){0.0f, 0.0f, -width}, (Float3){0.0f, 0.0f, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
-		debug_draw_line((Float3){0.0f, 0.0f, 0.0f}, (Float3){0.0f, 0.0f, width}, DD_BLUE);
-		width = 2.4f;
-		for (float i = 0.1f; i <= width; i += 0.1f) {
-			debug_draw_line((Float3){i, -width, 0.0f}, (Float3){i, width, 0.0f}, DD_WHITE & DD_QUARTER_ALPHA);
-			debug_draw_line((Float3){-i, -width, 0.0f}, (Float3){-i, width, 0.0f}, DD_WHITE & DD_QUARTER_ALPHA);
-			debug_draw_line((Float3){-width, i, 0.0f}, (Float3){width, i, 0.0f}, DD_WHITE & DD_QUARTER_ALPHA);
-			debug_draw_line((Float3){-width, -i, 0.0f}, (Float3){width, -i, 0.0f}, DD_WHITE & DD_QUARTER_ALPHA);
-		}
-	}
-	// draw local axis for players
-	for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
-		struct SpatialComponent *root = &players[iplayer]->spatial;
-		Float3 origin = {0};
-		Float3 x_axis = (Float3){0.1f, 0.0f, 0.0f};
-		Float3 y_axis = (Float3){0.0f, 0.1f, 0.0f};
-		Float3 z_axis = (Float3){0.0f, 0.0f, 0.1f};
-		Float3 o = float3x4_transform_point(root->world_transform, origin);
-		Float3 x = float3x4_transform_point(root->world_transform, x_axis);
-		Float3 y = float3x4_transform_point(root->world_transform, y_axis);
-		Float3 z = float3x4_transform_point(root->world_transform, z_axis);
-		debug_draw_line(o, x, DD_RED);
-		debug_draw_line(o, y, DD_GREEN);
-		debug_draw_line(o, z, DD_BLUE);
-	}
-
-
-	// interpolate camera for smooth movement
-	float coef = 0.05f;
-	nonstate->camera_display.position.x = nonstate->camera_display.position.x*(1.0f-coef) + nonstate->camera.position.x*coef;
-	nonstate->camera_display.position.y = nonstate->camera_display.position.y*(1.0f-coef) + nonstate->camera.position.y*coef;
-	nonstate->camera_display.position.z = nonstate->camera_display.position.z*(1.0f-coef) + nonstate->camera.position.z*coef;
-	nonstate->camera_display.lookat.x = nonstate->camera_display.lookat.x*(1.0f-coef) + nonstate->camera.lookat.x*coef;
-	nonstate->camera_display.lookat.y = nonstate->camera_display.lookat.y*(1.0f-coef) + nonstate->camera.lookat.y*coef;
-	nonstate->camera_display.lookat.z = nonstate->camera_display.lookat.z*(1.0f-coef) + nonstate->camera.lookat.z*coef;
-	nonstate->camera_display.vertical_fov = nonstate->camera_display.vertical_fov*(1.0f-coef) + nonstate->camera.vertical_fov*coef;
-	renderer_set_main_camera(ctx->renderer, nonstate->camera_display);
-
 	TracyCZoneEnd(f);
+
+	return frame_result;
 }
@@ -3,9 +3,9 @@
 #include "game_components.h"
 
 #define INPUT_BUFFER_SIZE 128 // Number of different inputs in the in buffer
+#define INPUT_RUN_MAX 255 // Input run lengths saturate, hold durations never exceed INPUT_BUFFER_SIZE
 
-struct Inputs;
-typedef struct Renderer Renderer;
+struct BattleContext;
 
 // Inputs for the battle system
 enum BattleInputBits
@@ -31,6 +31,33 @@ struct BattleInputs
 	struct BattleInput player2;
 };
 
+/**
+Input prediction for rollback, used for the inputs of the remote player that have not arrived yet.
+Directions are predicted to stay held. Buttons are predicted to be released when the player usually releases them:
+each player has a histogram of their press durations per button, and a held button is predicted released on a
+future frame when the past presses that lasted as long as the current one mostly ended before that frame.
+A release only helps if nothing else changed on that frame, so the ended presses are weighted by the share of
+clean releases of the button. Without enough presses to decide, buttons are predicted held, like the default
+GGPO prediction.
+ **/
+#define BATTLE_PREDICTOR_MAX_PRESS 32 // longer presses are counted in the last bucket
+#define BATTLE_PREDICTOR_MIN_PRESSES 8 // presses needed to predict a release
+#define BATTLE_PREDICTOR_MAX_PRESSES 1024 // the histogram is halved past this many presses, to follow the player
+
+struct BattleInputPredictorPlayer
+{
+	uint8_t held_frames[TEK_ACTION_INPUT_COUNT]; // current press, as of the last observed input
+	uint16_t presses_length[TEK_ACTION_INPUT_COUNT];
+	uint16_t clean_releases[TEK_ACTION_INPUT_COUNT]; // presses that ended without any other input change
+	uint16_t press_durations[TEK_ACTION_INPUT_COUNT][BATTLE_PREDICTOR_MAX_PRESS + 1]; // presses per duration in frames
+	struct BattleInput last_input;
+};
+
+struct BattleInputPredictor
+{
+	struct BattleInputPredictorPlayer players[2];
+};
+
 // Component for the battle system
 enum CharacterStatus
 {
@@ -48,8 +75,8 @@ struct TekPlayerComponent
 	uint8_t status;
 	uint8_t status_remaining;
 	// status
-	uint32_t requested_move_id;
-	uint32_t current_move_id;
+	tek_MoveIndex requested_move; // TEK_INVALID_MOVE if none
+	tek_MoveIndex current_move;
 	int hp;
 	// pushback
 	int pushback_remaining_frames;
@@ -59,6 +86,10 @@ struct TekPlayerComponent
 	// input buffer
 	struct BattleInput input_buffer[INPUT_BUFFER_SIZE];
 	uint64_t input_buffer_head;
+	// input runs, number of latest consecutive frames matching a condition, updated on every input push
+	uint8_t motion_absent_frames[TEK_MOTION_INPUT_COUNT]; // without this direction
+	uint8_t action_held_frames[TEK_ACTION_INPUT_COUNT]; // with this button held
+	uint8_t action_released_frames[TEK_ACTION_INPUT_COUNT]; // with this button released
 };
 
 // Replicated player state
@@ -76,8 +107,13 @@ struct PlayerNonEntity
 {
 	struct SkeletalMeshInstance mesh_instance; // created from the renderer during init
 	struct AnimPose pose; // technically is game state, but because it's computed each tick, it should be deterministic from the AnimationComponent
-	Float3 hurtboxes_position[MAX_BONES_PER_MESH];
-	Float3 hitboxes_position[MAX_HITBOXES];
+	// box centers in world space, SoA for the cylinder overlap kernel
+	float hurtboxes_x[MAX_BONES_PER_MESH];
+	float hurtboxes_y[MAX_BONES_PER_MESH];
+	float hurtboxes_z[MAX_BONES_PER_MESH];
+	float hitboxes_x[MAX_HITBOXES];
+	float hitboxes_y[MAX_HITBOXES];
+	float hitboxes_z[MAX_HITBOXES];
 };
 
 // Replicated game state, this struct can be rollbacked in network
@@ -112,17 +148,81 @@ struct BattleNonState
 	// session connection
 };
 
+// Optional presentation callbacks, the simulation runs without any of them
+struct BattlePresentation
+{
+	void *user_data;
+	// battle init, once per player
+	void (*init_player)(struct BattleContext *ctx, struct PlayerEntity *p, struct PlayerNonEntity *pn);
+	// the player pose has been evaluated for the current frame
+	void (*apply_pose)(struct BattleContext *ctx, struct PlayerEntity const *p, struct PlayerNonEntity *pn);
+	// end of a simulated frame
+	void (*frame_simulated)(struct BattleContext *ctx);
+	// battle term
+	void (*term)(struct BattleContext *ctx);
+};
+
 // Main object for the battle system
 struct BattleContext
 {
 	// external systems
-	Renderer *renderer;
 	struct AssetLibrary *assets;
+	struct BattlePresentation presentation;
 	// battle state
 	struct BattleState battle_state;
 	struct BattleNonState battle_non_state;
 };
 
+/**
+Replicated fields of BattleState, the canonical hash compares states field by field without the struct padding.
+The network desync checksum and the determinism verifier both hash them, a new replicated field goes in the table.
+ **/
+enum BattleStateFieldType
+{
+	BATTLE_STATE_FIELD_U8,
+	BATTLE_STATE_FIELD_U16,
+	BATTLE_STATE_FIELD_U32,
+	BATTLE_STATE_FIELD_I32,
+	BATTLE_STATE_FIELD_U64,
+	BATTLE_STATE_FIELD_F32,
+};
+
+struct BattleStateField
+{
+	const char *name;
+	uint32_t offset;
+	uint32_t size;
+	enum BattleStateFieldType type;
+};
+
+extern uint32_t const battle_state_field_type_sizes[];
+extern struct BattleStateField const battle_state_fields[];
+extern uint32_t const battle_state_fields_length;
+
+/**
+Replay keyframes: snapshots of the simulation taken every interval frames while a replay is recorded or watched.
+A seek restores the last keyframe before the target frame and resimulates at most interval - 1 frames, instead of
+resimulating from the start of the replay. The interval is the smallest one that fits the expected replay length in
+BATTLE_REPLAY_KEYFRAMES_BUDGET, longer replays drop every other keyframe and double the interval when the store is full.
+A keyframe is the BattleState and the won rounds, the rest of the BattleNonState is recomputed by the next simulated frame.
+ **/
+#define BATTLE_REPLAY_KEYFRAMES_BUDGET (4 << 20) // bytes
+#define BATTLE_REPLAY_MAX_KEYFRAMES ((BATTLE_REPLAY_KEYFRAMES_BUDGET / sizeof(struct BattleReplayKeyframe)) & ~(size_t)1) // even, for the compaction
+
+struct BattleReplayKeyframe
+{
+	struct BattleState battle_state;
+	int rounds_p1_won;
+	int rounds_p2_won;
+};
+
+struct BattleReplayKeyframes
+{
+	uint32_t interval; // in frames
+	uint32_t length; // keyframe i is the simulation before frame i * interval
+	struct BattleReplayKeyframe keyframes[BATTLE_REPLAY_MAX_KEYFRAMES];
+};
+
 enum BattleFrameResult
 {
 	BATTLE_FRAME_RESULT_CONTINUE,
@@ -134,8 +234,18 @@ void battle_state_new_round(struct BattleContext *ctx);
 void battle_state_term(struct BattleContext *ctx);
 
 // GGPO requires a function to simulate 1 frame with specified inputs for rollback.
-struct BattleInputs battle_read_input(struct Inputs const *inputs);
+struct BattleInput battle_input_from_raw(uint8_t raw_input); // raw is a combination of BattleInputBits
+// Observed inputs have to be the confirmed inputs of the player, in frame order
+void battle_input_predictor_observe(struct BattleInputPredictor *predictor, uint32_t iplayer, struct BattleInput input);
+// Predicted input frames_ahead frames after last, the last observed input
+struct BattleInput battle_input_predict(struct BattleInputPredictor const *predictor, uint32_t iplayer, struct BattleInput last, uint32_t frames_ahead);
 enum BattleFrameResult battle_simulate_frame(struct BattleContext *ctx, struct BattleInputs input);
-
-// Update renderer with the latest game state.
-void battle_render(struct BattleContext *ctx);
+uint64_t battle_state_hash(struct BattleState const *state);
+void battle_replay_keyframe_save(struct BattleContext const *ctx, struct BattleReplayKeyframe *keyframe);
+void battle_replay_keyframe_restore(struct BattleContext *ctx, struct BattleReplayKeyframe const *keyframe);
+// Replays are expected to be about expected_frames long
+void battle_replay_keyframes_reset(struct BattleReplayKeyframes *keyframes, uint32_t expected_frames);
+// Called before simulating frame, keeps the simulation if it is the next keyframe
+void battle_replay_keyframes_capture(struct BattleReplayKeyframes *keyframes, struct BattleContext const *ctx, uint32_t frame);
+// Moves ctx from current_frame to frame of the replay, initial is the simulation before frame 0. Returns the simulated frames.
+uint32_t battle_replay_seek(struct BattleReplayKeyframes *keyframes, struct BattleContext *ctx, struct BattleReplayKeyframe const *initial, struct BattleInputs const *inputs, uint32_t current_frame, uint32_t frame);
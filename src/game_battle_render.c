@@ -0,0 +1,377 @@
+#include "game_battle_render.h"
+#include "inputs.h"
+#include "debugdraw.h"
+#include "renderer.h"
+#include "editor.h"
+
+// -- Battle Inputs
+static const char* _get_motion_label(struct BattleInput input)
+{
+	const char *MOTIONS_LABELS[] = {
+		" ",
+		"db",
+		"d",
+		"df",
+		"b",
+		"n",
+		"f",
+		"ub",
+		"u",
+		"uf",
+	};
+	ASSERT(input.motion < ARRAY_LENGTH(MOTIONS_LABELS));
+	return MOTIONS_LABELS[input.motion];
+}
+
+static const char* _get_action_label(struct BattleInput input)
+{
+	const char *ACTIONS_LABELS[] = {
+		" ",
+		"LP",
+		"RP",
+		"LP+RP",
+		"LK",
+		"LP+LK",
+		"RP+LK",
+		"LP+RP+LK",
+		"RK",
+		"LP+RK",
+		"RP+RK",
+		"LP+RP+RK",
+		"LK+RK",
+		"LP+LK+RK",
+		"RP+LK+RK",
+		"LP+RP+LK+RK",
+	};
+	ASSERT(input.actions < ARRAY_LENGTH(ACTIONS_LABELS));
+	return ACTIONS_LABELS[input.actions];
+}
+
+struct BattleInputs battle_read_input(struct Inputs const *inputs)
+{
+	uint8_t p1_raw = 0;
+	if (inputs->buttons_is_down[InputButtons_W]) {
+		p1_raw |= BATTLE_INPUT_UP;
+	}
+	if (inputs->buttons_is_down[InputButtons_A]) {
+		p1_raw |= BATTLE_INPUT_BACK;
+	}
+	if (inputs->buttons_is_down[InputButtons_S]) {
+		p1_raw |= BATTLE_INPUT_DOWN;
+	}
+	if (inputs->buttons_is_down[InputButtons_D]) {
+		p1_raw |= BATTLE_INPUT_FORWARD;
+	}
+	if (inputs->buttons_is_down[InputButtons_U]) {
+		p1_raw |= BATTLE_INPUT_LPUNCH;
+	}
+	if (inputs->buttons_is_down[InputButtons_I]) {
+		p1_raw |= BATTLE_INPUT_RPUNCH;
+	}
+	if (inputs->buttons_is_down[InputButtons_J]) {
+		p1_raw |= BATTLE_INPUT_LKICK;
+	}
+	if (inputs->buttons_is_down[InputButtons_K]) {
+		p1_raw |= BATTLE_INPUT_RKICK;
+	}
+
+	uint8_t p2_raw = 0;
+	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_DPAD_UP]) {
+		p2_raw |= BATTLE_INPUT_UP;
+	}
+	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_DPAD_RIGHT]) {
+		p2_raw |= BATTLE_INPUT_BACK;
+	}
+	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_DPAD_DOWN]) {
+		p2_raw |= BATTLE_INPUT_DOWN;
+	}
+	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_DPAD_LEFT]) {
+		p2_raw |= BATTLE_INPUT_FORWARD;
+	}
+	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_WEST]) {
+		p2_raw |= BATTLE_INPUT_LPUNCH;
+	}
+	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_NORTH]) {
+		p2_raw |= BATTLE_INPUT_RPUNCH;
+	}
+	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_SOUTH]) {
+		p2_raw |= BATTLE_INPUT_LKICK;
+	}
+	if (inputs->gamepad_buttons_is_down[InputGamepadButtons_EAST]) {
+		p2_raw |= BATTLE_INPUT_RKICK;
+	}
+
+	// Add left stick directional input (works alongside D-pad)
+	float stick_deadzone = 0.1f;
+	if (inputs->gamepads[0]) {
+		float left_stick_x = SDL_GetGamepadAxis(inputs->gamepads[0], SDL_GAMEPAD_AXIS_LEFTX) / 32768.0f ;
+		float left_stick_y = SDL_GetGamepadAxis(inputs->gamepads[0], SDL_GAMEPAD_AXIS_LEFTY) / 32768.0f;
+
+		printf("[inputs] gamepad left stick %f x %f\n", left_stick_x, left_stick_y);
+
+		if (-stick_deadzone < left_stick_y && left_stick_y < stick_deadzone) {
+			// NONE
+		} else if (left_stick_y < 0.0f) {
+			p2_raw |= BATTLE_INPUT_UP;
+		} else if (left_stick_y > 0.0f) {
+			p2_raw |= BATTLE_INPUT_DOWN;
+		}
+
+		if (-stick_deadzone < left_stick_x && left_stick_x < stick_deadzone) {
+			// NONE
+		} else if (left_stick_x < 0.0f) {
+			p2_raw |= BATTLE_INPUT_FORWARD;
+		} else if (left_stick_x > 0.0f) {
+			p2_raw |= BATTLE_INPUT_BACK;
+		}
+	}
+
+	struct BattleInputs input = {0};
+	input.player1 = battle_input_from_raw(p1_raw);
+	input.player2 = battle_input_from_raw(p2_raw);
+	return input;
+}
+
+// -- Presentation hooks
+
+static void _battle_init_player(struct BattleContext *ctx, struct PlayerEntity *p, struct PlayerNonEntity *pn)
+{
+	Renderer *renderer = ctx->presentation.user_data;
+	struct tek_Character *c = tek_characters + p->tek.character_id;
+	SkeletalMeshAsset const *skeletal_mesh = asset_library_get_skeletal_mesh(ctx->assets, c->skeletal_mesh_id);
+	AnimSkeleton const *anim_skeleton = asset_library_get_anim_skeleton(ctx->assets, c->anim_skeleton_id);
+
+	// create an instance to hold the render pose
+	skeletal_mesh_create_instance(skeletal_mesh, &pn->mesh_instance, anim_skeleton);
+	// create render instances
+	struct SkeletalMeshInstanceData render_instance_data = {0};
+	render_instance_data.mesh = skeletal_mesh;
+	render_instance_data.dynamic_data_mesh = &pn->mesh_instance;
+	render_instance_data.dynamic_data_spatial = &p->spatial;
+	render_instance_data.dynamic_data_tek = &p->tek;
+	renderer_register_skeletal_mesh_instance(renderer, render_instance_data);
+}
+
+static void _battle_apply_pose(struct BattleContext *ctx, struct PlayerEntity const *p, struct PlayerNonEntity *pn)
+{
+	(void)ctx;
+	(void)p;
+	// update render skeleton
+	skeletal_mesh_apply_pose(&pn->mesh_instance, &pn->pose);
+}
+
+static void _battle_camera_follow(struct BattleContext *ctx)
+{
+	struct BattleState *state = &ctx->battle_state;
+	struct BattleNonState *nonstate = &ctx->battle_non_state;
+
+	// Camera follow
+	if (nonstate->camera_focus != 0)
+	{
+		struct SpatialComponent *p1_root = &state->p1_entity.spatial;
+		struct SpatialComponent *p2_root = &state->p2_entity.spatial;
+
+		Float3 target_pos = float3_add(p1_root->world_transform.cols[3], p2_root->world_transform.cols[3]);
+		target_pos.x *= 0.5f;
+		target_pos.y *= 0.5f;
+		target_pos.z *= 0.5f;
+		Float3 camera_pos = nonstate->camera.position;
+		(void)camera_pos;
+		float target_distance = float3_distance(target_pos, camera_pos);
+		(void)target_distance;
+
+		float ratio = 9.0f / 16.0f;
+		float fov_rad = nonstate->camera.vertical_fov * 2.0f * 3.14f / 360.0f;
+		float width_from_dist = ratio * 2.0f * tanf(fov_rad / 2.0f);
+
+		float const CAMERA_HACK_TWEAK = 0.35f;
+		float ideal_width = float3_distance(p1_root->world_transform.cols[3], p2_root->world_transform.cols[3]) * CAMERA_HACK_TWEAK;
+
+		float ideal_distance = ideal_width / width_from_dist;
+
+		Float3 camera_dir = p1_root->world_transform.cols[0];
+		if (nonstate->camera_focus == 2) {
+			camera_dir = p2_root->world_transform.cols[0];
+		}
+
+		float const MINIMUM_DISTANCE = 3.5f;
+		float const CAMERA_SMOOTHING = 0.1f;
+
+		float delta_dist = (ideal_distance - nonstate->camera_distance) * CAMERA_SMOOTHING;
+		nonstate->camera_distance += delta_dist;
+		if (nonstate->camera_distance < MINIMUM_DISTANCE) {
+			nonstate->camera_distance = MINIMUM_DISTANCE;
+		}
+
+		nonstate->camera.position = float3_add(target_pos, float3_mul_scalar(camera_dir, nonstate->camera_distance));
+		nonstate->camera.lookat = target_pos;
+
+		nonstate->camera.position.z += 1.0f;
+		nonstate->camera.lookat.z += 1.0f;
+	}
+}
+
+static void _battle_frame_simulated(struct BattleContext *ctx)
+{
+	_battle_camera_follow(ctx);
+}
+
+static void _battle_term(struct BattleContext *ctx)
+{
+	Renderer *renderer = ctx->presentation.user_data;
+	renderer_clear_skeletal_mesh_instances(renderer);
+}
+
+struct BattlePresentation battle_render_presentation(Renderer *renderer)
+{
+	struct BattlePresentation presentation = {0};
+	presentation.user_data = renderer;
+	presentation.init_player = _battle_init_player;
+	presentation.apply_pose = _battle_apply_pose;
+	presentation.frame_simulated = _battle_frame_simulated;
+	presentation.term = _battle_term;
+	return presentation;
+}
+
+// -- Render
+
+void battle_render(struct BattleContext *ctx, Renderer *renderer)
+{
+	TracyCZoneN(f, "BattleRender", true);
+	struct BattleState *state = &ctx->battle_state;
+	struct BattleNonState *nonstate = &ctx->battle_non_state;
+	struct PlayerEntity *players[] = {&state->p1_entity, &state->p2_entity};
+	struct PlayerNonEntity *nonplayers[] = {
+		&nonstate->p1_nonentity,
+		&nonstate->p2_nonentity,
+	};
+	struct tek_Character *characters[] = {
+		tek_characters + players[0]->tek.character_id,
+		tek_characters + players[1]->tek.character_id,
+	};
+
+	ed_display_player_entity("Player 1", &state->p1_entity);
+	ed_display_player_entity("Player 2", &state->p2_entity);
+	ed_display_debug_menu(ctx->assets, nonstate);
+
+	// -- debug draw
+	debug_draw_reset();
+
+	// Evaluate anims
+	if (nonstate->draw_bones) {
+		for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
+			struct AnimSkeleton const *anim_skeleton = asset_library_get_anim_skeleton(ctx->assets, players[iplayer]->anim_skeleton.anim_skeleton_id);
+			struct Animation const *animation = asset_library_get_animation(ctx->assets, players[iplayer]->animation.animation_id);
+			(void)animation;
+			// Debug draw animated pose
+			for (uint32_t ibone = 0; ibone < anim_skeleton->bones_length; ibone++) {
+				Float3 p;
+				p.x = F34(nonplayers[iplayer]->pose.global_transforms[ibone], 0, 3);
+				p.y = F34(nonplayers[iplayer]->pose.global_transforms[ibone], 1, 3);
+				p.z = F34(nonplayers[iplayer]->pose.global_transforms[ibone], 2, 3);
+				p = float3x4_transform_point(players[iplayer]->spatial.world_transform, p);
+				debug_draw_point(p);
+			}
+		}
+	}
+
+	// debug draw hurtboxes cylinders
+	if (nonstate->draw_hurtboxes) {
+		for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
+			for (uint32_t ihurtbox = 0; ihurtbox < characters[iplayer]->hurtboxes_length; ++ihurtbox) {
+				Float3 center;
+				center.x = nonplayers[iplayer]->hurtboxes_x[ihurtbox];
+				center.y = nonplayers[iplayer]->hurtboxes_y[ihurtbox];
+				center.z = nonplayers[iplayer]->hurtboxes_z[ihurtbox];
+				float radius = characters[iplayer]->hurtboxes_radius[ihurtbox];
+				float height = characters[iplayer]->hurtboxes_height[ihurtbox];
+				debug_draw_cylinder(center, radius, height, DD_RED);
+			}
+		}
+	}
+
+	// debug draw hitboxes cylinders
+	if (nonstate->draw_hitboxes) {
+		for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
+			struct tek_Move *current_move = characters[iplayer]->moves + players[iplayer]->tek.current_move;
+
+			uint32_t current = players[iplayer]->animation.frame;
+			uint32_t first_active = current_move->first_active;
+			uint32_t last_active = current_move->last_active;
+			bool is_active = first_active <= current && current <= last_active;
+			if (is_active) {
+				ASSERT(current_move->hitbox < characters[iplayer]->hitboxes_length);
+				uint32_t ihitbox = current_move->hitbox;
+				Float3 center;
+				center.x = nonplayers[iplayer]->hitboxes_x[ihitbox];
+				center.y = nonplayers[iplayer]->hitboxes_y[ihitbox];
+				center.z = nonplayers[iplayer]->hitboxes_z[ihitbox];
+				float radius = characters[iplayer]->hitboxes_radius[ihitbox];
+				float height = characters[iplayer]->hitboxes_height[ihitbox];
+				debug_draw_cylinder(center, radius, height, DD_GREEN);
+			}
+		}
+	}
+
+	if (nonstate->draw_colisions) {
+		for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
+			float radius = (float)characters[iplayer]->colision_radius;
+			Float3 center = players[iplayer]->spatial.world_transform.cols[3];
+			float height = 2.0;
+			center.z += height * 0.5f;
+			debug_draw_cylinder(center, radius, height, DD_GREEN);
+		}
+	}
+	// debug draw grid
+	if (nonstate->draw_grid) {
+		float width = 24.0f;
+		for (float i = 1.0f; i <= width; i += 1.0f) {
+			debug_draw_line((Float3){i, -width, 0.0f}, (Float3){i, width, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
+			debug_draw_line((Float3){-i, -width, 0.0f}, (Float3){-i, width, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
+			debug_draw_line((Float3){-width, i, 0.0f}, (Float3){width, i, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
+			debug_draw_line((Float3){-width, -i, 0.0f}, (Float3){width, -i, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
+		}
+		debug_draw_line((Float3){-width, 0.0f, 0.0f}, (Float3){0, 0.0f, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
+		debug_draw_line((Float3){0, 0.0f, 0.0f}, (Float3){width, 0.0f, 0.0f}, DD_RED);
+		debug_draw_line((Float3){0.0f, -width, 0.0f}, (Float3){0, 0.0f, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
+		debug_draw_line((Float3){0, 0.0f, 0.0f}, (Float3){0.0f, width, 0.0f}, DD_GREEN);
+		debug_draw_line((Float3){0.0f, 0.0f, -width}, (Float3){0.0f, 0.0f, 0.0f}, DD_WHITE & DD_HALF_ALPHA);
+		debug_draw_line((Float3){0.0f, 0.0f, 0.0f}, (Float3){0.0f, 0.0f, width}, DD_BLUE);
+		width = 2.4f;
+		for (float i = 0.1f; i <= width; i += 0.1f) {
+			debug_draw_line((Float3){i, -width, 0.0f}, (Float3){i, width, 0.0f}, DD_WHITE & DD_QUARTER_ALPHA);
+			debug_draw_line((Float3){-i, -width, 0.0f}, (Float3){-i, width, 0.0f}, DD_WHITE & DD_QUARTER_ALPHA);
+			debug_draw_line((Float3){-width, i, 0.0f}, (Float3){width, i, 0.0f}, DD_WHITE & DD_QUARTER_ALPHA);
+			debug_draw_line((Float3){-width, -i, 0.0f}, (Float3){width, -i, 0.0f}, DD_WHITE & DD_QUARTER_ALPHA);
+		}
+	}
+	// draw local axis for players
+	for (uint32_t iplayer = 0; iplayer < ARRAY_LENGTH(players); ++iplayer) {
+		struct SpatialComponent *root = &players[iplayer]->spatial;
+		Float3 origin = {0};
+		Float3 x_axis = (Float3){0.1f, 0.0f, 0.0f};
+		Float3 y_axis = (Float3){0.0f, 0.1f, 0.0f};
+		Float3 z_axis = (Float3){0.0f, 0.0f, 0.1f};
+		Float3 o = float3x4_transform_point(root->world_transform, origin);
+		Float3 x = float3x4_transform_point(root->world_transform, x_axis);
+		Float3 y = float3x4_transform_point(root->world_transform, y_axis);
+		Float3 z = float3x4_transform_point(root->world_transform, z_axis);
+		debug_draw_line(o, x, DD_RED);
+		debug_draw_line(o, y, DD_GREEN);
+		debug_draw_line(o, z, DD_BLUE);
+	}
+
+
+	// interpolate camera for smooth movement
+	float coef = 0.05f;
+	nonstate->camera_display.position.x = nonstate->camera_display.position.x*(1.0f-coef) + nonstate->camera.position.x*coef;
+	nonstate->camera_display.position.y = nonstate->camera_display.position.y*(1.0f-coef) + nonstate->camera.position.y*coef;
+	nonstate->camera_display.position.z = nonstate->camera_display.position.z*(1.0f-coef) + nonstate->camera.position.z*coef;
+	nonstate->camera_display.lookat.x = nonstate->camera_display.lookat.x*(1.0f-coef) + nonstate->camera.lookat.x*coef;
+	nonstate->camera_display.lookat.y = nonstate->camera_display.lookat.y*(1.0f-coef) + nonstate->camera.lookat.y*coef;
+	nonstate->camera_display.lookat.z = nonstate->camera_display.lookat.z*(1.0f-coef) + nonstate->camera.lookat.z*coef;
+	nonstate->camera_display.vertical_fov = nonstate->camera_display.vertical_fov*(1.0f-coef) + nonstate->camera.vertical_fov*coef;
+	renderer_set_main_camera(renderer, nonstate->camera_display);
+
+	TracyCZoneEnd(f);
+}
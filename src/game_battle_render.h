@@ -0,0 +1,12 @@
+#pragma once
+#include "game_battle.h"
+
+struct Inputs;
+typedef struct Renderer Renderer;
+
+// Presentation side of the battle system: local inputs, rendering and debug UI.
+struct BattlePresentation battle_render_presentation(Renderer *renderer);
+struct BattleInputs battle_read_input(struct Inputs const *inputs);
+
+// Update renderer with the latest game state.
+void battle_render(struct BattleContext *ctx, Renderer *renderer);
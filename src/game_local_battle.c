@@ -1,5 +1,6 @@
 #include "game_local_battle.h"
 #include "game_battle.h"
+#include "game_battle_render.h"
 #include "ui_helpers.h"
 
 void local_battle_new_match(struct Game *game)
@@ -10,7 +11,7 @@ void local_battle_new_match(struct Game *game)
 
 	memset(&simulation->battle_context, 0, sizeof(simulation->battle_context));
 	simulation->battle_context.assets = game->assets;
-	simulation->battle_context.renderer = game->renderer;
+	simulation->battle_context.presentation = battle_render_presentation(game->renderer);
 	simulation->battle_context.battle_non_state.rounds_first_to = 3;
 	battle_state_init(&simulation->battle_context);
 }
@@ -18,7 +19,11 @@ void local_battle_new_match(struct Game *game)
 void local_battle_init(struct Game *game)
 {
 	printf("LOCAL_BATTLE: Init\n");
-	memset(&game->local_battle, 0, sizeof(struct LocalBattle));
+	struct LocalBattle *data = &game->local_battle;
+	replay_writer_close(&data->replay_writer);
+	free(data->replay_inputs);
+	free(data->replay_keyframes);
+	memset(data, 0, sizeof(struct LocalBattle));
 	local_battle_new_match(game);
 }
 
@@ -26,6 +31,7 @@ static void _exit_local_battle(struct Game *game)
 {
 	printf("LOCAL_BATTLE: Exit to mainmenu\n");
 
+	replay_writer_close(&game->local_battle.replay_writer);
 	battle_state_term(&game->simulation.battle_context);
 
 	game->current_state = GAME_STATE_MAIN_MENU;
@@ -34,6 +40,67 @@ static void _exit_local_battle(struct Game *game)
 
 // -- replay
 
+static void local_battle_replay_start(struct LocalBattle *data, struct BattleReplayKeyframe const *initial)
+{
+	data->replay_initial_keyframe = *initial;
+	data->replay_current_input = 0;
+	data->replay_length = 0;
+	data->watching_frame = 0;
+	if (data->replay_keyframes == NULL) {
+		data->replay_keyframes = calloc(1, sizeof(struct BattleReplayKeyframes));
+	}
+	battle_replay_keyframes_reset(data->replay_keyframes, REPLAY_LENGTH_IN_FRAMES);
+}
+
+static void local_battle_replay_push_input(struct LocalBattle *data, struct BattleInputs inputs)
+{
+	if (data->replay_current_input >= data->replay_inputs_capacity) {
+		data->replay_inputs_capacity = data->replay_inputs_capacity ? 2 * data->replay_inputs_capacity : REPLAY_INPUTS_INITIAL_CAPACITY;
+		data->replay_inputs = realloc(data->replay_inputs, data->replay_inputs_capacity * sizeof(struct BattleInputs));
+	}
+	data->replay_inputs[data->replay_current_input] = inputs;
+	data->replay_current_input += 1;
+}
+
+static void local_battle_replay_stop(struct LocalBattle *data)
+{
+	data->play_state = LOCAL_BATTLE_PLAY_STATE_PLAYING;
+	data->replay_length = data->replay_current_input;
+	replay_writer_close(&data->replay_writer);
+}
+
+static void local_battle_replay_load(struct Game *game, const char *path)
+{
+	struct LocalBattle *data = &game->local_battle;
+	struct ReplayReader *reader = calloc(1, sizeof(struct ReplayReader));
+	if (!replay_reader_open(reader, path)) {
+		free(reader);
+		return;
+	}
+	if (!replay_file_header_matches(&reader->header, &game->simulation.battle_context)) {
+		printf("REPLAY: %s was recorded with other characters or assets, it may not play the same\n", path);
+	}
+
+	local_battle_replay_start(data, &reader->header.initial);
+	struct BattleInputs inputs;
+	struct BattleReplayKeyframe keyframe;
+	enum ReplayReadResult result;
+	while ((result = replay_reader_next(reader, &inputs, &keyframe)) != REPLAY_READ_END) {
+		if (result == REPLAY_READ_ERROR) {
+			printf("REPLAY: %s is corrupted after frame %u\n", path, data->replay_current_input);
+			break;
+		}
+		if (result == REPLAY_READ_INPUTS) {
+			local_battle_replay_push_input(data, inputs);
+		}
+	}
+	data->replay_length = data->replay_current_input;
+	printf("REPLAY: loaded %u frames from %s\n", data->replay_length, path);
+
+	replay_reader_close(reader);
+	free(reader);
+}
+
 static void local_battle_watch_set_frame(struct Game *game, uint32_t frame)
 {
 	struct LocalBattle *data = &game->local_battle;
@@ -48,32 +115,12 @@ static void local_battle_watch_set_frame(struct Game *game, uint32_t frame)
 	}
 
 	if (frame == 0) {
-		memcpy(&simulation->battle_context, &data->replay_initial_context, sizeof(struct BattleContext));
-	}
-
-	if (frame < data->watching_frame) {
-
-		// we are going back in time, resimulate from the initial game data
-		memcpy(&simulation->battle_context, &data->replay_initial_context, sizeof(struct BattleContext));
-		for (uint32_t i = 0; i < frame; ++i) {
-			TracyCZoneN(f, "Replay Frame", true);
-			struct BattleInputs battle_inputs = data->replay_inputs[i];
-			(void)battle_simulate_frame(&simulation->battle_context, battle_inputs);
-			TracyCZoneEnd(f);
-		}
-
-	} else {
-
-		// we are going forward in time, we can simulate from here
-		for (uint32_t i = data->watching_frame; i < frame; ++i) {
-			TracyCZoneN(f, "Replay Frame", true);
-			struct BattleInputs battle_inputs = data->replay_inputs[i];
-			(void)battle_simulate_frame(&simulation->battle_context, battle_inputs);
-			TracyCZoneEnd(f);
-		}
-
+		battle_replay_keyframe_restore(&simulation->battle_context, &data->replay_initial_keyframe);
+		data->watching_frame = 0;
 	}
 
+	// going back in time restores the closest keyframe, going forward simulates from here
+	battle_replay_seek(data->replay_keyframes, &simulation->battle_context, &data->replay_initial_keyframe, data->replay_inputs, data->watching_frame, frame);
 	data->watching_frame = frame;
 }
 
@@ -119,10 +166,14 @@ bool local_battle_update(struct Game *game, struct GameUpdateContext const *ctx)
 			if (data->play_state == LOCAL_BATTLE_PLAY_STATE_PLAYING) {
 				if (ImGui_Button("Record")) {
 					data->play_state = LOCAL_BATTLE_PLAY_STATE_RECORDING;
-					// copy context
-					memcpy(&data->replay_initial_context, &simulation->battle_context, sizeof(struct BattleContext));
-					// record inputs
-					data->replay_current_input = 0;
+					// record inputs from the current simulation, and save them as they come
+					struct ReplayFileHeader header = replay_file_header(&simulation->battle_context, REPLAY_FILE_KEYFRAME_INTERVAL);
+					local_battle_replay_start(data, &header.initial);
+					replay_writer_open(&data->replay_writer, REPLAY_PATH, &header);
+				}
+				ImGui_SameLine();
+				if (ImGui_Button("Load replay")) {
+					local_battle_replay_load(game, REPLAY_PATH);
 				}
 				ImGui_SameLine();
 
@@ -133,13 +184,17 @@ bool local_battle_update(struct Game *game, struct GameUpdateContext const *ctx)
 						local_battle_watch_set_frame(game, 0);
 					}
 					ImGui_SameLine();
+					// raw BattleInputs array, for bench.exe battle and predict
+					if (ImGui_Button("Save inputs")) {
+						struct Blob inputs_blob = {data->replay_inputs, (uint32_t)(data->replay_length * sizeof(struct BattleInputs))};
+						file_write_entire_file("replay.inputs", inputs_blob);
+					}
+					ImGui_SameLine();
 				}
 
 			} else if (data->play_state == LOCAL_BATTLE_PLAY_STATE_RECORDING) {
 				if (ImGui_Button("Stop")) {
-					// stop replay
-					data->play_state = LOCAL_BATTLE_PLAY_STATE_PLAYING;
-					data->replay_length = data->replay_current_input;
+					local_battle_replay_stop(data);
 				}
 				ImGui_SameLine();
 			}
@@ -226,11 +281,15 @@ bool local_battle_update(struct Game *game, struct GameUpdateContext const *ctx)
 	case LOCAL_BATTLE_STATE_PLAY: {
 
 		// Playing. Read inputs and simulate battle.
-		simulation->accumulator += ctx->previous_frame_time;
-		const uint64_t dt = 16;
+		simulation->accumulator += ctx->previous_frame_time_us;
+		const uint64_t dt = 16000;
 		while (simulation->accumulator >= dt) {
 			TracyCZoneN(f, "Battle Frame", true);
 			struct BattleInputs battle_inputs = battle_read_input(inputs);
+			if (data->play_state == LOCAL_BATTLE_PLAY_STATE_RECORDING) {
+				battle_replay_keyframes_capture(data->replay_keyframes, &simulation->battle_context, data->replay_current_input);
+				replay_writer_push(&data->replay_writer, &simulation->battle_context, battle_inputs);
+			}
 			// ggpo_add_local_input
 			// ggpo_synchronize_input
 			enum BattleFrameResult battle_result = battle_simulate_frame(&simulation->battle_context, battle_inputs);
@@ -238,20 +297,17 @@ bool local_battle_update(struct Game *game, struct GameUpdateContext const *ctx)
 
 			// save inputs to replay
 			if (data->play_state == LOCAL_BATTLE_PLAY_STATE_RECORDING) {
-				data->replay_inputs[data->replay_current_input] = battle_inputs;
-				if (data->replay_current_input + 1 >= ARRAY_LENGTH(data->replay_inputs)) {
-					// stop replay
-					data->play_state = LOCAL_BATTLE_PLAY_STATE_PLAYING;
-					data->replay_length = data->replay_current_input;
-				} else {
-					data->replay_current_input += 1;
-				}
+				local_battle_replay_push_input(data, battle_inputs);
 			}
 
 			simulation->t += dt;
 			simulation->accumulator -= dt;
 
 			if (battle_result != BATTLE_FRAME_RESULT_CONTINUE) {
+				// the replay ends with the match
+				if (data->play_state == LOCAL_BATTLE_PLAY_STATE_RECORDING) {
+					local_battle_replay_stop(data);
+				}
 				data->state = LOCAL_BATTLE_STATE_END;
 				battle_state_term(&simulation->battle_context);
 				break;
@@ -265,11 +321,20 @@ bool local_battle_update(struct Game *game, struct GameUpdateContext const *ctx)
 		switch (data->replay_state) {
 		case LOCAL_BATTLE_REPLAY_STATE_WATCHING: {
 			// Watching replay. Read inputs from buffer and simulate battle.
-			simulation->accumulator += ctx->previous_frame_time;
-			const uint64_t dt = 16;
+			simulation->accumulator += ctx->previous_frame_time_us;
+			const uint64_t dt = 16000;
 			while (simulation->accumulator >= dt) {
+			// a hitch runs several frames, loop back to the start before reading past the inputs
+			if (data->watching_frame >= data->replay_length) {
+				if (data->replay_length == 0) {
+					simulation->accumulator = 0;
+					break;
+				}
+				local_battle_watch_set_frame(game, 0);
+			}
 			TracyCZoneN(f, "Battle Frame", true);
 			struct BattleInputs battle_inputs = data->replay_inputs[data->watching_frame];
+			battle_replay_keyframes_capture(data->replay_keyframes, &simulation->battle_context, data->watching_frame);
 			(void)battle_simulate_frame(&simulation->battle_context, battle_inputs);
 			TracyCZoneEnd(f);
 
@@ -416,7 +481,7 @@ void local_battle_render(struct Game *game)
 	struct LocalBattle *data = &game->local_battle;
 	struct Simulation *simulation = &game->simulation;
 	if (data->state != LOCAL_BATTLE_STATE_END) {
-		battle_render(&simulation->battle_context);
+		battle_render(&simulation->battle_context, game->renderer);
 	}
 
 
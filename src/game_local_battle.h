@@ -1,7 +1,10 @@
 #pragma once
 #include "game_battle.h"
+#include "game_replay.h"
 
-#define REPLAY_LENGTH_IN_FRAMES (60*60*60) // 1 hour
+#define REPLAY_LENGTH_IN_FRAMES (60*60*60) // 1 hour, sizes the keyframes, longer replays get sparser keyframes
+#define REPLAY_INPUTS_INITIAL_CAPACITY (60*60) // 1 minute, doubled when full
+#define REPLAY_PATH "replay.tekreplay"
 
 enum LocalBattleState
 {
@@ -34,8 +37,11 @@ struct LocalBattle
 	enum LocalBattleReplayState replay_state;
 
 	// play recording state
-	struct BattleContext replay_initial_context;
-	struct BattleInputs replay_inputs[60*60*60];
+	struct BattleReplayKeyframe replay_initial_keyframe;
+	struct BattleInputs *replay_inputs;
+	uint32_t replay_inputs_capacity;
+	struct BattleReplayKeyframes *replay_keyframes; // captured while recording and watching, for seeking
+	struct ReplayWriter replay_writer; // the recording is saved to REPLAY_PATH as it goes
 	uint32_t replay_current_input;
 	uint32_t replay_length;
 	// replay watching state
@@ -1,4 +1,5 @@
 #include "game_network_battle.h"
+#include "game_battle_render.h"
 
 #include "steam_api_c.h"
 #include "ui_helpers.h"
@@ -31,14 +32,37 @@ bool tek_begin_game(const char *game)
  */
 bool tek_save_game_state(unsigned char **out_buffer, int *out_len, int *out_checksum, int frame)
 {
-	(void)frame;
+	struct NetworkBattle *data = &ggpo_game_global_state->network_battle;
+	struct BattleState const *state = &ggpo_game_global_state->simulation.battle_context.battle_state;
 	int length = sizeof(struct BattleState);
-	void *gs_copy = malloc(length);
-	memcpy(gs_copy, &ggpo_game_global_state->simulation.battle_context.battle_state, length);
 
-	*out_buffer = gs_copy;
+	// Slots are released in the order they are saved, the next one is almost always free
+	uint32_t islot = data->save_next_slot;
+	for (uint32_t i = 0; i < NETWORK_BATTLE_SAVE_SLOTS && data->save_slots_used[islot]; ++i) {
+		islot = (islot + 1) % NETWORK_BATTLE_SAVE_SLOTS;
+	}
+	ASSERT(!data->save_slots_used[islot]);
+	data->save_slots_used[islot] = true;
+	data->save_next_slot = (islot + 1) % NETWORK_BATTLE_SAVE_SLOTS;
+	data->save_slots_frame[islot] = frame;
+	data->current_frame = frame;
+
+	// the last save of a checked frame is the one GGPO compares with the peer
+	if (frame % NETWORK_BATTLE_DESYNC_INTERVAL == 0) {
+		uint32_t idesync = (uint32_t)(frame / NETWORK_BATTLE_DESYNC_INTERVAL) % NETWORK_BATTLE_DESYNC_STATES;
+		memset(&data->desync_states[idesync], 0, sizeof(struct BattleReplayKeyframe));
+		battle_replay_keyframe_save(&ggpo_game_global_state->simulation.battle_context, &data->desync_states[idesync]);
+		data->desync_states_frame[idesync] = frame;
+	}
+
+	uint8_t *slot = data->save_slots + islot * data->save_slot_stride;
+	memcpy(slot, state, length);
+	// GGPO compares int checksums, fold the 64-bit hash of the fields, the padding is not replicated
+	uint64_t hash = battle_state_hash(state);
+
+	*out_buffer = slot;
 	*out_len = length;
-	*out_checksum = 0;
+	*out_checksum = (int)(uint32_t)(hash ^ (hash >> 32));
 
 	return true;
 }
@@ -50,11 +74,21 @@ bool tek_save_game_state(unsigned char **out_buffer, int *out_len, int *out_chec
  * should make the current game state match the state contained in the
  * buffer.
  */
+static uint32_t network_battle_save_slot_index(struct NetworkBattle const *data, void const *buffer)
+{
+	uint32_t offset = (uint32_t)((uint8_t const*)buffer - data->save_slots);
+	uint32_t islot = offset / data->save_slot_stride;
+	ASSERT(islot < NETWORK_BATTLE_SAVE_SLOTS && offset % data->save_slot_stride == 0);
+	return islot;
+}
+
 bool tek_load_game_state(unsigned char *buffer, int len)
 {
+	struct NetworkBattle *data = &ggpo_game_global_state->network_battle;
 	int length = sizeof(struct BattleState);
 	if (len == length) {
 		memcpy(&ggpo_game_global_state->simulation.battle_context.battle_state, buffer, length);
+		data->current_frame = data->save_slots_frame[network_battle_save_slot_index(data, buffer)];
 		return true;
 	}
 	return false;
@@ -83,7 +117,81 @@ bool tek_log_game_state(char *filename, unsigned char *buffer, int len)
  */
 void tek_free_buffer(void *buffer)
 {
-	free(buffer);
+	if (buffer == NULL) {
+		return;
+	}
+	struct NetworkBattle *data = &ggpo_game_global_state->network_battle;
+	uint32_t islot = network_battle_save_slot_index(data, buffer);
+	ASSERT(data->save_slots_used[islot]);
+	data->save_slots_used[islot] = false;
+}
+
+static void network_battle_save_slots_init(struct NetworkBattle *data)
+{
+	uint32_t alignment = NETWORK_BATTLE_SAVE_ALIGNMENT;
+	data->save_slot_stride = (sizeof(struct BattleState) + alignment - 1) & ~(alignment - 1);
+	data->save_slab = calloc(1, NETWORK_BATTLE_SAVE_SLOTS * data->save_slot_stride + alignment - 1);
+	data->save_slots = (uint8_t*)(((uintptr_t)data->save_slab + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	data->save_next_slot = 0;
+	memset(data->save_slots_used, 0, sizeof(data->save_slots_used));
+}
+
+static void network_battle_save_slots_term(struct NetworkBattle *data)
+{
+	free(data->save_slab);
+	data->save_slab = NULL;
+	data->save_slots = NULL;
+}
+
+static void network_battle_desync_init(struct NetworkBattle *data, struct BattleContext const *ctx)
+{
+	data->current_frame = 0;
+	data->desync_frame = -1;
+	memset(&data->initial_keyframe, 0, sizeof(data->initial_keyframe));
+	battle_replay_keyframe_save(ctx, &data->initial_keyframe);
+	for (uint32_t i = 0; i < NETWORK_BATTLE_DESYNC_STATES; ++i) {
+		data->desync_states_frame[i] = -1;
+	}
+	GGPOErrorCode err = ggpo_set_desync_detection(data->ggpo_session, NETWORK_BATTLE_DESYNC_INTERVAL);
+	tek_check_error(err);
+}
+
+// The inputs of the frame about to be simulated, the resimulations overwrite the predicted ones
+static void network_battle_log_input(struct NetworkBattle *data, struct BattleInputs inputs)
+{
+	uint32_t frame = (uint32_t)data->current_frame;
+	if (frame >= data->input_log_capacity) {
+		data->input_log_capacity = data->input_log_capacity ? 2 * data->input_log_capacity : NETWORK_BATTLE_INPUT_LOG_INITIAL_CAPACITY;
+		data->input_log = realloc(data->input_log, data->input_log_capacity * sizeof(struct BattleInputs));
+	}
+	data->input_log[frame] = inputs;
+}
+
+// Writes the inputs until the desynced frame and the local state of that frame, to compare with the peer's file
+static void network_battle_write_desync(struct NetworkBattle *data, struct BattleContext const *ctx, int32_t frame)
+{
+	uint32_t idesync = (uint32_t)(frame / NETWORK_BATTLE_DESYNC_INTERVAL) % NETWORK_BATTLE_DESYNC_STATES;
+	bool has_state = data->desync_states_frame[idesync] == frame;
+	if (!has_state) {
+		printf("NETWORK_BATTLE: the state of frame %d is not kept anymore\n", frame);
+	}
+
+	char path[64];
+	snprintf(path, sizeof(path), "desync_%d.tekreplay", frame);
+	struct ReplayFileHeader header = replay_file_header(ctx, 0);
+	header.initial = data->initial_keyframe;
+	struct ReplayWriter *writer = calloc(1, sizeof(struct ReplayWriter));
+	if (replay_writer_open(writer, path, &header)) {
+		for (int32_t i = 0; i < frame; ++i) {
+			replay_writer_push(writer, ctx, data->input_log[i]);
+		}
+		if (has_state) {
+			replay_writer_push_keyframe(writer, &data->desync_states[idesync]);
+		}
+		replay_writer_close(writer);
+		printf("NETWORK_BATTLE: wrote %s, check it with bench.exe verify and compare it with the peer's\n", path);
+	}
+	free(writer);
 }
 
 /*
@@ -106,6 +214,7 @@ bool tek_advance_frame(int flags)
 	GGPOErrorCode err;
 	err = ggpo_synchronize_input(session, &network_inputs, sizeof(network_inputs), &disconnect_flags);
 	tek_check_error(err);
+	network_battle_log_input(&ggpo_game_global_state->network_battle, network_inputs);
 	(void)battle_simulate_frame(battle_ctx, network_inputs);
 	err = ggpo_advance_frame(session);
 	tek_check_error(err);
@@ -113,6 +222,38 @@ bool tek_advance_frame(int flags)
 	return true;
 }
 
+/*
+ * Input predictor - GGPO calls observe with every confirmed input, and predict for the
+ * remote inputs that have not arrived yet.
+ */
+void tek_observe_input(void *user_data, int player, const void *input, int size, int frame)
+{
+	(void)frame;
+	ASSERT(size == sizeof(struct BattleInput));
+	battle_input_predictor_observe(user_data, (uint32_t)player, *(struct BattleInput const*)input);
+}
+
+void tek_predict_input(void *user_data, int player, const void *last_input, int last_frame, int frame, void *prediction, int size)
+{
+	ASSERT(size == sizeof(struct BattleInput));
+	struct BattleInput result = {0};
+	if (last_input != NULL) {
+		result = battle_input_predict(user_data, (uint32_t)player, *(struct BattleInput const*)last_input, (uint32_t)(frame - last_frame));
+	}
+	memcpy(prediction, &result, sizeof(struct BattleInput));
+}
+
+static void network_battle_set_input_predictor(struct NetworkBattle *data)
+{
+	memset(&data->input_predictor, 0, sizeof(data->input_predictor));
+	GGPOInputPredictor predictor = {0};
+	predictor.user_data = &data->input_predictor;
+	predictor.observe = tek_observe_input;
+	predictor.predict = tek_predict_input;
+	GGPOErrorCode err = ggpo_set_input_predictor(data->ggpo_session, &predictor);
+	tek_check_error(err);
+}
+
 /*
  * on_event - Notification that something has happened.  See the GGPOEventCode
  * structure above for more information.
@@ -135,6 +276,14 @@ bool tek_on_event(GGPOEvent *info)
 		printf("NETWORK_BATTLE: [ggpo] connection interupted\n");
 	} else if (info->code == GGPO_EVENTCODE_CONNECTION_RESUMED) {
 		printf("NETWORK_BATTLE: [ggpo] connection resumed\n");
+	} else if (info->code == GGPO_EVENTCODE_DESYNC) {
+		printf("NETWORK_BATTLE: [ggpo] desync at frame %d (checksum %08x, peer %08x)\n",
+		       info->u.desync.frame, info->u.desync.local_checksum, info->u.desync.remote_checksum);
+		struct NetworkBattle *data = &ggpo_game_global_state->network_battle;
+		if (data->desync_frame < 0) {
+			data->desync_frame = info->u.desync.frame;
+			network_battle_write_desync(data, &ggpo_game_global_state->simulation.battle_context, info->u.desync.frame);
+		}
 	}
 
 	return true;
@@ -232,19 +381,29 @@ void network_battle_state_host(struct Game *game)
 	session_callbacks.free_buffer = tek_free_buffer;
 	session_callbacks.advance_frame = tek_advance_frame;
 	session_callbacks.on_event = tek_on_event;
+	network_battle_save_slots_init(data);
 	GGPOErrorCode err = ggpo_start_session(&data->ggpo_session, &session_callbacks, "tek", 2, sizeof(struct BattleInput), 0);
 	tek_check_error(err);
 	err = ggpo_add_player(data->ggpo_session, &data->ggpo_players[0], &data->ggpo_player_handles[0]);
 	tek_check_error(err);
 	err = ggpo_add_player(data->ggpo_session, &data->ggpo_players[1], &data->ggpo_player_handles[1]);
 	tek_check_error(err);
+	// receive and timestamp packets even while a frame is rendering
+	err = ggpo_start_network_thread(data->ggpo_session);
+	tek_check_error(err);
+	network_battle_set_input_predictor(data);
+	err = ggpo_set_timesync_mode(data->ggpo_session, GGPO_TIMESYNC_DILATION);
+	tek_check_error(err);
+	err = ggpo_set_adaptive_frame_delay(data->ggpo_session, NETWORK_BATTLE_MAX_FRAME_DELAY);
+	tek_check_error(err);
 
 	// Init battle
 	memset(&simulation->battle_context, 0, sizeof(simulation->battle_context));
 	simulation->battle_context.assets = game->assets;
-	simulation->battle_context.renderer = game->renderer;
+	simulation->battle_context.presentation = battle_render_presentation(game->renderer);
 	simulation->battle_context.battle_non_state.rounds_first_to = 3;
 	battle_state_init(&simulation->battle_context);
+	network_battle_desync_init(data, &simulation->battle_context);
 }
 
 void network_battle_on_lobby_joined(struct Game *game, uint64_t lobby_id)
@@ -285,19 +444,29 @@ void network_battle_on_lobby_joined(struct Game *game, uint64_t lobby_id)
 	session_callbacks.free_buffer = tek_free_buffer;
 	session_callbacks.advance_frame = tek_advance_frame;
 	session_callbacks.on_event = tek_on_event;
+	network_battle_save_slots_init(data);
 	GGPOErrorCode err = ggpo_start_session(&data->ggpo_session, &session_callbacks, "tek", 2, sizeof(struct BattleInput), 0);
 	tek_check_error(err);
 	err = ggpo_add_player(data->ggpo_session, &data->ggpo_players[0], &data->ggpo_player_handles[0]);
 	tek_check_error(err);
 	err = ggpo_add_player(data->ggpo_session, &data->ggpo_players[1], &data->ggpo_player_handles[1]);
 	tek_check_error(err);
+	// receive and timestamp packets even while a frame is rendering
+	err = ggpo_start_network_thread(data->ggpo_session);
+	tek_check_error(err);
+	network_battle_set_input_predictor(data);
+	err = ggpo_set_timesync_mode(data->ggpo_session, GGPO_TIMESYNC_DILATION);
+	tek_check_error(err);
+	err = ggpo_set_adaptive_frame_delay(data->ggpo_session, NETWORK_BATTLE_MAX_FRAME_DELAY);
+	tek_check_error(err);
 
 	// Init battle
 	memset(&simulation->battle_context, 0, sizeof(simulation->battle_context));
 	simulation->battle_context.assets = game->assets;
-	simulation->battle_context.renderer = game->renderer;
+	simulation->battle_context.presentation = battle_render_presentation(game->renderer);
 	simulation->battle_context.battle_non_state.rounds_first_to = 3;
 	battle_state_init(&simulation->battle_context);
+	network_battle_desync_init(data, &simulation->battle_context);
 }
 
 void network_battle_create_lobby(struct Game *game)
@@ -321,6 +490,10 @@ void network_battle_term(struct Game *game)
 	GGPOErrorCode err = ggpo_close_session(data->ggpo_session);
 	tek_check_error(err);
 	data->ggpo_session = NULL;
+	network_battle_save_slots_term(data);
+	free(data->input_log);
+	data->input_log = NULL;
+	data->input_log_capacity = 0;
 	ggpo_game_global_state = NULL;
 }
 
@@ -337,6 +510,20 @@ bool network_battle_update(struct Game *game, struct GameUpdateContext const *ct
 		err = ggpo_idle(data->ggpo_session, 5);
 		tek_check_error(err);
 
+		GGPORollbackStats rollback_stats = {0};
+		ggpo_get_rollback_stats(data->ggpo_session, &rollback_stats);
+		TracyCPlot("GGPO resimulated frames", (double)(rollback_stats.resimulated_frames - data->last_rollback_stats.resimulated_frames));
+		TracyCPlot("GGPO resimulated frames/s", (double)rollback_stats.resimulated_frames_per_second);
+		TracyCPlot("GGPO rollback us", rollback_stats.rollbacks != data->last_rollback_stats.rollbacks ? (double)rollback_stats.rollback.last_us : 0.0);
+		TracyCPlot("GGPO prediction stalls", (double)(rollback_stats.prediction_stalls - data->last_rollback_stats.prediction_stalls));
+		data->last_rollback_stats = rollback_stats;
+
+		// the frame period is stretched or shortened by a few percent to stay in sync with the peer
+		float time_dilation = 1.0f;
+		err = ggpo_get_time_dilation(data->ggpo_session, &time_dilation);
+		tek_check_error(err);
+		TracyCPlot("GGPO time dilation", (double)time_dilation);
+
 
 		if (ImGui_Begin("GGPO stats", NULL, 0)) {
 			GGPONetworkStats stats = {0};
@@ -345,26 +532,70 @@ bool network_battle_update(struct Game *game, struct GameUpdateContext const *ct
 			ImGui_Text("P1:");
 			ImGui_Text("network.send_queue_len: %d", stats.network.send_queue_len);
 			ImGui_Text("network.recv_queue_len: %d", stats.network.recv_queue_len);
-			ImGui_Text("network.ping: %d", stats.network.ping);
+			ImGui_Text("network.ping: %d ms (%d us)", stats.network.ping, stats.network.ping_us);
 			ImGui_Text("network.kbps_sent: %d", stats.network.kbps_sent);
+			ImGui_Text("network.bytes_sent: %d (version 2 layout: %d)", stats.network.bytes_sent, stats.network.legacy_bytes_sent);
+			ImGui_Text("network.msgs_queued: %d", stats.network.msgs_queued);
+			ImGui_Text("network.msg_heap_allocs: %d", stats.network.msg_heap_allocs);
+			ImGui_Text("network.send_buffer_peak: %d", stats.network.send_buffer_peak);
 			ImGui_Text("timesync.local_frames_behind: %d", stats.timesync.local_frames_behind);
 			ImGui_Text("timesync.remote_frames_behind: %d", stats.timesync.remote_frames_behind);
+			ImGui_Text("frame_delay: %d (wanted %d, remote %d)", stats.frame_delay.current, stats.frame_delay.wanted, stats.frame_delay.remote_wanted);
+			ImGui_Text("frame_delay.rtt: %.1f ms +- %.1f", stats.frame_delay.rtt_ms, stats.frame_delay.rtt_deviation_ms);
+			ImGui_Text("frame_delay.rollback_frames: %.1f", stats.frame_delay.rollback_frames);
 
 			ggpo_get_network_stats(data->ggpo_session, data->ggpo_player_handles[1], &stats);
 			ImGui_Text("P2:");
 			ImGui_Text("network.send_queue_len: %d", stats.network.send_queue_len);
 			ImGui_Text("network.recv_queue_len: %d", stats.network.recv_queue_len);
-			ImGui_Text("network.ping: %d", stats.network.ping);
+			ImGui_Text("network.ping: %d ms (%d us)", stats.network.ping, stats.network.ping_us);
 			ImGui_Text("network.kbps_sent: %d", stats.network.kbps_sent);
+			ImGui_Text("network.bytes_sent: %d (version 2 layout: %d)", stats.network.bytes_sent, stats.network.legacy_bytes_sent);
+			ImGui_Text("network.msgs_queued: %d", stats.network.msgs_queued);
+			ImGui_Text("network.msg_heap_allocs: %d", stats.network.msg_heap_allocs);
+			ImGui_Text("network.send_buffer_peak: %d", stats.network.send_buffer_peak);
 			ImGui_Text("timesync.local_frames_behind: %d", stats.timesync.local_frames_behind);
 			ImGui_Text("timesync.remote_frames_behind: %d", stats.timesync.remote_frames_behind);
+			ImGui_Text("frame_delay: %d (wanted %d, remote %d)", stats.frame_delay.current, stats.frame_delay.wanted, stats.frame_delay.remote_wanted);
+			ImGui_Text("frame_delay.rtt: %.1f ms +- %.1f", stats.frame_delay.rtt_ms, stats.frame_delay.rtt_deviation_ms);
+			ImGui_Text("frame_delay.rollback_frames: %.1f", stats.frame_delay.rollback_frames);
+
+			ImGui_Text("time dilation: %.4f", time_dilation);
+			if (data->desync_frame >= 0) {
+				ImGui_Text("DESYNC at frame %d, see desync_%d.tekreplay", data->desync_frame, data->desync_frame);
+			} else {
+				ImGui_Text("desync: none (checked every %d frames)", NETWORK_BATTLE_DESYNC_INTERVAL);
+			}
+
+			GGPORollbackStats const *rollback_stats = &data->last_rollback_stats;
+			ImGui_Text("Rollbacks:");
+			ImGui_Text("rollbacks: %d (%d over budget)", rollback_stats->rollbacks, rollback_stats->rollbacks_over_budget);
+			ImGui_Text("resimulated_frames: %d (%.1f/s)", rollback_stats->resimulated_frames, rollback_stats->resimulated_frames_per_second);
+			ImGui_Text("max_rollback_depth: %d", rollback_stats->max_rollback_depth);
+			for (int depth = 1; depth <= GGPO_MAX_PREDICTION_FRAMES; ++depth) {
+				ImGui_Text("  depth %d: %d", depth, rollback_stats->rollback_depth[depth]);
+			}
+			ImGui_Text("save: %.1f us avg, %d us max", rollback_stats->save.avg_us, rollback_stats->save.max_us);
+			ImGui_Text("load: %.1f us avg, %d us max", rollback_stats->load.avg_us, rollback_stats->load.max_us);
+			ImGui_Text("advance: %.1f us avg, %d us max", rollback_stats->advance.avg_us, rollback_stats->advance.max_us);
+			ImGui_Text("rollback: %.1f us avg, %d us max", rollback_stats->rollback.avg_us, rollback_stats->rollback.max_us);
+			ImGui_Text("prediction_misses: P1 %d, P2 %d", rollback_stats->prediction_misses[0], rollback_stats->prediction_misses[1]);
+			ImGui_Text("prediction_stalls: %d", rollback_stats->prediction_stalls);
+			ImGui_Text("timesync: %d events, %d frames", rollback_stats->timesync_events, rollback_stats->timesync_frames);
+			if (ImGui_Button("Write CSV")) {
+				ggpo_write_rollback_stats(data->ggpo_session, "ggpo_rollback_stats.csv", GGPO_STATS_FORMAT_CSV);
+			}
+			ImGui_SameLine();
+			if (ImGui_Button("Write JSON")) {
+				ggpo_write_rollback_stats(data->ggpo_session, "ggpo_rollback_stats.json", GGPO_STATS_FORMAT_JSON);
+			}
 		}
 		ImGui_End();
 
 		// Playing. Read inputs and simulate battle.
 		bool const is_host = data->lobby_create_call != 0;
-		simulation->accumulator += ctx->previous_frame_time;
-		const uint64_t dt = 16;
+		simulation->accumulator += ctx->previous_frame_time_us;
+		const uint64_t dt = (uint64_t)(16000.0f * time_dilation);
 		while (simulation->accumulator >= dt) {
 			TracyCZoneN(f, "Battle Frame", true);
 			struct BattleInputs battle_inputs = battle_read_input(game->inputs);
@@ -385,6 +616,7 @@ bool network_battle_update(struct Game *game, struct GameUpdateContext const *ct
 				err = ggpo_synchronize_input(data->ggpo_session, &network_inputs, sizeof(network_inputs), &disconnect_flags);
 				if (GGPO_SUCCEEDED(err)) {
 					tek_check_error(err);
+					network_battle_log_input(data, network_inputs);
 					enum BattleFrameResult battle_result = battle_simulate_frame(&simulation->battle_context, network_inputs);
 					TracyCZoneEnd(f);
 
@@ -418,7 +650,7 @@ void network_battle_render(struct Game *game)
 	struct Simulation *simulation = &game->simulation;
 
 	if (data->state == NETWORK_BATTLE_STATE_PLAY) {
-		battle_render(&simulation->battle_context);
+		battle_render(&simulation->battle_context, game->renderer);
 	}
 
 	UiHierarchy *h = &game->ui;
@@ -1,10 +1,19 @@
 #pragma once
 #include "game_battle.h"
+#include "game_replay.h"
 #include <ggponet.h>
 
 
 typedef uint64_t SteamAPICall_t;
 
+// GGPO keeps at most GGPO_MAX_PREDICTION_FRAMES + 2 saved states alive, they are stored in preallocated slots
+#define NETWORK_BATTLE_SAVE_SLOTS (GGPO_MAX_PREDICTION_FRAMES + 2)
+#define NETWORK_BATTLE_SAVE_ALIGNMENT 64
+#define NETWORK_BATTLE_MAX_FRAME_DELAY 4 // cap of the adaptive input delay, in frames
+#define NETWORK_BATTLE_DESYNC_INTERVAL 60 // frames between the checksums compared with the peer, about 40 bytes/s
+#define NETWORK_BATTLE_DESYNC_STATES 8 // states of the checked frames kept until the peer's checksum arrives
+#define NETWORK_BATTLE_INPUT_LOG_INITIAL_CAPACITY 3600
+
 
 enum NetworkBattleState
 {
@@ -31,6 +40,26 @@ struct NetworkBattle
 	GGPOPlayer ggpo_players[2];
 	GGPOPlayerHandle ggpo_player_handles[2];
 	bool ggpo_synchronizing;
+	// Saved states, slot_stride bytes per slot, allocated for the whole session
+	void *save_slab;
+	uint8_t *save_slots; // aligned on NETWORK_BATTLE_SAVE_ALIGNMENT
+	uint32_t save_slot_stride;
+	uint32_t save_next_slot;
+	bool save_slots_used[NETWORK_BATTLE_SAVE_SLOTS];
+	// Prediction of the remote inputs, learns from the confirmed inputs of both players
+	struct BattleInputPredictor input_predictor;
+	// Rollback stats of the previous update, to plot the per update deltas
+	GGPORollbackStats last_rollback_stats;
+	// Desync post-mortem: the inputs of every frame, rewritten by the rollbacks so they are final once
+	// confirmed, and the states of the frames checked by ggpo_set_desync_detection
+	int32_t current_frame; // GGPO frame of the simulation
+	int32_t save_slots_frame[NETWORK_BATTLE_SAVE_SLOTS];
+	struct BattleReplayKeyframe initial_keyframe;
+	struct BattleInputs *input_log;
+	uint32_t input_log_capacity;
+	struct BattleReplayKeyframe desync_states[NETWORK_BATTLE_DESYNC_STATES]; // slot (frame / interval) % length
+	int32_t desync_states_frame[NETWORK_BATTLE_DESYNC_STATES];
+	int32_t desync_frame; // -1 until GGPO_EVENTCODE_DESYNC
 
 	// State data
 	enum NetworkBattleState state;
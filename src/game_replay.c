@@ -0,0 +1,354 @@
+#include "game_replay.h"
+#include <stddef.h> // offsetof
+
+#if !defined(XXH_INLINE_ALL)
+#define XXH_INLINE_ALL
+#include <xxhash.h>
+#endif
+
+#define REPLAY_RUN_LENGTH_VARINT 15 // run length token meaning a varint follows
+#define REPLAY_FILE_HEADER_SIZE offsetof(struct ReplayFileHeader, initial) // bytes before the initial keyframe
+
+// -- Keyframes
+
+static uint64_t replay_state_layout_hash(void)
+{
+	uint64_t hash = 0;
+	for (uint32_t ifield = 0; ifield < battle_state_fields_length; ++ifield) {
+		struct BattleStateField const *field = &battle_state_fields[ifield];
+		uint32_t size_and_type[2] = {field->size, (uint32_t)field->type};
+		hash = XXH3_64bits_withSeed(field->name, strlen(field->name), hash);
+		hash = XXH3_64bits_withSeed(size_and_type, sizeof(size_and_type), hash);
+	}
+	return hash;
+}
+
+static uint32_t replay_keyframe_size(void)
+{
+	uint32_t size = 2 * sizeof(int32_t); // won rounds
+	for (uint32_t ifield = 0; ifield < battle_state_fields_length; ++ifield) {
+		size += battle_state_fields[ifield].size;
+	}
+	return size;
+}
+
+// out holds at least replay_keyframe_size() bytes
+static uint32_t replay_keyframe_encode(struct BattleReplayKeyframe const *keyframe, uint8_t *out)
+{
+	uint32_t size = 0;
+	for (uint32_t ifield = 0; ifield < battle_state_fields_length; ++ifield) {
+		struct BattleStateField const *field = &battle_state_fields[ifield];
+		memcpy(out + size, (uint8_t const*)&keyframe->battle_state + field->offset, field->size);
+		size += field->size;
+	}
+	int32_t rounds_won[2] = {keyframe->rounds_p1_won, keyframe->rounds_p2_won};
+	memcpy(out + size, rounds_won, sizeof(rounds_won));
+	size += sizeof(rounds_won);
+	return size;
+}
+
+static void replay_keyframe_decode(uint8_t const *in, struct BattleReplayKeyframe *keyframe)
+{
+	memset(keyframe, 0, sizeof(struct BattleReplayKeyframe));
+	uint32_t size = 0;
+	for (uint32_t ifield = 0; ifield < battle_state_fields_length; ++ifield) {
+		struct BattleStateField const *field = &battle_state_fields[ifield];
+		memcpy((uint8_t*)&keyframe->battle_state + field->offset, in + size, field->size);
+		size += field->size;
+	}
+	int32_t rounds_won[2];
+	memcpy(rounds_won, in + size, sizeof(rounds_won));
+	keyframe->rounds_p1_won = rounds_won[0];
+	keyframe->rounds_p2_won = rounds_won[1];
+}
+
+// -- Header
+
+struct ReplayFileHeader replay_file_header(struct BattleContext const *ctx, uint32_t keyframe_interval)
+{
+	struct ReplayFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = REPLAY_FILE_MAGIC;
+	header.version = REPLAY_FILE_VERSION;
+	header.characters_hash[0] = tek_characters[ctx->battle_state.p1_entity.tek.character_id].content_hash;
+	header.characters_hash[1] = tek_characters[ctx->battle_state.p2_entity.tek.character_id].content_hash;
+	header.assets_hash = ctx->assets ? ctx->assets->content_hash : 0;
+	header.rounds_first_to = (uint32_t)ctx->battle_non_state.rounds_first_to;
+	header.keyframe_interval = keyframe_interval;
+	header.state_layout_hash = replay_state_layout_hash();
+	battle_replay_keyframe_save(ctx, &header.initial);
+	return header;
+}
+
+bool replay_file_header_matches(struct ReplayFileHeader const *header, struct BattleContext const *ctx)
+{
+	struct ReplayFileHeader current = replay_file_header(ctx, 0);
+	return header->characters_hash[0] == current.characters_hash[0]
+		&& header->characters_hash[1] == current.characters_hash[1]
+		&& header->assets_hash == current.assets_hash;
+}
+
+// -- Writer
+
+static void replay_write_chunk(FILE *file, enum ReplayChunkType type, uint32_t first_frame, uint32_t frames_length, void const *payload, uint32_t size)
+{
+	struct ReplayChunkHeader header = {0};
+	header.type = type;
+	header.first_frame = first_frame;
+	header.frames_length = frames_length;
+	header.size = size;
+	header.checksum = XXH3_64bits(payload, size);
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(payload, size, 1, file);
+	// the chunks before a crash stay readable
+	fflush(file);
+}
+
+static void replay_writer_encode_run(struct ReplayWriter *writer)
+{
+	if (writer->run_length == 0) {
+		return;
+	}
+
+	uint8_t const *previous = (uint8_t const*)&writer->chunk_previous;
+	uint8_t const *current = (uint8_t const*)&writer->run_inputs;
+	uint8_t mask = 0;
+	for (uint32_t i = 0; i < sizeof(struct BattleInputs); ++i) {
+		if (previous[i] != current[i]) {
+			mask |= (uint8_t)(1 << i);
+		}
+	}
+
+	uint32_t length = writer->run_length - 1;
+	uint8_t *out = writer->chunk;
+	out[writer->chunk_size++] = mask | (uint8_t)((length < REPLAY_RUN_LENGTH_VARINT ? length : REPLAY_RUN_LENGTH_VARINT) << 4);
+	if (length >= REPLAY_RUN_LENGTH_VARINT) {
+		uint32_t rest = length - REPLAY_RUN_LENGTH_VARINT;
+		while (rest >= 0x80) {
+			out[writer->chunk_size++] = (uint8_t)(rest | 0x80);
+			rest >>= 7;
+		}
+		out[writer->chunk_size++] = (uint8_t)rest;
+	}
+	for (uint32_t i = 0; i < sizeof(struct BattleInputs); ++i) {
+		if (mask & (1 << i)) {
+			out[writer->chunk_size++] = current[i];
+		}
+	}
+	ASSERT(writer->chunk_size <= REPLAY_CHUNK_MAX_SIZE);
+
+	writer->chunk_previous = writer->run_inputs;
+	writer->run_length = 0;
+}
+
+static void replay_writer_flush_chunk(struct ReplayWriter *writer)
+{
+	replay_writer_encode_run(writer);
+	uint32_t frames_length = writer->frame - writer->chunk_first_frame;
+	if (frames_length > 0) {
+		replay_write_chunk(writer->file, REPLAY_CHUNK_INPUTS, writer->chunk_first_frame, frames_length, writer->chunk, writer->chunk_size);
+	}
+	// chunks are decoded on their own
+	writer->chunk_first_frame = writer->frame;
+	writer->chunk_size = 0;
+	memset(&writer->chunk_previous, 0, sizeof(struct BattleInputs));
+}
+
+bool replay_writer_open(struct ReplayWriter *writer, const char *path, struct ReplayFileHeader const *header)
+{
+	ASSERT(sizeof(struct BattleInputs) <= 4); // one mask bit per byte in the run tokens
+	memset(writer, 0, sizeof(struct ReplayWriter));
+	writer->file = fopen(path, "wb");
+	if (writer->file == NULL) {
+		perror("Error");
+		return false;
+	}
+	writer->header = *header;
+	uint8_t initial[sizeof(struct BattleReplayKeyframe)];
+	uint32_t initial_size = replay_keyframe_encode(&writer->header.initial, initial);
+	fwrite(&writer->header, REPLAY_FILE_HEADER_SIZE, 1, writer->file);
+	fwrite(initial, initial_size, 1, writer->file);
+	fflush(writer->file);
+	return true;
+}
+
+void replay_writer_push(struct ReplayWriter *writer, struct BattleContext const *ctx, struct BattleInputs inputs)
+{
+	if (writer->file == NULL) {
+		return;
+	}
+
+	// the keyframe of frame 0 is the initial simulation of the header
+	uint32_t keyframe_interval = writer->header.keyframe_interval;
+	if (keyframe_interval != 0 && writer->frame != 0 && writer->frame % keyframe_interval == 0) {
+		struct BattleReplayKeyframe keyframe;
+		battle_replay_keyframe_save(ctx, &keyframe);
+		replay_writer_push_keyframe(writer, &keyframe);
+	}
+
+	if (writer->run_length > 0 && memcmp(&writer->run_inputs, &inputs, sizeof(struct BattleInputs)) == 0) {
+		writer->run_length += 1;
+	} else {
+		replay_writer_encode_run(writer);
+		writer->run_inputs = inputs;
+		writer->run_length = 1;
+	}
+	writer->frame += 1;
+
+	if (writer->frame - writer->chunk_first_frame >= REPLAY_CHUNK_FRAMES) {
+		replay_writer_flush_chunk(writer);
+	}
+}
+
+void replay_writer_push_keyframe(struct ReplayWriter *writer, struct BattleReplayKeyframe const *keyframe)
+{
+	if (writer->file == NULL) {
+		return;
+	}
+	replay_writer_flush_chunk(writer);
+	uint8_t payload[sizeof(struct BattleReplayKeyframe)];
+	uint32_t size = replay_keyframe_encode(keyframe, payload);
+	replay_write_chunk(writer->file, REPLAY_CHUNK_KEYFRAME, writer->frame, 0, payload, size);
+}
+
+void replay_writer_close(struct ReplayWriter *writer)
+{
+	if (writer->file == NULL) {
+		return;
+	}
+	replay_writer_flush_chunk(writer);
+	fclose(writer->file);
+	writer->file = NULL;
+}
+
+// -- Reader
+
+bool replay_reader_open(struct ReplayReader *reader, const char *path)
+{
+	ASSERT(sizeof(struct BattleInputs) <= 4);
+	ASSERT(replay_keyframe_size() <= REPLAY_CHUNK_MAX_SIZE); // the initial keyframe is read in the chunk buffer
+	memset(reader, 0, sizeof(struct ReplayReader));
+	reader->file = fopen(path, "rb");
+	if (reader->file == NULL) {
+		perror("Error");
+		return false;
+	}
+	if (fread(&reader->header, REPLAY_FILE_HEADER_SIZE, 1, reader->file) != 1
+	    || reader->header.magic != REPLAY_FILE_MAGIC
+	    || reader->header.version != REPLAY_FILE_VERSION) {
+		printf("REPLAY: %s is not a replay of version %u\n", path, REPLAY_FILE_VERSION);
+		replay_reader_close(reader);
+		return false;
+	}
+	if (reader->header.state_layout_hash != replay_state_layout_hash()) {
+		printf("REPLAY: %s was recorded with other BattleState fields\n", path);
+		replay_reader_close(reader);
+		return false;
+	}
+	uint32_t initial_size = replay_keyframe_size();
+	if (fread(reader->chunk, initial_size, 1, reader->file) != 1) {
+		printf("REPLAY: %s is truncated\n", path);
+		replay_reader_close(reader);
+		return false;
+	}
+	replay_keyframe_decode(reader->chunk, &reader->header.initial);
+	return true;
+}
+
+static enum ReplayReadResult replay_reader_read_chunk(struct ReplayReader *reader)
+{
+	struct ReplayChunkHeader *header = &reader->chunk_header;
+	size_t header_read = fread(header, 1, sizeof(struct ReplayChunkHeader), reader->file);
+	if (header_read == 0) {
+		return REPLAY_READ_END;
+	}
+	if (header_read != sizeof(struct ReplayChunkHeader) || header->size > REPLAY_CHUNK_MAX_SIZE) {
+		return REPLAY_READ_ERROR;
+	}
+	if (fread(reader->chunk, 1, header->size, reader->file) != header->size
+	    || XXH3_64bits(reader->chunk, header->size) != header->checksum
+	    || header->first_frame != reader->frame) {
+		return REPLAY_READ_ERROR;
+	}
+	return header->type == REPLAY_CHUNK_KEYFRAME ? REPLAY_READ_KEYFRAME : REPLAY_READ_INPUTS;
+}
+
+enum ReplayReadResult replay_reader_next(struct ReplayReader *reader, struct BattleInputs *out_inputs, struct BattleReplayKeyframe *out_keyframe)
+{
+	if (reader->file == NULL) {
+		return REPLAY_READ_ERROR;
+	}
+
+	while (reader->run_length == 0) {
+		if (reader->chunk_frames_left == 0) {
+			enum ReplayReadResult result = replay_reader_read_chunk(reader);
+			if (result != REPLAY_READ_INPUTS && result != REPLAY_READ_KEYFRAME) {
+				return result;
+			}
+			if (reader->chunk_header.type == REPLAY_CHUNK_KEYFRAME) {
+				if (reader->chunk_header.size != replay_keyframe_size()) {
+					return REPLAY_READ_ERROR;
+				}
+				replay_keyframe_decode(reader->chunk, out_keyframe);
+				return REPLAY_READ_KEYFRAME;
+			}
+			if (reader->chunk_header.type != REPLAY_CHUNK_INPUTS) {
+				continue; // from a later version
+			}
+			reader->chunk_cursor = 0;
+			reader->chunk_frames_left = reader->chunk_header.frames_length;
+			memset(&reader->run_inputs, 0, sizeof(struct BattleInputs));
+			continue;
+		}
+
+		// next run
+		uint8_t const *in = reader->chunk;
+		uint32_t size = reader->chunk_header.size;
+		if (reader->chunk_cursor >= size) {
+			return REPLAY_READ_ERROR;
+		}
+		uint8_t token = in[reader->chunk_cursor++];
+		uint32_t length = (uint32_t)(token >> 4);
+		if (length == REPLAY_RUN_LENGTH_VARINT) {
+			uint32_t rest = 0;
+			for (uint32_t shift = 0; ; shift += 7) {
+				if (reader->chunk_cursor >= size || shift > 28) {
+					return REPLAY_READ_ERROR;
+				}
+				uint8_t byte = in[reader->chunk_cursor++];
+				rest |= (uint32_t)(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0) {
+					break;
+				}
+			}
+			length += rest;
+		}
+		uint8_t *inputs = (uint8_t*)&reader->run_inputs;
+		for (uint32_t i = 0; i < sizeof(struct BattleInputs); ++i) {
+			if (token & (1 << i)) {
+				if (reader->chunk_cursor >= size) {
+					return REPLAY_READ_ERROR;
+				}
+				inputs[i] = in[reader->chunk_cursor++];
+			}
+		}
+		if (length + 1 > reader->chunk_frames_left) {
+			return REPLAY_READ_ERROR;
+		}
+		reader->run_length = length + 1;
+	}
+
+	*out_inputs = reader->run_inputs;
+	reader->run_length -= 1;
+	reader->chunk_frames_left -= 1;
+	reader->frame += 1;
+	return REPLAY_READ_INPUTS;
+}
+
+void replay_reader_close(struct ReplayReader *reader)
+{
+	if (reader->file != NULL) {
+		fclose(reader->file);
+		reader->file = NULL;
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "game_battle.h"
+
+/**
+Replay files: the inputs of a battle, recorded from any point of a match, saved while playing and read back as a stream.
+
+The file starts with a ReplayFileHeader: the content hashes of the characters and of the cooked assets the replay was
+recorded with, a hash of the replicated fields of BattleState, and the simulation before the first frame. Chunks follow, each with a ReplayChunkHeader and a checksum
+of its payload, so a truncated or corrupted file is detected at the first bad chunk and the chunks before it are usable.
+
+Input chunks hold up to REPLAY_CHUNK_FRAMES frames. The inputs are run-length and delta encoded, a run is a token byte:
+the low 4 bits mask the bytes of BattleInputs that changed since the previous run, the high 4 bits are the run length
+minus 1, 15 means a varint with the rest of the length follows the token. Then come the changed bytes. Each chunk starts
+from zero inputs and can be decoded on its own. Held inputs cost a byte per run, about 1 byte every 10 frames.
+
+Keyframe chunks hold a BattleReplayKeyframe, the simulation before their frame, every keyframe_interval frames if the
+header asks for them. They let a reader check the simulation while it plays the replay, or start in the middle of it.
+Keyframes are written field by field from battle_state_fields then the won rounds, without the padding of the structs,
+so the file does not depend on the compiler. A replay recorded with other fields has another state_layout_hash and is
+rejected. Bump REPLAY_FILE_VERSION when the encoding itself changes.
+ **/
+#define REPLAY_FILE_MAGIC 0x524b4554 // "TEKR"
+#define REPLAY_FILE_VERSION 2
+#define REPLAY_CHUNK_FRAMES 3600 // 1 minute, a chunk is written to the file once it is full
+#define REPLAY_CHUNK_MAX_SIZE (REPLAY_CHUNK_FRAMES * (1 + sizeof(struct BattleInputs)))
+#define REPLAY_FILE_KEYFRAME_INTERVAL 600 // 10 seconds, about 1.4 bytes per frame
+
+enum ReplayChunkType
+{
+	REPLAY_CHUNK_INPUTS = 1,
+	REPLAY_CHUNK_KEYFRAME = 2,
+};
+
+struct ReplayFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t characters_hash[2]; // tek_Character content_hash of p1 and p2
+	uint64_t assets_hash; // AssetLibrary content_hash
+	uint32_t rounds_first_to;
+	uint32_t keyframe_interval; // frames between keyframe chunks, 0 = no keyframes
+	uint64_t state_layout_hash; // names, sizes and types of battle_state_fields
+	// the fields above are written as is, they have no padding
+	struct BattleReplayKeyframe initial; // the simulation before the first frame, written as a keyframe
+};
+
+struct ReplayChunkHeader
+{
+	uint32_t type; // ReplayChunkType
+	uint32_t first_frame;
+	uint32_t frames_length; // inputs in the chunk, 0 for keyframes
+	uint32_t size; // payload bytes
+	uint64_t checksum; // XXH3 of the payload
+};
+
+struct ReplayWriter
+{
+	FILE *file;
+	struct ReplayFileHeader header;
+	uint32_t frame; // next frame pushed
+	// current chunk
+	uint32_t chunk_first_frame;
+	uint32_t chunk_size;
+	struct BattleInputs chunk_previous; // inputs of the last encoded run
+	struct BattleInputs run_inputs;
+	uint32_t run_length;
+	uint8_t chunk[REPLAY_CHUNK_MAX_SIZE];
+};
+
+enum ReplayReadResult
+{
+	REPLAY_READ_INPUTS, // the inputs of the next frame
+	REPLAY_READ_KEYFRAME, // the simulation before the next frame
+	REPLAY_READ_END,
+	REPLAY_READ_ERROR, // truncated or corrupted chunk
+};
+
+struct ReplayReader
+{
+	FILE *file;
+	struct ReplayFileHeader header;
+	uint32_t frame; // next frame read
+	// current chunk
+	struct ReplayChunkHeader chunk_header;
+	uint32_t chunk_cursor;
+	uint32_t chunk_frames_left;
+	struct BattleInputs run_inputs;
+	uint32_t run_length;
+	uint8_t chunk[REPLAY_CHUNK_MAX_SIZE];
+};
+
+// The header of a replay starting from the current simulation
+struct ReplayFileHeader replay_file_header(struct BattleContext const *ctx, uint32_t keyframe_interval);
+// The characters and assets of ctx are the ones the replay was recorded with
+bool replay_file_header_matches(struct ReplayFileHeader const *header, struct BattleContext const *ctx);
+
+bool replay_writer_open(struct ReplayWriter *writer, const char *path, struct ReplayFileHeader const *header);
+// Called before simulating each frame, ctx is used for the keyframes
+void replay_writer_push(struct ReplayWriter *writer, struct BattleContext const *ctx, struct BattleInputs inputs);
+// Writes a keyframe of the simulation before the next frame, outside of the keyframe_interval
+void replay_writer_push_keyframe(struct ReplayWriter *writer, struct BattleReplayKeyframe const *keyframe);
+// Writes the last chunk and closes the file
+void replay_writer_close(struct ReplayWriter *writer);
+
+bool replay_reader_open(struct ReplayReader *reader, const char *path);
+enum ReplayReadResult replay_reader_next(struct ReplayReader *reader, struct BattleInputs *out_inputs, struct BattleReplayKeyframe *out_keyframe);
+void replay_reader_close(struct ReplayReader *reader);
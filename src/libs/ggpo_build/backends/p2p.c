@@ -21,13 +21,19 @@
  * in the LICENSE file.
  */
 
+#include <math.h>
 #include "p2p.h"
 
 static const int RECOMMENDATION_INTERVAL = 240;
+static const int FRAME_DELAY_INTERVAL = 30;       // frames between two adaptive frame delay decisions
+static const int FRAME_DELAY_IDLE_FRAMES = 4;     // frames a local input has to stay the same to change its delay
+static const float FRAME_DELAY_HYSTERESIS = 0.5f; // frames of margin before lowering the delay
 static const int DEFAULT_DISCONNECT_TIMEOUT = 5000;
 static const int DEFAULT_DISCONNECT_NOTIFY_START = 750;
 
 static void p2p_OnMsg(conn_Address from, UdpMsg* msg, int len, void* user_data);
+static void p2p_UpdateFrameDelay(Peer2PeerBackend *p2p);
+static void p2p_CheckDesync(Peer2PeerBackend *p2p, int confirmed_frame);
 
 
 
@@ -48,6 +54,17 @@ void p2p_ctor(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char *gamen
 	p2p->_header._callbacks = *cb;
 	p2p->_synchronizing = true;
 	p2p->_next_recommended_sleep = 0;
+	p2p->_timesync_mode = GGPO_TIMESYNC_SKIP_FRAMES;
+	p2p->_time_dilation = 1.0f;
+	p2p->_max_frame_delay = 0;
+	p2p->_wanted_frame_delay = 0;
+	p2p->_target_frame_delay = 0;
+	p2p->_rollback_frames = GGPO_ADAPTIVE_MAX_ROLLBACK_FRAMES;
+	p2p->_next_frame_delay_update = 0;
+	memset(p2p->_idle_input_frames, 0, sizeof(p2p->_idle_input_frames));
+	p2p->_desync_interval = 0;
+	p2p->_next_checksum_frame = 0;
+	memset(p2p->_desync_sent, 0, sizeof(p2p->_desync_sent));
 
 	/*
 	 * Initialize the synchronziation layer
@@ -90,7 +107,7 @@ void p2p_AddRemotePlayer(Peer2PeerBackend *p2p, char* ip, uint16 port, int queue
 	ASSERT(conn_support_ip_port());
 	conn_Address peer_addr = conn_address_from_ip_port(ip, port);
 
-	UdpProtocol_Init(&p2p->_endpoints[queue], &p2p->_udp, queue, peer_addr, p2p->_local_connect_status);
+	UdpProtocol_Init(&p2p->_endpoints[queue], &p2p->_udp, queue, peer_addr, p2p->_local_connect_status, p2p->_input_size);
 	UdpProtocol_SetDisconnectTimeout(&p2p->_endpoints[queue], p2p->_disconnect_timeout);
 	UdpProtocol_SetDisconnectNotifyStart(&p2p->_endpoints[queue], p2p->_disconnect_notify_start);
 	UdpProtocol_Synchronize(&p2p->_endpoints[queue]);
@@ -109,7 +126,7 @@ GGPOErrorCode p2p_AddSpectator(Peer2PeerBackend *p2p, char* ip, uint16 port)
 	ASSERT(conn_support_ip_port());
 	conn_Address peer_addr = conn_address_from_ip_port(ip, port);
 
-	UdpProtocol_Init(&p2p->_spectators[queue], &p2p->_udp, queue + 1000, peer_addr, p2p->_local_connect_status);
+	UdpProtocol_Init(&p2p->_spectators[queue], &p2p->_udp, queue + 1000, peer_addr, p2p->_local_connect_status, p2p->_input_size * p2p->_num_players);
 	UdpProtocol_SetDisconnectTimeout(&p2p->_spectators[queue], p2p->_disconnect_timeout);
 	UdpProtocol_SetDisconnectNotifyStart(&p2p->_spectators[queue], p2p->_disconnect_notify_start);
 	UdpProtocol_Synchronize(&p2p->_spectators[queue]);
@@ -151,6 +168,17 @@ void p2p_ctor_steam(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char
 	p2p->_header._callbacks = *cb;
 	p2p->_synchronizing = true;
 	p2p->_next_recommended_sleep = 0;
+	p2p->_timesync_mode = GGPO_TIMESYNC_SKIP_FRAMES;
+	p2p->_time_dilation = 1.0f;
+	p2p->_max_frame_delay = 0;
+	p2p->_wanted_frame_delay = 0;
+	p2p->_target_frame_delay = 0;
+	p2p->_rollback_frames = GGPO_ADAPTIVE_MAX_ROLLBACK_FRAMES;
+	p2p->_next_frame_delay_update = 0;
+	memset(p2p->_idle_input_frames, 0, sizeof(p2p->_idle_input_frames));
+	p2p->_desync_interval = 0;
+	p2p->_next_checksum_frame = 0;
+	memset(p2p->_desync_sent, 0, sizeof(p2p->_desync_sent));
 
 	/*
 	 * Initialize the synchronization layer
@@ -201,7 +229,7 @@ void p2p_AddRemotePlayerSteam(Peer2PeerBackend *p2p, uint64 steam_id, int queue)
 
 	conn_Address peer_addr = conn_address_from_steam_id(steam_id);
 
-	UdpProtocol_Init(&p2p->_endpoints[queue], &p2p->_udp, queue, peer_addr, p2p->_local_connect_status);
+	UdpProtocol_Init(&p2p->_endpoints[queue], &p2p->_udp, queue, peer_addr, p2p->_local_connect_status, p2p->_input_size);
 	UdpProtocol_SetDisconnectTimeout(&p2p->_endpoints[queue], p2p->_disconnect_timeout);
 	UdpProtocol_SetDisconnectNotifyStart(&p2p->_endpoints[queue], p2p->_disconnect_notify_start);
 	UdpProtocol_Synchronize(&p2p->_endpoints[queue]);
@@ -225,7 +253,7 @@ GGPOErrorCode p2p_AddSpectatorSteam(Peer2PeerBackend *p2p, uint64 steam_id)
 	conn_add_known_peer(steam_id);
 	conn_Address peer_addr = conn_address_from_steam_id(steam_id);
 
-	UdpProtocol_Init(&p2p->_spectators[queue], &p2p->_udp, queue + 1000, peer_addr, p2p->_local_connect_status);
+	UdpProtocol_Init(&p2p->_spectators[queue], &p2p->_udp, queue + 1000, peer_addr, p2p->_local_connect_status, p2p->_input_size * p2p->_num_players);
 	UdpProtocol_SetDisconnectTimeout(&p2p->_spectators[queue], p2p->_disconnect_timeout);
 	UdpProtocol_SetDisconnectNotifyStart(&p2p->_spectators[queue], p2p->_disconnect_notify_start);
 	UdpProtocol_Synchronize(&p2p->_spectators[queue]);
@@ -287,10 +315,23 @@ p2p_DoPoll(Peer2PeerBackend *p2p, int timeout)
 				}
 				Log("setting confirmed frame in sync to %d.\n", total_min_confirmed);
 				sync_SetLastConfirmedFrame(&p2p->_sync, total_min_confirmed);
+				if (p2p->_desync_interval > 0) {
+					p2p_CheckDesync(p2p, total_min_confirmed);
+				}
 			}
 
+			if (p2p->_timesync_mode == GGPO_TIMESYNC_DILATION) {
+				// slow down for the peer we are the most ahead of, or catch up with the one we are the least behind
+				float dilation = 0.0f;
+				for (int i = 0; i < p2p->_num_players; i++) {
+					if (UdpProtocol_IsRunning(&p2p->_endpoints[i])) {
+						dilation = MAX(dilation, UdpProtocol_RecommendFrameDilation(&p2p->_endpoints[i]));
+					}
+				}
+				p2p->_time_dilation = dilation > 0.0f ? dilation : 1.0f;
+			}
 			// send timesync notifications if now is the proper time
-			if (current_frame > p2p->_next_recommended_sleep) {
+			else if (current_frame > p2p->_next_recommended_sleep) {
 				int interval = 0;
 				for (int i = 0; i < p2p->_num_players; i++) {
 					interval = MAX(interval, UdpProtocol_RecommendFrameDelay(&p2p->_endpoints[i]));
@@ -300,16 +341,25 @@ p2p_DoPoll(Peer2PeerBackend *p2p, int timeout)
 					GGPOEvent info;
 					info.code = GGPO_EVENTCODE_TIMESYNC;
 					info.u.timesync.frames_ahead = interval;
+					metrics_RecordTimeSync(sync_GetMetrics(&p2p->_sync), interval);
 					p2p->_header._callbacks.on_event(&info);
 					p2p->_next_recommended_sleep = current_frame + RECOMMENDATION_INTERVAL;
 				}
 			}
+			if (p2p->_max_frame_delay > 0 && current_frame >= p2p->_next_frame_delay_update) {
+				p2p_UpdateFrameDelay(p2p);
+				p2p->_next_frame_delay_update = current_frame + FRAME_DELAY_INTERVAL;
+			}
+
 			// XXX: this is obviously a farce...
 			if (timeout) {
 				// ASSERT(false);
 				// Sleep(1);
 			}
 		}
+
+		// everything the endpoints sent during this poll goes out at once
+		udp_Flush(&p2p->_udp);
 	}
 	return GGPO_OK;
 }
@@ -416,6 +466,30 @@ p2p_AddPlayer(Peer2PeerBackend *p2p, GGPOPlayer* player,
 	return GGPO_OK;
 }
 
+/*
+ * Moves the frame delay of a local player one frame towards the agreed delay, only when its input
+ * is the same as the last queued one for a few frames: a larger delay repeats the last queued input
+ * in the padded frames, and a smaller one drops this input, which is the same as the previous one.
+ * Returns the idle frames of the queue once this input is queued, the caller restores the delay
+ * if the input is rejected.
+ */
+static int
+p2p_StepFrameDelay(Peer2PeerBackend *p2p, int queue, GameInput const *input)
+{
+	GameInput const *last_input = &p2p->_last_local_inputs[queue];
+	bool idle = last_input->size != 0 && gameinput_equal(input, last_input, true);
+	int idle_frames = idle ? p2p->_idle_input_frames[queue] + 1 : 0;
+
+	int delay = sync_GetFrameDelay(&p2p->_sync, queue);
+	if (delay == p2p->_target_frame_delay || idle_frames < FRAME_DELAY_IDLE_FRAMES) {
+		return idle_frames;
+	}
+	delay += delay < p2p->_target_frame_delay ? 1 : -1;
+	Log("changing the frame delay of queue %d to %d.\n", queue, delay);
+	sync_SetFrameDelay(&p2p->_sync, queue, delay);
+	return 0;
+}
+
 GGPOErrorCode
 p2p_AddLocalInput(Peer2PeerBackend *p2p, GGPOPlayerHandle player,
 	void* values,
@@ -439,10 +513,17 @@ p2p_AddLocalInput(Peer2PeerBackend *p2p, GGPOPlayerHandle player,
 
 	gameinput_init(&input, -1, (char*)values, size);
 
+	int delay = sync_GetFrameDelay(&p2p->_sync, queue);
+	int idle_frames = p2p->_max_frame_delay > 0 ? p2p_StepFrameDelay(p2p, queue, &input) : 0;
+	int last_sent_frame = p2p->_local_connect_status[queue].last_frame;
+
 	// Feed the input for the current frame into the synchronzation layer.
 	if (!sync_AddLocalInput(&p2p->_sync, queue, &input)) {
+		// the game retries this input, it is not idle until it is queued
+		sync_SetFrameDelay(&p2p->_sync, queue, delay);
 		return GGPO_ERRORCODE_PREDICTION_THRESHOLD;
 	}
+	p2p->_idle_input_frames[queue] = idle_frames;
 
 	if (input.frame != GAMEINPUT_NULL_FRAME) { // xxx: <- comment why this is the case
 		// Update the local connect status state to indicate that we've got a
@@ -451,13 +532,24 @@ p2p_AddLocalInput(Peer2PeerBackend *p2p, GGPOPlayerHandle player,
 
 		Log("setting local connect status for local queue %d to %d", queue, input.frame);
 		p2p->_local_connect_status[queue].last_frame = input.frame;
-
-		// Send the input to all the remote players.
-		for (int i = 0; i < p2p->_num_players; i++) {
-			if (UdpProtocol_IsInitialized(&p2p->_endpoints[i])) {
-				UdpProtocol_SendInput(&p2p->_endpoints[i], &input);
+		p2p->_last_local_inputs[queue] = input;
+
+		// Send the input to all the remote players, after the frames padded by a larger
+		// frame delay.  They repeat the previous queued input, send what the queue holds.
+		int first_frame = last_sent_frame >= 0 ? last_sent_frame + 1 : input.frame;
+		for (int frame = first_frame; frame <= input.frame; frame++) {
+			GameInput frame_input;
+			if (!sync_GetLocalInput(&p2p->_sync, queue, frame, &frame_input)) {
+				ASSERT(false && "local input missing from its queue");
+				continue;
+			}
+			for (int i = 0; i < p2p->_num_players; i++) {
+				if (UdpProtocol_IsInitialized(&p2p->_endpoints[i])) {
+					UdpProtocol_SendInput(&p2p->_endpoints[i], &frame_input);
+				}
 			}
 		}
+		udp_Flush(&p2p->_udp);
 	}
 
 	return GGPO_OK;
@@ -542,6 +634,15 @@ p2p_OnUdpProtocolPeerEvent(Peer2PeerBackend *p2p, udp_protocol_Event* evt, int q
 		p2p_DisconnectPlayer(p2p, p2p_QueueToPlayerHandle(p2p, queue));
 		break;
 
+	case UdpProtocol_Event_Checksum:
+		// compared in p2p_CheckDesync once the local checksum of that frame is known
+		if (p2p->_desync_interval > 0 && evt->u.checksum.frame >= 0 && evt->u.checksum.frame % p2p->_desync_interval == 0) {
+			p2p_FrameChecksum *remote = &p2p->_remote_checksums[queue][(evt->u.checksum.frame / p2p->_desync_interval) % P2P_CHECKSUM_HISTORY];
+			remote->frame = evt->u.checksum.frame;
+			remote->checksum = evt->u.checksum.checksum;
+		}
+		break;
+
 
 	case UdpProtocol_Event_Unknown:
 	case UdpProtocol_Event_Connected:
@@ -612,6 +713,7 @@ p2p_OnUdpProtocolEvent(Peer2PeerBackend *p2p, udp_protocol_Event* evt, GGPOPlaye
 	case UdpProtocol_Event_Unknown:
 	case UdpProtocol_Event_Input:
 	case UdpProtocol_Event_Disconnected:
+	case UdpProtocol_Event_Checksum:
 		// default case
 		break;
 	}
@@ -697,6 +799,16 @@ p2p_GetNetworkStats(Peer2PeerBackend *p2p, GGPONetworkStats* stats, GGPOPlayerHa
 	memset(stats, 0, sizeof * stats);
 	UdpProtocol_GetNetworkStats(&p2p->_endpoints[queue], stats);
 
+	for (int i = 0; i < p2p->_num_players; i++) {
+		if (!UdpProtocol_IsInitialized(&p2p->_endpoints[i])) {
+			stats->frame_delay.current = sync_GetFrameDelay(&p2p->_sync, i);
+		}
+	}
+	stats->frame_delay.wanted = p2p->_wanted_frame_delay;
+	stats->frame_delay.remote_wanted = p2p->_endpoints[queue]._remote_frame_delay_request;
+	UdpProtocol_GetRoundTripTime(&p2p->_endpoints[queue], &stats->frame_delay.rtt_ms, &stats->frame_delay.rtt_deviation_ms);
+	stats->frame_delay.rollback_frames = p2p->_rollback_frames;
+
 	return GGPO_OK;
 }
 
@@ -738,6 +850,193 @@ p2p_SetDisconnectNotifyStart(Peer2PeerBackend *p2p, int timeout)
 	return GGPO_OK;
 }
 
+GGPOErrorCode
+p2p_StartNetworkThread(Peer2PeerBackend *p2p)
+{
+	return udp_StartThread(&p2p->_udp) ? GGPO_OK : GGPO_ERRORCODE_GENERAL_FAILURE;
+}
+
+GGPOErrorCode
+p2p_GetRollbackStats(Peer2PeerBackend *p2p, GGPORollbackStats *stats)
+{
+	metrics_GetStats(sync_GetMetrics(&p2p->_sync), stats);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_WriteRollbackStats(Peer2PeerBackend *p2p, const char *filename, GGPOStatsFormat format)
+{
+	return metrics_Write(sync_GetMetrics(&p2p->_sync), filename, format) ? GGPO_OK : GGPO_ERRORCODE_GENERAL_FAILURE;
+}
+
+GGPOErrorCode
+p2p_SetLinkProfile(Peer2PeerBackend *p2p, const GGPOLinkProfile *profile)
+{
+	udp_SetLinkProfile(&p2p->_udp, profile);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_SetInputPredictor(Peer2PeerBackend *p2p, const GGPOInputPredictor *predictor)
+{
+	sync_SetInputPredictor(&p2p->_sync, predictor);
+	return GGPO_OK;
+}
+
+/*
+ * Chooses the input delay from the round trip time to the remote players.  Their inputs arrive
+ * after half a round trip, most of them within half of two mean deviations more: the frames of this
+ * latency not covered by the input delay are rolled back when a prediction is wrong.  The delay is
+ * the smallest one which keeps that rollback depth within what the session can afford.
+ */
+static void
+p2p_UpdateFrameDelay(Peer2PeerBackend *p2p)
+{
+	// resimulating has to fit in half a frame
+	GGPORollbackStats stats;
+	metrics_GetStats(sync_GetMetrics(&p2p->_sync), &stats);
+	float rollback_frames = GGPO_ADAPTIVE_MAX_ROLLBACK_FRAMES;
+	if (stats.advance.count > 0 && stats.advance.avg_us > 0.0f) {
+		float affordable = (GGPO_FRAME_BUDGET_US / 2 - stats.load.avg_us) / stats.advance.avg_us;
+		rollback_frames = MAX(0.0f, MIN(rollback_frames, affordable));
+	}
+	p2p->_rollback_frames = rollback_frames;
+
+	float latency_frames = 0.0f;
+	bool measured = false;
+	for (int i = 0; i < p2p->_num_players; i++) {
+		float rtt, deviation;
+		if (UdpProtocol_IsRunning(&p2p->_endpoints[i]) && UdpProtocol_GetRoundTripTime(&p2p->_endpoints[i], &rtt, &deviation)) {
+			latency_frames = MAX(latency_frames, (rtt + 2 * deviation) / 2 * 60 / 1000);
+			measured = true;
+		}
+	}
+	if (!measured) {
+		return;
+	}
+
+	// raise the delay as soon as it is needed, lower it once it is clearly not
+	float uncovered = latency_frames - rollback_frames;
+	int wanted = (int)ceilf(uncovered);
+	if (wanted < p2p->_wanted_frame_delay) {
+		wanted = MIN((int)ceilf(uncovered + FRAME_DELAY_HYSTERESIS), p2p->_wanted_frame_delay);
+	}
+	wanted = MAX(0, MIN(wanted, p2p->_max_frame_delay));
+	p2p->_wanted_frame_delay = wanted;
+
+	// both clients move to the largest delay they want, so they stay fair
+	int target = wanted;
+	for (int i = 0; i < p2p->_num_players; i++) {
+		if (UdpProtocol_IsRunning(&p2p->_endpoints[i])) {
+			UdpProtocol_SetFrameDelayRequest(&p2p->_endpoints[i], wanted);
+			target = MAX(target, UdpProtocol_GetRemoteFrameDelayRequest(&p2p->_endpoints[i]));
+		}
+	}
+	p2p->_target_frame_delay = MIN(target, p2p->_max_frame_delay);
+}
+
+GGPOErrorCode
+p2p_SetAdaptiveFrameDelay(Peer2PeerBackend *p2p, int max_frame_delay)
+{
+	if (max_frame_delay < 0 || max_frame_delay > GGPO_MAX_PREDICTION_FRAMES) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	p2p->_max_frame_delay = max_frame_delay;
+	p2p->_next_frame_delay_update = 0;
+	// keep the delays of the local players where they are
+	for (int i = 0; i < p2p->_num_players; i++) {
+		if (!UdpProtocol_IsInitialized(&p2p->_endpoints[i])) {
+			p2p->_target_frame_delay = sync_GetFrameDelay(&p2p->_sync, i);
+			p2p->_wanted_frame_delay = p2p->_target_frame_delay;
+		}
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_SetTimeSyncMode(Peer2PeerBackend *p2p, GGPOTimeSyncMode mode)
+{
+	p2p->_timesync_mode = mode;
+	p2p->_time_dilation = 1.0f;
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_GetTimeDilation(Peer2PeerBackend *p2p, float *dilation)
+{
+	*dilation = p2p->_time_dilation;
+	return GGPO_OK;
+}
+
+/*
+ * The state saved before a frame is final once the inputs of all the frames before it are
+ * confirmed: the rollbacks of this poll already resimulated it.  Its checksum is sent to the
+ * remote players and compared with theirs as soon as both are known.
+ */
+static void
+p2p_CheckDesync(Peer2PeerBackend *p2p, int confirmed_frame)
+{
+	int interval = p2p->_desync_interval;
+	int last_final_frame = MIN(confirmed_frame + 1, sync_GetFrameCount(&p2p->_sync));
+	for (; p2p->_next_checksum_frame <= last_final_frame; p2p->_next_checksum_frame += interval) {
+		int frame = p2p->_next_checksum_frame;
+		int checksum;
+		if (!sync_GetSavedChecksum(&p2p->_sync, frame, &checksum)) {
+			continue;
+		}
+		p2p_FrameChecksum *local = &p2p->_local_checksums[(frame / interval) % P2P_CHECKSUM_HISTORY];
+		local->frame = frame;
+		local->checksum = checksum;
+		for (int i = 0; i < p2p->_num_players; i++) {
+			if (UdpProtocol_IsRunning(&p2p->_endpoints[i])) {
+				UdpProtocol_SendChecksum(&p2p->_endpoints[i], frame, checksum);
+			}
+		}
+	}
+
+	for (int queue = 0; queue < p2p->_num_players; queue++) {
+		for (int i = 0; i < P2P_CHECKSUM_HISTORY; i++) {
+			p2p_FrameChecksum *remote = &p2p->_remote_checksums[queue][i];
+			p2p_FrameChecksum const *local = &p2p->_local_checksums[i];
+			// the remote one waits for the local one, unless the local slot already moved past it
+			if (remote->frame < 0 || local->frame < remote->frame) {
+				continue;
+			}
+			if (local->frame == remote->frame && local->checksum != remote->checksum && !p2p->_desync_sent[queue]) {
+				Log("desync with queue %d at frame %d (local checksum %08x, remote %08x).\n", queue, local->frame, local->checksum, remote->checksum);
+				GGPOEvent info;
+				info.code = GGPO_EVENTCODE_DESYNC;
+				info.u.desync.player = p2p_QueueToPlayerHandle(p2p, queue);
+				info.u.desync.frame = local->frame;
+				info.u.desync.local_checksum = local->checksum;
+				info.u.desync.remote_checksum = remote->checksum;
+				p2p->_header._callbacks.on_event(&info);
+				p2p->_desync_sent[queue] = true;
+			}
+			remote->frame = -1;
+		}
+	}
+}
+
+GGPOErrorCode
+p2p_SetDesyncDetection(Peer2PeerBackend *p2p, int interval)
+{
+	if (interval < 0) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	p2p->_desync_interval = interval;
+	// both clients check the same frames, the multiples of the interval
+	int frame = sync_GetFrameCount(&p2p->_sync);
+	p2p->_next_checksum_frame = interval > 0 ? (frame + interval - 1) / interval * interval : 0;
+	for (int i = 0; i < P2P_CHECKSUM_HISTORY; i++) {
+		p2p->_local_checksums[i].frame = -1;
+		for (int queue = 0; queue < UDP_MSG_MAX_PLAYERS; queue++) {
+			p2p->_remote_checksums[queue][i].frame = -1;
+		}
+	}
+	return GGPO_OK;
+}
+
 GGPOErrorCode
 p2p_PlayerHandleToQueue(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int* queue)
 {
@@ -32,6 +32,15 @@
 
 struct UdpMsg;
 
+// checksums kept for the comparison with the remote ones, see ggpo_set_desync_detection
+#define P2P_CHECKSUM_HISTORY 32
+
+struct p2p_FrameChecksum {
+   int frame; // -1 if none
+   int checksum;
+};
+typedef struct p2p_FrameChecksum p2p_FrameChecksum;
+
 struct Peer2PeerBackend {
 	GGPOSessionHeader _header;
 
@@ -45,6 +54,24 @@ struct Peer2PeerBackend {
    bool                  _synchronizing;
    int                   _num_players;
    int                   _next_recommended_sleep;
+   GGPOTimeSyncMode      _timesync_mode;
+   float                 _time_dilation;
+
+   // adaptive frame delay, see ggpo_set_adaptive_frame_delay
+   int                   _max_frame_delay; // 0 when disabled
+   int                   _wanted_frame_delay;
+   int                   _target_frame_delay;
+   float                 _rollback_frames;
+   int                   _next_frame_delay_update;
+   GameInput             _last_local_inputs[UDP_MSG_MAX_PLAYERS];
+   int                   _idle_input_frames[UDP_MSG_MAX_PLAYERS];
+
+   // desync detection, checksums of the frames multiple of _desync_interval in slot (frame / interval) % history
+   int                   _desync_interval; // 0 when disabled
+   int                   _next_checksum_frame;
+   p2p_FrameChecksum     _local_checksums[P2P_CHECKSUM_HISTORY];
+   p2p_FrameChecksum     _remote_checksums[UDP_MSG_MAX_PLAYERS][P2P_CHECKSUM_HISTORY];
+   bool                  _desync_sent[UDP_MSG_MAX_PLAYERS];
 
    int                   _next_spectator_frame;
    int                   _disconnect_timeout;
@@ -74,9 +101,18 @@ GGPOErrorCode p2p_SyncInput(Peer2PeerBackend *p2p, void *values, int size, int *
 GGPOErrorCode p2p_IncrementFrame(Peer2PeerBackend *p2p);
 GGPOErrorCode p2p_DisconnectPlayer(Peer2PeerBackend *p2p, GGPOPlayerHandle handle);
 GGPOErrorCode p2p_GetNetworkStats(Peer2PeerBackend *p2p, GGPONetworkStats *stats, GGPOPlayerHandle handle);
+GGPOErrorCode p2p_GetRollbackStats(Peer2PeerBackend *p2p, GGPORollbackStats *stats);
+GGPOErrorCode p2p_WriteRollbackStats(Peer2PeerBackend *p2p, const char *filename, GGPOStatsFormat format);
 GGPOErrorCode p2p_SetFrameDelay(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int delay);
 GGPOErrorCode p2p_SetDisconnectTimeout(Peer2PeerBackend *p2p, int timeout);
 GGPOErrorCode p2p_SetDisconnectNotifyStart(Peer2PeerBackend *p2p, int timeout);
+GGPOErrorCode p2p_StartNetworkThread(Peer2PeerBackend *p2p);
+GGPOErrorCode p2p_SetLinkProfile(Peer2PeerBackend *p2p, const GGPOLinkProfile *profile);
+GGPOErrorCode p2p_SetInputPredictor(Peer2PeerBackend *p2p, const GGPOInputPredictor *predictor);
+GGPOErrorCode p2p_SetTimeSyncMode(Peer2PeerBackend *p2p, GGPOTimeSyncMode mode);
+GGPOErrorCode p2p_SetAdaptiveFrameDelay(Peer2PeerBackend *p2p, int max_frame_delay);
+GGPOErrorCode p2p_GetTimeDilation(Peer2PeerBackend *p2p, float *dilation);
+GGPOErrorCode p2p_SetDesyncDetection(Peer2PeerBackend *p2p, int interval);
 
 GGPOErrorCode p2p_PlayerHandleToQueue(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int *queue);
 inline GGPOPlayerHandle p2p_QueueToPlayerHandle(Peer2PeerBackend *p2p, int queue) { return (GGPOPlayerHandle)(queue + 1); }
@@ -62,7 +62,8 @@ void spec_ctor(SpectatorBackend* spec, GGPOSessionCallbacks* cb,
 	conn_Address peer_addr =  conn_address_from_ip_port(hostip, hostport);
 
 	UdpProtocol_ctor(&spec->_host);
-	UdpProtocol_Init(&spec->_host, &spec->_udp, 0, peer_addr, NULL);
+	// the spectator only sends acks, the host sends the inputs of all the players
+	UdpProtocol_Init(&spec->_host, &spec->_udp, 0, peer_addr, NULL, 0);
 	UdpProtocol_Synchronize(&spec->_host);
 
 	/*
@@ -113,7 +114,8 @@ void spec_ctor_steam(SpectatorBackend* spec, GGPOSessionCallbacks* cb,
 	conn_Address peer_addr = conn_address_from_steam_id(host_steam_id);
 
 	UdpProtocol_ctor(&spec->_host);
-	UdpProtocol_Init(&spec->_host, &spec->_udp, 0, peer_addr, NULL);
+	// the spectator only sends acks, the host sends the inputs of all the players
+	UdpProtocol_Init(&spec->_host, &spec->_udp, 0, peer_addr, NULL, 0);
 	UdpProtocol_Synchronize(&spec->_host);
 
 	/*
@@ -134,7 +136,7 @@ spec_DoPoll(SpectatorBackend* spec, int timeout)
 {
 	udp_OnLoopPoll(&spec->_udp);
 	UdpProtocol_OnLoopPoll(&spec->_host);
-
+	udp_Flush(&spec->_udp);
 
 	spec_PollUdpProtocolEvents(spec);
 	return GGPO_OK;
@@ -247,6 +249,7 @@ spec_OnUdpProtocolEvent(SpectatorBackend* spec, udp_protocol_Event* evt)
 		spec->_inputs[input.frame % SPECTATOR_FRAME_BUFFER_SIZE] = input;
 		break;
 
+	case UdpProtocol_Event_Checksum:
 	case UdpProtocol_Event_Unknown:
 		break;
 	}
@@ -60,9 +60,18 @@ typedef struct SpectatorBackend SpectatorBackend;
    GGPOErrorCode spec_IncrementFrame(SpectatorBackend *spec);
    inline GGPOErrorCode spec_DisconnectPlayer(SpectatorBackend *spec, GGPOPlayerHandle handle) { return GGPO_ERRORCODE_UNSUPPORTED; }
    inline GGPOErrorCode spec_GetNetworkStats(SpectatorBackend *spec, GGPONetworkStats *stats, GGPOPlayerHandle handle) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   inline GGPOErrorCode spec_GetRollbackStats(SpectatorBackend *spec, GGPORollbackStats *stats) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   inline GGPOErrorCode spec_WriteRollbackStats(SpectatorBackend *spec, const char *filename, GGPOStatsFormat format) { return GGPO_ERRORCODE_UNSUPPORTED; }
    inline GGPOErrorCode spec_SetFrameDelay(SpectatorBackend *spec, GGPOPlayerHandle player, int delay) { return GGPO_ERRORCODE_UNSUPPORTED; }
    inline GGPOErrorCode spec_SetDisconnectTimeout(SpectatorBackend *spec, int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
    inline GGPOErrorCode spec_SetDisconnectNotifyStart(SpectatorBackend *spec, int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   inline GGPOErrorCode spec_StartNetworkThread(SpectatorBackend *spec) { return udp_StartThread(&spec->_udp) ? GGPO_OK : GGPO_ERRORCODE_GENERAL_FAILURE; }
+   inline GGPOErrorCode spec_SetInputPredictor(SpectatorBackend *spec, const GGPOInputPredictor *predictor) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   inline GGPOErrorCode spec_SetAdaptiveFrameDelay(SpectatorBackend *spec, int max_frame_delay) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   inline GGPOErrorCode spec_SetTimeSyncMode(SpectatorBackend *spec, GGPOTimeSyncMode mode) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   inline GGPOErrorCode spec_GetTimeDilation(SpectatorBackend *spec, float *dilation) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   inline GGPOErrorCode spec_SetDesyncDetection(SpectatorBackend *spec, int interval) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   inline GGPOErrorCode spec_SetLinkProfile(SpectatorBackend *spec, const GGPOLinkProfile *profile) { udp_SetLinkProfile(&spec->_udp, profile); return GGPO_OK; }
 
    void spec_PollUdpProtocolEvents(SpectatorBackend *spec);
    void spec_CheckInitialSync(SpectatorBackend *spec);
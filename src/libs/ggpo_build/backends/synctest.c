@@ -147,11 +147,17 @@ synctest_IncrementFrame(SyncTestBackend *synctest)
    if (frame - synctest->_last_verified == synctest->_check_distance) {
       // We've gone far enough ahead and should now start replaying frames.
       // Load the last verified frame and set the rollback flag to true.
+      Metrics* metrics = sync_GetMetrics(&synctest->_sync);
+      int depth = frame - synctest->_last_verified;
+      uint64 rollback_start = Platform_GetCurrentTimeUS();
       sync_LoadFrame(&synctest->_sync, synctest->_last_verified);
 
       synctest->_rollingback = true;
+      sync_SetRollingBack(&synctest->_sync, true);
       while(!ring_empty(&synctest->_saved_frames_ring)) {
+         uint64 advance_start = Platform_GetCurrentTimeUS();
          synctest->_header._callbacks.advance_frame(0);
+         metrics_RecordAdvance(metrics, (uint32)(Platform_GetCurrentTimeUS() - advance_start));
 
          // Verify that the checksumn of this frame is the same as the one in our
          // list.
@@ -171,6 +177,9 @@ synctest_IncrementFrame(SyncTestBackend *synctest)
       }
       synctest->_last_verified = frame;
       synctest->_rollingback = false;
+      sync_SetRollingBack(&synctest->_sync, false);
+      // the depth histogram stops at the prediction window, longer check distances land in the last bucket
+      metrics_RecordRollback(metrics, MIN(depth, GGPO_MAX_PREDICTION_FRAMES), (uint32)(Platform_GetCurrentTimeUS() - rollback_start));
    }
 
    return GGPO_OK;
@@ -69,6 +69,8 @@ struct SyncTestBackend {
    GGPOErrorCode synctest_IncrementFrame(SyncTestBackend *synctest);
    inline GGPOErrorCode synctest_DisconnectPlayer(SyncTestBackend *synctest,GGPOPlayerHandle handle) { return GGPO_OK; }
    inline GGPOErrorCode synctest_GetNetworkStats(SyncTestBackend *synctest,GGPONetworkStats* stats, GGPOPlayerHandle handle) { return GGPO_OK; }
+   inline GGPOErrorCode synctest_GetRollbackStats(SyncTestBackend *synctest, GGPORollbackStats *stats) { metrics_GetStats(sync_GetMetrics(&synctest->_sync), stats); return GGPO_OK; }
+   inline GGPOErrorCode synctest_WriteRollbackStats(SyncTestBackend *synctest, const char *filename, GGPOStatsFormat format) { return metrics_Write(sync_GetMetrics(&synctest->_sync), filename, format) ? GGPO_OK : GGPO_ERRORCODE_GENERAL_FAILURE; }
    GGPOErrorCode synctest_Logv(SyncTestBackend *synctest, char const *fmt, va_list list);
 
 
@@ -76,6 +78,13 @@ struct SyncTestBackend {
    	inline GGPOErrorCode synctest_SetFrameDelay(SyncTestBackend *synctest,GGPOPlayerHandle player, int delay) { return GGPO_ERRORCODE_UNSUPPORTED; }
 	inline GGPOErrorCode synctest_SetDisconnectTimeout(SyncTestBackend *synctest,int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
 	inline GGPOErrorCode synctest_SetDisconnectNotifyStart(SyncTestBackend *synctest,int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
+	inline GGPOErrorCode synctest_StartNetworkThread(SyncTestBackend *synctest) { return GGPO_ERRORCODE_UNSUPPORTED; }
+	inline GGPOErrorCode synctest_SetInputPredictor(SyncTestBackend *synctest, const GGPOInputPredictor *predictor) { sync_SetInputPredictor(&synctest->_sync, predictor); return GGPO_OK; }
+	inline GGPOErrorCode synctest_SetLinkProfile(SyncTestBackend *synctest, const GGPOLinkProfile *profile) { return GGPO_ERRORCODE_UNSUPPORTED; }
+	inline GGPOErrorCode synctest_SetAdaptiveFrameDelay(SyncTestBackend *synctest, int max_frame_delay) { return GGPO_ERRORCODE_UNSUPPORTED; }
+	inline GGPOErrorCode synctest_SetTimeSyncMode(SyncTestBackend *synctest, GGPOTimeSyncMode mode) { return GGPO_ERRORCODE_UNSUPPORTED; }
+	inline GGPOErrorCode synctest_GetTimeDilation(SyncTestBackend *synctest, float *dilation) { return GGPO_ERRORCODE_UNSUPPORTED; }
+	inline GGPOErrorCode synctest_SetDesyncDetection(SyncTestBackend *synctest, int interval) { return GGPO_ERRORCODE_UNSUPPORTED; }
    
    void synctest_RaiseSyncError(SyncTestBackend *synctest, const char *fmt, ...);
    void synctest_BeginLog(SyncTestBackend *synctest, int saving);
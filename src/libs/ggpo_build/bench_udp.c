@@ -0,0 +1,141 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+/*
+ * Loopback microbenchmark of the udp transport, Linux only.
+ *
+ * usage: bench_udp [polls] [datagrams]
+ *   Every poll, one socket sends `datagrams` input sized packets to another socket on 127.0.0.1,
+ *   which drains them with udp_OnLoopPoll. Runs with one syscall per datagram, with
+ *   sendmmsg/recvmmsg, and with a receive thread, and reports syscalls and us per poll for both
+ *   sides. With the receive thread, the recv time only covers dispatching the queued datagrams.
+ *
+ * build: gcc -O2 -I. -I.. -Inetwork bench_udp.c -o bench_udp -lpthread -lm
+ */
+#include "types.h"
+#include "log.c"
+#include "platform_linux.c"
+#include "network/connection.c"
+#include "network/link_emulator.c"
+#include "network/udp.c"
+
+#if !defined(CONN_BATCHED_IO)
+#error bench_udp needs CONN_BATCHED_IO
+#endif
+
+#define BENCH_UDP_PORT 7000
+#define BENCH_UDP_PACKET_SIZE 48 // an input message with a few frames of pending inputs
+
+static uint64 bench_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000ull + (uint64)ts.tv_nsec;
+}
+
+static void bench_on_msg(conn_Address from, UdpMsg* msg, int len, void* user_data)
+{
+	(void)from;
+	(void)msg;
+	*(int*)user_data += len == BENCH_UDP_PACKET_SIZE;
+}
+
+enum BenchUdpMode
+{
+	BENCH_UDP_SINGLE,
+	BENCH_UDP_BATCHED,
+	BENCH_UDP_THREAD,
+};
+
+static int bench_run(enum BenchUdpMode mode, int polls, int datagrams, uint16 port)
+{
+	static const char* mode_names[] = { "single", "batched", "thread" };
+	static Udp sender;
+	static Udp receiver;
+	int received = 0;
+	udp_ctor(&sender);
+	udp_ctor(&receiver);
+	udp_Init(&sender, port, bench_on_msg, &received);
+	udp_Init(&receiver, port + 1, bench_on_msg, &received);
+	if (!sender._socket || !receiver._socket) {
+		printf("could not bind ports %d and %d\n", port, port + 1);
+		return 1;
+	}
+	sender._batch_io = mode == BENCH_UDP_BATCHED;
+	receiver._batch_io = mode == BENCH_UDP_BATCHED;
+	conn_Address receiver_address = conn_address_from_ip_port("127.0.0.1", port + 1);
+	// after creating the addresses, the thread adds the sender address to the same pool
+	if (mode == BENCH_UDP_THREAD && !udp_StartThread(&receiver)) {
+		printf("could not start the receive thread\n");
+		return 1;
+	}
+
+	char packet[BENCH_UDP_PACKET_SIZE] = { 0 };
+	uint64 send_ns = 0;
+	uint64 recv_ns = 0;
+	int lost = 0;
+	for (int ipoll = 0; ipoll < polls; ++ipoll) {
+		received = 0;
+
+		uint64 t0 = bench_now_ns();
+		for (int i = 0; i < datagrams; ++i) {
+			packet[0] = (char)i;
+			udp_SendTo(&sender, packet, BENCH_UDP_PACKET_SIZE, 0, receiver_address);
+		}
+		udp_Flush(&sender);
+		uint64 t1 = bench_now_ns();
+		if (mode == BENCH_UDP_THREAD) {
+			// let the thread receive everything, the game thread only dispatches
+			for (int wait = 0; wait < 1000 && Platform_AtomicLoad(&receiver._recv_ring._head) - receiver._recv_ring._tail < (uint32)datagrams; ++wait) {
+				Platform_SleepMS(0);
+			}
+			t1 = bench_now_ns();
+		}
+		udp_OnLoopPoll(&receiver);
+		uint64 t2 = bench_now_ns();
+
+		send_ns += t1 - t0;
+		recv_ns += t2 - t1;
+		lost += datagrams - received;
+	}
+	udp_StopThread(&receiver);
+
+	printf("  %-8s send %6.2f syscalls %7.2f us/poll, recv %6.2f syscalls %7.2f us/poll, %d lost\n",
+		mode_names[mode],
+		(double)sender._send_calls / polls, (double)send_ns / polls / 1000.0,
+		(double)Platform_AtomicLoad(&receiver._recv_calls) / polls, (double)recv_ns / polls / 1000.0,
+		lost);
+
+	udp_dtor(&sender);
+	udp_dtor(&receiver);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int polls = argc > 1 ? atoi(argv[1]) : 20000;
+	int datagrams = argc > 2 ? atoi(argv[2]) : 8;
+	if (polls <= 0 || datagrams <= 0) {
+		printf("usage: bench_udp [polls] [datagrams]\n");
+		return 1;
+	}
+
+	printf("udp loopback: %d polls, %d datagrams of %d bytes per poll\n", polls, datagrams, BENCH_UDP_PACKET_SIZE);
+	int result = bench_run(BENCH_UDP_SINGLE, polls, datagrams, BENCH_UDP_PORT);
+	result |= bench_run(BENCH_UDP_BATCHED, polls, datagrams, BENCH_UDP_PORT + 2);
+	result |= bench_run(BENCH_UDP_THREAD, polls, datagrams, BENCH_UDP_PORT + 4);
+	return result;
+}
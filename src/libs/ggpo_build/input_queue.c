@@ -39,6 +39,7 @@ input_queue_Init(InputQueue* queue, int id, int input_size)
    queue->_first_incorrect_frame = GAMEINPUT_NULL_FRAME;
    queue->_last_frame_requested = GAMEINPUT_NULL_FRAME;
    queue->_last_added_frame = GAMEINPUT_NULL_FRAME;
+   queue->_predictor = NULL;
 
    gameinput_init(&queue->_prediction, GAMEINPUT_NULL_FRAME, NULL, input_size);
 
@@ -179,10 +180,21 @@ input_queue_GetInput(InputQueue* queue, int requested_frame, GameInput *input)
    /*
     * If we've made it this far, we must be predicting.  Go ahead and
     * forward the prediction frame contents.  Be sure to return the
-    * frame number requested by the client, though.
+    * frame number requested by the client, though.  The predictor
+    * sees the latest confirmed input, which may be newer than the one
+    * the prediction started from.  Remember what we returned, it is
+    * what the confirmed input will be compared with.
     */
-   *input = queue->_prediction;
-   input->frame = requested_frame;
+   GameInput *prediction = &queue->_predictions[requested_frame % INPUT_QUEUE_LENGTH];
+   *prediction = queue->_prediction;
+   prediction->frame = requested_frame;
+   if (queue->_predictor) {
+      GameInput const *last = queue->_last_added_frame == GAMEINPUT_NULL_FRAME ? NULL : &queue->_inputs[PREVIOUS_FRAME(queue->_head)];
+      queue->_predictor->predict(queue->_predictor->user_data, queue->_id,
+                                 last ? last->bits : NULL, queue->_last_added_frame,
+                                 requested_frame, prediction->bits, prediction->size);
+   }
+   *input = *prediction;
    Log("returning prediction frame number %d (%d).\n", input->frame, queue->_prediction.frame);
 
    return false;
@@ -241,6 +253,10 @@ input_queue_AddDelayedInputToQueue(InputQueue* queue, GameInput *input, int fram
 
    queue->_last_added_frame = frame_number;
 
+   if (queue->_predictor && queue->_predictor->observe) {
+      queue->_predictor->observe(queue->_predictor->user_data, queue->_id, input->bits, input->size, frame_number);
+   }
+
    if (queue->_prediction.frame != GAMEINPUT_NULL_FRAME) {
       ASSERT(frame_number == queue->_prediction.frame);
 
@@ -250,9 +266,13 @@ input_queue_AddDelayedInputToQueue(InputQueue* queue, GameInput *input, int fram
        * remember the first input which was incorrect so we can report it
        * in GetFirstIncorrectFrame()
        */
-      if (queue->_first_incorrect_frame == GAMEINPUT_NULL_FRAME && !gameinput_equal(&queue->_prediction, input, true)) {
-         Log("frame %d does not match prediction.  marking error.\n", frame_number);
-         queue->_first_incorrect_frame = frame_number;
+      GameInput const *prediction = &queue->_predictions[frame_number % INPUT_QUEUE_LENGTH];
+      if (queue->_first_incorrect_frame == GAMEINPUT_NULL_FRAME) {
+         ASSERT(prediction->frame == frame_number);
+         if (!gameinput_equal(prediction, input, true)) {
+            Log("frame %d does not match prediction.  marking error.\n", frame_number);
+            queue->_first_incorrect_frame = frame_number;
+         }
       }
 
       /*
@@ -24,6 +24,7 @@
 #ifndef _INPUT_QUEUE_H
 #define _INPUT_QUEUE_H
 
+#include "ggponet.h"
 #include "game_input.h"
 
 #define INPUT_QUEUE_LENGTH    128
@@ -46,6 +47,9 @@ struct InputQueue
 
 	GameInput            _inputs[INPUT_QUEUE_LENGTH];
 	GameInput            _prediction;
+	GameInput            _predictions[INPUT_QUEUE_LENGTH]; // the input returned for each predicted frame
+
+	GGPOInputPredictor const* _predictor; // NULL to repeat the last confirmed input
 };
 typedef struct InputQueue InputQueue;
 
@@ -54,6 +58,8 @@ int input_queue_GetLastConfirmedFrame(InputQueue* queue);
 int input_queue_GetFirstIncorrectFrame(InputQueue* queue);
 inline int input_queue_GetLength(InputQueue* queue) { return queue->_length; }
 inline void input_queue_SetFrameDelay(InputQueue* queue, int delay) { queue->_frame_delay = delay; }
+inline int input_queue_GetFrameDelay(InputQueue* queue) { return queue->_frame_delay; }
+inline void input_queue_SetPredictor(InputQueue* queue, GGPOInputPredictor const* predictor) { queue->_predictor = predictor; }
 void input_queue_ResetPrediction(InputQueue* queue, int frame);
 void input_queue_DiscardConfirmedFrames(InputQueue* queue, int frame);
 bool input_queue_GetConfirmedInput(InputQueue* queue, int frame, GameInput* input);
@@ -4,6 +4,7 @@
 #include "game_input.c"
 #include "input_queue.c"
 #include "log.c"
+#include "metrics.c"
 #include "main.c"
 #include "platform_windows.c"
 #include "sync.c"
@@ -13,5 +14,6 @@
 #include "backends/synctest.c"
 //#include "network/connection.c"
 #include "network/connection_steam.c"
+#include "network/link_emulator.c"
 #include "network/udp.c"
 #include "network/udp_proto.c"
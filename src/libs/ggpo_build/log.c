@@ -17,6 +17,13 @@ void LogFlush()
 }
 
 static char logbuf[4 * 1024 * 1024];
+// the log file and logbuf are not locked, only the game thread writes them
+static PLATFORM_THREAD_LOCAL bool log_thread_disabled = false;
+
+void LogDisableThisThread()
+{
+   log_thread_disabled = true;
+}
 
 void Log(const char *fmt, ...)
 {
@@ -28,9 +35,14 @@ void Log(const char *fmt, ...)
 
 void Logv(const char *fmt, va_list args)
 {
+    if (log_thread_disabled) {
+       return;
+    }
     char logbuf2[256] = { 0 };
     vsnprintf(logbuf2, 256, fmt, args);
+#if defined(_WINDOWS)
     OutputDebugStringA(logbuf2);
+#endif
 
    if (!Platform_GetConfigBool("ggpo.log") || Platform_GetConfigBool("ggpo.log.ignore")) {
       return;
@@ -12,6 +12,7 @@ extern void Log(const char *fmt, ...);
 extern void Logv(const char *fmt, va_list list);
 extern void LogvFile(FILE *fp, const char *fmt, va_list args);
 extern void LogFlush();
+extern void LogDisableThisThread();
 extern void LogFlushOnLog(bool flush);
 
 #endif
@@ -68,6 +68,7 @@ ggpo_start_session(GGPOSession **session,
                    int input_size,
                    int local_channel)
 {
+    Platform_Init();
     void* p2p = calloc(sizeof(Peer2PeerBackend), 1);
     p2p_ctor_steam((Peer2PeerBackend*)p2p, cb,
         game,
@@ -86,6 +87,7 @@ ggpo_start_session(GGPOSession **session,
                    int input_size,
                    unsigned short localport)
 {
+    Platform_Init();
     void* p2p = calloc(sizeof(Peer2PeerBackend), 1);
     p2p_ctor((Peer2PeerBackend*)p2p, cb,
         game,
@@ -125,6 +127,7 @@ ggpo_start_synctest(GGPOSession **ggpo,
                     int input_size,
                     int frames)
 {
+	Platform_Init();
 	void* synctest = calloc(sizeof(SyncTestBackend), 1);
 	synctest_ctor((SyncTestBackend*)synctest, cb, game, frames, num_players);
 	*ggpo = (GGPOSession*)synctest;
@@ -253,6 +256,41 @@ ggpo_get_network_stats(GGPOSession *ggpo,
    return GGPO_ERRORCODE_INVALID_SESSION;
 }
 
+GGPOErrorCode
+ggpo_get_rollback_stats(GGPOSession *ggpo,
+                        GGPORollbackStats *stats)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_GetRollbackStats((Peer2PeerBackend*)ggpo, stats);
+   case SESSION_SPECTATOR: return spec_GetRollbackStats((SpectatorBackend*)ggpo, stats);
+   case SESSION_SYNCTEST: return synctest_GetRollbackStats((SyncTestBackend*)ggpo, stats);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_write_rollback_stats(GGPOSession *ggpo,
+                          const char *filename,
+                          GGPOStatsFormat format)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_WriteRollbackStats((Peer2PeerBackend*)ggpo, filename, format);
+   case SESSION_SPECTATOR: return spec_WriteRollbackStats((SpectatorBackend*)ggpo, filename, format);
+   case SESSION_SYNCTEST: return synctest_WriteRollbackStats((SyncTestBackend*)ggpo, filename, format);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
 
 GGPOErrorCode
 ggpo_close_session(GGPOSession *ggpo)
@@ -302,6 +340,118 @@ ggpo_set_disconnect_notify_start(GGPOSession *ggpo, int timeout)
    return GGPO_ERRORCODE_INVALID_SESSION;
 }
 
+GGPOErrorCode
+ggpo_start_network_thread(GGPOSession *ggpo)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_StartNetworkThread((Peer2PeerBackend*)ggpo);
+   case SESSION_SPECTATOR: return spec_StartNetworkThread((SpectatorBackend*)ggpo);
+   case SESSION_SYNCTEST: return synctest_StartNetworkThread((SyncTestBackend*)ggpo);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_link_profile(GGPOSession *ggpo, const GGPOLinkProfile *profile)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetLinkProfile((Peer2PeerBackend*)ggpo, profile);
+   case SESSION_SPECTATOR: return spec_SetLinkProfile((SpectatorBackend*)ggpo, profile);
+   case SESSION_SYNCTEST: return synctest_SetLinkProfile((SyncTestBackend*)ggpo, profile);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_input_predictor(GGPOSession *ggpo, const GGPOInputPredictor *predictor)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetInputPredictor((Peer2PeerBackend*)ggpo, predictor);
+   case SESSION_SPECTATOR: return spec_SetInputPredictor((SpectatorBackend*)ggpo, predictor);
+   case SESSION_SYNCTEST: return synctest_SetInputPredictor((SyncTestBackend*)ggpo, predictor);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_adaptive_frame_delay(GGPOSession *ggpo, int max_frame_delay)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetAdaptiveFrameDelay((Peer2PeerBackend*)ggpo, max_frame_delay);
+   case SESSION_SPECTATOR: return spec_SetAdaptiveFrameDelay((SpectatorBackend*)ggpo, max_frame_delay);
+   case SESSION_SYNCTEST: return synctest_SetAdaptiveFrameDelay((SyncTestBackend*)ggpo, max_frame_delay);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_timesync_mode(GGPOSession *ggpo, GGPOTimeSyncMode mode)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetTimeSyncMode((Peer2PeerBackend*)ggpo, mode);
+   case SESSION_SPECTATOR: return spec_SetTimeSyncMode((SpectatorBackend*)ggpo, mode);
+   case SESSION_SYNCTEST: return synctest_SetTimeSyncMode((SyncTestBackend*)ggpo, mode);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_get_time_dilation(GGPOSession *ggpo, float *dilation)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_GetTimeDilation((Peer2PeerBackend*)ggpo, dilation);
+   case SESSION_SPECTATOR: return spec_GetTimeDilation((SpectatorBackend*)ggpo, dilation);
+   case SESSION_SYNCTEST: return synctest_GetTimeDilation((SyncTestBackend*)ggpo, dilation);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_desync_detection(GGPOSession *ggpo, int interval)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetDesyncDetection((Peer2PeerBackend*)ggpo, interval);
+   case SESSION_SPECTATOR: return spec_SetDesyncDetection((SpectatorBackend*)ggpo, interval);
+   case SESSION_SYNCTEST: return synctest_SetDesyncDetection((SyncTestBackend*)ggpo, interval);
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
 #if defined(GGPO_STEAM)
 GGPOErrorCode ggpo_start_spectating(GGPOSession **session,
                                     GGPOSessionCallbacks *cb,
@@ -311,6 +461,7 @@ GGPOErrorCode ggpo_start_spectating(GGPOSession **session,
                                     int local_channel,
                                     uint64_t host_steam_id)
 {
+    Platform_Init();
     void* spec = calloc(sizeof(SpectatorBackend), 1);
     spec_ctor_steam((SpectatorBackend*)spec, cb,
                     game,
@@ -331,6 +482,7 @@ GGPOErrorCode ggpo_start_spectating(GGPOSession **session,
                                     char *host_ip,
                                     unsigned short host_port)
 {
+    Platform_Init();
     void* spec = calloc(sizeof(SpectatorBackend), 1);
     spec_ctor((SpectatorBackend*)spec, cb,
                                                   game,
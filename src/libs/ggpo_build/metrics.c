@@ -0,0 +1,206 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+#include "metrics.h"
+
+static void metrics_AddTiming(metrics_Timing* timing, uint32 us)
+{
+	timing->total_us += us;
+	timing->count++;
+	timing->last_us = us;
+	timing->max_us = MAX(timing->max_us, us);
+}
+
+static void metrics_GetTiming(metrics_Timing const* timing, GGPOTimingStats* stats)
+{
+	stats->count = timing->count;
+	stats->avg_us = timing->count ? (float)((double)timing->total_us / timing->count) : 0.0f;
+	stats->last_us = (int)timing->last_us;
+	stats->max_us = (int)timing->max_us;
+}
+
+static void metrics_UpdateWindow(Metrics* metrics)
+{
+	uint64 now = Platform_GetCurrentTimeUS();
+	uint64 elapsed = now - metrics->_window_start_us;
+	if (elapsed >= 1000000) {
+		metrics->_resimulated_frames_per_second = (float)((double)metrics->_window_frames * 1000000.0 / (double)elapsed);
+		metrics->_window_start_us = now;
+		metrics->_window_frames = 0;
+	}
+}
+
+void metrics_Init(Metrics* metrics)
+{
+	memset(metrics, 0, sizeof(Metrics));
+	for (int i = 0; i < GGPO_STATS_HISTORY_FRAMES; ++i) {
+		metrics->_history[i].frame = -1;
+	}
+	metrics->_window_start_us = Platform_GetCurrentTimeUS();
+	metrics_BeginFrame(metrics, 0);
+}
+
+void metrics_BeginFrame(Metrics* metrics, int frame)
+{
+	metrics_FrameSample* sample = &metrics->_history[frame % GGPO_STATS_HISTORY_FRAMES];
+	memset(sample, 0, sizeof(metrics_FrameSample));
+	sample->frame = frame;
+	metrics->_current = sample;
+	metrics_UpdateWindow(metrics);
+}
+
+void metrics_RecordSave(Metrics* metrics, uint32 us)
+{
+	metrics_AddTiming(&metrics->_save, us);
+	metrics->_current->save_us += us;
+}
+
+void metrics_RecordLoad(Metrics* metrics, uint32 us)
+{
+	metrics_AddTiming(&metrics->_load, us);
+	metrics->_current->load_us += us;
+}
+
+void metrics_RecordAdvance(Metrics* metrics, uint32 us)
+{
+	metrics_AddTiming(&metrics->_advance, us);
+	metrics->_current->resim_us += us;
+}
+
+void metrics_RecordRollback(Metrics* metrics, int depth, uint32 us)
+{
+	ASSERT(depth >= 0 && depth <= GGPO_MAX_PREDICTION_FRAMES);
+	metrics->_rollbacks++;
+	metrics->_resimulated_frames += depth;
+	metrics->_rollback_depth[depth]++;
+	metrics_AddTiming(&metrics->_rollback, us);
+	if (us > GGPO_FRAME_BUDGET_US) {
+		metrics->_rollbacks_over_budget++;
+	}
+	metrics->_current->rollback_depth = (uint16)MAX(metrics->_current->rollback_depth, depth);
+	metrics->_window_frames += depth;
+	metrics_UpdateWindow(metrics);
+}
+
+void metrics_RecordStall(Metrics* metrics)
+{
+	metrics->_prediction_stalls++;
+	metrics->_current->prediction_stalls++;
+}
+
+void metrics_RecordTimeSync(Metrics* metrics, int frames)
+{
+	metrics->_timesync_events++;
+	metrics->_timesync_frames += frames;
+}
+
+void metrics_GetStats(Metrics const* metrics, GGPORollbackStats* stats)
+{
+	memset(stats, 0, sizeof(GGPORollbackStats));
+	stats->rollbacks = metrics->_rollbacks;
+	stats->resimulated_frames = metrics->_resimulated_frames;
+	stats->resimulated_frames_per_second = metrics->_resimulated_frames_per_second;
+	for (int i = 0; i <= GGPO_MAX_PREDICTION_FRAMES; ++i) {
+		stats->rollback_depth[i] = metrics->_rollback_depth[i];
+		if (metrics->_rollback_depth[i]) {
+			stats->max_rollback_depth = i;
+		}
+	}
+	metrics_GetTiming(&metrics->_save, &stats->save);
+	metrics_GetTiming(&metrics->_load, &stats->load);
+	metrics_GetTiming(&metrics->_advance, &stats->advance);
+	metrics_GetTiming(&metrics->_rollback, &stats->rollback);
+	stats->rollbacks_over_budget = metrics->_rollbacks_over_budget;
+	for (int i = 0; i < GGPO_MAX_PLAYERS; ++i) {
+		stats->prediction_misses[i] = metrics->_prediction_misses[i];
+	}
+	stats->prediction_stalls = metrics->_prediction_stalls;
+	stats->timesync_events = metrics->_timesync_events;
+	stats->timesync_frames = metrics->_timesync_frames;
+}
+
+static void metrics_WriteTiming(FILE* fp, const char* name, GGPOTimingStats const* timing)
+{
+	fprintf(fp, "  \"%s\": { \"count\": %d, \"avg_us\": %.1f, \"last_us\": %d, \"max_us\": %d },\n",
+		name, timing->count, timing->avg_us, timing->last_us, timing->max_us);
+}
+
+bool metrics_Write(Metrics const* metrics, const char* filename, GGPOStatsFormat format)
+{
+	FILE* fp = fopen(filename, "w");
+	if (!fp) {
+		return false;
+	}
+
+	// the samples are written oldest first
+	int last_frame = metrics->_current->frame;
+	int first_frame = MAX(0, last_frame - GGPO_STATS_HISTORY_FRAMES + 1);
+
+	if (format == GGPO_STATS_FORMAT_CSV) {
+		fprintf(fp, "frame,rollback_depth,save_us,load_us,resim_us,prediction_stalls\n");
+		for (int frame = first_frame; frame <= last_frame; ++frame) {
+			metrics_FrameSample const* sample = &metrics->_history[frame % GGPO_STATS_HISTORY_FRAMES];
+			if (sample->frame != frame) {
+				continue;
+			}
+			fprintf(fp, "%d,%u,%u,%u,%u,%u\n", sample->frame, sample->rollback_depth,
+				sample->save_us, sample->load_us, sample->resim_us, sample->prediction_stalls);
+		}
+	}
+	else {
+		GGPORollbackStats stats;
+		metrics_GetStats(metrics, &stats);
+		fprintf(fp, "{\n");
+		fprintf(fp, "  \"rollbacks\": %d,\n", stats.rollbacks);
+		fprintf(fp, "  \"resimulated_frames\": %d,\n", stats.resimulated_frames);
+		fprintf(fp, "  \"resimulated_frames_per_second\": %.1f,\n", stats.resimulated_frames_per_second);
+		fprintf(fp, "  \"rollback_depth\": [");
+		for (int i = 0; i <= GGPO_MAX_PREDICTION_FRAMES; ++i) {
+			fprintf(fp, i ? ", %d" : "%d", stats.rollback_depth[i]);
+		}
+		fprintf(fp, "],\n");
+		fprintf(fp, "  \"max_rollback_depth\": %d,\n", stats.max_rollback_depth);
+		metrics_WriteTiming(fp, "save", &stats.save);
+		metrics_WriteTiming(fp, "load", &stats.load);
+		metrics_WriteTiming(fp, "advance", &stats.advance);
+		metrics_WriteTiming(fp, "rollback", &stats.rollback);
+		fprintf(fp, "  \"rollbacks_over_budget\": %d,\n", stats.rollbacks_over_budget);
+		fprintf(fp, "  \"prediction_misses\": [");
+		for (int i = 0; i < GGPO_MAX_PLAYERS; ++i) {
+			fprintf(fp, i ? ", %d" : "%d", stats.prediction_misses[i]);
+		}
+		fprintf(fp, "],\n");
+		fprintf(fp, "  \"prediction_stalls\": %d,\n", stats.prediction_stalls);
+		fprintf(fp, "  \"timesync_events\": %d,\n", stats.timesync_events);
+		fprintf(fp, "  \"timesync_frames\": %d,\n", stats.timesync_frames);
+		fprintf(fp, "  \"frames\": [\n");
+		bool first = true;
+		for (int frame = first_frame; frame <= last_frame; ++frame) {
+			metrics_FrameSample const* sample = &metrics->_history[frame % GGPO_STATS_HISTORY_FRAMES];
+			if (sample->frame != frame) {
+				continue;
+			}
+			fprintf(fp, "%s    { \"frame\": %d, \"rollback_depth\": %u, \"save_us\": %u, \"load_us\": %u, \"resim_us\": %u, \"prediction_stalls\": %u }",
+				first ? "" : ",\n", sample->frame, sample->rollback_depth,
+				sample->save_us, sample->load_us, sample->resim_us, sample->prediction_stalls);
+			first = false;
+		}
+		fprintf(fp, "\n  ]\n}\n");
+	}
+
+	fclose(fp);
+	return true;
+}
@@ -0,0 +1,84 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include "types.h"
+#include "ggponet.h"
+
+/*
+ * Rollback metrics of a Sync, see GGPORollbackStats.
+ *
+ * Besides the totals, the last GGPO_STATS_HISTORY_FRAMES frames reached by the game have a sample.
+ * Everything that happens while the game is on a frame (the rollbacks and their timings, the
+ * stalls) is added to the sample of that frame, resimulated frames do not get their own sample.
+ */
+struct metrics_Timing {
+   uint64         total_us;
+   int            count;
+   uint32         last_us;
+   uint32         max_us;
+};
+typedef struct metrics_Timing metrics_Timing;
+
+struct metrics_FrameSample {
+   int            frame; // -1 for an unused sample
+   uint16         rollback_depth;
+   uint16         prediction_stalls;
+   uint32         save_us;
+   uint32         load_us;
+   uint32         resim_us;
+};
+typedef struct metrics_FrameSample metrics_FrameSample;
+
+struct Metrics {
+   int                  _rollbacks;
+   int                  _resimulated_frames;
+   int                  _rollback_depth[GGPO_MAX_PREDICTION_FRAMES + 1];
+   metrics_Timing       _save;
+   metrics_Timing       _load;
+   metrics_Timing       _advance;
+   metrics_Timing       _rollback;
+   int                  _rollbacks_over_budget;
+   int                  _prediction_misses[GGPO_MAX_PLAYERS];
+   int                  _prediction_stalls;
+   int                  _timesync_events;
+   int                  _timesync_frames;
+
+   // resimulated frames per second, measured over windows of one second
+   uint64               _window_start_us;
+   int                  _window_frames;
+   float                _resimulated_frames_per_second;
+
+   metrics_FrameSample* _current;
+   metrics_FrameSample  _history[GGPO_STATS_HISTORY_FRAMES];
+};
+typedef struct Metrics Metrics;
+
+void metrics_Init(Metrics* metrics);
+void metrics_BeginFrame(Metrics* metrics, int frame);
+void metrics_RecordSave(Metrics* metrics, uint32 us);
+void metrics_RecordLoad(Metrics* metrics, uint32 us);
+void metrics_RecordAdvance(Metrics* metrics, uint32 us);
+void metrics_RecordRollback(Metrics* metrics, int depth, uint32 us);
+inline void metrics_RecordPredictionMiss(Metrics* metrics, int queue) { metrics->_prediction_misses[queue]++; }
+void metrics_RecordStall(Metrics* metrics);
+void metrics_RecordTimeSync(Metrics* metrics, int frames);
+void metrics_GetStats(Metrics const* metrics, GGPORollbackStats* stats);
+bool metrics_Write(Metrics const* metrics, const char* filename, GGPOStatsFormat format);
+
+#endif
@@ -0,0 +1,485 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+/*
+ * Headless rollback test over an emulated network, Linux only.
+ *
+ * usage: netsim [frames] [profile] [skip|dilate] [max_frame_delay] [desync] [stall]
+ *   Runs two p2p sessions on 127.0.0.1 in the same process, each one sending through a
+ *   ggpo_set_link_profile emulated link, for `frames` frames at 60Hz. The game state is a hash of
+ *   the inputs, the inputs are scripted and change every few frames so the predictions miss.
+ *   Reports the rollbacks, the frames rolled back and the prediction stalls of each peer, the
+ *   rollback stats reported by ggpo_get_rollback_stats, the link stats, and checks that both
+ *   peers computed the same confirmed frames.
+ *   Without a profile, runs all of them: ideal, lan, wifi, dsl, bad.
+ *   With a time sync mode, p2 starts NETSIM_LATE_START_FRAMES late and the peers run with that
+ *   ggpo_set_timesync_mode, skipping the GGPO_EVENTCODE_TIMESYNC frames or scaling their frame
+ *   period by ggpo_get_time_dilation. Reports the frames skipped, the dilation range and the
+ *   average frame difference between the peers over the last second.
+ *   With a max frame delay, the peers use ggpo_set_adaptive_frame_delay and report the frame delay
+ *   they ended with and the round trip time it was chosen from.
+ *   The peers always exchange their checksums with ggpo_set_desync_detection and fail on a
+ *   GGPO_EVENTCODE_DESYNC. With desync, p2 alters its state in the middle of the run instead, and
+ *   both peers have to report the first checked frame after it, or a later one if the link lost
+ *   that checksum.
+ *   With stall, p2 stops ticking for NETSIM_STALL_TICKS every NETSIM_STALL_PERIOD frames, p1 reaches
+ *   the prediction barrier and retries another input than its last queued one until it is accepted,
+ *   like a player pressing a button during the freeze. p1 also drops its frame delay to 0 when it
+ *   starts stalling, so with a max frame delay the adaptive delay steps back up while the input is
+ *   rejected and the accepted one is padded.
+ *   Also reports the bandwidth each peer sent, and what the same messages would have taken with
+ *   the fixed layout of the protocol version 2.
+ *
+ * build: gcc -O2 -I. -I.. -Inetwork -Ibackends netsim.c -o netsim -lpthread -lm
+ */
+#include "types.h"
+#include "bitvector.c"
+#include "game_input.c"
+#include "input_queue.c"
+#include "log.c"
+#include "metrics.c"
+#include "main.c"
+#include "platform_linux.c"
+#include "sync.c"
+#include "timesync.c"
+#include "backends/p2p.c"
+#include "backends/spectator.c"
+#include "backends/synctest.c"
+#include "network/connection.c"
+#include "network/link_emulator.c"
+#include "network/udp.c"
+#include "network/udp_proto.c"
+
+#define NETSIM_PORT 7200
+#define NETSIM_FRAME_MS (1000.0 / 60.0)
+#define NETSIM_INPUT_PERIOD 6 // frames between two input changes
+#define NETSIM_SYNC_TIMEOUT_MS 5000
+#define NETSIM_LATE_START_FRAMES 8
+#define NETSIM_DESYNC_INTERVAL 60 // frames between the checksums of ggpo_set_desync_detection
+#define NETSIM_STALL_PERIOD 90 // frames between two freezes of p2 with stall
+#define NETSIM_STALL_TICKS 20
+#define NETSIM_STALL_INPUT 0x100 // added to the input retried while stalled, the scripted ones are 8 bits
+
+struct NetSimProfile {
+	const char* name;
+	GGPOLinkProfile link;
+};
+
+// latency, jitter, distribution, loss good/bad, good to bad, bad to good, duplicate, reorder, reorder ms, kbps, seed
+static const struct NetSimProfile netsim_profiles[] = {
+	{ "ideal", { 0, 0, GGPO_LINK_JITTER_UNIFORM, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0, 0, 1 } },
+	{ "lan", { 1, 1, GGPO_LINK_JITTER_UNIFORM, 0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 0, 0, 1 } },
+	{ "wifi", { 8, 6, GGPO_LINK_JITTER_EXPONENTIAL, 0.005f, 0.3f, 0.02f, 0.3f, 0.005f, 0.01f, 10, 0, 1 } },
+	{ "dsl", { 35, 4, GGPO_LINK_JITTER_NORMAL, 0.005f, 0.f, 0.f, 0.f, 0.f, 0.f, 0, 256, 1 } },
+	{ "bad", { 70, 15, GGPO_LINK_JITTER_NORMAL, 0.02f, 0.5f, 0.05f, 0.25f, 0.01f, 0.05f, 30, 128, 1 } },
+};
+
+struct NetSimState {
+	int frame;
+	uint32 hash;
+};
+
+struct NetSimPeer {
+	GGPOSession* session;
+	GGPOPlayerHandle local_handle;
+	GGPOPlayerHandle remote_handle;
+	int player_num;
+	bool running;
+	int skip_frames;
+	double next_tick; // ms since the start
+	float dilation;
+	struct NetSimState state;
+	uint32* frame_hashes; // hash after each frame, overwritten by the rollbacks
+	int altered_frame; // the state is altered after this frame, -1 if never
+	int desync_frame; // from GGPO_EVENTCODE_DESYNC, -1 if none
+	int frozen_ticks; // ticks left without simulating with stall
+	bool stalled; // the last input was rejected
+	// metrics
+	int ticks;
+	int stalls;
+	int rollbacks;
+	int frames_rolled_back;
+	int max_rollback;
+	int skipped_frames;
+	float min_dilation;
+	float max_dilation;
+};
+
+static struct NetSimPeer* g_peer; // the ggpo callbacks do not have a user data
+
+static uint32 netsim_hash(uint32 x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+static uint32 netsim_scripted_input(int player_num, int frame)
+{
+	return netsim_hash((uint32)player_num * 0x9E3779B9u + (uint32)(frame / NETSIM_INPUT_PERIOD)) & 0xFF;
+}
+
+static void netsim_step(struct NetSimPeer* peer, uint32 inputs[2])
+{
+	peer->state.hash = netsim_hash(peer->state.hash ^ inputs[0] ^ (inputs[1] << 8));
+	if (peer->state.frame == peer->altered_frame) {
+		peer->state.hash ^= 1;
+	}
+	peer->frame_hashes[peer->state.frame] = peer->state.hash;
+	peer->state.frame++;
+}
+
+static bool netsim_begin_game(const char* game) { return true; }
+static bool netsim_log_game_state(char* filename, unsigned char* buffer, int len) { return true; }
+static void netsim_free_buffer(void* buffer) { free(buffer); }
+
+static bool netsim_save_game_state(unsigned char** buffer, int* len, int* checksum, int frame)
+{
+	*len = sizeof(struct NetSimState);
+	*buffer = (unsigned char*)malloc(*len);
+	memcpy(*buffer, &g_peer->state, *len);
+	*checksum = (int)g_peer->state.hash;
+	return true;
+}
+
+static bool netsim_load_game_state(unsigned char* buffer, int len)
+{
+	struct NetSimState const* state = (struct NetSimState const*)buffer;
+	int rolled_back = g_peer->state.frame - state->frame;
+	g_peer->rollbacks++;
+	g_peer->frames_rolled_back += rolled_back;
+	g_peer->max_rollback = MAX(g_peer->max_rollback, rolled_back);
+	g_peer->state = *state;
+	return true;
+}
+
+static bool netsim_advance_frame(int flags)
+{
+	uint32 inputs[2] = { 0 };
+	int disconnect_flags = 0;
+	ggpo_synchronize_input(g_peer->session, inputs, sizeof(inputs), &disconnect_flags);
+	netsim_step(g_peer, inputs);
+	ggpo_advance_frame(g_peer->session);
+	return true;
+}
+
+static bool netsim_on_event(GGPOEvent* info)
+{
+	switch (info->code) {
+	case GGPO_EVENTCODE_RUNNING:
+		g_peer->running = true;
+		break;
+	case GGPO_EVENTCODE_TIMESYNC:
+		g_peer->skip_frames += info->u.timesync.frames_ahead;
+		break;
+	case GGPO_EVENTCODE_DESYNC:
+		g_peer->desync_frame = info->u.desync.frame;
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+static void netsim_tick(struct NetSimPeer* peer, int frames, bool stall)
+{
+	g_peer = peer;
+	if (!peer->running || peer->state.frame >= frames) {
+		return;
+	}
+	peer->ticks++;
+	if (peer->skip_frames > 0) {
+		peer->skip_frames--;
+		peer->skipped_frames++;
+		return;
+	}
+	if (stall && peer->player_num == 2) {
+		if (peer->frozen_ticks > 0) {
+			peer->frozen_ticks--;
+			return;
+		}
+		if (peer->state.frame > 0 && peer->state.frame % NETSIM_STALL_PERIOD == 0) {
+			peer->frozen_ticks = NETSIM_STALL_TICKS;
+		}
+	}
+
+	uint32 local_input = netsim_scripted_input(peer->player_num, peer->state.frame);
+	if (peer->stalled) {
+		local_input |= NETSIM_STALL_INPUT;
+	}
+	GGPOErrorCode result = ggpo_add_local_input(peer->session, peer->local_handle, &local_input, sizeof(local_input));
+	if (result == GGPO_ERRORCODE_PREDICTION_THRESHOLD && !peer->stalled && stall) {
+		ggpo_set_frame_delay(peer->session, peer->local_handle, 0);
+	}
+	peer->stalled = result == GGPO_ERRORCODE_PREDICTION_THRESHOLD;
+	if (GGPO_SUCCEEDED(result)) {
+		uint32 inputs[2] = { 0 };
+		int disconnect_flags = 0;
+		result = ggpo_synchronize_input(peer->session, inputs, sizeof(inputs), &disconnect_flags);
+		if (GGPO_SUCCEEDED(result)) {
+			netsim_step(peer, inputs);
+			ggpo_advance_frame(peer->session);
+			return;
+		}
+	}
+	peer->stalls++;
+}
+
+static int netsim_run(struct NetSimProfile const* profile, int frames, uint16 port, int timesync_mode, int max_frame_delay, bool alter_state, bool stall)
+{
+	GGPOSessionCallbacks cb = { 0 };
+	cb.begin_game = netsim_begin_game;
+	cb.save_game_state = netsim_save_game_state;
+	cb.load_game_state = netsim_load_game_state;
+	cb.log_game_state = netsim_log_game_state;
+	cb.free_buffer = netsim_free_buffer;
+	cb.advance_frame = netsim_advance_frame;
+	cb.on_event = netsim_on_event;
+
+	struct NetSimPeer peers[2] = { 0 };
+	for (int ipeer = 0; ipeer < 2; ++ipeer) {
+		struct NetSimPeer* peer = &peers[ipeer];
+		g_peer = peer;
+		peer->player_num = ipeer + 1;
+		peer->dilation = 1.0f;
+		peer->min_dilation = 1.0f;
+		peer->max_dilation = 1.0f;
+		peer->altered_frame = alter_state && ipeer == 1 ? frames / 2 : -1;
+		peer->desync_frame = -1;
+		// a rollback may advance a few frames past the last tick
+		peer->frame_hashes = (uint32*)calloc(frames + GGPO_MAX_PREDICTION_FRAMES + 2, sizeof(uint32));
+		if (ggpo_start_session(&peer->session, &cb, "netsim", 2, sizeof(uint32), port + ipeer) != GGPO_OK) {
+			printf("could not start the session on port %d\n", port + ipeer);
+			return 1;
+		}
+		ggpo_set_disconnect_timeout(peer->session, 3000);
+		if (timesync_mode >= 0) {
+			ggpo_set_timesync_mode(peer->session, (GGPOTimeSyncMode)timesync_mode);
+		}
+	}
+	if (timesync_mode >= 0) {
+		peers[1].next_tick = NETSIM_LATE_START_FRAMES * NETSIM_FRAME_MS;
+	}
+
+	// both sockets are bound before the first sync request
+	for (int ipeer = 0; ipeer < 2; ++ipeer) {
+		struct NetSimPeer* peer = &peers[ipeer];
+		g_peer = peer;
+		for (int iplayer = 0; iplayer < 2; ++iplayer) {
+			GGPOPlayer player = { 0 };
+			GGPOPlayerHandle handle;
+			player.size = sizeof(GGPOPlayer);
+			player.player_num = iplayer + 1;
+			if (iplayer == ipeer) {
+				player.type = GGPO_PLAYERTYPE_LOCAL;
+			}
+			else {
+				player.type = GGPO_PLAYERTYPE_REMOTE;
+				strcpy(player.u.remote.ip_address, "127.0.0.1");
+				player.u.remote.port = port + iplayer;
+			}
+			ggpo_add_player(peer->session, &player, &handle);
+			if (iplayer == ipeer) {
+				peer->local_handle = handle;
+			} else {
+				peer->remote_handle = handle;
+			}
+		}
+		if (max_frame_delay > 0) {
+			ggpo_set_adaptive_frame_delay(peer->session, max_frame_delay);
+		}
+		ggpo_set_desync_detection(peer->session, NETSIM_DESYNC_INTERVAL);
+
+		GGPOLinkProfile link = profile->link;
+		link.seed = link.seed * 2 + ipeer;
+		ggpo_set_link_profile(peer->session, &link);
+	}
+
+	uint32 start_time = Platform_GetCurrentTimeMS();
+	int frame_difference_sum = 0;
+	int frame_difference_samples = 0;
+	while (peers[0].state.frame < frames || peers[1].state.frame < frames) {
+		uint32 elapsed = Platform_GetCurrentTimeMS() - start_time;
+		if (!(peers[0].running && peers[1].running) && elapsed > NETSIM_SYNC_TIMEOUT_MS) {
+			printf("  %-6s could not synchronize the peers\n", profile->name);
+			break;
+		}
+		for (int ipeer = 0; ipeer < 2; ++ipeer) {
+			struct NetSimPeer* peer = &peers[ipeer];
+			if ((double)elapsed >= peer->next_tick) {
+				peer->next_tick += NETSIM_FRAME_MS * peer->dilation;
+				netsim_tick(peer, frames, stall);
+			}
+		}
+		if (peers[0].state.frame >= frames - 60 && peers[0].state.frame < frames && peers[1].state.frame < frames) {
+			frame_difference_sum += abs(peers[0].state.frame - peers[1].state.frame);
+			frame_difference_samples++;
+		}
+		for (int ipeer = 0; ipeer < 2; ++ipeer) {
+			struct NetSimPeer* peer = &peers[ipeer];
+			g_peer = peer;
+			ggpo_idle(peer->session, 0);
+			if (timesync_mode == GGPO_TIMESYNC_DILATION) {
+				ggpo_get_time_dilation(peer->session, &peer->dilation);
+				peer->min_dilation = MIN(peer->min_dilation, peer->dilation);
+				peer->max_dilation = MAX(peer->max_dilation, peer->dilation);
+			}
+		}
+		Platform_SleepMS(1);
+	}
+	double seconds = (Platform_GetCurrentTimeMS() - start_time) / 1000.0;
+
+	// the last frames may still be rolled back, only compare the confirmed ones
+	int confirmed = MIN(peers[0].state.frame, peers[1].state.frame) - GGPO_MAX_PREDICTION_FRAMES - 1;
+	int first_mismatch = -1;
+	for (int i = 0; i < confirmed; ++i) {
+		if (peers[0].frame_hashes[i] != peers[1].frame_hashes[i]) {
+			first_mismatch = i;
+			break;
+		}
+	}
+
+	printf("  %-6s", profile->name);
+	for (int ipeer = 0; ipeer < 2; ++ipeer) {
+		struct NetSimPeer* peer = &peers[ipeer];
+		printf(" | p%d %4d rollbacks %5d frames rolled back (%.2f/frame, max %d) %4d stalls",
+			peer->player_num, peer->rollbacks, peer->frames_rolled_back,
+			(double)peer->frames_rolled_back / MAX(peer->state.frame, 1), peer->max_rollback, peer->stalls);
+	}
+	printf(" | %s\n", first_mismatch < 0 ? "in sync" : "DESYNC");
+	if (first_mismatch >= 0) {
+		printf("         first mismatch at frame %d of %d confirmed\n", first_mismatch, confirmed);
+	}
+	// the state saved before a frame is checked, the alteration shows in the next multiple of the interval
+	int expected_desync_frame = -1;
+	if (alter_state) {
+		expected_desync_frame = (frames / 2 / NETSIM_DESYNC_INTERVAL + 1) * NETSIM_DESYNC_INTERVAL;
+		if (expected_desync_frame > confirmed) {
+			expected_desync_frame = -1; // not confirmed on both sides before the end
+		}
+	}
+	bool desync_detected = true;
+	for (int ipeer = 0; ipeer < 2; ++ipeer) {
+		int frame = peers[ipeer].desync_frame;
+		desync_detected = desync_detected && (expected_desync_frame < 0 ? frame == -1 : frame >= expected_desync_frame);
+	}
+	if (alter_state || !desync_detected) {
+		printf("         desync events: p1 frame %d, p2 frame %d, expected %d | %s\n",
+			peers[0].desync_frame, peers[1].desync_frame, expected_desync_frame, desync_detected ? "ok" : "WRONG");
+	}
+	for (int ipeer = 0; ipeer < 2; ++ipeer) {
+		GGPORollbackStats stats;
+		ggpo_get_rollback_stats(peers[ipeer].session, &stats);
+		printf("         p%d ggpo: %d rollbacks, depth", ipeer + 1, stats.rollbacks);
+		for (int depth = 1; depth <= GGPO_MAX_PREDICTION_FRAMES; ++depth) {
+			printf(" %d", stats.rollback_depth[depth]);
+		}
+		printf(", misses %d %d, %d stalls, %d timesyncs, rollback %.1f us avg %d us max\n",
+			stats.prediction_misses[0], stats.prediction_misses[1], stats.prediction_stalls, stats.timesync_events,
+			stats.rollback.avg_us, stats.rollback.max_us);
+	}
+	if (timesync_mode >= 0) {
+		printf("         timesync: p1 %d frames skipped, dilation %.4f..%.4f | p2 %d frames skipped, dilation %.4f..%.4f | %.2f frames apart over the last second\n",
+			peers[0].skipped_frames, peers[0].min_dilation, peers[0].max_dilation,
+			peers[1].skipped_frames, peers[1].min_dilation, peers[1].max_dilation,
+			(double)frame_difference_sum / MAX(frame_difference_samples, 1));
+	}
+	if (max_frame_delay > 0) {
+		printf("         frame delay:");
+		for (int ipeer = 0; ipeer < 2; ++ipeer) {
+			GGPONetworkStats stats;
+			ggpo_get_network_stats(peers[ipeer].session, peers[ipeer].remote_handle, &stats);
+			printf(" %s p%d %d (wanted %d, remote %d, rtt %.1f ms +- %.1f, %.1f rollback frames)", ipeer ? "|" : "",
+				ipeer + 1, stats.frame_delay.current, stats.frame_delay.wanted, stats.frame_delay.remote_wanted,
+				stats.frame_delay.rtt_ms, stats.frame_delay.rtt_deviation_ms, stats.frame_delay.rollback_frames);
+		}
+		printf("\n");
+	}
+	for (int ipeer = 0; ipeer < 2; ++ipeer) {
+		link_Stats const* stats = &((Peer2PeerBackend*)peers[ipeer].session)->_udp._link->_stats;
+		printf("         p%d link: %d sent, %d delivered, %d lost, %d duplicated, %d reordered, %d overflowed\n",
+			ipeer + 1, stats->sent, stats->delivered, stats->lost, stats->duplicated, stats->reordered, stats->overflowed);
+	}
+	for (int ipeer = 0; ipeer < 2; ++ipeer) {
+		GGPONetworkStats stats;
+		ggpo_get_network_stats(peers[ipeer].session, peers[ipeer].remote_handle, &stats);
+		double headers = (double)UDP_HEADER_SIZE * stats.network.msgs_queued;
+		printf("         p%d bandwidth: %.0f B/s, %.0f B/s with the version 2 layout (%+.0f%%) | with the UDP/IP headers %.0f B/s, %.0f B/s (%+.0f%%)\n",
+			ipeer + 1, stats.network.bytes_sent / seconds, stats.network.legacy_bytes_sent / seconds,
+			100.0 * (stats.network.bytes_sent - stats.network.legacy_bytes_sent) / MAX(stats.network.legacy_bytes_sent, 1),
+			(stats.network.bytes_sent + headers) / seconds, (stats.network.legacy_bytes_sent + headers) / seconds,
+			100.0 * (stats.network.bytes_sent - stats.network.legacy_bytes_sent) / MAX(stats.network.legacy_bytes_sent + headers, 1));
+	}
+
+	for (int ipeer = 0; ipeer < 2; ++ipeer) {
+		g_peer = &peers[ipeer];
+		ggpo_close_session(peers[ipeer].session);
+		free(peers[ipeer].frame_hashes);
+	}
+	if (alter_state) {
+		return first_mismatch >= 0 && desync_detected ? 0 : 1;
+	}
+	return first_mismatch < 0 && desync_detected ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+	int frames = argc > 1 ? atoi(argv[1]) : 600;
+	const char* profile_name = argc > 2 ? argv[2] : NULL;
+	int timesync_mode = -1;
+	int max_frame_delay = 0;
+	bool alter_state = false;
+	bool stall = false;
+	bool valid = frames > GGPO_MAX_PREDICTION_FRAMES;
+	for (int i = 3; i < argc; ++i) {
+		if (strcmp(argv[i], "dilate") == 0) {
+			timesync_mode = GGPO_TIMESYNC_DILATION;
+		} else if (strcmp(argv[i], "skip") == 0) {
+			timesync_mode = GGPO_TIMESYNC_SKIP_FRAMES;
+		} else if (strcmp(argv[i], "desync") == 0) {
+			alter_state = true;
+		} else if (strcmp(argv[i], "stall") == 0) {
+			stall = true;
+		} else if (argv[i][0] >= '0' && argv[i][0] <= '9') {
+			max_frame_delay = atoi(argv[i]);
+		} else {
+			valid = false;
+		}
+	}
+	if (!valid) {
+		printf("usage: netsim [frames] [ideal|lan|wifi|dsl|bad] [skip|dilate] [max_frame_delay] [desync] [stall]\n");
+		return 1;
+	}
+
+	printf("netsim: %d frames per profile\n", frames);
+	int result = 0;
+	int ran = 0;
+	for (int i = 0; i < (int)ARRAY_SIZE(netsim_profiles); ++i) {
+		if (profile_name && strcmp(profile_name, netsim_profiles[i].name) != 0) {
+			continue;
+		}
+		result |= netsim_run(&netsim_profiles[i], frames, (uint16)(NETSIM_PORT + 2 * i), timesync_mode, max_frame_delay, alter_state, stall);
+		ran++;
+	}
+	if (ran == 0) {
+		printf("unknown profile %s\n", profile_name);
+		return 1;
+	}
+	return result;
+}
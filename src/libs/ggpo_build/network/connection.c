@@ -21,8 +21,12 @@
 #else
 #include "sys/socket.h"
 #include <fcntl.h> // to set nonblocking socket
+#include <sys/select.h>
 #include <arpa/inet.h> // htonl
 #endif
+#if defined(CONN_BATCHED_IO)
+#include <sys/uio.h> // iovec
+#endif
 
 struct _conn_Socket
 {
@@ -36,7 +40,8 @@ struct _conn_Address
 };
 
 struct _conn_Address g_adress_pool[32];
-size_t g_address_pool_size;
+// the receive thread interns new senders, an entry is written before the size publishes it
+volatile uint32 g_address_pool_size;
 
 conn_Socket conn_open(uint16 port)
 {
@@ -51,7 +56,7 @@ conn_Socket conn_open(uint16 port)
 	int iresult = 0;
 	iresult = setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&optval, sizeof(optval));
 	ASSERT(iresult == 0);
-	LINGER dont_linger = { 0 };
+	struct linger dont_linger = { 0 };
 	iresult = setsockopt(s, SOL_SOCKET, SO_LINGER, (const char*)&dont_linger, sizeof(dont_linger));
 	// int error = WSAGetLastError();
 	// ASSERT(iresult == 0);
@@ -124,7 +129,8 @@ void conn_send(conn_Socket socket, conn_Address remote, void const* data, uint32
 
 static void conn_fill_out_address(struct sockaddr_in const* sender_addr, conn_Address* out_address)
 {
-	for (size_t i = 0; i < g_address_pool_size; ++i) {
+	uint32 pool_size = Platform_AtomicLoad(&g_address_pool_size);
+	for (size_t i = 0; i < pool_size; ++i) {
 		if (memcmp(sender_addr, &g_adress_pool[i].sa, sizeof(struct sockaddr_in)) == 0) {
 			*out_address = &g_adress_pool[i];
 			return;
@@ -132,9 +138,10 @@ static void conn_fill_out_address(struct sockaddr_in const* sender_addr, conn_Ad
 	}
 
 
-	ASSERT(g_address_pool_size < ARRAY_SIZE(g_adress_pool));
-	size_t iaddress = g_address_pool_size++;
+	ASSERT(pool_size < ARRAY_SIZE(g_adress_pool));
+	size_t iaddress = pool_size;
 	g_adress_pool[iaddress].sa = *sender_addr;
+	Platform_AtomicStore(&g_address_pool_size, pool_size + 1);
 	*out_address = &g_adress_pool[iaddress];
 	return;
 }
@@ -174,6 +181,93 @@ int conn_receive(conn_Socket socket, uint8* buf, uint32 size, conn_Address* out_
 	return len;
 }
 
+void conn_wait_readable(conn_Socket socket, int timeout_ms)
+{
+#if defined(_WINDOWS)
+	SOCKET s = (uptr)socket;
+#else
+	int s = (int)(uptr)socket;
+#endif
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(s, &readable);
+	struct timeval timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+	select((int)s + 1, &readable, NULL, NULL, &timeout);
+}
+
+#if defined(CONN_BATCHED_IO)
+int conn_send_batch(conn_Socket socket, conn_Datagram const* datagrams, int count)
+{
+	int s = (int)(uptr)socket;
+	struct mmsghdr msgs[CONN_MAX_BATCH];
+	struct iovec iovs[CONN_MAX_BATCH];
+
+	ASSERT(count <= CONN_MAX_BATCH);
+	memset(msgs, 0, count * sizeof(struct mmsghdr));
+	for (int i = 0; i < count; ++i) {
+		iovs[i].iov_base = datagrams[i].data;
+		iovs[i].iov_len = datagrams[i].size;
+		msgs[i].msg_hdr.msg_name = &datagrams[i].address->sa;
+		msgs[i].msg_hdr.msg_namelen = sizeof(datagrams[i].address->sa);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	// sendmmsg stops at the first datagram that fails, it may take a few calls
+	int syscalls = 0;
+	int sent = 0;
+	while (sent < count) {
+		int res = sendmmsg(s, msgs + sent, count - sent, 0);
+		syscalls += 1;
+		if (res < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			Log("unknown error in sendmmsg (errno: %d).\n", errno);
+			ASSERT(false && "Unknown error in sendmmsg");
+			break;
+		}
+		sent += res;
+	}
+	Log("sent %d packets in %d sendmmsg.\n", sent, syscalls);
+	return syscalls;
+}
+
+int conn_receive_batch(conn_Socket socket, conn_Datagram* datagrams, int count)
+{
+	int s = (int)(uptr)socket;
+	struct mmsghdr msgs[CONN_MAX_BATCH];
+	struct iovec iovs[CONN_MAX_BATCH];
+	struct sockaddr_in sender_addrs[CONN_MAX_BATCH];
+
+	ASSERT(count <= CONN_MAX_BATCH);
+	memset(msgs, 0, count * sizeof(struct mmsghdr));
+	for (int i = 0; i < count; ++i) {
+		iovs[i].iov_base = datagrams[i].data;
+		iovs[i].iov_len = datagrams[i].size;
+		msgs[i].msg_hdr.msg_name = &sender_addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(sender_addrs[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int res = recvmmsg(s, msgs, count, MSG_DONTWAIT, NULL);
+	if (res < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			Log("recvmmsg returned errno %d.\n", errno);
+		}
+		return 0;
+	}
+
+	for (int i = 0; i < res; ++i) {
+		datagrams[i].size = msgs[i].msg_len;
+		conn_fill_out_address(&sender_addrs[i], &datagrams[i].address);
+	}
+	Log("recvmmsg returned %d packets.\n", res);
+	return res;
+}
+#endif
+
 bool conn_support_ip_port()
 {
 	return true;
@@ -181,12 +275,14 @@ bool conn_support_ip_port()
 
 conn_Address conn_address_from_ip_port(char* ip, uint16 port)
 {
-	ASSERT(g_address_pool_size < ARRAY_SIZE(g_adress_pool));
+	uint32 pool_size = Platform_AtomicLoad(&g_address_pool_size);
+	ASSERT(pool_size < ARRAY_SIZE(g_adress_pool));
 
-	size_t iaddress = g_address_pool_size++;
+	size_t iaddress = pool_size;
 	g_adress_pool[iaddress].sa.sin_family = AF_INET; // IPv4
 	g_adress_pool[iaddress].sa.sin_port = htons(port);
 	inet_pton(AF_INET, ip, &g_adress_pool[iaddress].sa.sin_addr.s_addr);
+	Platform_AtomicStore(&g_address_pool_size, pool_size + 1);
 
 	return &g_adress_pool[iaddress];
 }
@@ -20,11 +20,33 @@
 typedef struct _conn_Socket* conn_Socket;
 typedef struct _conn_Address* conn_Address;
 
+// Linux sockets can send and receive several datagrams per syscall with sendmmsg/recvmmsg.
+#if defined(__linux__) && !defined(GGPO_STEAM)
+#define CONN_BATCHED_IO 1
+#endif
+#define CONN_MAX_BATCH 32
+
+struct conn_Datagram
+{
+	void* data;
+	uint32 size; // capacity of data when receiving, then the received length
+	conn_Address address;
+};
+typedef struct conn_Datagram conn_Datagram;
+
 conn_Socket conn_open(uint16 port);
 void conn_close(conn_Socket socket);
 
 void conn_send(conn_Socket socket, conn_Address remote, void const *data, uint32 size, int flags);
 int conn_receive(conn_Socket socket, uint8 *buf, uint32 size, conn_Address *out_address);
+// Blocks until a datagram can be received or timeout_ms elapsed
+void conn_wait_readable(conn_Socket socket, int timeout_ms);
+#if defined(CONN_BATCHED_IO)
+// Returns the number of syscalls
+int conn_send_batch(conn_Socket socket, conn_Datagram const *datagrams, int count);
+// Returns the number of datagrams received, never blocks
+int conn_receive_batch(conn_Socket socket, conn_Datagram *datagrams, int count);
+#endif
 
 bool conn_support_ip_port();
 bool conn_addr_is_equal(conn_Address a, conn_Address b);
@@ -30,7 +30,8 @@ struct _conn_Address
 };
 
 static struct _conn_Address g_address_pool[32];
-static size_t g_address_pool_size = 0;
+// the receive thread interns new senders, an entry is written before the size publishes it
+static volatile uint32 g_address_pool_size = 0;
 
 static uint64 g_known_peers[GGPO_MAX_PLAYERS];
 static int g_known_peers_count = 0;
@@ -61,15 +62,17 @@ static bool conn_is_known_peer(uint64 steam_id)
 
 static conn_Address conn_intern_identity(const SteamNetworkingIdentity* identity)
 {
-	for (size_t i = 0; i < g_address_pool_size; i++) {
+	uint32 pool_size = Platform_AtomicLoad(&g_address_pool_size);
+	for (size_t i = 0; i < pool_size; i++) {
 		if (memcmp(&g_address_pool[i].identity, identity, sizeof(SteamNetworkingIdentity)) == 0) {
 			return &g_address_pool[i];
 		}
 	}
 
-	ASSERT(g_address_pool_size < ARRAY_SIZE(g_address_pool));
-	size_t idx = g_address_pool_size++;
+	ASSERT(pool_size < ARRAY_SIZE(g_address_pool));
+	size_t idx = pool_size;
 	g_address_pool[idx].identity = *identity;
+	Platform_AtomicStore(&g_address_pool_size, pool_size + 1);
 	return &g_address_pool[idx];
 }
 
@@ -131,7 +134,7 @@ void conn_close(conn_Socket socket)
 	}
 
 	g_known_peers_count = 0;
-	g_address_pool_size = 0;
+	Platform_AtomicStore(&g_address_pool_size, 0);
 	g_steam_initialized = false;
 
 	Log("Steam Networking Messages connection closed.\n");
@@ -250,6 +253,12 @@ int conn_receive(conn_Socket socket, uint8* buf, uint32 size, conn_Address* out_
 	return len;
 }
 
+void conn_wait_readable(conn_Socket socket, int timeout_ms)
+{
+	// SteamNetworkingMessages has no blocking receive
+	Platform_SleepMS(timeout_ms > 0 ? 1 : 0);
+}
+
 bool conn_support_ip_port()
 {
 	return false;
@@ -257,7 +266,7 @@ bool conn_support_ip_port()
 
 conn_Address conn_address_from_steam_id(uint64 steam_id)
 {
-	ASSERT(g_address_pool_size < ARRAY_SIZE(g_address_pool));
+	ASSERT(Platform_AtomicLoad(&g_address_pool_size) < ARRAY_SIZE(g_address_pool));
 	ASSERT(steam_id != 0 && "Invalid Steam ID (zero)");
 
 	SteamNetworkingIdentity identity;
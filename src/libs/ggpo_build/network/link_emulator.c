@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+#include "link_emulator.h"
+#include <math.h>
+
+// xorshift64*
+static uint32 link_Rand(LinkEmulator* link)
+{
+	link->_rng ^= link->_rng >> 12;
+	link->_rng ^= link->_rng << 25;
+	link->_rng ^= link->_rng >> 27;
+	return (uint32)((link->_rng * 2685821657736338717ull) >> 32);
+}
+
+// [0, 1)
+static double link_RandUnit(LinkEmulator* link)
+{
+	return (double)link_Rand(link) * (1.0 / 4294967296.0);
+}
+
+static double link_SampleJitter(LinkEmulator* link)
+{
+	double jitter = (double)link->_profile.jitter_ms;
+	switch (link->_profile.jitter) {
+	case GGPO_LINK_JITTER_UNIFORM:
+		return link_RandUnit(link) * jitter;
+	case GGPO_LINK_JITTER_NORMAL: {
+		// Box-Muller, u1 in (0, 1]
+		double u1 = 1.0 - link_RandUnit(link);
+		double u2 = link_RandUnit(link);
+		return sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2) * jitter;
+	}
+	case GGPO_LINK_JITTER_EXPONENTIAL:
+		return -log(1.0 - link_RandUnit(link)) * jitter;
+	}
+	return 0.0;
+}
+
+void link_Init(LinkEmulator* link, GGPOLinkProfile const* profile)
+{
+	memset(link, 0, sizeof(LinkEmulator));
+	link->_profile = *profile;
+	// splitmix64 of the seed, xorshift needs a non zero state
+	uint64 z = (uint64)profile->seed + 0x9E3779B97F4A7C15ull;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	link->_rng = (z ^ (z >> 31)) | 1;
+}
+
+static void link_Queue(LinkEmulator* link, double deliver_time, void const* data, int len, conn_Address to)
+{
+	if (link->_packets_length == LINK_MAX_PACKETS) {
+		link->_stats.overflowed++;
+		return;
+	}
+	link_Packet* packet = NULL;
+	for (int i = 0; i < LINK_MAX_PACKETS; ++i) {
+		if (link->_packets[i].len == 0) {
+			packet = &link->_packets[i];
+			break;
+		}
+	}
+	packet->deliver_time = deliver_time;
+	packet->order = link->_next_order++;
+	packet->to = to;
+	packet->len = len;
+	memcpy(packet->data, data, len);
+	link->_packets_length++;
+}
+
+void link_Send(LinkEmulator* link, uint64 now, void const* data, int len, conn_Address to)
+{
+	GGPOLinkProfile const* profile = &link->_profile;
+	ASSERT(len > 0 && len <= LINK_MAX_PACKET_SIZE);
+	link->_stats.sent++;
+
+	// Gilbert-Elliott: the state may change before each packet, each state has its own loss rate
+	if (link->_bad_state) {
+		link->_bad_state = !(link_RandUnit(link) < profile->bad_to_good);
+	}
+	else {
+		link->_bad_state = link_RandUnit(link) < profile->good_to_bad;
+	}
+	if (link_RandUnit(link) < (link->_bad_state ? profile->loss_bad : profile->loss_good)) {
+		link->_stats.lost++;
+		return;
+	}
+
+	int copies = 1;
+	if (link_RandUnit(link) < profile->duplicate) {
+		link->_stats.duplicated++;
+		copies = 2;
+	}
+
+	for (int i = 0; i < copies; ++i) {
+		double depart_time = (double)now / 1000.0;
+		if (profile->bandwidth_kbps > 0) {
+			double start = MAX(depart_time, link->_link_free_time);
+			if (start - depart_time > LINK_MAX_QUEUE_MS) {
+				link->_stats.overflowed++;
+				continue;
+			}
+			// kbps is also bits per ms
+			link->_link_free_time = start + (double)((len + LINK_PACKET_OVERHEAD) * 8) / (double)profile->bandwidth_kbps;
+			depart_time = link->_link_free_time;
+		}
+
+		double delay = MAX(0.0, (double)profile->latency_ms + link_SampleJitter(link));
+		if (link_RandUnit(link) < profile->reorder) {
+			link->_stats.reordered++;
+			delay += (double)profile->reorder_ms;
+		}
+		link_Queue(link, depart_time + delay, data, len, to);
+	}
+}
+
+int link_Deliver(LinkEmulator* link, uint64 now, conn_Socket socket)
+{
+	int delivered = 0;
+	while (link->_packets_length > 0) {
+		link_Packet* next = NULL;
+		for (int i = 0; i < LINK_MAX_PACKETS; ++i) {
+			link_Packet* packet = &link->_packets[i];
+			if (packet->len == 0 || packet->deliver_time > (double)now / 1000.0) {
+				continue;
+			}
+			if (!next || packet->deliver_time < next->deliver_time || (packet->deliver_time == next->deliver_time && packet->order < next->order)) {
+				next = packet;
+			}
+		}
+		if (!next) {
+			break;
+		}
+		conn_send(socket, next->to, next->data, next->len, 0);
+		next->len = 0;
+		link->_packets_length--;
+		delivered++;
+	}
+	link->_stats.delivered += delivered;
+	return delivered;
+}
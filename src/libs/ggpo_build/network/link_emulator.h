@@ -0,0 +1,74 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+#ifndef _LINK_EMULATOR_H
+#define _LINK_EMULATOR_H
+
+#include "types.h"
+#include "ggponet.h"
+#include "connection.h"
+
+/*
+ * Emulated network link between udp_SendTo and the socket, see GGPOLinkProfile.
+ *
+ * For each packet, in order: Gilbert-Elliott loss, duplication, bandwidth (the packet waits for
+ * the previous ones to be serialized), then latency + jitter and the reordering delay. Packets
+ * are held in the emulator until their delivery time and sent by link_Deliver. The random
+ * numbers only depend on the seed and on the sequence of packets.
+ */
+#define LINK_MAX_PACKETS 256
+#define LINK_MAX_PACKET_SIZE 4096
+#define LINK_PACKET_OVERHEAD 28 // IP + UDP headers, counted against the bandwidth
+#define LINK_MAX_QUEUE_MS 1000 // packets waiting longer than this for the bandwidth are dropped
+
+struct link_Packet {
+   double         deliver_time; // ms
+   uint32         order;
+   conn_Address   to;
+   int            len; // 0 = free slot
+   uint8          data[LINK_MAX_PACKET_SIZE];
+};
+typedef struct link_Packet link_Packet;
+
+struct link_Stats {
+   int            sent;
+   int            delivered;
+   int            lost;
+   int            duplicated;
+   int            reordered;
+   int            overflowed;
+};
+typedef struct link_Stats link_Stats;
+
+struct LinkEmulator {
+   GGPOLinkProfile   _profile;
+   uint64            _rng;
+   bool              _bad_state;
+   double            _link_free_time; // the link is busy serializing packets until this time
+   uint32            _next_order;
+   int               _packets_length;
+   link_Packet       _packets[LINK_MAX_PACKETS];
+   link_Stats        _stats;
+};
+typedef struct LinkEmulator LinkEmulator;
+
+void link_Init(LinkEmulator* link, GGPOLinkProfile const* profile);
+// now is in us, the delivery times are kept in fractional ms
+void link_Send(LinkEmulator* link, uint64 now, void const* data, int len, conn_Address to);
+// Sends the packets due at now in delivery order, returns the number of packets sent
+int link_Deliver(LinkEmulator* link, uint64 now, conn_Socket socket);
+
+#endif
@@ -38,6 +38,9 @@ void udp_ctor(Udp* udp)
 
 void udp_dtor(Udp* udp)
 {
+	udp_StopThread(udp);
+	udp_Flush(udp);
+	udp_SetLinkProfile(udp, NULL);
 	conn_close(udp->_socket);
 	// closesocket(udp->_socket);
 	// udp->_socket = INVALID_SOCKET;
@@ -51,11 +54,32 @@ void udp_Init(Udp* udp, uint16 port, UdpOnMsgFn on_msg_callback, void* user_data
 	udp_Log("binding udp socket to port %d.\n", port);
 	// udp->_socket = CreateSocket(port, 0);
 	udp->_socket = conn_open(port);
+#if defined(CONN_BATCHED_IO)
+	udp->_batch_io = true;
+#endif
 }
 
 void udp_SendTo(Udp* udp, char* buffer, int len, int flags, conn_Address to)
 {
+	if (udp->_link) {
+		link_Send(udp->_link, Platform_GetCurrentTimeUS(), buffer, len, to);
+		return;
+	}
+
+	if (udp->_batch_io) {
+		ASSERT(flags == 0 && len <= UDP_SEND_BATCH_BYTES);
+		if (udp->_send_batch_len == UDP_BATCH_SIZE || udp->_send_batch_bytes + len > UDP_SEND_BATCH_BYTES) {
+			udp_Flush(udp);
+		}
+		uint8* data = udp->_send_buffer + udp->_send_batch_bytes;
+		memcpy(data, buffer, len);
+		udp->_send_batch[udp->_send_batch_len++] = (conn_Datagram){ data, (uint32)len, to };
+		udp->_send_batch_bytes += len;
+		return;
+	}
+
 	conn_send(udp->_socket, to, buffer, len, flags);
+	udp->_send_calls++;
 	// int res = sendto(udp->_socket, buffer, len, flags, dst, destlen);
 	// if (res == SOCKET_ERROR) {
 	// 	DWORD err = WSAGetLastError();
@@ -66,16 +90,149 @@ void udp_SendTo(Udp* udp, char* buffer, int len, int flags, conn_Address to)
 	// Log("sent packet length %d to %s:%d (ret:%d).\n", len, inet_ntop(AF_INET, (void*)&to->sin_addr, dst_ip, ARRAY_SIZE(dst_ip)), ntohs(to->sin_port), res);
 }
 
+void udp_Flush(Udp* udp)
+{
+	if (udp->_link) {
+		udp->_send_calls += link_Deliver(udp->_link, Platform_GetCurrentTimeUS(), udp->_socket);
+		return;
+	}
+
+#if defined(CONN_BATCHED_IO)
+	if (udp->_send_batch_len > 0) {
+		udp->_send_calls += conn_send_batch(udp->_socket, udp->_send_batch, udp->_send_batch_len);
+		udp->_send_batch_len = 0;
+		udp->_send_batch_bytes = 0;
+	}
+#endif
+}
+
+#if defined(CONN_BATCHED_IO)
+static void udp_OnLoopPollBatched(Udp *udp)
+{
+	conn_Datagram datagrams[UDP_BATCH_SIZE];
+
+	for (;;) {
+		for (int i = 0; i < UDP_BATCH_SIZE; ++i) {
+			datagrams[i].data = udp->_recv_buffer[i];
+			datagrams[i].size = MAX_UDP_PACKET_SIZE;
+		}
+		int count = conn_receive_batch(udp->_socket, datagrams, UDP_BATCH_SIZE);
+		Platform_AtomicStore(&udp->_recv_calls, udp->_recv_calls + 1);
+		for (int i = 0; i < count; ++i) {
+			if (datagrams[i].size > 0) {
+				udp->_on_msg_callback(datagrams[i].address, (UdpMsg*)datagrams[i].data, (int)datagrams[i].size, udp->_user_data);
+			}
+		}
+		// a partial batch means the socket is drained
+		if (count < UDP_BATCH_SIZE) {
+			break;
+		}
+	}
+}
+#endif
+
+static void udp_ThreadMain(void* user_data)
+{
+	Udp* udp = (Udp*)user_data;
+	// conn_receive logs every datagram, Log is only safe on the game thread
+	LogDisableThisThread();
+
+	while (!Platform_AtomicLoad(&udp->_thread_stop)) {
+		int slot = spsc_push_begin(&udp->_recv_ring);
+		if (slot < 0) {
+			// the game thread is not polling, leave the datagrams in the socket
+			Platform_SleepMS(1);
+			continue;
+		}
+
+		udp_RecvEntry* entry = &udp->_recv_queue[slot];
+		int len = conn_receive(udp->_socket, entry->data, MAX_UDP_PACKET_SIZE, &entry->from);
+		Platform_AtomicStore(&udp->_recv_calls, udp->_recv_calls + 1);
+		if (len > 0) {
+			entry->len = len;
+			entry->recv_time = Platform_GetCurrentTimeUS();
+			spsc_push_end(&udp->_recv_ring);
+		}
+		else {
+			conn_wait_readable(udp->_socket, UDP_THREAD_WAIT_MS);
+		}
+	}
+}
+
+bool udp_StartThread(Udp* udp)
+{
+	ASSERT(!udp->_thread);
+	udp->_recv_queue = (udp_RecvEntry*)malloc(UDP_RECV_QUEUE_SIZE * sizeof(udp_RecvEntry));
+	spsc_ctor(&udp->_recv_ring, UDP_RECV_QUEUE_SIZE);
+	udp->_thread_stop = 0;
+	udp->_thread = Platform_CreateThread(udp_ThreadMain, udp);
+	if (!udp->_thread) {
+		free(udp->_recv_queue);
+		udp->_recv_queue = NULL;
+		return false;
+	}
+	udp_Log("started receive thread.\n");
+	return true;
+}
+
+void udp_StopThread(Udp* udp)
+{
+	if (!udp->_thread) {
+		return;
+	}
+	Platform_AtomicStore(&udp->_thread_stop, 1);
+	Platform_JoinThread(udp->_thread);
+	udp->_thread = NULL;
+	free(udp->_recv_queue);
+	udp->_recv_queue = NULL;
+}
+
+void udp_SetLinkProfile(Udp* udp, GGPOLinkProfile const* profile)
+{
+	if (udp->_link) {
+		udp_Log("link emulator: %d sent, %d delivered, %d lost, %d duplicated, %d reordered, %d overflowed.\n",
+			udp->_link->_stats.sent, udp->_link->_stats.delivered, udp->_link->_stats.lost,
+			udp->_link->_stats.duplicated, udp->_link->_stats.reordered, udp->_link->_stats.overflowed);
+		free(udp->_link);
+		udp->_link = NULL;
+	}
+	if (profile) {
+		udp_Flush(udp);
+		udp->_link = (LinkEmulator*)malloc(sizeof(LinkEmulator));
+		link_Init(udp->_link, profile);
+		udp_Log("link emulator: %d ms latency, %d ms jitter, %d kbps, seed %u.\n",
+			profile->latency_ms, profile->jitter_ms, profile->bandwidth_kbps, profile->seed);
+	}
+}
+
 bool udp_OnLoopPoll(Udp *udp)
 {
 	uint8          recv_buf[MAX_UDP_PACKET_SIZE];
 	conn_Address    recv_addr;
 	// int            recv_addr_len;
 
+	if (udp->_thread) {
+		for (int slot; (slot = spsc_pop_begin(&udp->_recv_ring)) >= 0; spsc_pop_end(&udp->_recv_ring)) {
+			udp_RecvEntry* entry = &udp->_recv_queue[slot];
+			udp->_recv_time = entry->recv_time;
+			udp->_on_msg_callback(entry->from, (UdpMsg*)entry->data, entry->len, udp->_user_data);
+		}
+		return true;
+	}
+
+	udp->_recv_time = Platform_GetCurrentTimeUS();
+#if defined(CONN_BATCHED_IO)
+	if (udp->_batch_io) {
+		udp_OnLoopPollBatched(udp);
+		return true;
+	}
+#endif
+
 	for (;;) {
 		// recv_addr_len = sizeof(recv_addr);
 
 		int len = conn_receive(udp->_socket, recv_buf, MAX_UDP_PACKET_SIZE, &recv_addr);
+		Platform_AtomicStore(&udp->_recv_calls, udp->_recv_calls + 1);
 		// TODO: handle len == 0... indicates a disconnect.
 		// if (len == -1) {
 		//	int error = WSAGetLastError();
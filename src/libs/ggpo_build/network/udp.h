@@ -26,12 +26,37 @@
 
 #include "ggponet.h"
 #include "ring_buffer.h"
+#include "spsc_ring.h"
 #include "connection.h"
+#include "link_emulator.h"
 
 #define MAX_UDP_ENDPOINTS     16
 
 #define MAX_UDP_PACKET_SIZE 4096
 
+/*
+ * With CONN_BATCHED_IO, udp_SendTo only copies the datagram and udp_Flush sends every
+ * queued datagram in one syscall. Receives are drained UDP_BATCH_SIZE datagrams at a time.
+ */
+#define UDP_BATCH_SIZE 16
+#define UDP_SEND_BATCH_BYTES 16384
+
+/*
+ * With udp_StartThread, a thread receives the datagrams as soon as they arrive, timestamps them
+ * and queues them for the game thread. udp_OnLoopPoll then only dispatches the queued datagrams,
+ * everything else (decoding, sync, sends) stays on the game thread.
+ */
+#define UDP_RECV_QUEUE_SIZE 128
+#define UDP_THREAD_WAIT_MS 10
+
+struct udp_RecvEntry {
+   conn_Address   from;
+   uint64         recv_time; // us
+   int            len;
+   uint8          data[MAX_UDP_PACKET_SIZE];
+};
+typedef struct udp_RecvEntry udp_RecvEntry;
+
 typedef struct UdpMsg UdpMsg;
 typedef void (*UdpOnMsgFn)(conn_Address from, UdpMsg *msg, int len, void* user_data);
 
@@ -51,6 +76,28 @@ struct Udp
    // state management
    void* _user_data;
    UdpOnMsgFn      _on_msg_callback;
+
+   // batched I/O
+   bool            _batch_io;
+   int             _send_batch_len;
+   int             _send_batch_bytes;
+   conn_Datagram   _send_batch[UDP_BATCH_SIZE];
+   uint8           _send_buffer[UDP_SEND_BATCH_BYTES];
+   uint8           _recv_buffer[UDP_BATCH_SIZE][MAX_UDP_PACKET_SIZE];
+
+   // receive thread
+   PlatformThread* _thread;
+   volatile uint32 _thread_stop;
+   SpscRing        _recv_ring;
+   udp_RecvEntry*  _recv_queue;
+   uint64          _recv_time; // arrival time of the datagram being dispatched, in us
+
+   // network emulation, see udp_SetLinkProfile
+   LinkEmulator*   _link;
+
+   // stats
+   int             _send_calls;
+   volatile uint32 _recv_calls; // written by the receive thread when it runs
 };
 typedef struct Udp Udp;
 
@@ -60,7 +107,13 @@ void udp_ctor(Udp* udp);
 void udp_dtor(Udp* udp);
 void udp_Init(Udp* udp, uint16 port, UdpOnMsgFn on_msg_callback, void *user_data);
 void udp_SendTo(Udp* ud, char *buffer, int len, int flags, conn_Address to);
+void udp_Flush(Udp* udp);
 bool udp_OnLoopPoll(Udp* udp);
+bool udp_StartThread(Udp* udp);
+void udp_StopThread(Udp* udp);
+// Sends through a LinkEmulator until called with NULL, the packets are delivered by udp_Flush
+void udp_SetLinkProfile(Udp* udp, GGPOLinkProfile const* profile);
+inline uint64 udp_RecvTime(Udp* udp) { return udp->_recv_time; }
 
 
 #endif
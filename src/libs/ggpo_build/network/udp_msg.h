@@ -10,6 +10,37 @@
 
 #define MAX_COMPRESSED_BITS       4096
 #define UDP_MSG_MAX_PLAYERS          4
+/*
+ * Exchanged in the sync handshake, peers with another version never synchronize.
+ * 0: original protocol, the ping of the quality reports is in ms.
+ * 1: the ping of the quality reports is in us.
+ * 2: checksum messages, see ggpo_set_desync_detection.
+ * 3: compact wire format, the input size is exchanged in the sync handshake.
+ */
+#define UDP_MSG_PROTOCOL_VERSION     3
+
+/*
+ * Wire format of version 3. UdpMsg is the decoded message, UdpProtocol encodes the messages it
+ * sends and decodes the packets it receives, udp_msg_PacketSize is the size of the fixed
+ * layout sent up to version 2.
+ *
+ * Header, 3 bytes: the type in the low 4 bits of the first byte, the 12 bit sequence number
+ * in its high 4 bits and in the second byte, then an 8 bit tag of the sender magic number.
+ * The sync messages carry the whole magic number in their payload.
+ *
+ * Frames are sent as their low 16 bits and unwrapped around a frame the receiver knows: the
+ * input frames around the next one it expects, the acks around the last one it sent. The other
+ * numbers are little endian, varints are LEB128 and signed varints are zigzag encoded.
+ *
+ * Input payload: a flags byte (disconnect requested, inputs follow, and in the high 4 bits the
+ * mask of the connect status entries that follow), the ack frame, the entries as varints of
+ * their last frame minus the ack frame shifted left over the disconnected bit, then if inputs
+ * follow: the start frame, num_bits as a varint and the bits. An entry is only sent when it
+ * changed since the previous input message, and every few messages in case that one was lost.
+ */
+#define UDP_MSG_HEADER_SIZE          3
+#define UDP_MSG_SEQUENCE_MASK        0xFFF
+#define UDP_MSG_MAX_PACKET_SIZE      (UDP_MSG_HEADER_SIZE + 32 + MAX_COMPRESSED_BITS / 8)
 
 #pragma pack(push, 1)
 
@@ -22,6 +53,7 @@ enum udp_msg_MsgType {
       UdpMsg_QualityReply  = 5,
       UdpMsg_KeepAlive     = 6,
       UdpMsg_InputAck      = 7,
+      UdpMsg_Checksum      = 8,
 };
 typedef enum udp_msg_MsgType udp_msg_MsgType;
 
@@ -43,15 +75,20 @@ struct UdpMsg
          uint32      random_request;  /* please reply back with this random data */
          uint16      remote_magic;
          uint8       remote_endpoint;
+         uint8       protocol_version;
+         uint8       input_size;      /* of the inputs the sender sends, 0 if none */
       } sync_request;
       
       struct {
          uint32      random_reply;    /* OK, here's your random data back */
+         uint8       protocol_version;
+         uint8       input_size;
       } sync_reply;
       
       struct {
          int8        frame_advantage; /* what's the other guy's frame advantage? */
-         uint32      ping;
+         uint8       frame_delay;     /* the input delay the sender wants, see ggpo_set_adaptive_frame_delay */
+         uint32      ping;            /* sender clock in us, wraps around */
       } quality_report;
       
       struct {
@@ -67,13 +104,18 @@ struct UdpMsg
          int               ack_frame:31;
 
          uint16            num_bits;
-         uint8             input_size; // XXX: shouldn't be in every single packet!
+         uint8             input_size;      /* from the sync handshake, not sent */
          uint8             bits[MAX_COMPRESSED_BITS]; /* must be last */
       } input;
 
       struct {
          int               ack_frame:31;
       } input_ack;
+
+      struct {
+         int               frame;           /* confirmed frame of the sender */
+         int               checksum;        /* of the state saved before that frame */
+      } checksum;
    } u;
 };
 typedef struct UdpMsg UdpMsg;
@@ -91,6 +133,7 @@ inline int udp_msg_PayloadSize(UdpMsg* msg)
     case UdpMsg_QualityReport: return sizeof(msg->u.quality_report);
     case UdpMsg_QualityReply:  return sizeof(msg->u.quality_reply);
     case UdpMsg_InputAck:      return sizeof(msg->u.input_ack);
+    case UdpMsg_Checksum:      return sizeof(msg->u.checksum);
     case UdpMsg_KeepAlive:     return 0;
     case UdpMsg_Input:
         size = (int)((char *)&msg->u.input.bits - (char *)&msg->u.input);
@@ -32,10 +32,16 @@
 #define SYNC_FIRST_RETRY_INTERVAL 500
 #define RUNNING_RETRY_INTERVAL 200
 #define KEEP_ALIVE_INTERVAL 200
-#define QUALITY_REPORT_INTERVAL 1000
+#define QUALITY_REPORT_INTERVAL 200 // also the round trip time samples of the adaptive frame delay
 #define NETWORK_STATS_INTERVAL 1000
 #define UDP_SHUTDOWN_TIMER 5000
-#define MAX_SEQ_DISTANCE (1 << 15)
+// the intervals and timeouts are in ms, the protocol clock is in us
+#define MS_TO_US(ms) ((uint64)(ms) * 1000)
+#define MAX_SEQ_DISTANCE (1 << 11) // half of the 12 bit sequence numbers
+#define CONNECT_STATUS_REFRESH_INTERVAL 8 // input messages between two complete connect status
+// flags of the encoded input messages, the high 4 bits are the connect status mask
+#define INPUT_FLAG_DISCONNECT_REQUESTED 0x1
+#define INPUT_FLAG_BITS 0x2
 
 
 
@@ -47,6 +53,12 @@ static bool UdpProtocol_OnInputAck(UdpProtocol *protocol, UdpMsg* msg, int len);
 static bool UdpProtocol_OnQualityReport(UdpProtocol *protocol, UdpMsg* msg, int len);
 static bool UdpProtocol_OnQualityReply(UdpProtocol *protocol, UdpMsg* msg, int len);
 static bool UdpProtocol_OnKeepAlive(UdpProtocol *protocol, UdpMsg* msg, int len);
+static bool UdpProtocol_OnChecksum(UdpProtocol *protocol, UdpMsg* msg, int len);
+static int UdpProtocol_EncodeMsg(UdpProtocol *protocol, UdpMsg* msg, uint8* packet);
+static bool UdpProtocol_DecodeMsg(UdpProtocol *protocol, uint8 const* packet, int len, UdpMsg* msg);
+static uint8 UdpProtocol_MagicTag(uint16 magic);
+static bool UdpProtocol_AllocSendBuffer(UdpProtocol *protocol, int len, int *offset);
+static void UdpProtocol_PopSendQueue(UdpProtocol *protocol);
 
 void UdpProtocol_ctor(UdpProtocol* protocol)
 {
@@ -62,6 +74,8 @@ void UdpProtocol_ctor(UdpProtocol* protocol)
 	for (int i = 0; i < ARRAY_SIZE(protocol->_peer_connect_status); i++) {
 		protocol->_peer_connect_status[i].last_frame = -1;
 	}
+	// the peer starts with the same status, it is never sent until it changes
+	memcpy(protocol->_last_sent_connect_status, protocol->_peer_connect_status, sizeof(protocol->_last_sent_connect_status));
 	memset(&protocol->_peer_addr, 0, sizeof protocol->_peer_addr);
 	protocol->_oo_packet.msg = NULL;
 
@@ -78,17 +92,22 @@ void UdpProtocol_ctor(UdpProtocol* protocol)
 void UdpProtocol_dtor(UdpProtocol* protocol)
 {
 	UdpProtocol_ClearSendQueue(protocol);
+	free(protocol->_oo_packet.msg);
+	protocol->_oo_packet.msg = NULL;
 }
 
 void UdpProtocol_Init(UdpProtocol* protocol,
 	Udp* udp,
 	int queue,
 	conn_Address addr,
-	UdpMsg_connect_status* status)
+	UdpMsg_connect_status* status,
+	int input_size)
 {
+	ASSERT(input_size <= GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS);
 	protocol->_udp = udp;
 	protocol->_queue = queue;
 	protocol->_local_connect_status = status;
+	protocol->_input_size = input_size;
 
 	protocol->_peer_addr = addr;
 	// protocol->_peer_addr.sin_family = AF_INET;
@@ -125,19 +144,20 @@ void UdpProtocol_SendInput(UdpProtocol* protocol, GameInput* input)
 
 void UdpProtocol_SendPendingOutput(UdpProtocol* protocol)
 {
-	UdpMsg* msg = calloc(1, sizeof(UdpMsg));  udp_msg_ctor(msg, UdpMsg_Input);
+	UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_Input);
 	int i, j, offset = 0;
 	uint8* bits;
 	GameInput last;
 
 	if (ring_size(&protocol->_pending_output_ring)) {
 		last = protocol->_last_acked_input;
-		bits = msg->u.input.bits;
+		bits = msg.u.input.bits;
 
-		msg->u.input.start_frame = protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].frame;
-		msg->u.input.input_size = (uint8)protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].size;
+		msg.u.input.start_frame = protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].frame;
+		msg.u.input.input_size = (uint8)protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].size;
+		ASSERT(msg.u.input.input_size == protocol->_input_size);
 
-		ASSERT(last.frame == -1 || last.frame + 1 == msg->u.input.start_frame);
+		ASSERT(last.frame == -1 || last.frame + 1 == msg.u.input.start_frame);
 		for (j = 0; j < ring_size(&protocol->_pending_output_ring); j++) {
 			GameInput current = protocol->_pending_output[ring_item(&protocol->_pending_output_ring, j)];
 			if (memcmp(current.bits, last.bits, current.size) != 0) {
@@ -145,41 +165,52 @@ void UdpProtocol_SendPendingOutput(UdpProtocol* protocol)
 				for (i = 0; i < current.size * 8; i++) {
 					ASSERT(i < (1 << BITVECTOR_NIBBLE_SIZE));
 					if (gameinput_value(&current, i) != gameinput_value(&last, i)) {
-						BitVector_SetBit(msg->u.input.bits, &offset);
+						BitVector_SetBit(msg.u.input.bits, &offset);
 						(gameinput_value(&current, i) ? BitVector_SetBit : BitVector_ClearBit)(bits, &offset);
 						BitVector_WriteNibblet(bits, i, &offset);
 					}
 				}
 			}
-			BitVector_ClearBit(msg->u.input.bits, &offset);
+			BitVector_ClearBit(msg.u.input.bits, &offset);
 			last = protocol->_last_sent_input = current;
 		}
 	}
 	else {
-		msg->u.input.start_frame = 0;
-		msg->u.input.input_size = 0;
+		msg.u.input.start_frame = 0;
+		msg.u.input.input_size = 0;
 	}
-	msg->u.input.ack_frame = protocol->_last_received_input.frame;
-	msg->u.input.num_bits = (uint16)offset;
+	msg.u.input.ack_frame = protocol->_last_received_input.frame;
+	msg.u.input.num_bits = (uint16)offset;
 
-	msg->u.input.disconnect_requested = protocol->_current_state == UdpProtocol_Disconnected;
+	msg.u.input.disconnect_requested = protocol->_current_state == UdpProtocol_Disconnected;
 	if (protocol->_local_connect_status) {
-		memcpy(msg->u.input.peer_connect_status, protocol->_local_connect_status, sizeof(UdpMsg_connect_status) * UDP_MSG_MAX_PLAYERS);
+		memcpy(msg.u.input.peer_connect_status, protocol->_local_connect_status, sizeof(UdpMsg_connect_status) * UDP_MSG_MAX_PLAYERS);
 	}
 	else {
-		memset(msg->u.input.peer_connect_status, 0, sizeof(UdpMsg_connect_status) * UDP_MSG_MAX_PLAYERS);
+		memset(msg.u.input.peer_connect_status, 0, sizeof(UdpMsg_connect_status) * UDP_MSG_MAX_PLAYERS);
 	}
 
 	ASSERT(offset < MAX_COMPRESSED_BITS);
 
-	UdpProtocol_SendMsg(protocol, msg);
+	UdpProtocol_SendMsg(protocol, &msg);
 }
 
 void UdpProtocol_SendInputAck(UdpProtocol* protocol)
 {
-	UdpMsg* msg = calloc(1, sizeof(UdpMsg));  udp_msg_ctor(msg, UdpMsg_InputAck);
-	msg->u.input_ack.ack_frame = protocol->_last_received_input.frame;
-	UdpProtocol_SendMsg(protocol, msg);
+	UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_InputAck);
+	msg.u.input_ack.ack_frame = protocol->_last_received_input.frame;
+	UdpProtocol_SendMsg(protocol, &msg);
+}
+
+void UdpProtocol_SendChecksum(UdpProtocol* protocol, int frame, int checksum)
+{
+	// not resent, a lost checksum only skips one comparison
+	if (protocol->_udp && protocol->_current_state == UdpProtocol_Running) {
+		UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_Checksum);
+		msg.u.checksum.frame = frame;
+		msg.u.checksum.checksum = checksum;
+		UdpProtocol_SendMsg(protocol, &msg);
+	}
 }
 
 bool UdpProtocol_GetEvent(UdpProtocol* protocol, udp_protocol_Event* e)
@@ -199,14 +230,14 @@ bool UdpProtocol_OnLoopPoll(UdpProtocol* protocol)
 		return true;
 	}
 
-	unsigned int now = Platform_GetCurrentTimeMS();
+	uint64 now = Platform_GetCurrentTimeUS();
 	unsigned int next_interval;
 
 	UdpProtocol_PumpSendQueue(protocol);
 	switch (protocol->_current_state) {
 	case UdpProtocol_Syncing:
 		next_interval = (protocol->_state.sync.roundtrips_remaining == NUM_SYNC_PACKETS) ? SYNC_FIRST_RETRY_INTERVAL : SYNC_RETRY_INTERVAL;
-		if (protocol->_last_send_time && protocol->_last_send_time + next_interval < now) {
+		if (protocol->_last_send_time && protocol->_last_send_time + MS_TO_US(next_interval) < now) {
 			Log("No luck syncing after %d ms... Re-queueing sync packet.\n", next_interval);
 			UdpProtocol_SendSyncRequest(protocol);
 		}
@@ -214,33 +245,34 @@ bool UdpProtocol_OnLoopPoll(UdpProtocol* protocol)
 
 	case UdpProtocol_Running:
 		// xxx: rig all this up with a timer wrapper
-		if (!protocol->_state.running.last_input_packet_recv_time || protocol->_state.running.last_input_packet_recv_time + RUNNING_RETRY_INTERVAL < now) {
+		if (!protocol->_state.running.last_input_packet_recv_time || protocol->_state.running.last_input_packet_recv_time + MS_TO_US(RUNNING_RETRY_INTERVAL) < now) {
 			Log("Haven't exchanged packets in a while (last received:%d  last sent:%d).  Resending.\n", protocol->_last_received_input.frame, protocol->_last_sent_input.frame);
 			UdpProtocol_SendPendingOutput(protocol);
 			protocol->_state.running.last_input_packet_recv_time = now;
 		}
 
-		if (!protocol->_state.running.last_quality_report_time || protocol->_state.running.last_quality_report_time + QUALITY_REPORT_INTERVAL < now) {
-			UdpMsg* msg = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(msg, UdpMsg_QualityReport);
-			msg->u.quality_report.ping = Platform_GetCurrentTimeMS();
-			msg->u.quality_report.frame_advantage = (uint8)protocol->_local_frame_advantage;
-			UdpProtocol_SendMsg(protocol, msg);
+		if (!protocol->_state.running.last_quality_report_time || protocol->_state.running.last_quality_report_time + MS_TO_US(QUALITY_REPORT_INTERVAL) < now) {
+			UdpMsg msg;   udp_msg_ctor(&msg, UdpMsg_QualityReport);
+			msg.u.quality_report.ping = (uint32)now;
+			msg.u.quality_report.frame_advantage = (uint8)protocol->_local_frame_advantage;
+			msg.u.quality_report.frame_delay = (uint8)protocol->_frame_delay_request;
+			UdpProtocol_SendMsg(protocol, &msg);
 			protocol->_state.running.last_quality_report_time = now;
 		}
 
-		if (!protocol->_state.running.last_network_stats_interval || protocol->_state.running.last_network_stats_interval + NETWORK_STATS_INTERVAL < now) {
+		if (!protocol->_state.running.last_network_stats_interval || protocol->_state.running.last_network_stats_interval + MS_TO_US(NETWORK_STATS_INTERVAL) < now) {
 			UdpProtocol_UpdateNetworkStats(protocol);
 			protocol->_state.running.last_network_stats_interval = now;
 		}
 
-		if (protocol->_last_send_time && protocol->_last_send_time + KEEP_ALIVE_INTERVAL < now) {
+		if (protocol->_last_send_time && protocol->_last_send_time + MS_TO_US(KEEP_ALIVE_INTERVAL) < now) {
 			Log("Sending keep alive packet\n");
-			UdpMsg* msg = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(msg, UdpMsg_KeepAlive);
-			UdpProtocol_SendMsg(protocol, msg);
+			UdpMsg msg;   udp_msg_ctor(&msg, UdpMsg_KeepAlive);
+			UdpProtocol_SendMsg(protocol, &msg);
 		}
 
 		if (protocol->_disconnect_timeout && protocol->_disconnect_notify_start &&
-			!protocol->_disconnect_notify_sent && (protocol->_last_recv_time + protocol->_disconnect_notify_start < now)) {
+			!protocol->_disconnect_notify_sent && (protocol->_last_recv_time + MS_TO_US(protocol->_disconnect_notify_start) < now)) {
 			Log("Endpoint has stopped receiving packets for %d ms.  Sending notification.\n", protocol->_disconnect_notify_start);
 			udp_protocol_Event e = { UdpProtocol_Event_NetworkInterrupted };
 			e.u.network_interrupted.disconnect_timeout = protocol->_disconnect_timeout - protocol->_disconnect_notify_start;
@@ -248,7 +280,7 @@ bool UdpProtocol_OnLoopPoll(UdpProtocol* protocol)
 			protocol->_disconnect_notify_sent = true;
 		}
 
-		if (protocol->_disconnect_timeout && (protocol->_last_recv_time + protocol->_disconnect_timeout < now)) {
+		if (protocol->_disconnect_timeout && (protocol->_last_recv_time + MS_TO_US(protocol->_disconnect_timeout) < now)) {
 			if (!protocol->_disconnect_event_sent) {
 				Log("Endpoint has stopped receiving packets for %d ms.  Disconnecting.\n", protocol->_disconnect_timeout);
 				UdpProtocol_QueueEvent(protocol, &(udp_protocol_Event){ UdpProtocol_Event_Disconnected });
@@ -276,32 +308,398 @@ bool UdpProtocol_OnLoopPoll(UdpProtocol* protocol)
 void UdpProtocol_Disconnect(UdpProtocol* protocol)
 {
 	protocol->_current_state = UdpProtocol_Disconnected;
-	protocol->_shutdown_timeout = Platform_GetCurrentTimeMS() + UDP_SHUTDOWN_TIMER;
+	protocol->_shutdown_timeout = Platform_GetCurrentTimeUS() + MS_TO_US(UDP_SHUTDOWN_TIMER);
 }
 
 void UdpProtocol_SendSyncRequest(UdpProtocol* protocol)
 {
 	protocol->_state.sync.random = rand() & 0xFFFF;
-	UdpMsg* msg = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(msg, UdpMsg_SyncRequest);
-	msg->u.sync_request.random_request = protocol->_state.sync.random;
-	UdpProtocol_SendMsg(protocol, msg);
+	UdpMsg msg;   udp_msg_ctor(&msg, UdpMsg_SyncRequest);
+	msg.u.sync_request.random_request = protocol->_state.sync.random;
+	msg.u.sync_request.protocol_version = UDP_MSG_PROTOCOL_VERSION;
+	msg.u.sync_request.input_size = (uint8)protocol->_input_size;
+	UdpProtocol_SendMsg(protocol, &msg);
 }
 
 void UdpProtocol_SendMsg(UdpProtocol* protocol, UdpMsg* msg)
 {
 	UdpProtocol_LogMsg(protocol, "send", msg);
 
-	protocol->_packets_sent++;
-	protocol->_last_send_time = Platform_GetCurrentTimeMS();
-	protocol->_bytes_sent += udp_msg_PacketSize(msg);
-
 	msg->hdr.magic = protocol->_magic_number;
-	msg->hdr.sequence_number = protocol->_next_send_seq++;
+	msg->hdr.sequence_number = protocol->_next_send_seq;
+	protocol->_next_send_seq = (protocol->_next_send_seq + 1) & UDP_MSG_SEQUENCE_MASK;
+
+	uint8 packet[UDP_MSG_MAX_PACKET_SIZE];
+	int len = UdpProtocol_EncodeMsg(protocol, msg, packet);
+	protocol->_packets_sent++;
+	protocol->_last_send_time = Platform_GetCurrentTimeUS();
+	protocol->_bytes_sent += len;
+	protocol->_legacy_bytes_sent += udp_msg_PacketSize(msg);
 
-	protocol->_send_queue[ring_push(&protocol->_send_queue_ring)] = (udp_protocol_QueueEntry){(int)Platform_GetCurrentTimeMS(), protocol->_peer_addr, msg};
+	/*
+	 * The message is encoded on the stack, copy its bytes in the send buffer.
+	 */
+	udp_protocol_QueueEntry entry = {protocol->_last_send_time, protocol->_peer_addr, NULL, 0, len};
+	if (UdpProtocol_AllocSendBuffer(protocol, len, &entry.offset)) {
+		memcpy(protocol->_send_buffer + entry.offset, packet, len);
+	}
+	else {
+		Log("send buffer full, allocating message (seq: %d).\n", msg->hdr.sequence_number);
+		entry.heap_msg = malloc(len);
+		memcpy(entry.heap_msg, packet, len);
+		protocol->_msg_heap_allocs++;
+	}
+	protocol->_msgs_queued++;
+	protocol->_send_queue[ring_push(&protocol->_send_queue_ring)] = entry;
 	UdpProtocol_PumpSendQueue(protocol);
 }
 
+static bool UdpProtocol_AllocSendBuffer(UdpProtocol *protocol, int len, int *offset)
+{
+	int head = protocol->_send_buffer_head;
+	int tail = protocol->_send_buffer_tail;
+
+	/*
+	 * Messages are freed in the order they were queued. A message never straddles the end
+	 * of the buffer: when it does not fit it goes back to the start, and the end stays unused
+	 * until the tail wraps too. head == tail only when the buffer is empty.
+	 */
+	if (head >= tail) {
+		if (head + len > UDP_PROTO_SEND_BUFFER_SIZE) {
+			if (len >= tail) {
+				return false;
+			}
+			head = 0;
+		}
+	}
+	else if (head + len >= tail) {
+		return false;
+	}
+
+	*offset = head;
+	protocol->_send_buffer_head = head + len;
+
+	int used = head + len >= tail ? head + len - tail : UDP_PROTO_SEND_BUFFER_SIZE - tail + head + len;
+	protocol->_send_buffer_peak = MAX(protocol->_send_buffer_peak, used);
+	return true;
+}
+
+static void UdpProtocol_PopSendQueue(UdpProtocol *protocol)
+{
+	udp_protocol_QueueEntry const *entry = &protocol->_send_queue[ring_front(&protocol->_send_queue_ring)];
+	if (entry->heap_msg) {
+		free(entry->heap_msg);
+	}
+	else {
+		protocol->_send_buffer_tail = entry->offset + entry->len;
+	}
+	ring_pop(&protocol->_send_queue_ring);
+	if (ring_empty(&protocol->_send_queue_ring)) {
+		protocol->_send_buffer_head = 0;
+		protocol->_send_buffer_tail = 0;
+	}
+}
+
+/*
+ * Wire format, see udp_msg.h. The reader flags the packets that end early instead of reading
+ * past them.
+ */
+struct udp_proto_Reader
+{
+	uint8 const* cursor;
+	uint8 const* end;
+	bool         error;
+};
+typedef struct udp_proto_Reader udp_proto_Reader;
+
+static uint8 UdpProtocol_MagicTag(uint16 magic)
+{
+	return (uint8)(magic ^ (magic >> 8));
+}
+
+static uint64 UdpProtocol_Zigzag(int64 value)
+{
+	return ((uint64)value << 1) ^ (uint64)(value >> 63);
+}
+
+static int64 UdpProtocol_Unzigzag(uint64 value)
+{
+	return (int64)(value >> 1) ^ -(int64)(value & 1);
+}
+
+static void UdpProtocol_WriteU16(uint8** out, uint16 value)
+{
+	(*out)[0] = (uint8)value;
+	(*out)[1] = (uint8)(value >> 8);
+	*out += 2;
+}
+
+static void UdpProtocol_WriteU32(uint8** out, uint32 value)
+{
+	UdpProtocol_WriteU16(out, (uint16)value);
+	UdpProtocol_WriteU16(out, (uint16)(value >> 16));
+}
+
+static void UdpProtocol_WriteVarint(uint8** out, uint64 value)
+{
+	while (value >= 0x80) {
+		*(*out)++ = (uint8)(value | 0x80);
+		value >>= 7;
+	}
+	*(*out)++ = (uint8)value;
+}
+
+static uint8 UdpProtocol_ReadU8(udp_proto_Reader* in)
+{
+	if (in->cursor >= in->end) {
+		in->error = true;
+		return 0;
+	}
+	return *in->cursor++;
+}
+
+static uint16 UdpProtocol_ReadU16(udp_proto_Reader* in)
+{
+	uint16 low = UdpProtocol_ReadU8(in);
+	return (uint16)(low | (UdpProtocol_ReadU8(in) << 8));
+}
+
+static uint32 UdpProtocol_ReadU32(udp_proto_Reader* in)
+{
+	uint32 low = UdpProtocol_ReadU16(in);
+	return low | ((uint32)UdpProtocol_ReadU16(in) << 16);
+}
+
+static uint64 UdpProtocol_ReadVarint(udp_proto_Reader* in)
+{
+	uint64 value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		uint8 byte = UdpProtocol_ReadU8(in);
+		value |= (uint64)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0) {
+			return value;
+		}
+	}
+	in->error = true;
+	return 0;
+}
+
+// the frame closest to reference with the same low 16 bits
+static int UdpProtocol_ReadFrame(udp_proto_Reader* in, int reference)
+{
+	uint16 low = UdpProtocol_ReadU16(in);
+	return reference + (int16)(uint16)(low - (uint16)reference);
+}
+
+static void UdpProtocol_EncodeInput(UdpProtocol* protocol, UdpMsg* msg, uint8** out)
+{
+	/*
+	 * The entries that did not change since the last input message are not sent. That message
+	 * may have been lost, every few messages the entries the peer did not start with are sent
+	 * again, the peer keeps the largest frames so a stale entry is harmless.
+	 */
+	bool refresh = --protocol->_connect_status_refresh <= 0;
+	if (refresh) {
+		protocol->_connect_status_refresh = CONNECT_STATUS_REFRESH_INTERVAL;
+	}
+	UdpMsg_connect_status const* status = msg->u.input.peer_connect_status;
+	UdpMsg_connect_status* sent = protocol->_last_sent_connect_status;
+	uint8 flags = 0;
+	for (int i = 0; i < UDP_MSG_MAX_PLAYERS; i++) {
+		bool changed = status[i].disconnected != sent[i].disconnected || status[i].last_frame != sent[i].last_frame;
+		bool initial = !status[i].disconnected && status[i].last_frame == -1;
+		if (changed || (refresh && !initial)) {
+			flags |= (uint8)(1 << (4 + i));
+			sent[i] = status[i];
+		}
+	}
+	if (msg->u.input.disconnect_requested) {
+		flags |= INPUT_FLAG_DISCONNECT_REQUESTED;
+	}
+	if (msg->u.input.num_bits) {
+		flags |= INPUT_FLAG_BITS;
+	}
+
+	int ack_frame = msg->u.input.ack_frame;
+	*(*out)++ = flags;
+	UdpProtocol_WriteU16(out, (uint16)ack_frame);
+	for (int i = 0; i < UDP_MSG_MAX_PLAYERS; i++) {
+		if (flags & (1 << (4 + i))) {
+			uint64 delta = UdpProtocol_Zigzag((int64)status[i].last_frame - ack_frame);
+			UdpProtocol_WriteVarint(out, (delta << 1) | status[i].disconnected);
+		}
+	}
+	if (msg->u.input.num_bits) {
+		int bytes = (msg->u.input.num_bits + 7) / 8;
+		UdpProtocol_WriteU16(out, (uint16)msg->u.input.start_frame);
+		UdpProtocol_WriteVarint(out, msg->u.input.num_bits);
+		memcpy(*out, msg->u.input.bits, bytes);
+		*out += bytes;
+	}
+}
+
+static int UdpProtocol_EncodeMsg(UdpProtocol* protocol, UdpMsg* msg, uint8* packet)
+{
+	uint8* out = packet;
+	*out++ = (uint8)(msg->hdr.type | ((msg->hdr.sequence_number >> 8) << 4));
+	*out++ = (uint8)msg->hdr.sequence_number;
+	*out++ = UdpProtocol_MagicTag(msg->hdr.magic);
+
+	switch (msg->hdr.type) {
+	case UdpMsg_SyncRequest:
+		UdpProtocol_WriteU16(&out, msg->hdr.magic);
+		UdpProtocol_WriteU32(&out, msg->u.sync_request.random_request);
+		*out++ = msg->u.sync_request.protocol_version;
+		*out++ = msg->u.sync_request.input_size;
+		break;
+	case UdpMsg_SyncReply:
+		UdpProtocol_WriteU16(&out, msg->hdr.magic);
+		UdpProtocol_WriteU32(&out, msg->u.sync_reply.random_reply);
+		*out++ = msg->u.sync_reply.protocol_version;
+		*out++ = msg->u.sync_reply.input_size;
+		break;
+	case UdpMsg_Input:
+		UdpProtocol_EncodeInput(protocol, msg, &out);
+		break;
+	case UdpMsg_QualityReport:
+		*out++ = (uint8)msg->u.quality_report.frame_advantage;
+		*out++ = msg->u.quality_report.frame_delay;
+		UdpProtocol_WriteU32(&out, msg->u.quality_report.ping);
+		break;
+	case UdpMsg_QualityReply:
+		UdpProtocol_WriteU32(&out, msg->u.quality_reply.pong);
+		break;
+	case UdpMsg_KeepAlive:
+		break;
+	case UdpMsg_InputAck:
+		UdpProtocol_WriteU16(&out, (uint16)msg->u.input_ack.ack_frame);
+		break;
+	case UdpMsg_Checksum:
+		UdpProtocol_WriteVarint(&out, UdpProtocol_Zigzag(msg->u.checksum.frame));
+		UdpProtocol_WriteU32(&out, (uint32)msg->u.checksum.checksum);
+		break;
+	default:
+		ASSERT(false && "Unknown UdpMsg type.");
+	}
+	ASSERT(out - packet <= UDP_MSG_MAX_PACKET_SIZE);
+	return (int)(out - packet);
+}
+
+// The input stream is, for each frame, (1, on, button) per changed button then a 0 bit.
+// OnInput reads it without bound checks, so a stream ending in the middle of a frame is rejected here.
+static bool UdpProtocol_InputBitsValid(uint8* bits, int num_bits)
+{
+	int offset = 0;
+	while (offset < num_bits) {
+		for (;;) {
+			if (offset >= num_bits) {
+				return false;
+			}
+			if (!BitVector_ReadBit(bits, &offset)) {
+				break;
+			}
+			if (num_bits - offset < 1 + BITVECTOR_NIBBLE_SIZE) {
+				return false;
+			}
+			offset += 1;
+			int button = BitVector_ReadNibblet(bits, &offset);
+			if (button >= GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void UdpProtocol_DecodeInput(UdpProtocol* protocol, udp_proto_Reader* in, UdpMsg* msg)
+{
+	uint8 flags = UdpProtocol_ReadU8(in);
+	int ack_frame = UdpProtocol_ReadFrame(in, protocol->_last_sent_input.frame);
+	msg->u.input.disconnect_requested = (flags & INPUT_FLAG_DISCONNECT_REQUESTED) != 0;
+	msg->u.input.ack_frame = ack_frame;
+	for (int i = 0; i < UDP_MSG_MAX_PLAYERS; i++) {
+		UdpMsg_connect_status* status = &msg->u.input.peer_connect_status[i];
+		if (flags & (1 << (4 + i))) {
+			uint64 value = UdpProtocol_ReadVarint(in);
+			status->disconnected = (unsigned int)(value & 1);
+			status->last_frame = (int)(ack_frame + UdpProtocol_Unzigzag(value >> 1));
+		}
+		else {
+			// unchanged, merging it is a no-op
+			*status = protocol->_peer_connect_status[i];
+		}
+	}
+
+	msg->u.input.input_size = (uint8)protocol->_remote_input_size;
+	msg->u.input.start_frame = 0;
+	msg->u.input.num_bits = 0;
+	if (flags & INPUT_FLAG_BITS) {
+		msg->u.input.start_frame = (uint32)UdpProtocol_ReadFrame(in, protocol->_last_received_input.frame + 1);
+		uint64 num_bits = UdpProtocol_ReadVarint(in);
+		int bytes = (int)((num_bits + 7) / 8);
+		if (num_bits == 0 || num_bits >= MAX_COMPRESSED_BITS || in->end - in->cursor < bytes) {
+			in->error = true;
+			return;
+		}
+		msg->u.input.num_bits = (uint16)num_bits;
+		memcpy(msg->u.input.bits, in->cursor, bytes);
+		in->cursor += bytes;
+		if (!UdpProtocol_InputBitsValid(msg->u.input.bits, (int)num_bits)) {
+			in->error = true;
+		}
+	}
+}
+
+static bool UdpProtocol_DecodeMsg(UdpProtocol* protocol, uint8 const* packet, int len, UdpMsg* msg)
+{
+	udp_proto_Reader in = { packet, packet + len, false };
+	uint8 type = UdpProtocol_ReadU8(&in);
+	uint8 sequence_low = UdpProtocol_ReadU8(&in);
+	// the input bits are not cleared, the decoder checks that only num_bits of them are read
+	memset(msg, 0, (char*)msg->u.input.bits - (char*)msg);
+	msg->hdr.type = type & 0xf;
+	msg->hdr.sequence_number = (uint16)(((type >> 4) << 8) | sequence_low);
+	msg->hdr.magic = UdpProtocol_ReadU8(&in);
+
+	switch (msg->hdr.type) {
+	case UdpMsg_SyncRequest:
+		msg->hdr.magic = UdpProtocol_ReadU16(&in);
+		msg->u.sync_request.random_request = UdpProtocol_ReadU32(&in);
+		msg->u.sync_request.protocol_version = UdpProtocol_ReadU8(&in);
+		msg->u.sync_request.input_size = UdpProtocol_ReadU8(&in);
+		break;
+	case UdpMsg_SyncReply:
+		msg->hdr.magic = UdpProtocol_ReadU16(&in);
+		msg->u.sync_reply.random_reply = UdpProtocol_ReadU32(&in);
+		msg->u.sync_reply.protocol_version = UdpProtocol_ReadU8(&in);
+		msg->u.sync_reply.input_size = UdpProtocol_ReadU8(&in);
+		break;
+	case UdpMsg_Input:
+		UdpProtocol_DecodeInput(protocol, &in, msg);
+		break;
+	case UdpMsg_QualityReport:
+		msg->u.quality_report.frame_advantage = (int8)UdpProtocol_ReadU8(&in);
+		msg->u.quality_report.frame_delay = UdpProtocol_ReadU8(&in);
+		msg->u.quality_report.ping = UdpProtocol_ReadU32(&in);
+		break;
+	case UdpMsg_QualityReply:
+		msg->u.quality_reply.pong = UdpProtocol_ReadU32(&in);
+		break;
+	case UdpMsg_KeepAlive:
+		break;
+	case UdpMsg_InputAck:
+		msg->u.input_ack.ack_frame = UdpProtocol_ReadFrame(&in, protocol->_last_sent_input.frame);
+		break;
+	case UdpMsg_Checksum:
+		msg->u.checksum.frame = (int)UdpProtocol_Unzigzag(UdpProtocol_ReadVarint(&in));
+		msg->u.checksum.checksum = (int)UdpProtocol_ReadU32(&in);
+		break;
+	default:
+		return false; // another protocol, or not a ggpo packet
+	}
+	return !in.error;
+}
+
 bool UdpProtocol_HandlesMsg(UdpProtocol* protocol, conn_Address from, UdpMsg* msg)
 {
 	if (!protocol->_udp) {
@@ -323,23 +721,33 @@ static const DispatchFn table[] = {
 	   UdpProtocol_OnQualityReply,        /* QualityReply */
 	   UdpProtocol_OnKeepAlive,           /* KeepAlive */
 	   UdpProtocol_OnInputAck,            /* InputAck */
+	   UdpProtocol_OnChecksum,            /* Checksum */
 };
 
-void UdpProtocol_OnMsg(UdpProtocol* protocol, UdpMsg* msg, int len)
+void UdpProtocol_OnMsg(UdpProtocol* protocol, UdpMsg* packet, int len)
 {
 	bool handled = false;
 
+	// packet is the received bytes, the handlers get the decoded message
+	UdpMsg decoded;
+	UdpMsg* msg = &decoded;
+	if (!UdpProtocol_DecodeMsg(protocol, (uint8 const*)packet, len, msg)) {
+		Log("dropping malformed packet (len: %d).\n", len);
+		return;
+	}
+
 	// filter out messages that don't match what we expect
 	uint16 seq = msg->hdr.sequence_number;
 	if (msg->hdr.type != UdpMsg_SyncRequest &&
 		msg->hdr.type != UdpMsg_SyncReply) {
-		if (msg->hdr.magic != protocol->_remote_magic_number) {
+		// only the sync messages carry the whole magic number
+		if (msg->hdr.magic != UdpProtocol_MagicTag(protocol->_remote_magic_number)) {
 			UdpProtocol_LogMsg(protocol, "recv rejecting", msg);
 			return;
 		}
 
 		// filter out out-of-order packets
-		uint16 skipped = (uint16)((int)seq - (int)protocol->_next_recv_seq);
+		uint16 skipped = (uint16)((seq - protocol->_next_recv_seq) & UDP_MSG_SEQUENCE_MASK);
 		// Log("checking sequence number -> next - seq : %d - %d = %d\n", seq, protocol->_next_recv_seq, skipped);
 		if (skipped > MAX_SEQ_DISTANCE) {
 			Log("dropping out of order packet (seq: %d, last seq:%d)\n", seq, protocol->_next_recv_seq);
@@ -356,7 +764,7 @@ void UdpProtocol_OnMsg(UdpProtocol* protocol, UdpMsg* msg, int len)
 		handled = (*(table[msg->hdr.type]))(protocol, msg, len);
 	}
 	if (handled) {
-		protocol->_last_recv_time = Platform_GetCurrentTimeMS();
+		protocol->_last_recv_time = udp_RecvTime(protocol->_udp);
 		if (protocol->_disconnect_notify_sent && protocol->_current_state == UdpProtocol_Running) {
 			UdpProtocol_QueueEvent(protocol, &(udp_protocol_Event){ UdpProtocol_Event_NetworkResumed });
 			protocol->_disconnect_notify_sent = false;
@@ -366,25 +774,26 @@ void UdpProtocol_OnMsg(UdpProtocol* protocol, UdpMsg* msg, int len)
 
 void UdpProtocol_UpdateNetworkStats(UdpProtocol *protocol)
 {
-	int now = Platform_GetCurrentTimeMS();
+	uint64 now = Platform_GetCurrentTimeUS();
 
 	if (protocol->_stats_start_time == 0) {
 		protocol->_stats_start_time = now;
 	}
 
 	int total_bytes_sent = protocol->_bytes_sent + (UDP_HEADER_SIZE * protocol->_packets_sent);
-	float seconds = (float)((now - protocol->_stats_start_time) / 1000.0);
+	float seconds = (float)((now - protocol->_stats_start_time) / 1000000.0);
 	float Bps = total_bytes_sent / seconds;
 	float udp_overhead = (float)(100.0 * (UDP_HEADER_SIZE * protocol->_packets_sent) / protocol->_bytes_sent);
 
 	protocol->_kbps_sent = (int)(Bps / 1024);
 
 	Log("Network Stats -- Bandwidth: %.2f KBps   Packets Sent: %5d (%.2f pps)   "
-		"KB Sent: %.2f    UDP Overhead: %.2f %%.\n",
+		"KB Sent: %.2f (%.2f with the version 2 layout)    UDP Overhead: %.2f %%.\n",
 		protocol->_kbps_sent,
 		protocol->_packets_sent,
-		(float)protocol->_packets_sent * 1000 / (now - protocol->_stats_start_time),
+		(float)protocol->_packets_sent / seconds,
 		total_bytes_sent / 1024.0,
+		(protocol->_legacy_bytes_sent + UDP_HEADER_SIZE * protocol->_packets_sent) / 1024.0,
 		udp_overhead);
 }
 
@@ -451,6 +860,9 @@ void UdpProtocol_LogMsg(UdpProtocol *protocol, const char* prefix, UdpMsg* msg)
 	case UdpMsg_InputAck:
 		UdpProtocol_Log(protocol, "%s input ack.\n", prefix);
 		break;
+	case UdpMsg_Checksum:
+		UdpProtocol_Log(protocol, "%s checksum %08x of frame %d.\n", prefix, msg->u.checksum.checksum, msg->u.checksum.frame);
+		break;
 	default:
 		ASSERT(false && "Unknown UdpMsg type.");
 	}
@@ -476,9 +888,20 @@ bool UdpProtocol_OnSyncRequest(UdpProtocol *protocol, UdpMsg* msg, int len)
 			msg->hdr.magic, protocol->_remote_magic_number);
 		return false;
 	}
-	UdpMsg* reply = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(reply, UdpMsg_SyncReply);
-	reply->u.sync_reply.random_reply = msg->u.sync_request.random_request;
-	UdpProtocol_SendMsg(protocol, reply);
+	if (msg->u.sync_request.protocol_version != UDP_MSG_PROTOCOL_VERSION) {
+		Log("Ignoring sync request with another protocol version.\n");
+		return false;
+	}
+	if (msg->u.sync_request.input_size > GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS) {
+		Log("Ignoring sync request with %d bytes inputs.\n", msg->u.sync_request.input_size);
+		return false;
+	}
+	protocol->_remote_input_size = msg->u.sync_request.input_size;
+	UdpMsg reply;   udp_msg_ctor(&reply, UdpMsg_SyncReply);
+	reply.u.sync_reply.random_reply = msg->u.sync_request.random_request;
+	reply.u.sync_reply.protocol_version = UDP_MSG_PROTOCOL_VERSION;
+	reply.u.sync_reply.input_size = (uint8)protocol->_input_size;
+	UdpProtocol_SendMsg(protocol, &reply);
 	return true;
 }
 
@@ -489,6 +912,15 @@ bool UdpProtocol_OnSyncReply(UdpProtocol *protocol, UdpMsg* msg, int len)
 		return msg->hdr.magic == protocol->_remote_magic_number;
 	}
 
+	if (msg->u.sync_reply.protocol_version != UDP_MSG_PROTOCOL_VERSION) {
+		Log("Ignoring sync reply with another protocol version.\n");
+		return false;
+	}
+	if (msg->u.sync_reply.input_size > GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS) {
+		Log("Ignoring sync reply with %d bytes inputs.\n", msg->u.sync_reply.input_size);
+		return false;
+	}
+
 	if (msg->u.sync_reply.random_reply != protocol->_state.sync.random) {
 		Log("sync reply %d != %d.  Keep looking...\n",
 			msg->u.sync_reply.random_reply, protocol->_state.sync.random);
@@ -505,8 +937,11 @@ bool UdpProtocol_OnSyncReply(UdpProtocol *protocol, UdpMsg* msg, int len)
 		Log("Synchronized!\n");
 		UdpProtocol_QueueEvent(protocol, &(udp_protocol_Event){ UdpProtocol_Event_Synchronzied });
 		protocol->_current_state = UdpProtocol_Running;
+		// the running timers share their storage with the sync state
+		memset(&protocol->_state.running, 0, sizeof(protocol->_state.running));
 		protocol->_last_received_input.frame = -1;
 		protocol->_remote_magic_number = msg->hdr.magic;
+		protocol->_remote_input_size = msg->u.sync_reply.input_size;
 	}
 	else {
 		udp_protocol_Event evt = { UdpProtocol_Event_Synchronizing };
@@ -600,7 +1035,7 @@ bool UdpProtocol_OnInput(UdpProtocol *protocol, UdpMsg* msg, int len)
 
 				gameinput_desc(&protocol->_last_received_input, desc, ARRAY_SIZE(desc), true);
 
-				protocol->_state.running.last_input_packet_recv_time = Platform_GetCurrentTimeMS();
+				protocol->_state.running.last_input_packet_recv_time = udp_RecvTime(protocol->_udp);
 
 				Log("Sending frame %d to emu queue %d (%s).\n", protocol->_last_received_input.frame, protocol->_queue, desc);
 				UdpProtocol_QueueEvent(protocol, &evt);
@@ -643,23 +1078,55 @@ bool UdpProtocol_OnInputAck(UdpProtocol *protocol, UdpMsg* msg, int len)
 	return true;
 }
 
+bool UdpProtocol_OnChecksum(UdpProtocol *protocol, UdpMsg* msg, int len)
+{
+	udp_protocol_Event evt = { UdpProtocol_Event_Checksum };
+	evt.u.checksum.frame = msg->u.checksum.frame;
+	evt.u.checksum.checksum = msg->u.checksum.checksum;
+	UdpProtocol_QueueEvent(protocol, &evt);
+	return true;
+}
+
 bool UdpProtocol_OnQualityReport(UdpProtocol *protocol, UdpMsg* msg, int len)
 {
 	// send a reply so the other side can compute the round trip transmit time.
-	UdpMsg* reply = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(reply, UdpMsg_QualityReply);
-	reply->u.quality_reply.pong = msg->u.quality_report.ping;
-	UdpProtocol_SendMsg(protocol, reply);
+	UdpMsg reply;   udp_msg_ctor(&reply, UdpMsg_QualityReply);
+	reply.u.quality_reply.pong = msg->u.quality_report.ping;
+	UdpProtocol_SendMsg(protocol, &reply);
 
 	protocol->_remote_frame_advantage = msg->u.quality_report.frame_advantage;
+	protocol->_remote_frame_delay_request = msg->u.quality_report.frame_delay;
 	return true;
 }
 
 bool UdpProtocol_OnQualityReply(UdpProtocol *protocol, UdpMsg* msg, int len)
 {
-	protocol->_round_trip_time = Platform_GetCurrentTimeMS() - msg->u.quality_reply.pong;
+	// arrival time, the round trip does not include the time until the game thread polls.
+	// The pong is the low 32 bits of our clock, the unsigned difference survives the wrap around.
+	uint32 rtt_us = (uint32)udp_RecvTime(protocol->_udp) - msg->u.quality_reply.pong;
+	protocol->_round_trip_time = (int)rtt_us;
+
+	// smoothed round trip time and mean deviation, like the TCP retransmission timer (RFC 6298)
+	float rtt = (float)rtt_us / 1000.0f;
+	if (protocol->_rtt_samples == 0) {
+		protocol->_rtt_avg = rtt;
+		protocol->_rtt_deviation = rtt / 2;
+	} else {
+		float error = rtt - protocol->_rtt_avg;
+		protocol->_rtt_deviation += ((error < 0 ? -error : error) - protocol->_rtt_deviation) / 4;
+		protocol->_rtt_avg += error / 8;
+	}
+	protocol->_rtt_samples++;
 	return true;
 }
 
+bool UdpProtocol_GetRoundTripTime(UdpProtocol *protocol, float *rtt, float *deviation)
+{
+	*rtt = protocol->_rtt_avg;
+	*deviation = protocol->_rtt_deviation;
+	return protocol->_rtt_samples > 0;
+}
+
 bool UdpProtocol_OnKeepAlive(UdpProtocol *protocol, UdpMsg* msg, int len)
 {
 	return true;
@@ -667,9 +1134,15 @@ bool UdpProtocol_OnKeepAlive(UdpProtocol *protocol, UdpMsg* msg, int len)
 
 void UdpProtocol_GetNetworkStats(UdpProtocol *protocol, struct GGPONetworkStats* s)
 {
-	s->network.ping = protocol->_round_trip_time;
+	s->network.ping = protocol->_round_trip_time / 1000;
+	s->network.ping_us = protocol->_round_trip_time;
 	s->network.send_queue_len = ring_size(&protocol->_pending_output_ring);
 	s->network.kbps_sent = protocol->_kbps_sent;
+	s->network.bytes_sent = protocol->_bytes_sent;
+	s->network.legacy_bytes_sent = protocol->_legacy_bytes_sent;
+	s->network.msgs_queued = protocol->_msgs_queued;
+	s->network.msg_heap_allocs = protocol->_msg_heap_allocs;
+	s->network.send_buffer_peak = protocol->_send_buffer_peak;
 	s->timesync.remote_frames_behind = protocol->_remote_frame_advantage;
 	s->timesync.local_frames_behind = protocol->_local_frame_advantage;
 }
@@ -681,7 +1154,7 @@ void UdpProtocol_SetLocalFrameNumber(UdpProtocol *protocol, int localFrame)
 	 * last frame they gave us plus some delta for the one-way packet
 	 * trip time.
 	 */
-	int remoteFrame = protocol->_last_received_input.frame + (protocol->_round_trip_time * 60 / 1000);
+	int remoteFrame = protocol->_last_received_input.frame + (int)((int64)protocol->_round_trip_time * 60 / 1000000);
 
 	/*
 	 * Our frame advantage is how many frames *behind* the other guy
@@ -698,6 +1171,11 @@ int UdpProtocol_RecommendFrameDelay(UdpProtocol *protocol)
 	return timesync_recommend_frame_wait_duration(&protocol->_timesync, false);
 }
 
+float UdpProtocol_RecommendFrameDilation(UdpProtocol *protocol)
+{
+	return timesync_recommend_frame_dilation(&protocol->_timesync);
+}
+
 
 void UdpProtocol_SetDisconnectTimeout(UdpProtocol *protocol, int timeout)
 {
@@ -713,34 +1191,37 @@ void UdpProtocol_PumpSendQueue(UdpProtocol *protocol)
 {
 	while (!ring_empty(&protocol->_send_queue_ring)) {
 		udp_protocol_QueueEntry const entry = protocol->_send_queue[ring_front(&protocol->_send_queue_ring)];
+		uint8* packet = entry.heap_msg ? entry.heap_msg : protocol->_send_buffer + entry.offset;
 
 		if (protocol->_send_latency) {
 			// should really come up with a gaussian distributation based on the configured
 			// value, but this will do for now.
 			int jitter = (protocol->_send_latency * 2 / 3) + ((rand() % protocol->_send_latency) / 3);
-			if (Platform_GetCurrentTimeMS() < protocol->_send_queue[ring_front(&protocol->_send_queue_ring)].queue_time + jitter) {
+			if (Platform_GetCurrentTimeUS() < entry.queue_time + MS_TO_US(jitter)) {
 				break;
 			}
 		}
 		if (protocol->_oop_percent && !protocol->_oo_packet.msg && ((rand() % 100) < protocol->_oop_percent)) {
 			int delay = rand() % (protocol->_send_latency * 10 + 1000);
-			Log("creating rogue oop (seq: %d  delay: %d)\n", entry.msg->hdr.sequence_number, delay);
-			protocol->_oo_packet.send_time = Platform_GetCurrentTimeMS() + delay;
-			protocol->_oo_packet.msg = entry.msg;
+			Log("creating rogue oop (len: %d  delay: %d)\n", entry.len, delay);
+			// debug only, the message outlives its queue entry
+			protocol->_oo_packet.send_time = Platform_GetCurrentTimeUS() + MS_TO_US(delay);
+			protocol->_oo_packet.msg = malloc(entry.len);
+			memcpy(protocol->_oo_packet.msg, packet, entry.len);
+			protocol->_oo_packet.len = entry.len;
 			protocol->_oo_packet.dest_addr = entry.dest_addr;
+			protocol->_msg_heap_allocs++;
 		}
 		else {
 			ASSERT(entry.dest_addr);
 
-			udp_SendTo(protocol->_udp, (char*)entry.msg, udp_msg_PacketSize(entry.msg), 0, entry.dest_addr);
-
-			free(entry.msg);
+			udp_SendTo(protocol->_udp, (char*)packet, entry.len, 0, entry.dest_addr);
 		}
-		ring_pop(&protocol->_send_queue_ring);
+		UdpProtocol_PopSendQueue(protocol);
 	}
-	if (protocol->_oo_packet.msg && protocol->_oo_packet.send_time < Platform_GetCurrentTimeMS()) {
+	if (protocol->_oo_packet.msg && protocol->_oo_packet.send_time < Platform_GetCurrentTimeUS()) {
 		Log("sending rogue oop!");
-		udp_SendTo(protocol->_udp, (char*)protocol->_oo_packet.msg, udp_msg_PacketSize(protocol->_oo_packet.msg), 0,
+		udp_SendTo(protocol->_udp, (char*)protocol->_oo_packet.msg, protocol->_oo_packet.len, 0,
 			   protocol->_oo_packet.dest_addr);
 
 		free(protocol->_oo_packet.msg);
@@ -751,7 +1232,6 @@ void UdpProtocol_PumpSendQueue(UdpProtocol *protocol)
 void UdpProtocol_ClearSendQueue(UdpProtocol *protocol)
 {
 	while (!ring_empty(&protocol->_send_queue_ring)) {
-		free(protocol->_send_queue[ring_front(&protocol->_send_queue_ring)].msg);
-		ring_pop(&protocol->_send_queue_ring);
+		UdpProtocol_PopSendQueue(protocol);
 	}
 }
@@ -50,6 +50,7 @@ enum udp_protocol_EventType {
 			UdpProtocol_Event_Disconnected,
 			UdpProtocol_Event_NetworkInterrupted,
 			UdpProtocol_Event_NetworkResumed,
+			UdpProtocol_Event_Checksum,
 };
 typedef enum udp_protocol_EventType udp_protocol_EventType;
 
@@ -66,6 +67,10 @@ struct udp_protocol_Event {
 			struct {
 				int         disconnect_timeout;
 			} network_interrupted;
+			struct {
+				int         frame;
+				int         checksum;
+			} checksum;
 		} u;
 };
 typedef struct udp_protocol_Event udp_protocol_Event;
@@ -79,11 +84,19 @@ enum udp_protocol_State
 };
 typedef enum udp_protocol_State udp_protocol_State;
 
+/*
+ * Queued messages are encoded in a byte ring inside the protocol, using only their encoded
+ * length. The heap is only used when the ring is full or for the debug out of order packet.
+ */
+#define UDP_PROTO_SEND_BUFFER_SIZE 8192
+
 struct udp_protocol_QueueEntry
 {
-		int         queue_time;
+		uint64      queue_time;
 		conn_Address dest_addr;
-		UdpMsg* msg;
+		uint8* heap_msg;            /* NULL if the message is in _send_buffer */
+		int         offset;         /* in _send_buffer */
+		int         len;
 };
 typedef struct udp_protocol_QueueEntry udp_protocol_QueueEntry;
 
@@ -101,27 +114,46 @@ struct UdpProtocol
 	int            _send_latency;
 	int            _oop_percent;
 	struct {
-		int         send_time;
+		uint64      send_time;
 		conn_Address dest_addr;
-		UdpMsg* msg;
+		uint8* msg;
+		int         len;
 	}              _oo_packet;
 	RingBuffer _send_queue_ring;
 	udp_protocol_QueueEntry _send_queue[64];
+	uint8          _send_buffer[UDP_PROTO_SEND_BUFFER_SIZE];
+	int            _send_buffer_head;
+	int            _send_buffer_tail;
 
 	/*
-	 * Stats
+	 * Stats, the times are in us from Platform_GetCurrentTimeUS
 	 */
-	int            _round_trip_time;
+	int            _round_trip_time; // last sample, in us
+	float          _rtt_avg;       // smoothed round trip time and deviation, in ms
+	float          _rtt_deviation;
+	int            _rtt_samples;
 	int            _packets_sent;
 	int            _bytes_sent;
+	int            _legacy_bytes_sent; // the same messages in the fixed layout of the version 2
 	int            _kbps_sent;
-	int            _stats_start_time;
+	uint64         _stats_start_time;
+	int            _msgs_queued;
+	int            _msg_heap_allocs;
+	int            _send_buffer_peak;
 
 	/*
 	 * The state machine
 	 */
 	UdpMsg_connect_status* _local_connect_status;
 	UdpMsg_connect_status _peer_connect_status[UDP_MSG_MAX_PLAYERS];
+	UdpMsg_connect_status _last_sent_connect_status[UDP_MSG_MAX_PLAYERS]; // only the changes are sent
+	int            _connect_status_refresh; // input messages until the whole status is sent again
+
+	/*
+	 * Bytes of the inputs sent by each side, exchanged in the sync handshake.
+	 */
+	int            _input_size;
+	int            _remote_input_size;
 
 	udp_protocol_State          _current_state;
 	union {
@@ -130,9 +162,9 @@ struct UdpProtocol
 			uint32   random;
 		} sync;
 		struct {
-			uint32   last_quality_report_time;
-			uint32   last_network_stats_interval;
-			uint32   last_input_packet_recv_time;
+			uint64   last_quality_report_time;
+			uint64   last_network_stats_interval;
+			uint64   last_input_packet_recv_time;
 		} running;
 	} _state;
 
@@ -141,6 +173,8 @@ struct UdpProtocol
 	 */
 	int               _local_frame_advantage;
 	int               _remote_frame_advantage;
+	int               _frame_delay_request; // input delays wanted by each side
+	int               _remote_frame_delay_request;
 
 	/*
 	 * Packet loss...
@@ -150,9 +184,9 @@ struct UdpProtocol
 	GameInput                  _last_received_input;
 	GameInput                  _last_sent_input;
 	GameInput                  _last_acked_input;
-	unsigned int               _last_send_time;
-	unsigned int               _last_recv_time;
-	unsigned int               _shutdown_timeout;
+	uint64                     _last_send_time;
+	uint64                     _last_recv_time;
+	uint64                     _shutdown_timeout;
 	unsigned int               _disconnect_event_sent;
 	unsigned int               _disconnect_timeout;
 	unsigned int               _disconnect_notify_start;
@@ -181,7 +215,7 @@ typedef struct UdpProtocol UdpProtocol;
 	bool UdpProtocol_OnLoopPoll(UdpProtocol *protocol);
 
 
-	void UdpProtocol_Init(UdpProtocol *protocol, Udp* udp, int queue, conn_Address addr, UdpMsg_connect_status* status);
+	void UdpProtocol_Init(UdpProtocol *protocol, Udp* udp, int queue, conn_Address addr, UdpMsg_connect_status* status, int input_size);
 
 	void UdpProtocol_Synchronize(UdpProtocol *protocol);
 	bool UdpProtocol_GetPeerConnectStatus(UdpProtocol *protocol, int id, int* frame);
@@ -190,6 +224,7 @@ typedef struct UdpProtocol UdpProtocol;
 	inline bool UdpProtocol_IsRunning(UdpProtocol *protocol) { return protocol->_current_state == UdpProtocol_Running; }
 	void UdpProtocol_SendInput(UdpProtocol *protocol, GameInput* input);
 	void UdpProtocol_SendInputAck(UdpProtocol *protocol);
+	void UdpProtocol_SendChecksum(UdpProtocol *protocol, int frame, int checksum);
 	bool UdpProtocol_HandlesMsg(UdpProtocol *protocol, conn_Address from, UdpMsg* msg);
 	void UdpProtocol_OnMsg(UdpProtocol *protocol, UdpMsg* msg, int len);
 	void UdpProtocol_Disconnect(UdpProtocol *protocol);
@@ -199,6 +234,10 @@ typedef struct UdpProtocol UdpProtocol;
 	void UdpProtocol_GGPONetworkStats(UdpProtocol *protocol, udp_protocol_Stats* stats);
 	void UdpProtocol_SetLocalFrameNumber(UdpProtocol *protocol, int num);
 	int UdpProtocol_RecommendFrameDelay(UdpProtocol *protocol);
+	float UdpProtocol_RecommendFrameDilation(UdpProtocol *protocol);
+	bool UdpProtocol_GetRoundTripTime(UdpProtocol *protocol, float *rtt, float *deviation);
+	inline void UdpProtocol_SetFrameDelayRequest(UdpProtocol *protocol, int delay) { protocol->_frame_delay_request = delay; }
+	inline int UdpProtocol_GetRemoteFrameDelayRequest(UdpProtocol *protocol) { return protocol->_remote_frame_delay_request; }
 
 	void UdpProtocol_SetDisconnectTimeout(UdpProtocol *protocol, int timeout);
 	void UdpProtocol_SetDisconnectNotifyStart(UdpProtocol *protocol, int timeout);
@@ -9,14 +9,18 @@
 #include "types.h"
 #include "platform_linux.h"
 
+// written once by Platform_Init, read by the game and the receive threads
 struct timespec start = { 0 };
 
-uint32 Platform_GetCurrentTimeMS()
+void Platform_Init()
 {
     if (start.tv_sec == 0 && start.tv_nsec == 0) {
         clock_gettime(CLOCK_MONOTONIC, &start);
-        return 0;
     }
+}
+
+uint32 Platform_GetCurrentTimeMS()
+{
     struct timespec current;
     clock_gettime(CLOCK_MONOTONIC, &current);
 
@@ -24,6 +28,51 @@ uint32 Platform_GetCurrentTimeMS()
 	    ((current.tv_nsec  - start.tv_nsec ) / 1000000);
 }
 
+uint64 Platform_GetCurrentTimeUS()
+{
+    struct timespec current;
+    clock_gettime(CLOCK_MONOTONIC, &current);
+    return (uint64)current.tv_sec * 1000000 + (uint64)current.tv_nsec / 1000;
+}
+
 int Platform_GetConfigInt(const char* name) { return 0; }
 bool Platform_GetConfigBool(const char* name) { return false; }
+
+struct PlatformThread
+{
+    pthread_t handle;
+    Platform_ThreadFn fn;
+    void* user_data;
+};
+
+static void* Platform_ThreadMain(void* arg)
+{
+    PlatformThread* thread = (PlatformThread*)arg;
+    thread->fn(thread->user_data);
+    return NULL;
+}
+
+PlatformThread* Platform_CreateThread(Platform_ThreadFn fn, void* user_data)
+{
+    PlatformThread* thread = (PlatformThread*)calloc(1, sizeof(PlatformThread));
+    thread->fn = fn;
+    thread->user_data = user_data;
+    if (pthread_create(&thread->handle, NULL, Platform_ThreadMain, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void Platform_JoinThread(PlatformThread* thread)
+{
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+void Platform_SleepMS(int ms)
+{
+    struct timespec duration = { ms / 1000, (ms % 1000) * 1000000 };
+    nanosleep(&duration, NULL);
+}
 #endif
\ No newline at end of file
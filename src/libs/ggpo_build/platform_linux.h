@@ -9,6 +9,7 @@
 #define _GGPO_LINUX_H_
 
 #define _POSIX_C_SOURCE 199309L // We need this POSIX standard for clock_gettime
+#define _GNU_SOURCE // recvmmsg, sendmmsg
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -20,6 +21,7 @@
 #include <limits.h>
 #include <time.h>
 #include <stdint.h>
+#include <pthread.h>
 
 typedef uint64 ProcessID;
 
@@ -44,8 +46,21 @@ inline void DebugBreak()
 
 inline ProcessID Platform_GetProcessID() { return (ProcessID)getpid(); }
 inline void Platform_AssertFailed(char *msg) {}
+// called by the session constructors, before any network thread starts
+void Platform_Init();
 uint32 Platform_GetCurrentTimeMS();
+uint64 Platform_GetCurrentTimeUS();
 int Platform_GetConfigInt(const char* name);
 bool Platform_GetConfigBool(const char* name);
 
+typedef struct PlatformThread PlatformThread;
+typedef void (*Platform_ThreadFn)(void* user_data);
+PlatformThread* Platform_CreateThread(Platform_ThreadFn fn, void* user_data);
+void Platform_JoinThread(PlatformThread* thread);
+void Platform_SleepMS(int ms);
+
+inline uint32 Platform_AtomicLoad(volatile uint32* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+inline void Platform_AtomicStore(volatile uint32* p, uint32 value) { __atomic_store_n(p, value, __ATOMIC_RELEASE); }
+#define PLATFORM_THREAD_LOCAL _Thread_local
+
 #endif
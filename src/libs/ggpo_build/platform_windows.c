@@ -31,4 +31,58 @@ bool Platform_GetConfigBool(const char* name)
    return atoi(buf) != 0 || _stricmp(buf, "true") == 0;
 }
 
+// written once by Platform_Init, read by the game and the receive threads
+static LARGE_INTEGER frequency;
+
+void Platform_Init()
+{
+   if (frequency.QuadPart == 0) {
+      QueryPerformanceFrequency(&frequency);
+   }
+}
+
+uint64 Platform_GetCurrentTimeUS()
+{
+   LARGE_INTEGER counter;
+   QueryPerformanceCounter(&counter);
+   // split to avoid overflowing counter * 1000000
+   uint64 seconds = (uint64)(counter.QuadPart / frequency.QuadPart);
+   uint64 remainder = (uint64)(counter.QuadPart % frequency.QuadPart);
+   return seconds * 1000000 + remainder * 1000000 / (uint64)frequency.QuadPart;
+}
+
+struct PlatformThread
+{
+   HANDLE handle;
+   Platform_ThreadFn fn;
+   void* user_data;
+};
+
+static DWORD WINAPI Platform_ThreadMain(LPVOID arg)
+{
+   PlatformThread* thread = (PlatformThread*)arg;
+   thread->fn(thread->user_data);
+   return 0;
+}
+
+PlatformThread* Platform_CreateThread(Platform_ThreadFn fn, void* user_data)
+{
+   PlatformThread* thread = (PlatformThread*)calloc(1, sizeof(PlatformThread));
+   thread->fn = fn;
+   thread->user_data = user_data;
+   thread->handle = CreateThread(NULL, 0, Platform_ThreadMain, thread, 0, NULL);
+   if (thread->handle == NULL) {
+      free(thread);
+      return NULL;
+   }
+   return thread;
+}
+
+void Platform_JoinThread(PlatformThread* thread)
+{
+   WaitForSingleObject(thread->handle, INFINITE);
+   CloseHandle(thread->handle);
+   free(thread);
+}
+
 #endif
@@ -19,8 +19,22 @@ typedef uint64 ProcessID;
 
 inline ProcessID Platform_GetProcessID() { return (ProcessID)GetCurrentProcessId(); }
    inline void Platform_AssertFailed(char *msg) { MessageBoxA(NULL, msg, "GGPO Assertion Failed", MB_OK | MB_ICONEXCLAMATION); }
+   // called by the session constructors, before any network thread starts
+   void Platform_Init();
    inline uint32 Platform_GetCurrentTimeMS() { return timeGetTime(); }
+   uint64 Platform_GetCurrentTimeUS();
    int Platform_GetConfigInt(const char* name);
    bool Platform_GetConfigBool(const char* name);
 
+   typedef struct PlatformThread PlatformThread;
+   typedef void (*Platform_ThreadFn)(void* user_data);
+   PlatformThread* Platform_CreateThread(Platform_ThreadFn fn, void* user_data);
+   void Platform_JoinThread(PlatformThread* thread);
+   inline void Platform_SleepMS(int ms) { Sleep(ms); }
+
+   // Interlocked functions are full barriers
+   inline uint32 Platform_AtomicLoad(volatile uint32* p) { return (uint32)InterlockedCompareExchange((volatile LONG*)p, 0, 0); }
+   inline void Platform_AtomicStore(volatile uint32* p, uint32 value) { InterlockedExchange((volatile LONG*)p, (LONG)value); }
+#  define PLATFORM_THREAD_LOCAL __declspec(thread)
+
 #endif
@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+#ifndef _SPSC_RING_H
+#define _SPSC_RING_H
+
+#include "types.h"
+
+/*
+ * Indices of a ring shared by exactly one producer thread and one consumer thread, the items
+ * live in an array next to it like with RingBuffer.
+ *
+ * Unlike RingBuffer there is no shared size: the producer only writes _head, the consumer only
+ * writes _tail. An item is written between spsc_push_begin and spsc_push_end, and is visible to
+ * the consumer after spsc_push_end. N must be a power of two.
+ */
+struct SpscRing
+{
+   volatile uint32 _head;
+   volatile uint32 _tail;
+   uint32 _mask;
+};
+typedef struct SpscRing SpscRing;
+
+inline void spsc_ctor(SpscRing* ring, uint32 N)
+{
+   ASSERT(N != 0 && (N & (N - 1)) == 0);
+   ring->_head = 0;
+   ring->_tail = 0;
+   ring->_mask = N - 1;
+}
+
+// Producer: returns the item to write, or -1 if the ring is full
+inline int spsc_push_begin(SpscRing* ring)
+{
+   uint32 head = ring->_head;
+   if (head - Platform_AtomicLoad(&ring->_tail) > ring->_mask) {
+      return -1;
+   }
+   return (int)(head & ring->_mask);
+}
+
+inline void spsc_push_end(SpscRing* ring)
+{
+   Platform_AtomicStore(&ring->_head, ring->_head + 1);
+}
+
+// Consumer: returns the item to read, or -1 if the ring is empty
+inline int spsc_pop_begin(SpscRing* ring)
+{
+   uint32 tail = ring->_tail;
+   if (Platform_AtomicLoad(&ring->_head) == tail) {
+      return -1;
+   }
+   return (int)(tail & ring->_mask);
+}
+
+inline void spsc_pop_end(SpscRing* ring)
+{
+   Platform_AtomicStore(&ring->_tail, ring->_tail + 1);
+}
+
+#endif
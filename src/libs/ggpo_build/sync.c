@@ -41,6 +41,7 @@ void sync_ctor(Sync* sync, UdpMsg_connect_status* connect_status)
    memset(&sync->_savedstate, 0, sizeof(sync->_savedstate));
 
    ring_ctor(&sync->_event_queue_ring, ARRAY_SIZE(sync->_event_queue));
+   metrics_Init(&sync->_metrics);
 }
 
 void sync_dtor(Sync* sync)
@@ -83,11 +84,24 @@ void sync_SetFrameDelay(Sync* sync, int queue, int delay)
         input_queue_SetFrameDelay(&sync->_input_queues[queue], delay);
 }
 
+void sync_SetInputPredictor(Sync* sync, GGPOInputPredictor const* predictor)
+{
+        sync->_has_predictor = predictor != NULL;
+        if (predictor) {
+                ASSERT(predictor->predict);
+                sync->_predictor = *predictor;
+        }
+        for (int i = 0; i < sync->_config.num_players; i++) {
+                input_queue_SetPredictor(&sync->_input_queues[i], sync->_has_predictor ? &sync->_predictor : NULL);
+        }
+}
+
 bool sync_AddLocalInput(Sync* sync, int queue, GameInput* input)
 {
    int frames_behind = sync->_framecount - sync->_last_confirmed_frame;
    if (sync->_framecount >= sync->_max_prediction_frames && frames_behind >= sync->_max_prediction_frames) {
       Log("Rejecting input from emulator: reached prediction barrier.\n");
+      metrics_RecordStall(&sync->_metrics);
       return false;
    }
 
@@ -164,6 +178,7 @@ void sync_AdjustSimulation(Sync* sync, int seek_to)
 
    Log("Catching up\n");
    sync->_rollingback = true;
+   uint64 rollback_start = Platform_GetCurrentTimeUS();
 
    /*
     * Flush our input queue and load the last frame.
@@ -177,11 +192,14 @@ void sync_AdjustSimulation(Sync* sync, int seek_to)
     */
    _sync_ResetPrediction(sync, sync->_framecount);
    for (int i = 0; i < count; i++) {
+      uint64 advance_start = Platform_GetCurrentTimeUS();
       sync->_callbacks.advance_frame(0);
+      metrics_RecordAdvance(&sync->_metrics, (uint32)(Platform_GetCurrentTimeUS() - advance_start));
    }
    ASSERT(sync->_framecount == framecount);
 
    sync->_rollingback = false;
+   metrics_RecordRollback(&sync->_metrics, count, (uint32)(Platform_GetCurrentTimeUS() - rollback_start));
 
    Log("---\n");
 }
@@ -189,6 +207,9 @@ void sync_AdjustSimulation(Sync* sync, int seek_to)
 void sync_IncrementFrame(Sync* sync)
 {
         sync->_framecount++;
+        if (!sync->_rollingback) {
+                metrics_BeginFrame(&sync->_metrics, sync->_framecount);
+        }
         sync_SaveCurrentFrame(sync);
 }
 
@@ -223,7 +244,9 @@ void sync_SaveCurrentFrame(Sync* sync)
                 state->buf = NULL;
         }
         state->frame = sync->_framecount;
+        uint64 save_start = Platform_GetCurrentTimeUS();
         sync->_callbacks.save_game_state(&state->buf, &state->cbuf, &state->checksum, state->frame);
+        metrics_RecordSave(&sync->_metrics, (uint32)(Platform_GetCurrentTimeUS() - save_start));
 
         Log("=== Saved frame info %d (size: %d  checksum: %08x).\n", state->frame, state->cbuf, state->checksum);
         sync->_savedstate.head = (sync->_savedstate.head + 1) % ARRAY_SIZE(sync->_savedstate.frames);
@@ -245,7 +268,9 @@ void sync_LoadFrame(Sync* sync, int frame)
        state->frame, state->cbuf, state->checksum);
 
    ASSERT(state->buf && state->cbuf);
+   uint64 load_start = Platform_GetCurrentTimeUS();
    sync->_callbacks.load_game_state(state->buf, state->cbuf);
+   metrics_RecordLoad(&sync->_metrics, (uint32)(Platform_GetCurrentTimeUS() - load_start));
 
    // Reset framecount and the head of the state ring-buffer to point in
    // advance of the current frame (as if we had just finished executing it).
@@ -253,6 +278,18 @@ void sync_LoadFrame(Sync* sync, int frame)
    sync->_savedstate.head = (sync->_savedstate.head + 1) % ARRAY_SIZE(sync->_savedstate.frames);
 }
 
+// The checksum of a frame still in the saved states, the last one saved if it was resimulated
+bool sync_GetSavedChecksum(Sync* sync, int frame, int* checksum)
+{
+   for (int i = 0; i < ARRAY_SIZE(sync->_savedstate.frames); i++) {
+      if (sync->_savedstate.frames[i].buf && sync->_savedstate.frames[i].frame == frame) {
+         *checksum = sync->_savedstate.frames[i].checksum;
+         return true;
+      }
+   }
+   return false;
+}
+
 static int _sync_FindSavedFrameIndex(Sync* sync, int frame)
 {
    int i, count = ARRAY_SIZE(sync->_savedstate.frames);
@@ -273,6 +310,7 @@ static bool _sync_CreateQueues(Sync* sync, sync_Config *config)
    sync->_input_queues = calloc(sync->_config.num_players, sizeof(InputQueue));
    for (int i = 0; i < sync->_config.num_players; i++) {
       input_queue_Init(&sync->_input_queues[i], i, sync->_config.input_size);
+      input_queue_SetPredictor(&sync->_input_queues[i], sync->_has_predictor ? &sync->_predictor : NULL);
    }
    return true;
 }
@@ -284,6 +322,9 @@ static bool _sync_CheckSimulationConsistency(Sync* sync, int *seekTo)
       int incorrect = input_queue_GetFirstIncorrectFrame(&sync->_input_queues[i]);
       Log("considering incorrect frame %d reported by queue %d.\n", incorrect, i);
 
+      if (incorrect != GAMEINPUT_NULL_FRAME) {
+         metrics_RecordPredictionMiss(&sync->_metrics, i);
+      }
       if (incorrect != GAMEINPUT_NULL_FRAME && (first_incorrect == GAMEINPUT_NULL_FRAME || incorrect < first_incorrect)) {
          first_incorrect = incorrect;
       }
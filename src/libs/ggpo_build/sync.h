@@ -29,6 +29,7 @@
 #include "game_input.h"
 #include "input_queue.h"
 #include "ring_buffer.h"
+#include "metrics.h"
 
 #define MAX_PREDICTION_FRAMES    8
 
@@ -90,6 +91,11 @@ struct Sync
         RingBuffer _event_queue_ring;
         sync_Event _event_queue[32];
         UdpMsg_connect_status* _local_connect_status;
+
+        Metrics        _metrics;
+
+        GGPOInputPredictor _predictor;
+        bool           _has_predictor;
 };
 typedef struct Sync Sync;
 
@@ -99,6 +105,7 @@ void sync_Init(Sync *sync, sync_Config* config);
 
 void sync_SetLastConfirmedFrame(Sync* sync, int frame);
 void sync_SetFrameDelay(Sync* sync, int queue, int delay);
+void sync_SetInputPredictor(Sync* sync, GGPOInputPredictor const* predictor);
 bool sync_AddLocalInput(Sync* sync, int queue, GameInput* input);
 void sync_AddRemoteInput(Sync* sync, int queue, GameInput* input);
 int sync_GetConfirmedInputs(Sync* sync, void* values, int size, int frame);
@@ -108,9 +115,16 @@ void sync_AdjustSimulation(Sync* sync, int seek_to);
 void sync_IncrementFrame(Sync* sync);
 inline int sync_GetFrameCount(Sync* sync) { return sync->_framecount; }
 inline bool sync_InRollback(Sync* sync) { return sync->_rollingback; }
+// for the backends that resimulate on their own, the resimulated frames do not begin metrics samples
+inline void sync_SetRollingBack(Sync* sync, bool rollingback) { sync->_rollingback = rollingback; }
 bool sync_GetEvent(Sync* sync, sync_Event* e);
 sync_SavedFrame* sync_GetLastSavedFrame(Sync* sync);
 void sync_SaveCurrentFrame(Sync* sync);
 void sync_LoadFrame(Sync* sync, int frame);
+bool sync_GetSavedChecksum(Sync* sync, int frame, int* checksum);
+inline Metrics* sync_GetMetrics(Sync* sync) { return &sync->_metrics; }
+inline int sync_GetFrameDelay(Sync* sync, int queue) { return input_queue_GetFrameDelay(&sync->_input_queues[queue]); }
+// the input of a local queue, including the frames padded by a larger frame delay
+inline bool sync_GetLocalInput(Sync* sync, int queue, int frame, GameInput* input) { return input_queue_GetConfirmedInput(&sync->_input_queues[queue], frame, input); }
 #endif
 
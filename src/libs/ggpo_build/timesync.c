@@ -27,6 +27,8 @@ void timesync_init(TimeSync* timesync)
 {
 	memset(timesync->_local, 0, sizeof(timesync->_local));
 	memset(timesync->_remote, 0, sizeof(timesync->_remote));
+	timesync->_local_sum = 0;
+	timesync->_remote_sum = 0;
 	timesync->_next_prediction = FRAME_WINDOW_SIZE * 3;
 }
 
@@ -36,26 +38,20 @@ void timesync_advance_frame(TimeSync* timesync, GameInput* input, int advantage,
 
 	// Remember the last frame and frame advantage
 	timesync->_last_inputs[input->frame % ARRAY_SIZE(timesync->_last_inputs)] = *input;
-	timesync->_local[input->frame % ARRAY_SIZE(timesync->_local)] = advantage;
-	timesync->_remote[input->frame % ARRAY_SIZE(timesync->_remote)] = radvantage;
+	int i = input->frame % ARRAY_SIZE(timesync->_local);
+	timesync->_local_sum += advantage - timesync->_local[i];
+	timesync->_remote_sum += radvantage - timesync->_remote[i];
+	timesync->_local[i] = advantage;
+	timesync->_remote[i] = radvantage;
 
 }
 
 int timesync_recommend_frame_wait_duration(TimeSync const* timesync, bool require_idle_input)
 {
 	// Average our local and remote frame advantages
-	int i, sum = 0;
-	float advantage, radvantage;
-	for (i = 0; i < ARRAY_SIZE(timesync->_local); i++) {
-		sum += timesync->_local[i];
-	}
-	advantage = sum / (float)ARRAY_SIZE(timesync->_local);
-
-	sum = 0;
-	for (i = 0; i < ARRAY_SIZE(timesync->_remote); i++) {
-		sum += timesync->_remote[i];
-	}
-	radvantage = sum / (float)ARRAY_SIZE(timesync->_remote);
+	int i;
+	float advantage = timesync->_local_sum / (float)ARRAY_SIZE(timesync->_local);
+	float radvantage = timesync->_remote_sum / (float)ARRAY_SIZE(timesync->_remote);
 
 	static int count = 0;
 	count++;
@@ -97,3 +93,17 @@ int timesync_recommend_frame_wait_duration(TimeSync const* timesync, bool requir
 	return MIN(sleep_frames, MAX_FRAME_ADVANTAGE);
 
 }
+
+float timesync_recommend_frame_dilation(TimeSync const* timesync)
+{
+	// Same difference as the frame wait duration, but instead of the client ahead sleeping, both
+	// clients correct half of it by slightly changing their frame period: the one ahead runs longer
+	// frames and the one behind shorter ones. The correction is proportional so they converge
+	// without overshooting, and small enough to not be noticed.
+	float advantage = timesync->_local_sum / (float)ARRAY_SIZE(timesync->_local);
+	float radvantage = timesync->_remote_sum / (float)ARRAY_SIZE(timesync->_remote);
+	float frames_ahead = (radvantage - advantage) / 2;
+	float dilation = frames_ahead * 0.5f / DILATION_CORRECTION_FRAMES;
+	dilation = MIN(MAX(dilation, -MAX_FRAME_DILATION), MAX_FRAME_DILATION);
+	return 1.0f + dilation;
+}
@@ -31,12 +31,16 @@
 #define MIN_UNIQUE_FRAMES           10
 #define MIN_FRAME_ADVANTAGE          3
 #define MAX_FRAME_ADVANTAGE          9
+#define DILATION_CORRECTION_FRAMES  60    // frames to spread a frame advantage correction over
+#define MAX_FRAME_DILATION          0.02f // max change of the frame period, in both directions
 
 
 struct TimeSync
 {
 	int         _local[FRAME_WINDOW_SIZE];
 	int         _remote[FRAME_WINDOW_SIZE];
+	int         _local_sum;  // running sums of the windows
+	int         _remote_sum;
 	GameInput   _last_inputs[MIN_UNIQUE_FRAMES];
 	int         _next_prediction;
 };
@@ -45,5 +49,6 @@ typedef struct TimeSync TimeSync;
 void timesync_init(TimeSync* timesync);
 void timesync_advance_frame(TimeSync* timesync, GameInput* input, int advantage, int radvantage);
 int timesync_recommend_frame_wait_duration(TimeSync const* timesync, bool require_idle_input);
+float timesync_recommend_frame_dilation(TimeSync const* timesync);
 
 #endif
@@ -149,7 +149,14 @@ typedef enum {
  * GGPO_EVENTCODE_TIMESYNC - The time synchronziation code has determined
  * that this client is too far ahead of the other one and should slow
  * down to ensure fairness.  The u.timesync.frames_ahead parameter in
- * the GGPOEvent object indicates how many frames the client is.
+ * the GGPOEvent object indicates how many frames the client is.  Only
+ * sent with GGPO_TIMESYNC_SKIP_FRAMES, see ggpo_set_timesync_mode.
+ *
+ * GGPO_EVENTCODE_DESYNC - The checksum of the saved state of frame
+ * u.desync.frame differs between this client and the remote player
+ * u.desync.player, see ggpo_set_desync_detection.  Both inputs were confirmed
+ * for all the frames before it, the simulations diverged.  Only the first
+ * desync with each player is sent, the next frames differ as well.
  *
  */
 typedef enum {
@@ -161,6 +168,7 @@ typedef enum {
    GGPO_EVENTCODE_TIMESYNC                     = 1005,
    GGPO_EVENTCODE_CONNECTION_INTERRUPTED       = 1006,
    GGPO_EVENTCODE_CONNECTION_RESUMED           = 1007,
+   GGPO_EVENTCODE_DESYNC                       = 1008,
 } GGPOEventCode;
 
 /*
@@ -195,6 +203,12 @@ typedef struct {
       struct {
          GGPOPlayerHandle  player;
       } connection_resumed;
+      struct {
+         GGPOPlayerHandle  player;
+         int               frame;
+         int               local_checksum;
+         int               remote_checksum;
+      } desync;
    } u;
 } GGPOEvent;
 
@@ -277,11 +291,27 @@ typedef struct {
  * network.ping - The roundtrip packet transmission time as calcuated
  * by GGPO.net.  This will be roughly equal to the actual round trip
  * packet transmission time + 2 the interval at which you call ggpo_idle
- * or ggpo_advance_frame.
+ * or ggpo_advance_frame.  In ms, network.ping_us is the same measure
+ * in microseconds, for LAN connections with sub-millisecond pings.
  *
  * network.kbps_sent - The estimated bandwidth used between the two
  * clients, in kilobits per second.
  *
+ * network.bytes_sent - The bytes of the messages sent to the remote client
+ * since the start of the session, without the UDP and IP headers.
+ * network.legacy_bytes_sent is what the same messages would have taken
+ * with the fixed layout of the protocol version 2, to compare the two.
+ *
+ * network.msgs_queued - The total number of messages sent to the remote
+ * client since the start of the session.
+ *
+ * network.msg_heap_allocs - The number of those messages which did not fit
+ * in the preallocated send buffer and had to be allocated on the heap.  It
+ * should stay at 0 once the session is running.
+ *
+ * network.send_buffer_peak - The largest number of bytes waiting in the send
+ * buffer at once.
+ *
  * timesync.local_frames_behind - The number of frames GGPO.net calculates
  * that the local client is behind the remote client at this instant in
  * time.  For example, if at this instant the current game client is running
@@ -291,20 +321,200 @@ typedef struct {
  * timesync.remote_frames_behind - The same as local_frames_behind, but
  * calculated from the perspective of the remote player.
  *
+ * frame_delay.current - The input delay of the local players, in frames.
+ *
+ * frame_delay.wanted, frame_delay.remote_wanted - The input delay wanted
+ * by this client and by the remote one with ggpo_set_adaptive_frame_delay.
+ * The local players move towards the largest of the two.
+ *
+ * frame_delay.rtt_ms, frame_delay.rtt_deviation_ms - The smoothed round
+ * trip time to the remote player and its mean deviation.
+ *
+ * frame_delay.rollback_frames - The rollback depth accepted before adding
+ * input delay, from the cost of the rollbacks.
+ *
  */
 typedef struct GGPONetworkStats {
    struct {
       int   send_queue_len;
       int   recv_queue_len;
       int   ping;
+      int   ping_us;
       int   kbps_sent;
+      int   bytes_sent;
+      int   legacy_bytes_sent;
+      int   msgs_queued;
+      int   msg_heap_allocs;
+      int   send_buffer_peak;
    } network;
    struct {
       int   local_frames_behind;
       int   remote_frames_behind;
    } timesync;
+   struct {
+      int   current;
+      int   wanted;
+      int   remote_wanted;
+      float rtt_ms;
+      float rtt_deviation_ms;
+      float rollback_frames;
+   } frame_delay;
 } GGPONetworkStats;
 
+/*
+ * The GGPORollbackStats structure contains the rollback metrics of a
+ * session, since the start of the session.
+ *
+ * rollbacks, resimulated_frames - The number of rollbacks and the total
+ * number of frames they resimulated.
+ *
+ * resimulated_frames_per_second - The frames resimulated during the last
+ * second.
+ *
+ * rollback_depth - rollback_depth[n] is the number of rollbacks which
+ * resimulated n frames.  max_rollback_depth is the deepest one.
+ *
+ * save, load, advance - The time spent in the save_game_state and
+ * load_game_state callbacks, and in the advance_frame callback for each
+ * resimulated frame (which includes saving that frame), in microseconds.
+ *
+ * rollback - The time of a whole rollback: loading the state and
+ * resimulating the frames.  rollbacks_over_budget counts the rollbacks which
+ * took longer than a 60Hz frame (GGPO_FRAME_BUDGET_US).
+ *
+ * prediction_misses - The number of times the predicted inputs of each
+ * player were wrong, indexed by player_num - 1.
+ *
+ * prediction_stalls - The number of times ggpo_add_local_input returned
+ * GGPO_ERRORCODE_PREDICTION_THRESHOLD because the remote inputs were too
+ * late.
+ *
+ * timesync_events, timesync_frames - The number of GGPO_EVENTCODE_TIMESYNC
+ * events sent to the game, and the total number of frames they asked to
+ * wait.
+ */
+#define GGPO_FRAME_BUDGET_US           16667
+
+typedef struct GGPOTimingStats {
+   int      count;
+   float    avg_us;
+   int      last_us;
+   int      max_us;
+} GGPOTimingStats;
+
+typedef struct GGPORollbackStats {
+   int               rollbacks;
+   int               resimulated_frames;
+   float             resimulated_frames_per_second;
+   int               rollback_depth[GGPO_MAX_PREDICTION_FRAMES + 1];
+   int               max_rollback_depth;
+   GGPOTimingStats   save;
+   GGPOTimingStats   load;
+   GGPOTimingStats   advance;
+   GGPOTimingStats   rollback;
+   int               rollbacks_over_budget;
+   int               prediction_misses[GGPO_MAX_PLAYERS];
+   int               prediction_stalls;
+   int               timesync_events;
+   int               timesync_frames;
+} GGPORollbackStats;
+
+typedef enum {
+   GGPO_STATS_FORMAT_CSV,
+   GGPO_STATS_FORMAT_JSON,
+} GGPOStatsFormat;
+
+/*
+ * GGPOTimeSyncMode - How the clients are kept running at the same pace,
+ * see ggpo_set_timesync_mode.
+ *
+ * GGPO_TIMESYNC_SKIP_FRAMES - The client ahead receives a
+ * GGPO_EVENTCODE_TIMESYNC event and waits that many frames.  This is the
+ * default.
+ *
+ * GGPO_TIMESYNC_DILATION - The clients slightly change their frame period
+ * instead, by the factor returned by ggpo_get_time_dilation.  No frame is
+ * skipped.
+ */
+typedef enum {
+   GGPO_TIMESYNC_SKIP_FRAMES,
+   GGPO_TIMESYNC_DILATION,
+} GGPOTimeSyncMode;
+
+/*
+ * The GGPOInputPredictor structure replaces the input prediction of
+ * ggpo_synchronize_input, see ggpo_set_input_predictor.  By default, the
+ * input of a player which has not arrived yet is predicted to be the same as
+ * their last confirmed input.
+ *
+ * player - The index of the player, player_num - 1.
+ *
+ * observe - Called with every confirmed input of each player, in frame
+ * order.  Use it to learn how the player plays.
+ *
+ * predict - Fills prediction with the input of the player at frame.  The last
+ * confirmed input of the player is last_input, at last_frame (last_input is
+ * NULL and last_frame is -1 before the first one).  frame is always after
+ * last_frame.  The prediction of a frame must not change until the frame is
+ * confirmed or rolled back, GGPO keeps the value that was simulated and
+ * compares it with the confirmed input.
+ */
+typedef struct GGPOInputPredictor {
+   void     *user_data;
+   void     (*observe)(void *user_data, int player, const void *input, int size, int frame);
+   void     (*predict)(void *user_data, int player, const void *last_input, int last_frame, int frame, void *prediction, int size);
+} GGPOInputPredictor;
+
+/*
+ * The GGPOLinkProfile structure describes the network conditions emulated by
+ * ggpo_set_link_profile, on the packets sent by the session.  Set a field to
+ * 0 to disable it.
+ *
+ * latency_ms - The one way delay added to every packet.
+ *
+ * jitter_ms, jitter - The random delay added on top of latency_ms.  With
+ * GGPO_LINK_JITTER_UNIFORM it is between 0 and jitter_ms, with
+ * GGPO_LINK_JITTER_NORMAL it has a standard deviation of jitter_ms, and with
+ * GGPO_LINK_JITTER_EXPONENTIAL it has a mean of jitter_ms.
+ *
+ * loss_good, loss_bad, good_to_bad, bad_to_good - Gilbert-Elliott burst loss.
+ * The link is either in the good or the bad state, packets are lost with a
+ * probability of loss_good or loss_bad depending on the state.  Before each
+ * packet, the link switches to the other state with a probability of
+ * good_to_bad or bad_to_good.  Only set loss_good for uniform loss.
+ *
+ * duplicate - The probability to send a packet twice.
+ *
+ * reorder, reorder_ms - The probability to hold a packet for reorder_ms more
+ * milliseconds, so it arrives after the packets sent right after it.
+ *
+ * bandwidth_kbps - The link capacity in kilobits per second, the packets
+ * queue up behind each other when they are sent faster than that.
+ *
+ * seed - The same seed and the same sequence of packets give the same
+ * losses and delays.
+ */
+typedef enum {
+   GGPO_LINK_JITTER_UNIFORM,
+   GGPO_LINK_JITTER_NORMAL,
+   GGPO_LINK_JITTER_EXPONENTIAL,
+} GGPOLinkJitter;
+
+typedef struct GGPOLinkProfile {
+   int               latency_ms;
+   int               jitter_ms;
+   GGPOLinkJitter    jitter;
+   float             loss_good;
+   float             loss_bad;
+   float             good_to_bad;
+   float             bad_to_good;
+   float             duplicate;
+   float             reorder;
+   int               reorder_ms;
+   int               bandwidth_kbps;
+   unsigned int      seed;
+} GGPOLinkProfile;
+
 /*
  * ggpo_start_session --
  *
@@ -463,6 +673,71 @@ GGPO_API GGPOErrorCode ggpo_set_frame_delay(GGPOSession *,
                                                     GGPOPlayerHandle player,
                                                     int frame_delay);
 
+/*
+ * ggpo_set_input_predictor --
+ *
+ * Predicts the inputs of the players which have not arrived yet with
+ * predictor instead of repeating their last confirmed input.  The predictor
+ * is copied.  Pass NULL to go back to the default prediction.  It can be
+ * changed at any time, the frames already predicted keep their value until
+ * they are confirmed.
+ */
+GGPO_API GGPOErrorCode ggpo_set_input_predictor(GGPOSession *,
+                                                         const GGPOInputPredictor *predictor);
+
+/*
+ * ggpo_set_adaptive_frame_delay --
+ *
+ * Lets the session choose the input delay of the local players, between 0
+ * and max_frame_delay frames, instead of the fixed ggpo_set_frame_delay.
+ * The round trip time and its deviation are measured continuously, and the
+ * delay is the smallest one which keeps most rollbacks within the depth
+ * the session can resimulate in half a frame, and within
+ * GGPO_ADAPTIVE_MAX_ROLLBACK_FRAMES.  Both clients exchange the delay they
+ * want and use the largest one.  The delay changes one frame at a time, only
+ * while the local input is not changing, so no input is lost or added.
+ * Pass 0 to keep the current delay from now on.  See the frame_delay
+ * network stats.
+ */
+#define GGPO_ADAPTIVE_MAX_ROLLBACK_FRAMES 3
+
+GGPO_API GGPOErrorCode ggpo_set_adaptive_frame_delay(GGPOSession *,
+                                                              int max_frame_delay);
+
+/*
+ * ggpo_set_timesync_mode --
+ *
+ * Chooses how the time synchronization corrects a client running ahead of
+ * the others, see GGPOTimeSyncMode.
+ */
+GGPO_API GGPOErrorCode ggpo_set_timesync_mode(GGPOSession *,
+                                                       GGPOTimeSyncMode mode);
+
+/*
+ * ggpo_get_time_dilation --
+ *
+ * Returns the factor to apply to the duration of the next frames with
+ * GGPO_TIMESYNC_DILATION.  It is above 1 when this client is ahead and
+ * below 1 when it is behind, within a few percent, and is updated in
+ * ggpo_idle from running averages of the frame advantages.  Always 1 with
+ * GGPO_TIMESYNC_SKIP_FRAMES.
+ */
+GGPO_API GGPOErrorCode ggpo_get_time_dilation(GGPOSession *,
+                                                       float *dilation);
+
+/*
+ * ggpo_set_desync_detection --
+ *
+ * Sends the checksum returned by save_game_state for every interval-th
+ * frame to the remote players, once all the inputs before that frame are
+ * confirmed, and compares it with theirs.  A different checksum sends
+ * GGPO_EVENTCODE_DESYNC.  Each checksum is a 13 bytes message, about
+ * 40 bytes per second with the UDP headers and an interval of 60 frames.
+ * Both clients have to use the same interval.  Pass 0 to stop (the default).
+ */
+GGPO_API GGPOErrorCode ggpo_set_desync_detection(GGPOSession *,
+                                                          int interval);
+
 /*
  * ggpo_idle --
  * Should be called periodically by your application to give GGPO.net
@@ -555,6 +830,30 @@ GGPO_API GGPOErrorCode ggpo_get_network_stats(GGPOSession *,
                                                       GGPOPlayerHandle player,
                                                       GGPONetworkStats *stats);
 
+/*
+ * ggpo_get_rollback_stats --
+ *
+ * Used to fetch the rollback metrics of the session, see GGPORollbackStats.
+ * Not supported by spectator sessions, which never roll back.
+ */
+GGPO_API GGPOErrorCode ggpo_get_rollback_stats(GGPOSession *,
+                                                        GGPORollbackStats *stats);
+
+/*
+ * ggpo_write_rollback_stats --
+ *
+ * Writes the rollback metrics to filename for offline analysis.  The file
+ * contains one row per frame for the last GGPO_STATS_HISTORY_FRAMES frames:
+ * the rollback depth, the time spent saving, loading and resimulating, and
+ * the prediction stalls of that frame.  The JSON format also contains the
+ * GGPORollbackStats totals.
+ */
+#define GGPO_STATS_HISTORY_FRAMES      3600
+
+GGPO_API GGPOErrorCode ggpo_write_rollback_stats(GGPOSession *,
+                                                          const char *filename,
+                                                          GGPOStatsFormat format);
+
 /*
  * ggpo_set_disconnect_timeout --
  *
@@ -582,6 +881,33 @@ GGPO_API GGPOErrorCode ggpo_set_disconnect_timeout(GGPOSession *,
 GGPO_API GGPOErrorCode ggpo_set_disconnect_notify_start(GGPOSession *,
                                                                 int timeout);
 
+/*
+ * ggpo_start_network_thread --
+ *
+ * Receive packets on a dedicated thread instead of in ggpo_idle.  Packets are
+ * timestamped when they arrive, so the ping and the disconnect timers do not
+ * depend on how often the game calls ggpo_idle.  They are still processed
+ * during ggpo_idle, on the game thread.
+ *
+ * Call it after all the players and spectators have been added.  The thread
+ * is stopped by ggpo_close_session.
+ */
+GGPO_API GGPOErrorCode ggpo_start_network_thread(GGPOSession *);
+
+/*
+ * ggpo_set_link_profile --
+ *
+ * Emulates a bad network on the packets sent by this session, to test the
+ * game under latency, jitter and packet loss without a real network.  The
+ * emulation happens before the packets reach the socket, so set a profile on
+ * both ends to affect both directions.  Pass NULL to go back to the real
+ * network, the packets still held by the emulator are dropped.
+ *
+ * See GGPOLinkProfile for the emulated conditions.
+ */
+GGPO_API GGPOErrorCode ggpo_set_link_profile(GGPOSession *,
+                                                      const GGPOLinkProfile *profile);
+
 /*
  * ggpo_log --
  *
@@ -18,6 +18,8 @@
 #include "tek.h"
 #include "game.h"
 #include "game_battle.h"
+#include "collision.h"
+#include "game_battle_render.h"
 #include "debugdraw.h"
 #include "file.h"
 #include "watcher.h"
@@ -36,6 +38,7 @@ struct Application
 	Renderer *renderer;
 
 	uint64_t current_time;
+	uint64_t current_time_ns;
 	uint64_t f;
 };
 
@@ -81,6 +84,7 @@ static void load_assets(struct AssetLibrary *assets)
 	Serializer s = {0};
 
 	s = serialize_begin_read_file("cooking/3227071964");
+	asset_library_add_content_hash(assets, s.buffer);
 	SkeletalMeshWithAnimationsAsset skeletal_mesh_with_animations;
 	Serialize_SkeletalMeshWithAnimationsAsset(&s, &skeletal_mesh_with_animations);
 	serialize_end_read_file(&s);
@@ -94,17 +98,13 @@ static void load_assets(struct AssetLibrary *assets)
 	load_assets_materials(assets);
 
 	// tek
-	tek_read_character_json();
+	tek_read_character_json(assets);
 }
 
 static void postload_assets(struct AssetLibrary *assets, struct Renderer *renderer)
 {
-	for (uint32_t iskeletal_mesh = 0; iskeletal_mesh < ASSET_SKELETAL_MESH_CAPACITY; ++iskeletal_mesh) {
-		if (assets->skeletal_meshes_id[iskeletal_mesh] == 0) {
-			break;
-		}
-
-		SkeletalMeshAsset *skeletal_mesh = assets->skeletal_meshes + iskeletal_mesh;
+	for (uint32_t iskeletal_mesh = 0; iskeletal_mesh < assets->skeletal_meshes.length; ++iskeletal_mesh) {
+		SkeletalMeshAsset *skeletal_mesh = asset_table_at(&assets->skeletal_meshes, iskeletal_mesh, sizeof(SkeletalMeshAsset));
 		renderer_create_render_skeletal_mesh(renderer, skeletal_mesh, iskeletal_mesh);
 	}
 }
@@ -564,6 +564,9 @@ SDL_AppResult SDL_AppIterate(void *appstate)
 	uint64_t new_time = SDL_GetTicks();
 	uint64_t previous_frame_time = new_time - application->current_time;
 	application->current_time = new_time;
+	uint64_t new_time_ns = SDL_GetTicksNS();
+	uint64_t previous_frame_time_us = (new_time_ns - application->current_time_ns) / 1000;
+	application->current_time_ns = new_time_ns;
 
 	// inputs_imgui(&application->inputs);
 
@@ -571,6 +574,7 @@ SDL_AppResult SDL_AppIterate(void *appstate)
 	update_ctx.inputs = application->inputs;
 	update_ctx.current_time = application->current_time;
 	update_ctx.previous_frame_time = previous_frame_time;
+	update_ctx.previous_frame_time_us = previous_frame_time_us;
 	update_ctx.f = application->f;
 	game_update(&application->game, &update_ctx);
 
@@ -603,6 +607,8 @@ SDL_AppResult SDL_AppIterate(void *appstate)
 #include "renderer.c"
 #include "game.c"
 #include "game_battle.c"
+#include "game_replay.c"
+#include "game_battle_render.c"
 #include "game_mainmenu.c"
 #include "game_local_battle.c"
 #include "game_network_battle.c"
@@ -610,6 +616,7 @@ SDL_AppResult SDL_AppIterate(void *appstate)
 #include "anim.c"
 #include "game_components.c"
 #include "tek.c"
+#include "collision.c"
 #include <ufbx.c>
 #include "watcher.c"
 #include "drawer2d.c"
@@ -171,6 +171,7 @@ Quat quat_normalize(Quat a)
 	r.x = a.x / norm;
 	r.y = a.y / norm;
 	r.z = a.z / norm;
+	r.w = a.w / norm;
 	return r;
 }
 
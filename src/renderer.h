@@ -5,6 +5,7 @@ typedef struct Camera Camera;
 struct SkeletalMeshInstance;
 struct AssetLibrary;
 struct Drawer2D;
+struct SDL_Window;
 
 struct Camera
 {
@@ -63,7 +64,7 @@ struct RendererTextureUpload
 
 // init
 uint32_t renderer_get_size(void);
-void renderer_init(Renderer *renderer, struct AssetLibrary *assets, SDL_Window *window);
+void renderer_init(Renderer *renderer, struct AssetLibrary *assets, struct SDL_Window *window);
 void renderer_init_materials(Renderer *renderer, struct AssetLibrary *assets);
 void renderer_create_render_skeletal_mesh(Renderer *renderer, struct SkeletalMeshAsset *asset, uint32_t handle);
 // game init
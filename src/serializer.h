@@ -19,7 +19,8 @@ struct Serializer
 enum SerializerVersions
 {
 	SV_INITIAL=0, // first commit
-	SV_LATEST=SV_INITIAL,
+	SV_ANIM_CLIP, // compressed animation tracks
+	SV_LATEST=SV_ANIM_CLIP,
 };
 
 
@@ -409,6 +409,7 @@ static void tek_read_json_hurtbox(struct tek_Character *character, struct json_o
 	ASSERT(ibox < ARRAY_LENGTH(character->hurtboxes_radius));
 	character->hurtboxes_radius[ibox] = radius;
 	character->hurtboxes_height[ibox] = height;
+	character->hurtboxes_half_height[ibox] = height * 0.5f;
 	character->hurtboxes_bone_id[ibox] = bone_id;
 	character->hurtboxes_length += 1;
 }
@@ -432,6 +433,7 @@ static void tek_read_json_hitbox(struct tek_Character *character, struct json_ob
 	ASSERT(ibox < ARRAY_LENGTH(character->hitboxes_radius));
 	character->hitboxes_radius[ibox] = radius;
 	character->hitboxes_height[ibox] = height;
+	character->hitboxes_half_height[ibox] = height * 0.5f;
 	character->hitboxes_bone_id[ibox] = bone_id;
 	character->hitboxes_length += 1;
 }
@@ -456,34 +458,337 @@ static uint32_t tek_create_hit_reactions_move(struct tek_Character *character,
 	return new_move->id;
 }
 
+// Load-time lookup, the move lookup table is built once all moves are created
+static struct tek_Move *tek_character_find_move_linear(struct tek_Character *character, uint32_t id)
+{
+	ASSERT(id != 0);
+	for (uint32_t imove = 0; imove < character->moves_length; ++imove) {
+		if (character->moves[imove].id == id) {
+			return character->moves + imove;
+		}
+	}
+	return NULL;
+}
+
 static void tek_create_hit_reactions_moves(struct tek_Character *c)
 {
 	for (uint32_t i = 0; i < c->hit_reactions_length; ++i) {
 		struct tek_HitReactions *r = c->hit_reactions + i;
 		if (r->standing_move) {
-			struct tek_Move *standing_move = tek_character_find_move(c, r->standing_move);
+			struct tek_Move *standing_move = tek_character_find_move_linear(c, r->standing_move);
 			r->standing_move = tek_create_hit_reactions_move(c, i, standing_move, r->standing_stun, "%s_standing_r%u");
 		}
 		if (r->standing_counter_hit_move) {
-			struct tek_Move *standing_ch_move = tek_character_find_move(c, r->standing_counter_hit_move);
+			struct tek_Move *standing_ch_move = tek_character_find_move_linear(c, r->standing_counter_hit_move);
 			r->standing_counter_hit_move = tek_create_hit_reactions_move(c, i, standing_ch_move, r->standing_counter_hit_stun, "%s_standing_ch_r%u");
 		}
 		if (r->standing_block_move) {
-			struct tek_Move *standing_block_move = tek_character_find_move(c, r->standing_block_move);
+			struct tek_Move *standing_block_move = tek_character_find_move_linear(c, r->standing_block_move);
 			r->standing_block_move = tek_create_hit_reactions_move(c, i, standing_block_move, r->standing_block_stun, "%s_standing_blk_r%u");
 		}
 		if (r->crouch_move) {
-			struct tek_Move *crouch_move = tek_character_find_move(c, r->crouch_move);
+			struct tek_Move *crouch_move = tek_character_find_move_linear(c, r->crouch_move);
 			r->crouch_move = tek_create_hit_reactions_move(c, i, crouch_move, r->crouch_stun, "%s_crouch_r%u");
 		}
 		if (r->crouch_block_move) {
-			struct tek_Move *crouch_block_move = tek_character_find_move(c, r->crouch_block_move);
+			struct tek_Move *crouch_block_move = tek_character_find_move_linear(c, r->crouch_block_move);
 			r->crouch_block_move = tek_create_hit_reactions_move(c, i, crouch_block_move, r->crouch_block_stun, "%s_crouch_blk_r%u");
 		}
 	}
 }
 
-void tek_read_character_json()
+static uint32_t tek_move_lookup_hash(uint32_t id, uint32_t seed)
+{
+	// murmur3 finalizer
+	uint32_t h = id ^ (seed * 0x9E3779B9u);
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h;
+}
+
+static void tek_build_move_lookup(struct tek_Character *character)
+{
+	struct tek_MoveLookup *lookup = &character->move_lookup;
+	memset(lookup->seeds, 0, sizeof(lookup->seeds));
+	for (uint32_t islot = 0; islot < MOVE_LOOKUP_SIZE; ++islot) {
+		lookup->slots[islot] = TEK_INVALID_MOVE;
+	}
+
+	// Group moves by bucket, duplicated ids keep the first move like a linear search would
+	uint32_t move_bucket[MAX_MOVES];
+	uint32_t bucket_length[MOVE_LOOKUP_BUCKETS] = {0};
+	for (uint32_t imove = 0; imove < character->moves_length; ++imove) {
+		uint32_t id = character->moves[imove].id;
+		move_bucket[imove] = MOVE_LOOKUP_BUCKETS;
+		if (id == 0 || tek_character_find_move_linear(character, id) != character->moves + imove) {
+			continue;
+		}
+		move_bucket[imove] = tek_move_lookup_hash(id, 0) % MOVE_LOOKUP_BUCKETS;
+		bucket_length[move_bucket[imove]] += 1;
+	}
+
+	// Place the largest buckets first, find a seed that sends all their moves to free slots
+	bool bucket_placed[MOVE_LOOKUP_BUCKETS] = {0};
+	for (uint32_t iplaced = 0; iplaced < MOVE_LOOKUP_BUCKETS; ++iplaced) {
+		uint32_t ibucket = MOVE_LOOKUP_BUCKETS;
+		for (uint32_t i = 0; i < MOVE_LOOKUP_BUCKETS; ++i) {
+			if (!bucket_placed[i] && (ibucket == MOVE_LOOKUP_BUCKETS || bucket_length[i] > bucket_length[ibucket])) {
+				ibucket = i;
+			}
+		}
+		if (bucket_length[ibucket] == 0) {
+			break;
+		}
+		bucket_placed[ibucket] = true;
+
+		bool found_seed = false;
+		for (uint32_t seed = 0; seed <= UINT16_MAX && !found_seed; ++seed) {
+			uint32_t placed_slots[MAX_MOVES];
+			uint32_t placed_length = 0;
+			found_seed = true;
+			for (uint32_t imove = 0; imove < character->moves_length; ++imove) {
+				if (move_bucket[imove] != ibucket) {
+					continue;
+				}
+				uint32_t islot = tek_move_lookup_hash(character->moves[imove].id, seed + 1) & (MOVE_LOOKUP_SIZE - 1);
+				if (lookup->slots[islot] != TEK_INVALID_MOVE) {
+					found_seed = false;
+					break;
+				}
+				lookup->slots[islot] = (tek_MoveIndex)imove;
+				placed_slots[placed_length++] = islot;
+			}
+			if (found_seed) {
+				lookup->seeds[ibucket] = (uint16_t)seed;
+			} else {
+				for (uint32_t i = 0; i < placed_length; ++i) {
+					lookup->slots[placed_slots[i]] = TEK_INVALID_MOVE;
+				}
+			}
+		}
+		ASSERT(found_seed);
+	}
+}
+
+static tek_MoveIndex tek_resolve_move(struct tek_Character const *character, uint32_t id)
+{
+	if (id == 0) {
+		return TEK_INVALID_MOVE;
+	}
+	return tek_character_find_move_index(character, id);
+}
+
+static void tek_resolve_cancel(struct tek_Character const *character, struct tek_Cancel *cancel)
+{
+	cancel->ito_move = TEK_INVALID_MOVE;
+	if (cancel->to_move_id == 0) {
+		return;
+	}
+	if (cancel->type == TEK_CANCEL_TYPE_LIST) {
+		for (uint32_t igroup = 0; igroup < character->cancel_groups_length; ++igroup) {
+			if (character->cancel_groups[igroup].id == cancel->to_move_id) {
+				cancel->ito_move = (tek_MoveIndex)igroup;
+				break;
+			}
+		}
+	} else {
+		cancel->ito_move = tek_resolve_move(character, cancel->to_move_id);
+	}
+}
+
+// Replace ids by indices so the simulation never has to look up a move
+static void tek_resolve_character_indices(struct tek_Character *character)
+{
+	for (uint32_t imove = 0; imove < character->moves_length; ++imove) {
+		struct tek_Move *move = character->moves + imove;
+		for (uint32_t icancel = 0; icancel < ARRAY_LENGTH(move->cancels); ++icancel) {
+			tek_resolve_cancel(character, move->cancels + icancel);
+		}
+	}
+	for (uint32_t igroup = 0; igroup < character->cancel_groups_length; ++igroup) {
+		struct tek_CancelGroup *group = character->cancel_groups + igroup;
+		for (uint32_t icancel = 0; icancel < ARRAY_LENGTH(group->cancels); ++icancel) {
+			struct tek_Cancel *cancel = group->cancels + icancel;
+			// groups are only one level deep, the index of a nested group would be flattened as a move
+			if (cancel->type == TEK_CANCEL_TYPE_LIST) {
+				if (cancel->to_move_id != 0) {
+					fprintf(stderr, "[tek] cancel group %u lists the cancel group %u, ignoring it\n", group->id, cancel->to_move_id);
+				}
+				cancel->ito_move = TEK_INVALID_MOVE;
+				continue;
+			}
+			tek_resolve_cancel(character, cancel);
+		}
+	}
+	for (uint32_t i = 0; i < character->hit_reactions_length; ++i) {
+		struct tek_HitReactions *r = character->hit_reactions + i;
+		r->istanding_move = tek_resolve_move(character, r->standing_move);
+		r->istanding_counter_hit_move = tek_resolve_move(character, r->standing_counter_hit_move);
+		r->istanding_block_move = tek_resolve_move(character, r->standing_block_move);
+		r->icrouch_move = tek_resolve_move(character, r->crouch_move);
+		r->icrouch_block_move = tek_resolve_move(character, r->crouch_block_move);
+	}
+	character->imove_death = tek_resolve_move(character, (uint32_t)TEK_MOVE_DEATH_ID);
+}
+
+static uint8_t tek_resolve_box_bone(struct AnimSkeleton const *anim_skeleton, uint32_t bone_id)
+{
+	uint32_t ibone = anim_skeleton_find_bone(anim_skeleton, bone_id);
+	if (ibone == MAX_BONES_PER_MESH) {
+		fprintf(stderr, "[tek] box bone %u is not in the skeleton, using the root bone\n", bone_id);
+		ibone = 0;
+	}
+	return (uint8_t)ibone;
+}
+
+// Resolve asset ids to handles so the simulation never hashes an asset id
+static void tek_resolve_character_assets(struct tek_Character *character, struct AssetLibrary *assets)
+{
+	character->anim_skeleton = asset_library_find_anim_skeleton(assets, character->anim_skeleton_id);
+	ASSERT(character->anim_skeleton != ASSET_HANDLE_INVALID);
+	// bind the boxes to the skeleton
+	AnimSkeleton const *anim_skeleton = asset_library_anim_skeleton_from_handle(assets, character->anim_skeleton);
+	for (uint32_t ibox = 0; ibox < character->hurtboxes_length; ++ibox) {
+		character->hurtboxes_bone_index[ibox] = tek_resolve_box_bone(anim_skeleton, character->hurtboxes_bone_id[ibox]);
+	}
+	for (uint32_t ibox = 0; ibox < character->hitboxes_length; ++ibox) {
+		character->hitboxes_bone_index[ibox] = tek_resolve_box_bone(anim_skeleton, character->hitboxes_bone_id[ibox]);
+	}
+	for (uint32_t imove = 0; imove < character->moves_length; ++imove) {
+		struct tek_Move *move = character->moves + imove;
+		move->animation = asset_library_find_animation(assets, move->animation_id);
+		ASSERT(move->animation != ASSET_HANDLE_INVALID);
+		Animation const *animation = asset_library_animation_from_handle(assets, move->animation);
+		move->animation_length = animation->root_motion_track.translations.length;
+	}
+}
+
+// A cancel of a move with its frame conditions resolved, it can fire in [first_frame, last_frame]
+struct tek_FlatCancel
+{
+	struct tek_CompiledCancel compiled;
+	uint32_t first_frame;
+	uint32_t last_frame;
+};
+
+static uint32_t tek_flatten_cancel(struct tek_FlatCancel *flat, uint32_t flat_length, struct tek_Cancel const *cancel, uint32_t min_frame, uint32_t animation_length)
+{
+	if (cancel->ito_move == TEK_INVALID_MOVE) {
+		return flat_length;
+	}
+
+	uint32_t first_frame = cancel->starting_frame;
+	if (cancel->condition == TEK_CANCEL_CONDITION_END_OF_ANIMATION) {
+		first_frame = animation_length;
+	}
+	if (first_frame < min_frame) {
+		first_frame = min_frame;
+	}
+	uint32_t last_frame = UINT32_MAX;
+	// no input window means the whole animation
+	if (cancel->input_window_start != 0 || cancel->input_window_end != 0) {
+		if (first_frame < cancel->input_window_start) {
+			first_frame = cancel->input_window_start;
+		}
+		last_frame = cancel->input_window_end;
+	}
+	if (first_frame > last_frame) {
+		return flat_length;
+	}
+
+	struct tek_FlatCancel *f = flat + flat_length;
+	f->compiled.command = cancel->command;
+	f->compiled.ito_move = cancel->ito_move;
+	f->compiled.type = cancel->type;
+	f->first_frame = first_frame;
+	f->last_frame = last_frame;
+	return flat_length + 1;
+}
+
+/**
+Flatten the direct cancels and the cancels of the groups of a move in priority order, then split the
+animation in segments where the set of cancels that can fire does not change. At runtime, the
+cancel matching only finds the segment of the current frame and checks the inputs of its cancels.
+ **/
+static void tek_compile_move_cancels(struct tek_Character *character, struct tek_Move *move)
+{
+	struct tek_FlatCancel flat[MAX_CANCELS_PER_MOVE * MAX_CANCELS_PER_GROUP];
+	uint32_t flat_length = 0;
+	for (uint32_t icancel = 0; icancel < move->cancels_length; ++icancel) {
+		struct tek_Cancel const *cancel = move->cancels + icancel;
+		if (cancel->type != TEK_CANCEL_TYPE_LIST) {
+			flat_length = tek_flatten_cancel(flat, flat_length, cancel, 0, move->animation_length);
+		} else if (cancel->ito_move != TEK_INVALID_MOVE) {
+			// the group is gated by the starting frame of the list cancel
+			uint32_t group_first_frame = cancel->starting_frame;
+			if (cancel->condition == TEK_CANCEL_CONDITION_END_OF_ANIMATION) {
+				group_first_frame = move->animation_length;
+			}
+			struct tek_CancelGroup const *group = character->cancel_groups + cancel->ito_move;
+			for (uint32_t igroupcancel = 0; igroupcancel < group->cancels_length; ++igroupcancel) {
+				flat_length = tek_flatten_cancel(flat, flat_length, group->cancels + igroupcancel, group_first_frame, move->animation_length);
+			}
+		}
+	}
+
+	// segment boundaries, sorted
+	uint32_t boundaries[1 + 2 * ARRAY_LENGTH(flat)];
+	uint32_t boundaries_length = 0;
+	boundaries[boundaries_length++] = 0;
+	for (uint32_t iflat = 0; iflat < flat_length; ++iflat) {
+		boundaries[boundaries_length++] = flat[iflat].first_frame;
+		if (flat[iflat].last_frame != UINT32_MAX) {
+			boundaries[boundaries_length++] = flat[iflat].last_frame + 1;
+		}
+	}
+	for (uint32_t i = 1; i < boundaries_length; ++i) {
+		uint32_t boundary = boundaries[i];
+		uint32_t j = i;
+		for (; j > 0 && boundaries[j - 1] > boundary; --j) {
+			boundaries[j] = boundaries[j - 1];
+		}
+		boundaries[j] = boundary;
+	}
+
+	move->cancel_segments_offset = (uint16_t)character->cancel_segments_length;
+	move->cancel_segments_length = 0;
+	for (uint32_t iboundary = 0; iboundary < boundaries_length; ++iboundary) {
+		uint32_t first_frame = boundaries[iboundary];
+		if (iboundary > 0 && first_frame == boundaries[iboundary - 1]) {
+			continue;
+		}
+
+		ASSERT(character->cancel_segments_length < MAX_CANCEL_SEGMENTS);
+		struct tek_CancelSegment *segment = character->cancel_segments + character->cancel_segments_length;
+		character->cancel_segments_length += 1;
+		move->cancel_segments_length += 1;
+		segment->first_frame = first_frame;
+		segment->cancels_offset = (uint16_t)character->cancel_program_length;
+		segment->cancels_length = 0;
+		for (uint32_t iflat = 0; iflat < flat_length; ++iflat) {
+			if (flat[iflat].first_frame <= first_frame && first_frame <= flat[iflat].last_frame) {
+				ASSERT(character->cancel_program_length < MAX_CANCEL_PROGRAM_LENGTH);
+				character->cancel_program[character->cancel_program_length] = flat[iflat].compiled;
+				character->cancel_program_length += 1;
+				segment->cancels_length += 1;
+			}
+		}
+	}
+}
+
+static void tek_compile_character_cancels(struct tek_Character *character)
+{
+	character->cancel_program_length = 0;
+	character->cancel_segments_length = 0;
+	for (uint32_t imove = 0; imove < character->moves_length; ++imove) {
+		tek_compile_move_cancels(character, character->moves + imove);
+	}
+}
+
+void tek_read_character_json(struct AssetLibrary *assets)
 {
 	const char* source_path = "assets/michel.character.json";
 
@@ -491,6 +796,7 @@ void tek_read_character_json()
 	character.max_health = 100;
 
 	struct Blob character_json_file = file_read_entire_file(source_path);
+	character.content_hash = XXH3_64bits(character_json_file.data, character_json_file.size);
 	struct json_value_s* root = json_parse_ex(character_json_file.data, character_json_file.size, json_parse_flags_allow_c_style_comments | json_parse_flags_allow_trailing_comma , NULL, NULL, NULL);
 	ASSERT(root->type == json_type_object);
 
@@ -548,18 +854,34 @@ void tek_read_character_json()
 		}
 	}
 
+	tek_build_move_lookup(&character);
+	tek_resolve_character_indices(&character);
+	tek_resolve_character_assets(&character, assets);
+	tek_compile_character_cancels(&character);
+
 	tek_characters[0] = character;
 }
 
+tek_MoveIndex tek_character_find_move_index(struct tek_Character const *character, uint32_t id)
+{
+	struct tek_MoveLookup const *lookup = &character->move_lookup;
+	uint32_t ibucket = tek_move_lookup_hash(id, 0) % MOVE_LOOKUP_BUCKETS;
+	uint32_t islot = tek_move_lookup_hash(id, (uint32_t)lookup->seeds[ibucket] + 1) & (MOVE_LOOKUP_SIZE - 1);
+	tek_MoveIndex imove = lookup->slots[islot];
+	if (imove != TEK_INVALID_MOVE && character->moves[imove].id == id) {
+		return imove;
+	}
+	return TEK_INVALID_MOVE;
+}
+
 struct tek_Move *tek_character_find_move(struct tek_Character *character, uint32_t id)
 {
 	ASSERT(id != 0);
-	for (uint32_t imove = 0; imove < ARRAY_LENGTH(character->moves); ++imove) {
-		if (character->moves[imove].id == id) {
-			return character->moves + imove;
-		}
+	tek_MoveIndex imove = tek_character_find_move_index(character, id);
+	if (imove == TEK_INVALID_MOVE) {
+		return NULL;
 	}
-	return NULL;
+	return character->moves + imove;
 }
 
 struct tek_CancelGroup *tek_character_find_cancel_group(struct tek_Character *character, uint32_t id)
@@ -5,6 +5,15 @@
 #define MAX_CANCELS_PER_GROUP 32
 #define MAX_CANCEL_GROUPS 16
 #define MAX_HITBOXES 8
+#define MAX_MOVES 128
+#define MAX_CANCEL_PROGRAM_LENGTH 2048 // compiled cancels of all moves, repeated in each segment they can fire in
+#define MAX_CANCEL_SEGMENTS 1024
+#define MOVE_LOOKUP_BUCKETS 64 // perfect hash buckets, each has its own seed
+#define MOVE_LOOKUP_SIZE 256 // perfect hash slots, must be a power of 2
+
+// Index in tek_Character.moves, ids are only used at load time and by external lookups
+typedef uint16_t tek_MoveIndex;
+#define TEK_INVALID_MOVE ((tek_MoveIndex)0xFFFF)
 
 // -- Runtime data
 
@@ -36,6 +45,7 @@ enum tek_MotionInputBits
 	TEK_MOTION_INPUT_UB      = 7,
 	TEK_MOTION_INPUT_U       = 8,
 	TEK_MOTION_INPUT_UF      = 9,
+	TEK_MOTION_INPUT_COUNT,
 };
 typedef uint8_t tek_MotionInput;
 typedef uint16_t tek_MotionInputSet;
@@ -46,7 +56,8 @@ enum tek_ActionInputBits
 	TEK_ACTION_INPUT_LP      = 0,
 	TEK_ACTION_INPUT_RP      = 1,
 	TEK_ACTION_INPUT_LK      = 2,
-	TEK_ACTION_INPUT_RK      = 3
+	TEK_ACTION_INPUT_RK      = 3,
+	TEK_ACTION_INPUT_COUNT,
 };
 typedef uint8_t tek_ActionInput;
 typedef uint8_t tek_ActionInputSet;
@@ -113,7 +124,8 @@ typedef uint8_t tek_CancelCondition;
 
 struct tek_Cancel
 {
-	uint32_t to_move_id; // cancel group index if type is list
+	uint32_t to_move_id; // cancel group id if type is list
+	tek_MoveIndex ito_move; // resolved at load, index in cancel_groups if type is list
 	union tek_Command command;
 	tek_CancelType type;
 	tek_CancelCondition condition;
@@ -122,6 +134,22 @@ struct tek_Cancel
 	uint8_t starting_frame; // at which frame of the current move the cancel should be applied (does not read input?)
 };
 
+// Cancel compiled at load, its frame conditions are resolved by the segments that contain it
+struct tek_CompiledCancel
+{
+	union tek_Command command;
+	tek_MoveIndex ito_move;
+	tek_CancelType type;
+};
+
+// Cancels of a move that can fire from first_frame until the next segment, in priority order
+struct tek_CancelSegment
+{
+	uint32_t first_frame;
+	uint16_t cancels_offset; // in tek_Character.cancel_program
+	uint16_t cancels_length;
+};
+
 struct tek_CancelGroup
 {
 	uint32_t id;
@@ -175,6 +203,8 @@ struct tek_Move
 	uint32_t id;
 	// animation
 	uint32_t animation_id;
+	AssetHandle animation; // resolved at load
+	uint32_t animation_length; // resolved at load
 	float animation_root_motion_scale;
 	// hit
 	enum tek_HitLevel hit_level;
@@ -188,6 +218,8 @@ struct tek_Move
 	// cancels
 	struct tek_Cancel cancels[MAX_CANCELS_PER_MOVE];
 	uint32_t cancels_length;
+	uint16_t cancel_segments_offset; // compiled at load, in tek_Character.cancel_segments
+	uint16_t cancel_segments_length;
 	// hit conditions
 	struct tek_HitCondition hit_conditions[MAX_HIT_CONDITIONS_PER_MOVE];
 	uint32_t hit_conditions_length;
@@ -202,6 +234,12 @@ struct tek_HitReactions
 	uint32_t standing_block_move;
 	uint32_t crouch_move;
 	uint32_t crouch_block_move;
+	// resolved at load
+	tek_MoveIndex istanding_move;
+	tek_MoveIndex istanding_counter_hit_move;
+	tek_MoveIndex istanding_block_move;
+	tek_MoveIndex icrouch_move;
+	tek_MoveIndex icrouch_block_move;
 	// number of stun frames (relative to recovery of attack) for each move
 	int8_t standing_stun;
 	int8_t standing_counter_hit_stun;
@@ -215,33 +253,53 @@ struct tek_DebugName
 	char string[32];
 };
 
+// Hash and displace: bucket = hash(id, 0), slot = hash(id, seeds[bucket])
+struct tek_MoveLookup
+{
+	uint16_t seeds[MOVE_LOOKUP_BUCKETS];
+	tek_MoveIndex slots[MOVE_LOOKUP_SIZE];
+};
+
 struct tek_Character
 {
 	uint32_t id;
+	uint64_t content_hash; // of the character json, identifies the frame data of a replay
 	uint32_t skeletal_mesh_id;
 	uint32_t anim_skeleton_id;
+	AssetHandle anim_skeleton; // resolved at load
 	float colision_radius;
 	int max_health;
 	// moves
-	struct tek_Move moves[128];
+	struct tek_Move moves[MAX_MOVES];
 	uint32_t moves_length;
+	struct tek_MoveLookup move_lookup;
+	tek_MoveIndex imove_death;
 	struct tek_CancelGroup cancel_groups[MAX_CANCEL_GROUPS];
 	uint32_t cancel_groups_length;
+	// direct and group cancels of every move, sorted by frame window
+	struct tek_CompiledCancel cancel_program[MAX_CANCEL_PROGRAM_LENGTH];
+	uint32_t cancel_program_length;
+	struct tek_CancelSegment cancel_segments[MAX_CANCEL_SEGMENTS];
+	uint32_t cancel_segments_length;
 	// reactions
 	struct tek_HitReactions hit_reactions[128];
 	uint32_t hit_reactions_length;
 	// hurtboxes, 0 or 1 per bone
 	float hurtboxes_radius[MAX_BONES_PER_MESH];
 	float hurtboxes_height[MAX_BONES_PER_MESH];
+	float hurtboxes_half_height[MAX_BONES_PER_MESH];
 	uint32_t hurtboxes_bone_id[MAX_BONES_PER_MESH];
+	uint8_t hurtboxes_bone_index[MAX_BONES_PER_MESH]; // resolved at load, in the anim skeleton
 	uint32_t hurtboxes_length;
 	// hitboxes, referrenced by index in this list
 	float hitboxes_radius[MAX_HITBOXES];
 	float hitboxes_height[MAX_HITBOXES];
+	float hitboxes_half_height[MAX_HITBOXES];
 	uint32_t hitboxes_bone_id[MAX_HITBOXES];
+	uint8_t hitboxes_bone_index[MAX_HITBOXES]; // resolved at load, in the anim skeleton
 	uint32_t hitboxes_length;
 
-	struct tek_DebugName move_names[128+1];
+	struct tek_DebugName move_names[MAX_MOVES+1];
 };
 
 
@@ -249,7 +307,9 @@ struct tek_Character
 struct tek_Character tek_characters[1] = {0};
 const char* tek_characters_filename[1] = {"michel.character.json"};
 
-void tek_read_character_json();
+struct AssetLibrary;
+void tek_read_character_json(struct AssetLibrary *assets);
 
+tek_MoveIndex tek_character_find_move_index(struct tek_Character const *character, uint32_t id);
 struct tek_Move *tek_character_find_move(struct tek_Character *character, uint32_t id);
 struct tek_CancelGroup *tek_character_find_cancel_group(struct tek_Character *character, uint32_t id);